@@ -4,16 +4,13 @@
 using namespace DirectX;
 
 DisplayHDR10App::DisplayHDR10App()
+  : m_hdr10Feature(0)
 {
 }
 
 void DisplayHDR10App::Prepare()
 {
   SetTitle("DisplayHDR10");
-
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
-
   PrepareTeapot();
 }
 
@@ -24,27 +21,21 @@ void DisplayHDR10App::Cleanup()
 void DisplayHDR10App::Render()
 {
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(), nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
   // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
-  RenderTeapot();
+  RenderTeapot(commandList);
 
   // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -55,7 +46,7 @@ void DisplayHDR10App::OnSizeChanged(UINT width, UINT height, bool isMinimized)
   D3D12AppBase::OnSizeChanged(width, height, isMinimized);
 }
 
-void DisplayHDR10App::RenderTeapot()
+void DisplayHDR10App::RenderTeapot(const GraphicsCommandList& commandList)
 {
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
@@ -64,19 +55,19 @@ void DisplayHDR10App::RenderTeapot()
     0.0f, 0.0f, 0.0f, 0.0f
   };
   // J[obt@EfvXobt@̃NA.
-  m_commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   // r[|[gƃVU[̃Zbg.
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   // eB[|bg̕`.
   auto cb = m_model.sceneCB[m_frameIndex];
@@ -92,20 +83,24 @@ void DisplayHDR10App::RenderTeapot()
   XMStoreFloat4x4(&sceneParam.viewProj, XMMatrixTranspose(mtxView * mtxProj));
   XMStoreFloat4(&sceneParam.lightPos, XMVectorSet(0.0f, 10.0f, 10.0f, 0.0f));
   XMStoreFloat4(&sceneParam.cameraPos, cameraPos);
-  sceneParam.branchFrags.x = m_swapchain->GetFormat() == DXGI_FORMAT_R10G10B10A2_UNORM ? 1.0f : 0.0f;
 
   void* mapped;
   cb->Map(0, nullptr, &mapped);
   memcpy(mapped, &sceneParam, sizeof(sceneParam));
   cb->Unmap(0, nullptr);
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
-  m_commandList->SetPipelineState(m_model.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
+  commandList->SetPipelineState(m_model.pipelines[GetModelShaderFeatures()].Get());
+  commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
+  commandList->IASetIndexBuffer(&m_model.ibView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
+}
+
+ShaderFeatureMask DisplayHDR10App::GetModelShaderFeatures() const
+{
+  return m_swapchain->GetFormat() == DXGI_FORMAT_R10G10B10A2_UNORM ? m_hdr10Feature : 0;
 }
 
 void DisplayHDR10App::PrepareTeapot()
@@ -114,7 +109,7 @@ void DisplayHDR10App::PrepareTeapot()
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -131,7 +126,7 @@ void DisplayHDR10App::PrepareTeapot()
   m_model.vbView.SizeInBytes = bufferSize;
   m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
 
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
 
   bufferSize = sizeof(TeapotModel::TeapotIndices);
   auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -149,31 +144,30 @@ void DisplayHDR10App::PrepareTeapot()
   m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
   m_model.indexCount = _countof(TeapotModel::TeapotIndices);
 
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
+  command->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
 
   // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
+  // Xe[ge[uɂf悤AJڂ̓v[ʂ.
+  m_commandContextPool->Transition(command, m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+  m_commandContextPool->Transition(command, m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+
+  // Abv[hp̃obt@Oɓ]̊҂.
+  FinishCommandList(command);
+
+  // ST2084 ւ̕ϊ͎sɕ򂳂AώƂăRpCĂ.
+  auto modelPS = LoadShaderPermutation(L"modelPS.hlsl");
+  m_hdr10Feature = modelPS.GetMask("HDR10_ST2084");
+  const ShaderFeatureMask variants[] = { 0, m_hdr10Feature };
+  std::vector<ShaderCompileJob> shaders = {
+    { L"modelVS.hlsl", L"vs_6_0" },
   };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
-
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
-
-  WaitForIdleGPU(); // ̂҂.
-
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"modelVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"modelPS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  for (auto mask : variants)
+  {
+    shaders.emplace_back(L"modelPS.hlsl", L"ps_6_0", modelPS.MakeDefines(mask));
+  }
+  hr = CompileShadersFromFile(shaders);
+  ThrowIfFailed(hr, "Shader compile error");
+  ComPtr<ID3DBlob> errBlob, vs = shaders[0].shaderBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[1];
@@ -186,7 +180,7 @@ void DisplayHDR10App::PrepareTeapot()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_model.rootSig)
   );
@@ -201,12 +195,15 @@ void DisplayHDR10App::PrepareTeapot()
   auto surfaceFormat = m_swapchain->GetFormat();
 
   // pCvCXe[gIuWFNg̐.
-  auto psoDesc = book_util::CreateDefaultPsoDesc(
-    surfaceFormat,
-    vs, ps, book_util::CreateTeapotModelRasterizerDesc(),
-    inputElementDesc, _countof(inputElementDesc), m_model.rootSig);
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
-  ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
+  for (UINT i = 0; i < _countof(variants); ++i)
+  {
+    auto psoDesc = book_util::CreateDefaultPsoDesc(
+      surfaceFormat,
+      vs, shaders[1 + i].shaderBlob, book_util::CreateTeapotModelRasterizerDesc(),
+      inputElementDesc, _countof(inputElementDesc), m_model.rootSig);
+    hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipelines[variants[i]]));
+    ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
+  }
 
   // 萔obt@
   bufferSize = sizeof(SceneParameter);
@@ -17,12 +17,13 @@ public:
     DirectX::XMFLOAT4X4 viewProj;
     DirectX::XMFLOAT4 lightPos;
     DirectX::XMFLOAT4 cameraPos;
-    DirectX::XMFLOAT4 branchFrags;
   };
 
   virtual void OnSizeChanged(UINT width, UINT height, bool isMinimized);
 private:
-  void RenderTeapot();
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+
+  void RenderTeapot(const GraphicsCommandList& commandList);
   void PrepareTeapot();
 
   using Buffer = ComPtr<ID3D12Resource1>;
@@ -37,9 +38,13 @@ private:
     Buffer resourceIB;
 
     ComPtr<ID3D12RootSignature> rootSig;
-    ComPtr<ID3D12PipelineState> pipeline;
+    // modelPS.hlsl ̕ώ했̃pCvC.
+    std::unordered_map<ShaderFeatureMask, ComPtr<ID3D12PipelineState>> pipelines;
     std::vector<Buffer> sceneCB;
   };
+  // o̓tH[}bg modelPS.hlsl ̕ώ߂.
+  ShaderFeatureMask GetModelShaderFeatures() const;
 
   ModelData m_model;
+  ShaderFeatureMask m_hdr10Feature;
 };
\ No newline at end of file
@@ -1,3 +1,5 @@
+// @feature HDR10_ST2084
+
 struct VSOutput
 {
   float4 Position : SV_POSITION;
@@ -12,7 +14,6 @@ cbuffer ShaderParameter : register(b0)
   float4x4 viewProj;
   float4 lightPos;
   float4 cameraPos;
-  float4 branchFlags;
 }
 
 static const float3x3 from709to2020 =
@@ -41,12 +42,11 @@ float4 main(VSOutput In) : SV_TARGET
   float4 color = In.Color;
   color.rgb += specular;
 
-  if (branchFlags.x > 0.5)
-  {
-    float3 rec2020 = mul(from709to2020, color.rgb);
-    float3 hdr10 = LinearToST2084(rec2020 * (80.0 / 10000.0));
-    color.rgb = hdr10;
-  }
+#if HDR10_ST2084
+  float3 rec2020 = mul(from709to2020, color.rgb);
+  float3 hdr10 = LinearToST2084(rec2020 * (80.0 / 10000.0));
+  color.rgb = hdr10;
+#endif
 
   return color;
 }
\ No newline at end of file
@@ -10,10 +10,6 @@ ResizableApp::ResizableApp()
 void ResizableApp::Prepare()
 {
   SetTitle("Resizable");
-
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
-
   PrepareTeapot();
 }
 
@@ -24,27 +20,21 @@ void ResizableApp::Cleanup()
 void ResizableApp::Render()
 {
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(), nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
   // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
-  RenderTeapot();
+  RenderTeapot(commandList);
 
   // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -55,7 +45,7 @@ void ResizableApp::OnSizeChanged(UINT width, UINT height, bool isMinimized)
   D3D12AppBase::OnSizeChanged(width, height, isMinimized);
 }
 
-void ResizableApp::RenderTeapot()
+void ResizableApp::RenderTeapot(const GraphicsCommandList& commandList)
 {
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
@@ -64,19 +54,19 @@ void ResizableApp::RenderTeapot()
     0.0f, 0.0f, 0.0f, 0.0f
   };
   // J[obt@EfvXobt@̃NA.
-  m_commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   // r[|[gƃVU[̃Zbg.
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   // eB[|bg̕`.
   auto cb = m_model.sceneCB[m_frameIndex];
@@ -98,13 +88,13 @@ void ResizableApp::RenderTeapot()
   memcpy(mapped, &sceneParam, sizeof(sceneParam));
   cb->Unmap(0, nullptr);
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
-  m_commandList->SetPipelineState(m_model.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
+  commandList->SetPipelineState(m_model.pipeline.Get());
+  commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
+  commandList->IASetIndexBuffer(&m_model.ibView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
 }
 
 void ResizableApp::PrepareTeapot()
@@ -113,7 +103,7 @@ void ResizableApp::PrepareTeapot()
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -130,7 +120,7 @@ void ResizableApp::PrepareTeapot()
   m_model.vbView.SizeInBytes = bufferSize;
   m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
 
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
 
   bufferSize = sizeof(TeapotModel::TeapotIndices);
   auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -148,31 +138,23 @@ void ResizableApp::PrepareTeapot()
   m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
   m_model.indexCount = _countof(TeapotModel::TeapotIndices);
 
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
+  command->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
 
   // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
+  // Xe[ge[uɂf悤AJڂ̓v[ʂ.
+  m_commandContextPool->Transition(command, m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+  m_commandContextPool->Transition(command, m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  // Abv[hp̃obt@Oɓ]̊҂.
+  FinishCommandList(command);
 
-  WaitForIdleGPU(); // ̂҂.
-
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"modelVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"modelPS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  std::vector<ShaderCompileJob> shaders = {
+    { L"modelVS.hlsl", L"vs_6_0" },
+    { L"modelPS.hlsl", L"ps_6_0" },
+  };
+  hr = CompileShadersFromFile(shaders);
+  ThrowIfFailed(hr, "Shader compile error");
+  ComPtr<ID3DBlob> errBlob, vs = shaders[0].shaderBlob, ps = shaders[1].shaderBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[1];
@@ -185,7 +167,7 @@ void ResizableApp::PrepareTeapot()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_model.rootSig)
   );
@@ -202,7 +184,7 @@ void ResizableApp::PrepareTeapot()
     DXGI_FORMAT_R8G8B8A8_UNORM,
     vs, ps, book_util::CreateTeapotModelRasterizerDesc(),
     inputElementDesc, _countof(inputElementDesc), m_model.rootSig);
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@
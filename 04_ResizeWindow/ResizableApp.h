@@ -21,7 +21,9 @@ public:
 
   virtual void OnSizeChanged(UINT width, UINT height, bool isMinimized);
 private:
-  void RenderTeapot();
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+
+  void RenderTeapot(const GraphicsCommandList& commandList);
   void PrepareTeapot();
 
   using Buffer = ComPtr<ID3D12Resource1>;
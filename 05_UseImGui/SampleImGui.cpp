@@ -32,46 +32,36 @@ void SampleImGui::Render()
   UpdateImGui();
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(),
-    nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
 
   // J[obt@(_[^[Qbgr[)̃NA
-  m_commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  RenderImGui();
+  RenderImGui(commandList);
 
   // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -103,8 +93,8 @@ void SampleImGui::UpdateImGui()
   ImGui::End();
 }
 
-void SampleImGui::RenderImGui()
+void SampleImGui::RenderImGui(const GraphicsCommandList& commandList)
 {
   ImGui::Render();
-  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_commandList.Get());
+  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
 }
\ No newline at end of file
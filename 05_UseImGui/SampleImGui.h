@@ -8,8 +8,10 @@ public:
 
   virtual void Render();
 private:
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+
   void UpdateImGui();
-  void RenderImGui();
+  void RenderImGui(const GraphicsCommandList& commandList);
 
   float m_factor;
   float m_clearColor[4];
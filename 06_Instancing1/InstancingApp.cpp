@@ -24,55 +24,26 @@ InstancingApp::InstancingApp()
 void InstancingApp::Prepare()
 {
   SetTitle("Instancing : Use VertexStream");
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
 
   void* mapped;
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
-  UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
-  
-  m_model.resourceVB = CreateBufferResource(
-    D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COPY_DEST
-  );
-
-  auto uploadVB = CreateBufferResource(
-    D3D12_HEAP_TYPE_UPLOAD, bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ
-  );
-
-  hr = uploadVB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotVerticesPN, bufferSize);
-    uploadVB->Unmap(0, nullptr);
-  }
-  m_model.vbView.BufferLocation = m_model.resourceVB->GetGPUVirtualAddress();
-  m_model.vbView.SizeInBytes = bufferSize;
-  m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
-
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
-
-  bufferSize = sizeof(TeapotModel::TeapotIndices);
-  m_model.resourceIB = CreateBufferResource(
-    D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COPY_DEST
-  );
-  auto uploadIB = CreateBufferResource(
-    D3D12_HEAP_TYPE_UPLOAD, bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ
-  );
-
-  hr = uploadIB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotIndices, bufferSize);
-    uploadIB->Unmap(0, nullptr);
+  UINT bufferSize = 0;
+
+  // _ECfbNX̓WIgv[ւ܂Ƃ߂Ĕzu.
+  // ]̓Rs[L[֐ς܂A`L[ GPU Ŋ҂.
+  m_geometryPool.Prepare(this, sizeof(TeapotModel::Vertex), GeometryVertexMax, GeometryIndexMax);
+  m_model.mesh = m_geometryPool.AddMesh(this,
+    TeapotModel::TeapotVerticesPN, _countof(TeapotModel::TeapotVerticesPN),
+    TeapotModel::TeapotIndices, _countof(TeapotModel::TeapotIndices));
+  if (m_model.mesh == GeometryPool::InvalidHandle)
+  {
+    throw std::runtime_error("GeometryPool is full.");
   }
-  m_model.ibView.BufferLocation = m_model.resourceIB->GetGPUVirtualAddress();
-  m_model.ibView.SizeInBytes = bufferSize;
-  m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
-  m_model.indexCount = _countof(TeapotModel::TeapotIndices);
-
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
+  QueueWaitForUpload(m_geometryPool.GetUploadTicket());
 
   // CX^VOp̃f[^.
+  auto command = CreateCommandList();
   bufferSize = sizeof(InstanceData) * InstanceDataMax;
   m_instanceData = CreateBufferResource(
     D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COPY_DEST
@@ -96,37 +67,24 @@ void InstancingApp::Prepare()
   m_streamView.SizeInBytes = bufferSize;
   m_streamView.StrideInBytes = sizeof(InstanceData);
 
-  m_commandList->CopyResource(m_instanceData.Get(), uploadVB2.Get());
+  command->CopyResource(m_instanceData.Get(), uploadVB2.Get());
 
-  // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  auto barrierVB2 = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_instanceData.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB, barrierVB2
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
-  
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  // Rs[I̓obt@̃Xe[gK؂ɕύXĂ.
+  // Xe[ge[uɂf悤AJڂ̓v[ʂ.
+  m_commandContextPool->Transition(command, m_instanceData.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-  WaitForIdleGPU(); // ̂҂.
+  // Abv[hp̃obt@Oɓ]̊҂.
+  FinishCommandList(command);
 
   ComPtr<ID3DBlob> errBlob;
-  hr= CompileShaderFromFile(
-    L"VertexShader.hlsl", L"vs_6_0", m_vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-
-  hr = CompileShaderFromFile(
-    L"PixelShader.hlsl", L"ps_6_0", m_ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  std::vector<ShaderCompileJob> shaders = {
+    { L"VertexShader.hlsl", L"vs_6_0" },
+    { L"PixelShader.hlsl", L"ps_6_0" },
+  };
+  hr = CompileShadersFromFile(shaders);
+  ThrowIfFailed(hr, "Shader compile error");
+  m_vs = shaders[0].shaderBlob;
+  m_ps = shaders[1].shaderBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[1];
@@ -139,7 +97,7 @@ void InstancingApp::Prepare()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_rootSignature)
   );
@@ -179,19 +137,10 @@ void InstancingApp::Prepare()
   psoDesc.SampleDesc = { 1,0 };
   psoDesc.SampleMask = UINT_MAX; // YƊGoȂxoȂ̂Œ.
 
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
-  // 萔obt@̏
-  bufferSize = book_util::RoundupConstantBufferSize(sizeof(SceneParameter));
-  for (UINT i = 0; i < FrameBufferCount; ++i) {
-    auto cb = CreateBufferResource(
-      D3D12_HEAP_TYPE_UPLOAD,
-      bufferSize,
-      D3D12_RESOURCE_STATE_GENERIC_READ
-    );
-    m_constantBuffers.push_back(cb);
-  }
+  // V[̒萔obt@͖t[ UploadRing ؂o.
 
   // ImGui ZbgAbv
   auto descriptor = m_heap->Alloc();
@@ -209,6 +158,7 @@ void InstancingApp::Prepare()
 void InstancingApp::Cleanup()
 {
   imgui_helper::CleanupImGui();
+  m_geometryPool.Cleanup(this);
 }
 
 
@@ -233,82 +183,68 @@ void InstancingApp::Render()
 
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
+  m_uploadRing->BeginFrame(GetCompletedFrameFenceValue());
 
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(),
-    nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
 
   // J[obt@(_[^[Qbgr[)̃NA
   float m_clearColor[4] = { 0.5f,0.75f,1.0f,0 };
-  m_commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   // r[|[gƃVU[̃Zbg
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  auto cb = m_constantBuffers[m_frameIndex];
-  {
-    void* mapped;
-    cb->Map(0, nullptr, &mapped);
-    memcpy(mapped, &sceneParam, sizeof(sceneParam));
-    cb->Unmap(0, nullptr);
-  }
+  auto sceneCB = m_uploadRing->Push(sceneParam);
 
   D3D12_VERTEX_BUFFER_VIEW vbViews[] = {
-    m_model.vbView, m_streamView
+    m_geometryPool.GetVertexBufferView(), m_streamView
   };
+  auto ibView = m_geometryPool.GetIndexBufferView();
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->IASetVertexBuffers(0, _countof(vbViews), vbViews);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->IASetVertexBuffers(0, _countof(vbViews), vbViews);
+  commandList->IASetIndexBuffer(&ibView);
 
-  m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-  m_commandList->SetPipelineState(m_pipeline.Get());
-  m_commandList->SetGraphicsRootConstantBufferView(
-    0, cb->GetGPUVirtualAddress()
-  );
+  commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+  commandList->SetPipelineState(m_pipeline.Get());
+  commandList->SetGraphicsRootConstantBufferView(0, sceneCB);
 
-  m_commandList->DrawIndexedInstanced(
-    m_model.indexCount,
+  const auto& mesh = m_geometryPool.GetMesh(m_model.mesh);
+  commandList->DrawIndexedInstanced(
+    mesh.indexCount,
     m_instancingCount,
-    0, 0, 0
+    mesh.firstIndex, mesh.baseVertex, 0
   );
 
-  RenderImGui();
+  RenderImGui(commandList);
 
   // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_uploadRing->EndFrame(m_commandContextPool->Submit(&commandList, 1));
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -329,27 +265,14 @@ void InstancingApp::UpdateImGui()
   ImGui::End();
 }
 
-void InstancingApp::RenderImGui()
+void InstancingApp::RenderImGui(const GraphicsCommandList& commandList)
 {
   ImGui::Render();
-  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_commandList.Get());
+  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
 }
 
 InstancingApp::Buffer InstancingApp::CreateBufferResource(D3D12_HEAP_TYPE type, UINT bufferSize, D3D12_RESOURCE_STATES state)
 {
-  Buffer ret;
-  HRESULT hr;
-
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(type);
   const auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &resDesc,
-    state,
-    nullptr,
-    IID_PPV_ARGS(&ret)
-  );
-  ThrowIfFailed(hr, "CreateCommittedResource failed.");
-  return ret;
+  return CreateResource(resDesc, state, nullptr, type);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "GeometryPool.h"
 #include <DirectXMath.h>
 
 class InstancingApp : public D3D12AppBase {
@@ -19,9 +20,10 @@ public:
   };
 private:
   using Buffer = ComPtr<ID3D12Resource1>;
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
 
   void UpdateImGui();
-  void RenderImGui();
+  void RenderImGui(const GraphicsCommandList& commandList);
   Buffer CreateBufferResource(D3D12_HEAP_TYPE type, UINT bufferSize, D3D12_RESOURCE_STATES state);
 
 
@@ -31,15 +33,15 @@ private:
   ComPtr<ID3D12RootSignature> m_rootSignature;
   ComPtr<ID3D12PipelineState> m_pipeline;
 
-  std::vector<Buffer> m_constantBuffers;
+
+  enum {
+    GeometryVertexMax = 65536,
+    GeometryIndexMax = 65536 * 3,
+  };
 
   struct ModelData
   {
-    UINT indexCount;
-    D3D12_VERTEX_BUFFER_VIEW vbView;
-    D3D12_INDEX_BUFFER_VIEW  ibView;
-    Buffer resourceVB;
-    Buffer resourceIB;
+    GeometryPool::MeshHandle mesh;
   };
 
   struct InstanceData
@@ -50,6 +52,7 @@ private:
 
   const UINT InstanceDataMax = 200;
 
+  GeometryPool m_geometryPool;
   ModelData m_model;
   Buffer m_instanceData;
   D3D12_VERTEX_BUFFER_VIEW m_streamView;
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "GeometryPool.h"
 #include <DirectXMath.h>
 
 class InstancingApp : public D3D12AppBase {
@@ -18,9 +19,10 @@ public:
   };
 private:
   using Buffer = ComPtr<ID3D12Resource1>;
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
 
   void UpdateImGui();
-  void RenderImGui();
+  void RenderImGui(const GraphicsCommandList& commandList);
   Buffer CreateBufferResource(D3D12_HEAP_TYPE type, UINT bufferSize, D3D12_RESOURCE_STATES state);
 
 
@@ -30,19 +32,16 @@ private:
   ComPtr<ID3D12RootSignature> m_rootSignature;
   ComPtr<ID3D12PipelineState> m_pipeline;
 
-  std::vector<Buffer> m_constantBuffers;
 
   enum {
     InstanceDataMax = 500,
+    GeometryVertexMax = 65536,
+    GeometryIndexMax = 65536 * 3,
   };
 
   struct ModelData
   {
-    UINT indexCount;
-    D3D12_VERTEX_BUFFER_VIEW vbView;
-    D3D12_INDEX_BUFFER_VIEW  ibView;
-    Buffer resourceVB;
-    Buffer resourceIB;
+    GeometryPool::MeshHandle mesh;
   };
 
   struct InstanceData
@@ -55,6 +54,7 @@ private:
     InstanceData  data[InstanceDataMax];
   };
 
+  GeometryPool m_geometryPool;
   ModelData m_model;
   std::vector<Buffer> m_instanceBuffers;
 
@@ -12,109 +12,42 @@ void RenderToTextureApp::Prepare()
 {
   SetTitle("RenderToTexture");
 
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
+  // AvŎgVF[_[ɐ錾A܂Ƃ߂ĕɃRpC.
+  std::vector<ShaderCompileJob> shaders = {
+    { L"modelVS.hlsl", L"vs_6_0" },
+    { L"modelPS.hlsl", L"ps_6_0" },
+    { L"planeVS.hlsl", L"vs_6_0" },
+    { L"planePS.hlsl", L"ps_6_0" },
+  };
+  ThrowIfFailed(CompileShadersFromFile(shaders), "Shader compile error");
 
-  PrepareTeapot();
-  PreparePlane();
-
-  auto width = RenderTexWidth;
-  auto height = RenderTexHeight;
-  // eNX`_Op
-  auto colorTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_R8G8B8A8_UNORM, width, height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
-  );
-  auto depthTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_D32_FLOAT, width, height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
-  );
-  D3D12_CLEAR_VALUE clearColor, clearDepth;
-  clearColor.Format = colorTexDesc.Format;
-  clearColor.Color[0] = 0.25f;
-  clearColor.Color[1] = 0.25f;
-  clearColor.Color[2] = 0.25f;
-  clearColor.Color[3] = 0.0f;
-  clearDepth.Format = DXGI_FORMAT_D32_FLOAT;
-  clearDepth.DepthStencil.Depth = 1.0f;
-  clearDepth.DepthStencil.Stencil = 0;
-
-  HRESULT hr;
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &colorTexDesc,
-    D3D12_RESOURCE_STATE_RENDER_TARGET,
-    &clearColor,
-    IID_PPV_ARGS(&m_colorRT)
-  );
-  ThrowIfFailed(hr, "CreateCommittedResource(Color)");
-
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &depthTexDesc,
-    D3D12_RESOURCE_STATE_DEPTH_WRITE,
-    &clearDepth,
-    IID_PPV_ARGS(&m_depthRT)
-  );
-  ThrowIfFailed(hr, "CreateCommittedResource(Depth)");
-
-  m_hColorRTV = m_heapRTV->Alloc();
-  m_device->CreateRenderTargetView(m_colorRT.Get(), nullptr, m_hColorRTV);
-  m_hDepthDSV = m_heapDSV->Alloc();
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
-  dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  m_device->CreateDepthStencilView(m_depthRT.Get(), &dsvDesc, m_hDepthDSV);
-
-  m_hColorSRV = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-  srvDesc.Format = colorTexDesc.Format;
-  srvDesc.Texture2D.MipLevels = 1;
-  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(m_colorRT.Get(), &srvDesc, m_hColorSRV);
-
-  m_hDepthSRV = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc{};
-  depthSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-  depthSrvDesc.Texture2D.MipLevels = 1;
-  depthSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  depthSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(m_depthRT.Get(), &depthSrvDesc, m_hDepthSRV);
+  PrepareTeapot(shaders[0].shaderBlob, shaders[1].shaderBlob);
+  PreparePlane(shaders[2].shaderBlob, shaders[3].shaderBlob);
 
+  PrepareFrameGraph();
 }
 
 void RenderToTextureApp::Cleanup()
 {
+  m_frameGraphExecutor.Cleanup();
 }
 
 void RenderToTextureApp::Render()
 {
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(), nullptr
-  );
-
-  // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  // pXԂ̃oA̓Ot̃RpCʂAepX̐擪ł܂Ƃ߂ċL^.
+  auto commandList = m_commandContextPool->Begin();
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  RenderToTexture();
+  m_frameGraphExecutor.SetImportedTexture(
+    m_backBufferId, m_swapchain->GetImage(m_frameIndex).Get(), m_swapchain->GetCurrentRTV());
+  m_frameGraphExecutor.SetImportedTexture(
+    m_depthBufferId, m_depthBuffer.Get(), D3D12_CPU_DESCRIPTOR_HANDLE(), m_defaultDepthDSV);
+  m_frameGraphExecutor.Execute(commandList);
 
-  RenderToMain();
-
-  m_commandList->Close();
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -127,19 +60,23 @@ void RenderToTextureApp::OnSizeChanged(UINT width, UINT height, bool isMinimized
   D3D12AppBase::OnSizeChanged(width, height, isMinimized);
 }
 
-void RenderToTextureApp::RenderToTexture()
+void RenderToTextureApp::RenderToTexture(FrameGraphContext& context)
 {
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_colorRTId);
+  auto dsv = context.GetDSV(m_depthRTId);
+
   const float clearColor[] = {
     0.25f, 0.25f, 0.25f, 0.0f
   };
   // eNX`̃J[obt@EfvXobt@̃NA.
-  m_commandList->ClearRenderTargetView(m_hColorRTV, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(m_hDepthDSV, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // eNX``ɃZbg.
-  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { m_hColorRTV };
-  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = m_hDepthDSV;
-  m_commandList->OMSetRenderTargets(
+  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { rtv };
+  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = dsv;
+  commandList->OMSetRenderTargets(
     _countof(colorDescriptors), colorDescriptors, FALSE, &depthDescirptor);
 
   // r[|[gƃVU[̃Zbg.
@@ -147,8 +84,8 @@ void RenderToTextureApp::RenderToTexture()
   auto height = RenderTexHeight;
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(width), float(height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(width), LONG(height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   // eB[|bg̕`.
   auto cb = m_model.sceneCB[m_frameIndex];
@@ -167,46 +104,41 @@ void RenderToTextureApp::RenderToTexture()
   memcpy(mapped, &sceneParam, sizeof(sceneParam));
   cb->Unmap(0, nullptr);
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
-  m_commandList->SetPipelineState(m_model.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
-
-  // `AeNX`ƂĎg߂̃oAݒ.
-  auto barrierToSRV = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_colorRT.Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-  );
-  m_commandList->ResourceBarrier(1, &barrierToSRV);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
+  commandList->SetPipelineState(m_model.pipeline.Get());
+  commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
+  commandList->IASetIndexBuffer(&m_model.ibView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
 }
 
-void RenderToTextureApp::RenderToMain()
+void RenderToTextureApp::RenderToMain(FrameGraphContext& context)
 {
-  auto rtv = m_swapchain->GetCurrentRTV();
-  auto dsv = m_defaultDepthDSV;
+  // teapot `悵eNX`̓ǂݎƃobNobt@ւ̕`̑Jڂ́AOtpX̐擪1ŋL^.
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_backBufferId);
+  auto dsv = context.GetDSV(m_depthBufferId);
 
   // J[obt@(_[^[Qbgr[)̃NA
   float m_clearColor[4] = { 0.5f,0.75f,1.0f,0 };
-  m_commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   // r[|[gƃVU[̃Zbg
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   auto mtxWorld = XMMatrixRotationY(m_frameCount*0.01f);
   auto mtxView = XMMatrixLookAtRH(
@@ -223,35 +155,23 @@ void RenderToTextureApp::RenderToMain()
     m_plane.sceneCB[m_frameIndex]->Unmap(0, nullptr);
   }
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-  m_commandList->SetGraphicsRootSignature(m_plane.rootSig.Get());
-  m_commandList->SetPipelineState(m_plane.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_plane.vbView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_plane.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->SetGraphicsRootDescriptorTable(1, m_hColorSRV);
-  m_commandList->DrawInstanced(4, 1, 0, 0);
-
-
-  // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  auto barrierToRT = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_colorRT.Get(),
-    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET
-  );
-  CD3DX12_RESOURCE_BARRIER barriers[] = {
-    barrierToPresent, barrierToRT
-  };
-  
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+  commandList->SetGraphicsRootSignature(m_plane.rootSig.Get());
+  commandList->SetPipelineState(m_plane.pipeline.Get());
+  commandList->IASetVertexBuffers(0, 1, &m_plane.vbView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_plane.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->SetGraphicsRootDescriptorTable(1, context.GetSRV(m_colorRTId));
+  commandList->DrawInstanced(4, 1, 0, 0);
+  // _[^[QbgXbv`FC\\ւ̑Jڂ́AŌ̃pX̌ɃOtL^.
 }
 
-void RenderToTextureApp::PrepareTeapot()
+void RenderToTextureApp::PrepareTeapot(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps)
 {
   void* mapped;
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -268,7 +188,7 @@ void RenderToTextureApp::PrepareTeapot()
   m_model.vbView.SizeInBytes = bufferSize;
   m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
 
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
 
   bufferSize = sizeof(TeapotModel::TeapotIndices);
   auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -286,31 +206,17 @@ void RenderToTextureApp::PrepareTeapot()
   m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
   m_model.indexCount = _countof(TeapotModel::TeapotIndices);
 
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
+  command->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
 
   // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
+  // Xe[ge[uɂf悤AJڂ̓v[ʂ.
+  m_commandContextPool->Transition(command, m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+  m_commandContextPool->Transition(command, m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  // Abv[hp̃obt@Oɓ]̊҂.
+  FinishCommandList(command);
 
-  WaitForIdleGPU(); // ̂҂.
-
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"modelVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"modelPS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[1];
@@ -323,7 +229,7 @@ void RenderToTextureApp::PrepareTeapot()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_model.rootSig)
   );
@@ -340,7 +246,7 @@ void RenderToTextureApp::PrepareTeapot()
     DXGI_FORMAT_R8G8B8A8_UNORM,
     vs, ps, book_util::CreateTeapotModelRasterizerDesc(),
     inputElementDesc, _countof(inputElementDesc), m_model.rootSig);
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@
@@ -353,7 +259,7 @@ void RenderToTextureApp::PrepareTeapot()
   }
 }
 
-void RenderToTextureApp::PreparePlane()
+void RenderToTextureApp::PreparePlane(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps)
 {
   VertexPT plane[] = {
     { XMFLOAT3(-1.0f, 1.0f, 0.0f), XMFLOAT2(0.0f,0.0f) },
@@ -364,7 +270,7 @@ void RenderToTextureApp::PreparePlane()
   void* mapped;
   HRESULT hr;
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(plane);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -380,25 +286,15 @@ void RenderToTextureApp::PreparePlane()
   m_plane.vbView.SizeInBytes = bufferSize;
   m_plane.vbView.StrideInBytes = sizeof(VertexPT);
 
-  m_commandList->CopyResource(m_plane.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_plane.resourceVB.Get(), uploadVB.Get());
 
-  // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_plane.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  m_commandList->ResourceBarrier(1, &barrierVB);
-  m_commandList->Close();
-
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  // Rs[I̓obt@̃Xe[gK؂ɕύXĂ.
+  m_commandContextPool->Transition(command, m_plane.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-  WaitForIdleGPU(); // ̂҂.
+  // Abv[hp̃obt@Oɓ]̊҂.
+  FinishCommandList(command);
 
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"planeVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"planePS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_DESCRIPTOR_RANGE rangeSrv;
@@ -417,7 +313,7 @@ void RenderToTextureApp::PreparePlane()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_plane.rootSig)
   );
@@ -437,7 +333,7 @@ void RenderToTextureApp::PreparePlane()
     DXGI_FORMAT_R8G8B8A8_UNORM,
     vs, ps, rasterizerDesc,
     inputElementDesc, _countof(inputElementDesc), m_plane.rootSig);
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_plane.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_plane.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@
@@ -449,3 +345,30 @@ void RenderToTextureApp::PreparePlane()
     m_plane.sceneCB.push_back(cb);
   }
 }
+
+void RenderToTextureApp::PrepareFrameGraph()
+{
+  // eNX`_Op
+  FrameGraph::TextureDesc colorTexDesc{
+    RenderTexWidth, RenderTexHeight, DXGI_FORMAT_R8G8B8A8_UNORM, 1, { 0.25f, 0.25f, 0.25f, 0.0f }
+  };
+  FrameGraph::TextureDesc depthTexDesc{
+    RenderTexWidth, RenderTexHeight, DXGI_FORMAT_D32_FLOAT, 1, { 1.0f }
+  };
+  m_backBufferId = m_frameGraph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  m_depthBufferId = m_frameGraph.ImportTexture("DepthBuffer", FrameGraph::USAGE_DEPTH_WRITE, FrameGraph::USAGE_DEPTH_WRITE);
+  m_colorRTId = m_frameGraph.CreateTexture("TeapotColor", colorTexDesc);
+  m_depthRTId = m_frameGraph.CreateTexture("TeapotDepth", depthTexDesc);
+
+  auto teapotPass = m_frameGraph.AddPass("Teapot", [this](FrameGraphContext& context) { RenderToTexture(context); });
+  m_frameGraph.Write(teapotPass, m_colorRTId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(teapotPass, m_depthRTId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  auto mainPass = m_frameGraph.AddPass("Main", [this](FrameGraphContext& context) { RenderToMain(context); });
+  m_frameGraph.Read(mainPass, m_colorRTId, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  m_frameGraph.Write(mainPass, m_backBufferId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(mainPass, m_depthBufferId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  m_frameGraphExecutor.Prepare(this, m_heapRTV, m_heapDSV, m_heap);
+  m_frameGraphExecutor.Compile(m_frameGraph);
+}
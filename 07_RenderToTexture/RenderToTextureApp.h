@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "FrameGraphExecutor.h"
 #include "DirectXMath.h"
 
 class RenderToTextureApp : public D3D12AppBase {
@@ -29,11 +30,12 @@ public:
 
   virtual void OnSizeChanged(UINT width, UINT height, bool isMinimized);
 private:
-  void RenderToTexture();
-  void RenderToMain();
+  void RenderToTexture(FrameGraphContext& context);
+  void RenderToMain(FrameGraphContext& context);
 
-  void PrepareTeapot();
-  void PreparePlane();
+  void PrepareTeapot(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps);
+  void PreparePlane(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps);
+  void PrepareFrameGraph();
 
   using Buffer = ComPtr<ID3D12Resource1>;
   using Texture = ComPtr<ID3D12Resource1>;
@@ -54,12 +56,11 @@ private:
   ModelData m_model;
   ModelData m_plane;
 
-  Texture m_colorRT;
-  Texture m_depthRT;
-  DescriptorHandle m_hColorRTV;
-  DescriptorHandle m_hDepthDSV;
-  DescriptorHandle m_hColorSRV;
-  DescriptorHandle m_hDepthSRV;
+  // teapot ̕`̓t[OẗꎞeNX`ƂApXԂ̃oA̓OtL^.
+  FrameGraph m_frameGraph;
+  FrameGraphExecutor m_frameGraphExecutor;
+  FrameGraph::ResourceId m_backBufferId, m_depthBufferId;
+  FrameGraph::ResourceId m_colorRTId, m_depthRTId;
 
   UINT m_frameCount;
 };
\ No newline at end of file
@@ -27,19 +27,30 @@ PostEffectApp::PostEffectApp()
   m_effectParameter.speed = 1.5;
   m_effectParameter.distortion = 0.03f;
   m_effectParameter.brightness = 0.25f;
+  ResetConstantBufferRanges();
 
 }
 
 void PostEffectApp::Prepare()
 {
   SetTitle("PostEffect");
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
 
-  PrepareTeapot();
-  PreparePostEffectPlane();
-  PrepareRenderTextureResource();
+  // AvŎgVF[_[ɐ錾A܂Ƃ߂ĕɃRpC.
+  std::vector<ShaderCompileJob> shaders = {
+    { L"sceneVS.hlsl", L"vs_6_0" },
+    { L"scenePS.hlsl", L"ps_6_0" },
+    { L"mosaicVS.hlsl", L"vs_6_0" },
+    { L"mosaicPS.hlsl", L"ps_6_0" },
+    { L"waterVS.hlsl", L"vs_6_0" },
+    { L"waterPS.hlsl", L"ps_6_0" },
+  };
+  ThrowIfFailed(CompileShadersFromFile(shaders), "Shader compile error");
+
+  PrepareConstantBufferRanges(shaders);
+  PrepareTeapot(shaders[0], shaders[1]);
+  PreparePostEffectPlane(shaders[2], shaders[3], shaders[4], shaders[5]);
+  PrepareFrameGraph();
+  m_descriptorRing.Prepare(m_device, m_heap, TransientDescriptorCount);
 
   // ImGui ZbgAbv
   auto descriptor = m_heap->Alloc();
@@ -57,6 +68,9 @@ void PostEffectApp::Prepare()
 void PostEffectApp::Cleanup()
 {
   imgui_helper::CleanupImGui();
+  m_frameGraphExecutor.Cleanup();
+  m_descriptorRing.Cleanup();
+  m_geometryPool.Cleanup(this);
 }
 
 
@@ -65,46 +79,33 @@ void PostEffectApp::Render()
   UpdateImGui();
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
+  // GPU gIt[̃e[uƃ\[X.
+  m_descriptorRing.BeginFrame(GetCompletedFrameFenceValue());
+  m_uploadRing->BeginFrame(GetCompletedFrameFenceValue());
+  CollectDeferredReleases();
+  // ăRpC̏IVF[_[̃pCvCōւ.
+  m_shaderHotReload->Update();
 
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(),
-    nullptr
-  );
+  // t[Ot̃oA̓v[̃Xe[gǐՂʂ߁AXgv[o.
+  auto commandList = m_commandContextPool->Begin();
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
-
-  // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
-
-  // ʏ3DV[eNX`֕`
-  RenderToTexture();
-
-  // C̕`փ|XgGtFNgKpĕ`悷
-  RenderToMain();
-
-  // ImGui ̃tgGhŌɏd˂
-  RenderImGui();
-
-  // \[XoA2ݒ.
-  // - _[^[QbgXbv`FC\\.
-  // - ̃eNX``̂߂ɃVF[_[\[X烌_[^[Qbg.
-  CD3DX12_RESOURCE_BARRIER barriers[] = {
-    m_swapchain->GetBarrierToPresent(),
-    CD3DX12_RESOURCE_BARRIER::Transition(
-      m_colorRT.Get(), 
-      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET
-    ),
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  m_commandList->Close();
+  // ʏ3DV[̃eNX`ւ̕`A|XgGtFNgAImGui ̏ɋL^.
+  // obNobt@eNX`̃oA̓t[OtepX̐擪ŋL^.
+  m_frameGraphExecutor.SetImportedTexture(
+    m_backBufferId, m_swapchain->GetImage(m_frameIndex).Get(), m_swapchain->GetCurrentRTV());
+  m_frameGraphExecutor.SetImportedTexture(
+    m_depthBufferId, m_depthBuffer.Get(), D3D12_CPU_DESCRIPTOR_HANDLE(), m_defaultDepthDSV);
+  m_frameGraphExecutor.Execute(commandList);
 
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
+  // ̃t[Ŏge[uփfBXNv^܂Ƃ߂ăRs[Ă瓊.
+  m_descriptorRing.Flush();
 
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  auto fenceValue = m_commandContextPool->Submit(&commandList, 1);
+  m_descriptorRing.EndFrame(fenceValue);
+  m_uploadRing->EndFrame(fenceValue);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -117,16 +118,14 @@ void PostEffectApp::OnSizeChanged(UINT width, UINT height, bool isMinimized)
   D3D12AppBase::OnSizeChanged(width, height, isMinimized);
 
   // 𑜓xύX̂߃|XgGtFNgp̃eNX`蒼B
-  if (m_colorRT)
+  // ÂeNX`͕`撆̃t[gIĂ.
+  if (m_frameGraph.GetResourceCount() == 0 || isMinimized)
   {
-    m_heap->Free(m_hColorSRV);
-    m_heapRTV->Free(m_hColorRTV);
+    return;
   }
-  if (m_depthRT)
-  {
-    m_heapDSV->Free(m_hDepthDSV);
-  }
-  PrepareRenderTextureResource();
+  m_frameGraph.SetTextureDesc(m_sceneColorId, GetSceneColorDesc());
+  m_frameGraph.SetTextureDesc(m_sceneDepthId, GetSceneDepthDesc());
+  m_frameGraphExecutor.Compile(m_frameGraph);
 }
 
 
@@ -142,6 +141,20 @@ void PostEffectApp::UpdateImGui()
   ImGui::Text("Framerate(avg) %.3f ms/frame", 1000.0f / framerate);
 
   ImGui::Combo("Effect", (int*)&m_effectType, "Mosaic effect\0Water effect\0\0");
+  auto ringStats = m_descriptorRing.GetStats();
+  ImGui::Text("Descriptor Ring %u/%u (peak %u)", ringStats.used, ringStats.capacity, ringStats.peakUsed);
+  ImGui::Text("  Tables %u, Copy %u, Wrap %llu", ringStats.tablesThisFrame, ringStats.copyCallsThisFrame, ringStats.wrapCount);
+  auto uploadStats = m_uploadRing->GetStats();
+  ImGui::Text("Upload Ring %llu/%llu KB (peak %llu)",
+    uploadStats.used / 1024, uploadStats.capacity / 1024, uploadStats.peakUsed / 1024);
+  ImGui::Text("  Alloc %u, %llu bytes/frame (skipped %llu)",
+    uploadStats.allocationsThisFrame, uploadStats.bytesThisFrame, uploadStats.skippedBytesThisFrame);
+  const auto& graphStats = m_frameGraphExecutor.GetStats();
+  ImGui::Text("Graph %u passes (culled %u), barriers %u in %u batches",
+    graphStats.declaredPassCount - graphStats.culledPassCount, graphStats.culledPassCount,
+    graphStats.transitionCount + graphStats.aliasingCount + graphStats.uavCount, graphStats.barrierBatchCount);
+  ImGui::Text("  Transient %.1f MB (%.1f MB without aliasing)",
+    graphStats.aliasedBytes / (1024.0 * 1024.0), graphStats.transientBytes / (1024.0 * 1024.0));
   ImGui::Spacing();
 
   if(ImGui::CollapsingHeader("Mosaic effect", ImGuiTreeNodeFlags_DefaultOpen))
@@ -164,8 +177,12 @@ void PostEffectApp::UpdateImGui()
   ImGui::End();
 }
 
-void PostEffectApp::RenderToTexture()
+void PostEffectApp::RenderToTexture(FrameGraphContext& context)
 {
+  auto& commandList = context.GetCommandList();
+  auto colorRTV = context.GetRTV(m_sceneColorId);
+  auto depthDSV = context.GetDSV(m_sceneDepthId);
+
   SceneParameter sceneParam;
   XMStoreFloat4x4(&sceneParam.view,
     XMMatrixTranspose(
@@ -202,184 +219,117 @@ void PostEffectApp::RenderToTexture()
 
   float clearColor[4] = { 0.5f,0.75f,1.0f,0 };
   // eNX`̃J[obt@EfvXobt@̃NA.
-  m_commandList->ClearRenderTargetView(m_hColorRTV, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(m_hDepthDSV, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(colorRTV, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(depthDSV, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // eNX``ɃZbg.
-  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { m_hColorRTV };
-  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = m_hDepthDSV;
-  m_commandList->OMSetRenderTargets(
+  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { colorRTV };
+  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = depthDSV;
+  commandList->OMSetRenderTargets(
     _countof(colorDescriptors), colorDescriptors, FALSE, &depthDescirptor);
   
   // r[|[gƃVU[̃Zbg.
-  m_commandList->RSSetViewports(1, &m_viewport);
-  m_commandList->RSSetScissorRects(1, &m_scissorRect);
+  commandList->RSSetViewports(1, &m_viewport);
+  commandList->RSSetScissorRects(1, &m_scissorRect);
 
   // 萔obt@̍XV.
-  void* mapped;
-  auto sceneCB = m_model.sceneCB[m_frameIndex];
-  if (SUCCEEDED(sceneCB->Map(0, nullptr, &mapped)))
-  {
-    memcpy(mapped, &sceneParam, sizeof(sceneParam));
-    sceneCB->Unmap(0, nullptr);
-  }
-  auto instanceCB = m_model.instanceCB[m_frameIndex];
-  if (SUCCEEDED(instanceCB->Map(0, nullptr, &mapped)))
-  {
-    memcpy(mapped, instanceData.data(), sizeof(InstanceParameter));
-    instanceCB->Unmap(0, nullptr);
-  }
-
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
-
-  m_commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
-  m_commandList->SetPipelineState(m_model.pipeline.Get());
-  m_commandList->SetGraphicsRootConstantBufferView(
-    0, sceneCB->GetGPUVirtualAddress()
-  );
-  m_commandList->SetGraphicsRootConstantBufferView(
-    1, instanceCB->GetGPUVirtualAddress()
-  );
-
-  m_commandList->DrawIndexedInstanced(
-    m_model.indexCount,
+  auto sceneCB = m_uploadRing->Push(sceneParam, m_sceneParameterRange);
+  auto instanceCB = m_uploadRing->Push(instanceData.data(), sizeof(InstanceParameter), m_instanceParameterRange);
+
+  auto vbView = m_geometryPool.GetVertexBufferView();
+  auto ibView = m_geometryPool.GetIndexBufferView();
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->IASetVertexBuffers(0, 1, &vbView);
+  commandList->IASetIndexBuffer(&ibView);
+
+  commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
+  commandList->SetPipelineState(m_model.pipeline.Get());
+  commandList->SetGraphicsRootConstantBufferView(0, sceneCB);
+  commandList->SetGraphicsRootConstantBufferView(1, instanceCB);
+
+  const auto& mesh = m_geometryPool.GetMesh(m_model.mesh);
+  commandList->DrawIndexedInstanced(
+    mesh.indexCount,
     InstanceCount,
-    0, 0, 0
+    mesh.firstIndex, mesh.baseVertex, 0
   );
-
-  // `AeNX`ƂĎg߂̃oAݒ.
-  auto barrierToSRV = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_colorRT.Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-  );
-  m_commandList->ResourceBarrier(1, &barrierToSRV);
 }
 
-void PostEffectApp::RenderToMain()
+void PostEffectApp::RenderToMain(FrameGraphContext& context)
 {
+  auto& commandList = context.GetCommandList();
   // GtFNgpf[^̍XV.
   m_effectParameter.screenSize = XMFLOAT2(float(m_width), float(m_height));
   m_effectParameter.frameCount = m_frameCount;
 
-  auto rtv = m_swapchain->GetCurrentRTV();
-  auto dsv = m_defaultDepthDSV;
+  auto rtv = context.GetRTV(m_backBufferId);
+  auto dsv = context.GetDSV(m_depthBufferId);
 
   // J[obt@(_[^[Qbgr[)̃NA
   float m_clearColor[4] = { 0.5f,0.75f,1.0f,0 };
-  m_commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   // r[|[gƃVU[̃Zbg
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
-  auto effectCB = m_effectCB[m_frameIndex];
-  void* mapped;
-  if (SUCCEEDED(effectCB->Map(0, nullptr, &mapped)))
-  {
-    memcpy(mapped, &m_effectParameter, sizeof(m_effectParameter));
-    effectCB->Unmap(0, nullptr);
-  }
+  auto effectCB = m_uploadRing->Push(m_effectParameter, m_effectParameterRanges[m_effectType]);
 
   // Sʂ𕢂|S`
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-  m_commandList->SetGraphicsRootSignature(m_effectRS.Get());
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+  commandList->SetGraphicsRootSignature(m_effectRS.Get());
   switch (m_effectType)
   {
   case EFFECT_TYPE_MOSAIC:
-    m_commandList->SetPipelineState(m_mosaicPSO.Get());
+    commandList->SetPipelineState(m_mosaicPSO.Get());
     break;
   case EFFECT_TYPE_WATER:
-    m_commandList->SetPipelineState(m_waterPSO.Get());
+    commandList->SetPipelineState(m_waterPSO.Get());
     break;
   }
-  m_commandList->IASetVertexBuffers(0, 0, nullptr);
-  m_commandList->SetGraphicsRootConstantBufferView(0, effectCB->GetGPUVirtualAddress());
-  m_commandList->SetGraphicsRootDescriptorTable(1, m_hColorSRV);
-  m_commandList->DrawInstanced(m_postEffect.vertexCount, 1, 0, 0);
+  commandList->IASetVertexBuffers(0, 0, nullptr);
+  commandList->SetGraphicsRootConstantBufferView(0, effectCB);
+  D3D12_CPU_DESCRIPTOR_HANDLE srcSRV = context.GetSRV(m_sceneColorId);
+  auto table = m_descriptorRing.Allocate(1, &srcSRV);
+  commandList->SetGraphicsRootDescriptorTable(1, table);
+  commandList->DrawInstanced(m_postEffect.vertexCount, 1, 0, 0);
 }
 
-void PostEffectApp::RenderImGui()
+void PostEffectApp::RenderImGui(FrameGraphContext& context)
 {
   ImGui::Render();
-  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_commandList.Get());
+  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), context.GetCommandList().Get());
 }
 
-void PostEffectApp::PrepareTeapot()
+void PostEffectApp::PrepareTeapot(const ShaderCompileJob& vs, const ShaderCompileJob& ps)
 {
-  void* mapped;
   HRESULT hr;
-  CD3DX12_RANGE range(0, 0);
-  UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
-  auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-  m_model.resourceVB = CreateResource(vbDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, D3D12_HEAP_TYPE_DEFAULT);
-  auto uploadVB = CreateResource(vbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
-
-  hr = uploadVB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotVerticesPN, bufferSize);
-    uploadVB->Unmap(0, nullptr);
-  }
-  m_model.vbView.BufferLocation = m_model.resourceVB->GetGPUVirtualAddress();
-  m_model.vbView.SizeInBytes = bufferSize;
-  m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
-
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
 
-  bufferSize = sizeof(TeapotModel::TeapotIndices);
-  auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-  m_model.resourceIB = CreateResource(ibDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, D3D12_HEAP_TYPE_DEFAULT);
-  auto uploadIB = CreateResource(ibDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
-
-  hr = uploadIB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotIndices, bufferSize);
-    uploadIB->Unmap(0, nullptr);
+  // _ECfbNX̓WIgv[ւ܂Ƃ߂Ĕzu.
+  // ]̓Rs[L[֐ς܂A`L[ GPU Ŋ҂.
+  m_geometryPool.Prepare(this, sizeof(TeapotModel::Vertex), GeometryVertexMax, GeometryIndexMax);
+  m_model.mesh = m_geometryPool.AddMesh(this,
+    TeapotModel::TeapotVerticesPN, _countof(TeapotModel::TeapotVerticesPN),
+    TeapotModel::TeapotIndices, _countof(TeapotModel::TeapotIndices));
+  if (m_model.mesh == GeometryPool::InvalidHandle)
+  {
+    throw std::runtime_error("GeometryPool is full.");
   }
-  m_model.ibView.BufferLocation = m_model.resourceIB->GetGPUVirtualAddress();
-  m_model.ibView.SizeInBytes = bufferSize;
-  m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
-  m_model.indexCount = _countof(TeapotModel::TeapotIndices);
+  QueueWaitForUpload(m_geometryPool.GetUploadTicket());
 
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
-
-  // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
-
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
-
-  ComPtr<ID3DBlob> vs, ps, errBlob;
-  hr = CompileShaderFromFile(
-    L"sceneVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-
-  hr = CompileShaderFromFile(
-    L"scenePS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[2];
@@ -393,7 +343,7 @@ void PostEffectApp::PrepareTeapot()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_model.rootSig)
   );
@@ -408,45 +358,25 @@ void PostEffectApp::PrepareTeapot()
   auto rasterizerDesc = book_util::CreateTeapotModelRasterizerDesc();
   auto psoDesc = book_util::CreateDefaultPsoDesc(
     DXGI_FORMAT_R8G8B8A8_UNORM,
-    vs.Get(), ps.Get(),
+    vs.shaderBlob.Get(), ps.shaderBlob.Get(),
     rasterizerDesc, inputElementDesc, _countof(inputElementDesc),
     m_model.rootSig
   );
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
+  m_shaderHotReload->Register(this, &m_model.pipeline, psoDesc, vs, ps, [this]() { ResetConstantBufferRanges(); });
 
-  // 萔obt@̏
-  for (UINT i = 0; i < FrameBufferCount; ++i)
-  {
-    bufferSize = sizeof(SceneParameter);
-    bufferSize = book_util::RoundupConstantBufferSize(bufferSize);
-    auto cbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-    auto cb = CreateResource(cbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
-    m_model.sceneCB.push_back(cb);
-
-    bufferSize = sizeof(InstanceParameter);
-    bufferSize = book_util::RoundupConstantBufferSize(bufferSize);
-    cbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-    cb = CreateResource(cbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
-    m_model.instanceCB.push_back(cb);
-  }
-
+  // 萔obt@͕`掞 UploadRing ؂o.
 
   WaitForIdleGPU(); // ̂҂.
 }
 
-void PostEffectApp::PreparePostEffectPlane()
+void PostEffectApp::PreparePostEffectPlane(
+  const ShaderCompileJob& mosaicVS, const ShaderCompileJob& mosaicPS,
+  const ShaderCompileJob& waterVS, const ShaderCompileJob& waterPS)
 {
   HRESULT hr;
-  ComPtr<ID3DBlob> errBlob, mosaicVS, mosaicPS, waterVS, waterPS;
-  hr = CompileShaderFromFile(L"mosaicVS.hlsl", L"vs_6_0", mosaicVS, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"mosaicPS.hlsl", L"ps_6_0", mosaicPS, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
-  hr = CompileShaderFromFile(L"waterVS.hlsl", L"vs_6_0", waterVS, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"waterPS.hlsl", L"ps_6_0", waterPS, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_DESCRIPTOR_RANGE rangeSrv;
@@ -467,7 +397,7 @@ void PostEffectApp::PreparePostEffectPlane()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_effectRS)
   );
@@ -482,73 +412,89 @@ void PostEffectApp::PreparePostEffectPlane()
   // pCvCXe[gIuWFNg̐.
   auto mosaicPsoDesc = book_util::CreateDefaultPsoDesc(
     m_surfaceFormat,
-    mosaicVS, mosaicPS, CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT),
+    mosaicVS.shaderBlob, mosaicPS.shaderBlob, CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT),
     inputElementDesc, _countof(inputElementDesc),
     m_effectRS
   );
-  hr = m_device->CreateGraphicsPipelineState(&mosaicPsoDesc, IID_PPV_ARGS(&m_mosaicPSO));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&mosaicPsoDesc, IID_PPV_ARGS(&m_mosaicPSO));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.(Mosaic)");
+  m_shaderHotReload->Register(this, &m_mosaicPSO, mosaicPsoDesc, mosaicVS, mosaicPS, [this]() { ResetConstantBufferRanges(); });
 
   auto waterPsoDesc = book_util::CreateDefaultPsoDesc(
     m_surfaceFormat,
-    waterVS, waterPS, CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT),
+    waterVS.shaderBlob, waterPS.shaderBlob, CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT),
     inputElementDesc, _countof(inputElementDesc),
     m_effectRS
   );
-  hr = m_device->CreateGraphicsPipelineState(&waterPsoDesc, IID_PPV_ARGS(&m_waterPSO));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&waterPsoDesc, IID_PPV_ARGS(&m_waterPSO));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.(Water)");
+  m_shaderHotReload->Register(this, &m_waterPSO, waterPsoDesc, waterVS, waterPS, [this]() { ResetConstantBufferRanges(); });
 
   m_postEffect.vertexCount = 4;
+}
+
+void PostEffectApp::PrepareConstantBufferRanges(const std::vector<ShaderCompileJob>& shaders)
+{
+  // 萔obt@̍\̂VF[_[ cbuffer ƏƍApCvCɓǂޔ͈͂߂.
+  auto teapot = ReflectConstantBuffers({ &shaders[0], &shaders[1] });
+  CheckConstantBufferLayout(teapot, 0, GetSceneParameterFields(), sizeof(SceneParameter));
+  CheckConstantBufferLayout(teapot, 1, GetInstanceParameterFields(), sizeof(InstanceParameter));
+  m_sceneParameterRange = teapot.GetUsedRange(0, sizeof(SceneParameter));
+  m_instanceParameterRange = teapot.GetUsedRange(1, sizeof(InstanceParameter));
+
+  const auto effectFields = GetEffectParameterFields();
+  auto mosaic = ReflectConstantBuffers({ &shaders[2], &shaders[3] });
+  auto water = ReflectConstantBuffers({ &shaders[4], &shaders[5] });
+  CheckConstantBufferLayout(mosaic, 0, effectFields, sizeof(EffectParameter));
+  CheckConstantBufferLayout(water, 0, effectFields, sizeof(EffectParameter));
+  m_effectParameterRanges[EFFECT_TYPE_MOSAIC] = mosaic.GetUsedRange(0, sizeof(EffectParameter));
+  m_effectParameterRanges[EFFECT_TYPE_WATER] = water.GetUsedRange(0, sizeof(EffectParameter));
+}
 
-  for (UINT i = 0; i < FrameBufferCount; ++i)
+void PostEffectApp::ResetConstantBufferRanges()
+{
+  // ւVF[_[͕ʂ̕ϐǂނȂ߁Aȍ~͍\̂̑Ŝ.
+  m_sceneParameterRange = ConstantBufferRange{ 0, sizeof(SceneParameter) };
+  m_instanceParameterRange = ConstantBufferRange{ 0, sizeof(InstanceParameter) };
+  for (auto& range : m_effectParameterRanges)
   {
-    UINT bufferSize = sizeof(EffectParameter);
-    bufferSize = book_util::RoundupConstantBufferSize(bufferSize);
-    auto cbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-    auto cb = CreateResource(cbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
-    m_effectCB.push_back(cb);
+    range = ConstantBufferRange{ 0, sizeof(EffectParameter) };
   }
 }
 
-void PostEffectApp::PrepareRenderTextureResource()
+FrameGraph::TextureDesc PostEffectApp::GetSceneColorDesc() const
 {
-  auto colorTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
-  );
-  auto depthTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_D32_FLOAT, m_width, m_height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
-  );
-  
-  D3D12_CLEAR_VALUE clearColor, clearDepth;
-  clearColor.Format = colorTexDesc.Format;
-  clearColor.Color[0] = 0.5f;
-  clearColor.Color[1] = 0.75f;
-  clearColor.Color[2] = 1.0f;
-  clearColor.Color[3] = 0.0f;
-  clearDepth.Format = DXGI_FORMAT_D32_FLOAT;
-  clearDepth.DepthStencil.Depth = 1.0f;
-  clearDepth.DepthStencil.Stencil = 0;
-
-  m_colorRT = CreateResource(colorTexDesc, D3D12_RESOURCE_STATE_RENDER_TARGET, &clearColor, D3D12_HEAP_TYPE_DEFAULT);
-  m_depthRT = CreateResource(depthTexDesc, D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearDepth, D3D12_HEAP_TYPE_DEFAULT);
-
-  m_hColorRTV = m_heapRTV->Alloc();
-  m_device->CreateRenderTargetView(m_colorRT.Get(), nullptr, m_hColorRTV);
-  m_hDepthDSV = m_heapDSV->Alloc();
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
-  dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  m_device->CreateDepthStencilView(m_depthRT.Get(), &dsvDesc, m_hDepthDSV);
-
-  m_hColorSRV = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-  srvDesc.Format = colorTexDesc.Format;
-  srvDesc.Texture2D.MipLevels = 1;
-  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(m_colorRT.Get(), &srvDesc, m_hColorSRV);
+  return FrameGraph::TextureDesc{
+    m_width, m_height, DXGI_FORMAT_R8G8B8A8_UNORM, 1, { 0.5f, 0.75f, 1.0f, 0.0f }
+  };
+}
+FrameGraph::TextureDesc PostEffectApp::GetSceneDepthDesc() const
+{
+  return FrameGraph::TextureDesc{
+    m_width, m_height, DXGI_FORMAT_D32_FLOAT, 1, { 1.0f }
+  };
+}
+
+void PostEffectApp::PrepareFrameGraph()
+{
+  m_backBufferId = m_frameGraph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  m_depthBufferId = m_frameGraph.ImportTexture("DepthBuffer", FrameGraph::USAGE_DEPTH_WRITE, FrameGraph::USAGE_DEPTH_WRITE);
+  m_sceneColorId = m_frameGraph.CreateTexture("SceneColor", GetSceneColorDesc());
+  m_sceneDepthId = m_frameGraph.CreateTexture("SceneDepth", GetSceneDepthDesc());
+
+  auto scenePass = m_frameGraph.AddPass("Scene", [this](FrameGraphContext& context) { RenderToTexture(context); });
+  m_frameGraph.Write(scenePass, m_sceneColorId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(scenePass, m_sceneDepthId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  auto effectPass = m_frameGraph.AddPass("PostEffect", [this](FrameGraphContext& context) { RenderToMain(context); });
+  m_frameGraph.Read(effectPass, m_sceneColorId, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  m_frameGraph.Write(effectPass, m_backBufferId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(effectPass, m_depthBufferId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  // ImGui ̃tgGhŌɏd˂.
+  auto uiPass = m_frameGraph.AddPass("ImGui", [this](FrameGraphContext& context) { RenderImGui(context); });
+  m_frameGraph.Write(uiPass, m_backBufferId, FrameGraph::USAGE_RENDER_TARGET);
+
+  m_frameGraphExecutor.Prepare(this, m_heapRTV, m_heapDSV, m_heapStaging);
+  m_frameGraphExecutor.Compile(m_frameGraph);
 }
@@ -1,5 +1,8 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "DescriptorRing.h"
+#include "FrameGraphExecutor.h"
+#include "GeometryPool.h"
 #include <DirectXMath.h>
 
 class PostEffectApp : public D3D12AppBase {
@@ -29,22 +32,68 @@ public:
     float  distortion; // c݋x
     float  brightness; // 邳W
   };
+
+  enum {
+    InstanceCount = 200,
+  };
+  struct InstanceData
+  {
+    DirectX::XMFLOAT4X4 world;
+    DirectX::XMFLOAT4 Color;
+  };
+  struct InstanceParameter
+  {
+    InstanceData  data[InstanceCount];
+  };
+
+  // VF[_[ cbuffer Ƃ̑Ή. P̃eXgł\[XƏƍ.
+  static std::vector<ConstantBufferField> GetSceneParameterFields()
+  {
+    return {
+      CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+      CONSTANT_BUFFER_FIELD(SceneParameter, proj, proj),
+    };
+  }
+  static std::vector<ConstantBufferField> GetInstanceParameterFields()
+  {
+    return { CONSTANT_BUFFER_FIELD(InstanceParameter, data, data) };
+  }
+  static std::vector<ConstantBufferField> GetEffectParameterFields()
+  {
+    return {
+      CONSTANT_BUFFER_FIELD(EffectParameter, screenSize, windowSize),
+      CONSTANT_BUFFER_FIELD(EffectParameter, mosaicBlockSize, blockSize),
+      CONSTANT_BUFFER_FIELD(EffectParameter, frameCount, frameCount),
+      CONSTANT_BUFFER_FIELD(EffectParameter, ripple, ripple),
+      CONSTANT_BUFFER_FIELD(EffectParameter, speed, speed),
+      CONSTANT_BUFFER_FIELD(EffectParameter, distortion, distortion),
+      CONSTANT_BUFFER_FIELD(EffectParameter, brightness, brightness),
+    };
+  }
 private:
   using Buffer = ComPtr<ID3D12Resource1>;
   using Texture = ComPtr<ID3D12Resource1>;
 
-  void RenderToTexture();
-  void RenderToMain();
+  void RenderToTexture(FrameGraphContext& context);
+  void RenderToMain(FrameGraphContext& context);
 
   void UpdateImGui();
-  void RenderImGui();
-
-  void PrepareTeapot();
-  void PreparePostEffectPlane();
-  void PrepareRenderTextureResource();
+  void RenderImGui(FrameGraphContext& context);
+
+  void PrepareTeapot(const ShaderCompileJob& vs, const ShaderCompileJob& ps);
+  void PreparePostEffectPlane(
+    const ShaderCompileJob& mosaicVS, const ShaderCompileJob& mosaicPS,
+    const ShaderCompileJob& waterVS, const ShaderCompileJob& waterPS);
+  void PrepareFrameGraph();
+  void PrepareConstantBufferRanges(const std::vector<ShaderCompileJob>& shaders);
+  void ResetConstantBufferRanges();
+  FrameGraph::TextureDesc GetSceneColorDesc() const;
+  FrameGraph::TextureDesc GetSceneDepthDesc() const;
 
   enum {
-    InstanceCount = 200,
+    TransientDescriptorCount = 256,
+    GeometryVertexMax = 65536,
+    GeometryIndexMax = 65536 * 3,
   };
   enum EffectType
   {
@@ -52,28 +101,12 @@ private:
     EFFECT_TYPE_WATER,
   };
 
-  struct InstanceData
-  {
-    DirectX::XMFLOAT4X4 world;
-    DirectX::XMFLOAT4 Color;
-  };
-  struct InstanceParameter
-  {
-    InstanceData  data[InstanceCount];
-  };
-
   struct ModelData
   {
-    UINT indexCount;
-    D3D12_VERTEX_BUFFER_VIEW vbView;
-    D3D12_INDEX_BUFFER_VIEW  ibView;
-    Buffer resourceVB;
-    Buffer resourceIB;
+    GeometryPool::MeshHandle mesh;
 
     ComPtr<ID3D12RootSignature> rootSig;
     ComPtr<ID3D12PipelineState> pipeline;
-    std::vector<Buffer> sceneCB;
-    std::vector<Buffer> instanceCB;
   };
   struct PlaneData
   {
@@ -82,18 +115,25 @@ private:
     Buffer resourceVB;
   };
 
-  Texture m_colorRT, m_depthRT;
-  DescriptorHandle m_hColorRTV;
-  DescriptorHandle m_hDepthDSV;
-  DescriptorHandle m_hColorSRV;
+  // V[̕`͈ꎞeNX`Ƃăt[OtŊǗ.
+  // SRV  CPU pq[vɒuA`掞ɃOփRs[.
+  FrameGraph m_frameGraph;
+  FrameGraphExecutor m_frameGraphExecutor;
+  FrameGraph::ResourceId m_backBufferId, m_depthBufferId;
+  FrameGraph::ResourceId m_sceneColorId, m_sceneDepthId;
+  DescriptorRing m_descriptorRing;
 
+  GeometryPool m_geometryPool;
   ModelData m_model;
   PlaneData m_postEffect;
 
   UINT m_frameCount;
 
   EffectParameter m_effectParameter;
-  std::vector<Buffer> m_effectCB;
+  // 萔obt@̂VF[_[ǂޔ͈. ݂͈͂̔͂ɂ.
+  ConstantBufferRange m_sceneParameterRange;
+  ConstantBufferRange m_instanceParameterRange;
+  ConstantBufferRange m_effectParameterRanges[2]; // EffectType .
 
   EffectType m_effectType;
   ComPtr<ID3D12RootSignature> m_effectRS;
@@ -23,7 +23,7 @@ cbuffer ShaderParameter : register(b0)
 }
 cbuffer InstanceParameter : register(b1)
 {
-  InstanceData data[500];
+  InstanceData data[200]; // PostEffectApp::InstanceCount
 }
 
 VSOutput main( VSInput In )
@@ -19,80 +19,32 @@ BundleApp::BundleApp()
 void BundleApp::Prepare()
 {
   SetTitle("Bundle Sample");
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
-
   void* mapped;
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
-  UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
-
-  m_model.resourceVB = CreateBufferResource(
-    D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COPY_DEST
-  );
-
-  auto uploadVB = CreateBufferResource(
-    D3D12_HEAP_TYPE_UPLOAD, bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ
-  );
-
-  hr = uploadVB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotVerticesPN, bufferSize);
-    uploadVB->Unmap(0, nullptr);
-  }
-  m_model.vbView.BufferLocation = m_model.resourceVB->GetGPUVirtualAddress();
-  m_model.vbView.SizeInBytes = bufferSize;
-  m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
-
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
-
-  bufferSize = sizeof(TeapotModel::TeapotIndices);
-  m_model.resourceIB = CreateBufferResource(
-    D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COPY_DEST
-  );
-  auto uploadIB = CreateBufferResource(
-    D3D12_HEAP_TYPE_UPLOAD, bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ
-  );
-
-  hr = uploadIB->Map(0, nullptr, &mapped);
-  if (SUCCEEDED(hr)) {
-    memcpy(mapped, TeapotModel::TeapotIndices, bufferSize);
-    uploadIB->Unmap(0, nullptr);
+  UINT bufferSize = 0;
+
+  // _ECfbNX̓WIgv[ւ܂Ƃ߂Ĕzu.
+  // ]̓Rs[L[֐ς܂A`L[ GPU Ŋ҂.
+  m_geometryPool.Prepare(this, sizeof(TeapotModel::Vertex), GeometryVertexMax, GeometryIndexMax);
+  m_model.mesh = m_geometryPool.AddMesh(this,
+    TeapotModel::TeapotVerticesPN, _countof(TeapotModel::TeapotVerticesPN),
+    TeapotModel::TeapotIndices, _countof(TeapotModel::TeapotIndices));
+  if (m_model.mesh == GeometryPool::InvalidHandle)
+  {
+    throw std::runtime_error("GeometryPool is full.");
   }
-  m_model.ibView.BufferLocation = m_model.resourceIB->GetGPUVirtualAddress();
-  m_model.ibView.SizeInBytes = bufferSize;
-  m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
-  m_model.indexCount = _countof(TeapotModel::TeapotIndices);
-
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
-
-  // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
-
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
-
-  WaitForIdleGPU(); // ̂҂.
+  QueueWaitForUpload(m_geometryPool.GetUploadTicket());
 
   ComPtr<ID3DBlob> errBlob;
-  hr = CompileShaderFromFile(
-    L"VertexShader.hlsl", L"vs_6_0", m_vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-
-  hr = CompileShaderFromFile(
-    L"PixelShader.hlsl", L"ps_6_0", m_ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  std::vector<ShaderCompileJob> shaders = {
+    { L"VertexShader.hlsl", L"vs_6_0" },
+    { L"PixelShader.hlsl", L"ps_6_0" },
+  };
+  hr = CompileShadersFromFile(shaders);
+  ThrowIfFailed(hr, "Shader compile error");
+  m_vs = shaders[0].shaderBlob;
+  m_ps = shaders[1].shaderBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[2];
@@ -106,7 +58,7 @@ void BundleApp::Prepare()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_rootSignature)
   );
@@ -144,7 +96,7 @@ void BundleApp::Prepare()
   psoDesc.SampleDesc = { 1,0 };
   psoDesc.SampleMask = UINT_MAX; // YƊGoȂxoȂ̂Œ.
 
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@̏
@@ -207,8 +159,11 @@ void BundleApp::Prepare()
     ThrowIfFailed(hr, "CreateCommandList(Bundle) failed.");
 
     bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    bundle->IASetVertexBuffers(0, 1, &m_model.vbView);
-    bundle->IASetIndexBuffer(&m_model.ibView);
+    // v[̃bV͓obt@ݒL.
+    auto vbView = m_geometryPool.GetVertexBufferView();
+    auto ibView = m_geometryPool.GetIndexBufferView();
+    bundle->IASetVertexBuffers(0, 1, &vbView);
+    bundle->IASetIndexBuffer(&ibView);
     bundle->SetGraphicsRootSignature(m_rootSignature.Get());
     bundle->SetPipelineState(m_pipeline.Get());
     bundle->SetGraphicsRootConstantBufferView(
@@ -217,8 +172,9 @@ void BundleApp::Prepare()
     bundle->SetGraphicsRootConstantBufferView(
       1, m_instanceBuffers[i]->GetGPUVirtualAddress()
     );
+    const auto& mesh = m_geometryPool.GetMesh(m_model.mesh);
     bundle->DrawIndexedInstanced(
-      m_model.indexCount, m_instancingCount, 0, 0, 0);
+      mesh.indexCount, m_instancingCount, mesh.firstIndex, mesh.baseVertex, 0);
     bundle->Close();
 
     m_bundles.emplace_back(bundle);
@@ -226,6 +182,7 @@ void BundleApp::Prepare()
 }
 void BundleApp::Cleanup()
 {
+  m_geometryPool.Cleanup(this);
 }
 
 
@@ -248,41 +205,38 @@ void BundleApp::Render()
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
 
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(),
-    nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
 
   // J[obt@(_[^[Qbgr[)̃NA
   float clearColor[4] = { 0.5f,0.75f,1.0f,0 };
-  m_commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   // r[|[gƃVU[̃Zbg
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
   auto cb = m_constantBuffers[m_frameIndex];
   {
@@ -293,17 +247,11 @@ void BundleApp::Render()
   }
 
   auto teapot = m_bundles[m_frameIndex];
-  m_commandList->ExecuteBundle(teapot.Get());
+  commandList->ExecuteBundle(teapot.Get());
 
   // _[^[QbgXbv`FC\\
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -311,19 +259,6 @@ void BundleApp::Render()
 
 BundleApp::Buffer BundleApp::CreateBufferResource(D3D12_HEAP_TYPE type, UINT bufferSize, D3D12_RESOURCE_STATES state)
 {
-  Buffer ret;
-  HRESULT hr;
-
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(type);
   const auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &resDesc,
-    state,
-    nullptr,
-    IID_PPV_ARGS(&ret)
-  );
-  ThrowIfFailed(hr, "CreateCommittedResource failed.");
-  return ret;
+  return CreateResource(resDesc, state, nullptr, type);
 }
\ No newline at end of file
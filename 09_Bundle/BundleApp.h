@@ -2,6 +2,7 @@
 
 #pragma once
 #include "D3D12AppBase.h"
+#include "GeometryPool.h"
 #include <DirectXMath.h>
 
 class BundleApp : public D3D12AppBase {
@@ -34,15 +35,13 @@ private:
 
   enum {
     InstanceDataMax = 500,
+    GeometryVertexMax = 65536,
+    GeometryIndexMax = 65536 * 3,
   };
 
   struct ModelData
   {
-    UINT indexCount;
-    D3D12_VERTEX_BUFFER_VIEW vbView;
-    D3D12_INDEX_BUFFER_VIEW  ibView;
-    Buffer resourceVB;
-    Buffer resourceIB;
+    GeometryPool::MeshHandle mesh;
   };
 
   struct InstanceData
@@ -55,6 +54,7 @@ private:
     InstanceData  data[InstanceDataMax];
   };
 
+  GeometryPool m_geometryPool;
   ModelData m_model;
   std::vector<Buffer> m_instanceBuffers;
 
@@ -6,17 +6,21 @@
 #include <DirectXTex.h>
 
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <exception>
 
 using namespace std;
 using namespace DirectX;
 
-#define DRAW_GROUP_NORMAL std::string("normalDraw")
 #define DRAW_GROUP_OUTLINE std::string("outlineDraw")
 #define DRAW_GROUP_SHADOW std::string("shadowDraw")
+#define DRAW_GROUP_NORMAL_BINDLESS std::string("normalDrawBindless")
 
-inline Model::PMDVertex convertTo(const loader::PMDVertex& v)
+inline ModelAsset::PMDVertex convertTo(const loader::PMDVertex& v)
 {
-  return Model::PMDVertex{
+  return ModelAsset::PMDVertex{
     v.getPosition(), v.getNormal(), v.getUV(),
     XMUINT2(v.getBoneIndex(0), v.getBoneIndex(1)),
     XMFLOAT2(v.getBoneWeight(0), v.getBoneWeight(1)),
@@ -62,14 +66,6 @@ bool Material::HasTexture() const
   return m_parameters.useTexture != 0;
 }
 
-void Material::Update(D3D12AppBase* app)
-{
-  app->WriteToUploadHeapMemory(
-    m_materialConstantBuffer.resource.Get(),
-    sizeof(m_parameters),
-    &m_parameters);
-}
-
 Bone::Bone() :
   m_name(), m_translation(), m_rotation(), m_initialTranslation(),
   m_parent(nullptr), m_mtxLocal(), m_mtxWorld(), m_mtxInvBind()
@@ -121,18 +117,169 @@ void Bone::SetInitialTranslation(const XMFLOAT3& trans)
   m_initialTranslation = XMLoadFloat3(&trans);
 }
 
-void Model::Prepare(D3D12AppBase* app, const char* filename)
+// Abv[hp̃obt@펞}bvĂ. ɎIɃA}bv.
+static std::vector<void*> MapUploadBuffers(const std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>>& buffers)
+{
+  std::vector<void*> mapped(buffers.size());
+  CD3DX12_RANGE readRange(0, 0);
+  for (size_t i = 0; i < buffers.size(); ++i)
+  {
+    HRESULT hr = buffers[i]->Map(0, &readRange, &mapped[i]);
+    ThrowIfFailed(hr, "Map failed.");
+  }
+  return mapped;
+}
+
+// GPU Ŋmۂ郊\[X̃TCY߂.
+static UINT64 GetAllocationBytes(D3D12AppBase* app, ID3D12Resource* resource)
+{
+  if (resource == nullptr)
+  {
+    return 0;
+  }
+  auto desc = resource->GetDesc();
+  auto info = app->GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+  return info.SizeInBytes;
+}
+
+// 摜ɍ킹eNX`zu\[XƂč. ]Ƃ COPY_DEST ōA
+// Rs[L[ŎgI COMMON ֖߂邽߁A`掞̈Öق̏iɔC.
+static Microsoft::WRL::ComPtr<ID3D12Resource1> CreateTextureResource(D3D12AppBase* app, const TexMetadata& metadata)
+{
+  auto desc = CD3DX12_RESOURCE_DESC::Tex2D(
+    metadata.format, UINT64(metadata.width), UINT(metadata.height),
+    UINT16(metadata.arraySize), UINT16(metadata.mipLevels));
+  return app->CreateResource(desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, D3D12_HEAP_TYPE_DEFAULT);
+}
+
+// [J[Xbhœǂݍ񂾃eNX`. GPU ւ̓]̓CXbhōs.
+struct LoadedTexture
+{
+  ScratchImage image;
+  Microsoft::WRL::ComPtr<ID3D12Resource1> texture;
+  DescriptorHandle descriptor;
+  std::exception_ptr error;
+};
+
+// 摜̃fR[hAeNX`̐ SRV ̍쐬𕡐Xbhōs.
+// fBXNv^̓XbhƂ̃LbVmۂ.
+static void LoadTexturesParallel(D3D12AppBase* app, const vector<string>& files, vector<LoadedTexture>& results)
+{
+  results.resize(files.size());
+  auto device = app->GetDevice();
+  auto descriptorManager = app->GetDescriptorManager();
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    // WIC g߃XbhƂ COM .
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    DescriptorManager::ThreadCache cache(descriptorManager->GetConcurrentPool());
+    size_t i;
+    while ((i = next++) < files.size())
+    {
+      auto& result = results[i];
+      try
+      {
+        HRESULT hr = LoadFromWICFile(book_util::ConvertWstring(files[i]).c_str(), 0, nullptr, result.image);
+        ThrowIfFailed(hr, "LoadFromWICFile Failed.");
+        auto metadata = result.image.GetMetadata();
+        result.texture = CreateTextureResource(app, metadata);
+
+        // eNX`QƂ̂߂̃fBXNv^.
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+        srvDesc.Format = metadata.format;
+        srvDesc.Texture2D.MipLevels = UINT(metadata.mipLevels);
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        result.descriptor = descriptorManager->Alloc(cache);
+        device->CreateShaderResourceView(
+          result.texture.Get(), &srvDesc, result.descriptor);
+      }
+      catch (...)
+      {
+        result.error = std::current_exception();
+      }
+    }
+    CoUninitialize();
+  };
+
+  auto threadCount = std::min<size_t>(files.size(), std::max(1u, std::thread::hardware_concurrency()));
+  vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; ++i)
+  {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  for (auto& result : results)
+  {
+    if (result.error)
+    {
+      std::rethrow_exception(result.error);
+    }
+  }
+}
+
+std::unordered_map<std::string, std::weak_ptr<ModelAsset>> ModelAsset::s_cache;
+
+ModelAsset::ModelAsset()
+  : m_materialStride(0), m_materialTableStats(),
+  m_bonePaletteBytes(0), m_paletteStats(), m_legacyPaletteStats(),
+  m_useTextureFeature(0), m_pipelineGeneration(0), m_sceneParameterRange{ 0, sizeof(SceneParameter) },
+  m_indexBufferSize(0), m_isBindlessSupported(false), m_morphVertexBegin(0), m_morphVertexEnd(0)
+{
+}
+
+ModelAsset::~ModelAsset()
+{
+  if (m_shaderHotReload)
+  {
+    m_shaderHotReload->Unregister(this);
+  }
+  // AhXɍꂽʂ̃\[XÂXe[gpȂ悤Ao^O.
+  if (m_resourceStates)
+  {
+    m_resourceStates->Unregister(m_indexBuffer.Get());
+    m_resourceStates->Unregister(m_textureDummy.Get());
+    for (const auto& material : m_materials)
+    {
+      m_resourceStates->Unregister(material.GetTexture().resource.Get());
+    }
+  }
+}
+
+std::shared_ptr<ModelAsset> ModelAsset::Load(D3D12AppBase* app, const std::string& filename)
+{
+  auto itr = s_cache.find(filename);
+  if (itr != s_cache.end())
+  {
+    auto asset = itr->second.lock();
+    if (asset)
+    {
+      return asset;
+    }
+  }
+  auto asset = std::make_shared<ModelAsset>();
+  asset->Prepare(app, filename.c_str());
+  s_cache[filename] = asset;
+  return asset;
+}
+
+void ModelAsset::Prepare(D3D12AppBase* app, const char* filename)
 {
   ifstream infile(filename, std::ios::binary);
   loader::PMDFile loader(infile);
   auto device = app->GetDevice();
+  m_resourceStates = app->GetResourceStateTable();
 
   auto vertexCount = loader.getVertexCount();
   auto indexCount = loader.getIndexCount();
-  m_hostMemVertices.resize(vertexCount);
+  m_vertices.resize(vertexCount);
   for (uint32_t i = 0; i < vertexCount; ++i)
   {
-    m_hostMemVertices[i] = convertTo(loader.getVertex(i));
+    m_vertices[i] = convertTo(loader.getVertex(i));
   }
   std::vector<uint32_t> modelIndices(indexCount);
   for (uint32_t i = 0; i < indexCount; ++i)
@@ -141,47 +288,52 @@ void Model::Prepare(D3D12AppBase* app, const char* filename)
     v = loader.getIndices()[i];
   }
 
+  // }eA̎Op`AQƃ{[ BonePaletteSize ȉɂȂ悤.
+  // _̓TubṼ[J{[ԍ悤Kvɉĕ.
+  const auto materialCount = loader.getMaterialCount();
+  std::vector<uint32_t> materialIndexCounts(materialCount);
+  for (uint32_t i = 0; i < materialCount; ++i)
+  {
+    materialIndexCounts[i] = loader.getMaterial(i).getNumberOfPolygons();
+  }
+  std::vector<uint32_t> srcIndices;
+  std::swap(srcIndices, modelIndices);
+  PartitionBonePalettes(loader.getBoneCount(), srcIndices, materialIndexCounts, modelIndices);
+  indexCount = uint32_t(modelIndices.size());
+
+  // CfbNXobt@ƃeNX`̓Rs[L[ł܂Ƃ߂ē].
+  // Rs[L[ł̎gp COMMON ֖߂邽߁A`掞̈Öق̏iɔCăoA͒Ȃ.
+  auto uploader = app->GetUploadManager();
   m_indexBufferSize = indexCount * sizeof(UINT);
   auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(m_indexBufferSize);
-  auto stagingIB = app->CreateResource(
-    ibDesc, D3D12_RESOURCE_STATE_GENERIC_READ,
-    nullptr, D3D12_HEAP_TYPE_UPLOAD
-  );
   m_indexBuffer = app->CreateResource(
     ibDesc, 
     D3D12_RESOURCE_STATE_COPY_DEST,
     nullptr, D3D12_HEAP_TYPE_DEFAULT
   );
-  app->WriteToUploadHeapMemory(stagingIB.Get(), uint32_t(ibDesc.Width), modelIndices.data());
-
-  auto command = app->CreateCommandList();
-  // Staging => Default ֓][CfbNXobt@]
-  command->CopyResource(m_indexBuffer.Get(), stagingIB.Get());
-  // \[XXe[găZbg.
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_indexBuffer.Get(),
-    D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  command->ResourceBarrier(1, &barrierIB);
-  app->FinishCommandList(command);
+  uploader->UploadBuffer(m_indexBuffer.Get(), 0, modelIndices.data(), m_indexBufferSize);
 
-  // _obt@쐬.
-  m_vertexBuffers.resize(D3D12AppBase::FrameBufferCount);
-  auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(
-    vertexCount * sizeof(PMDVertex)
-  );
-  for (UINT i = 0; i < D3D12AppBase::FrameBufferCount; ++i)
+  // }eAQƂeNX`ɕœǂݍ.
+  vector<string> textureFiles;
+  vector<int> textureSlots(materialCount, -1);
+  for (uint32_t i = 0; i < materialCount; ++i)
   {
-    m_vertexBuffers[i] = app->CreateResource(
-      vbDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      D3D12_HEAP_TYPE_UPLOAD
-    );
+    auto textureFileName = loader.getMaterial(i).getTexture();
+    auto hasSphereMap = textureFileName.find('*');
+    if (hasSphereMap != std::string::npos)
+    {
+      textureFileName = textureFileName.substr(0, hasSphereMap);
+    }
+    if (!textureFileName.empty())
+    {
+      textureSlots[i] = int(textureFiles.size());
+      textureFiles.push_back(textureFileName);
+    }
   }
+  vector<LoadedTexture> textures;
+  LoadTexturesParallel(app, textureFiles, textures);
 
   // }eAǂݍ.
-  const auto materialCount = loader.getMaterialCount();
   for (uint32_t i = 0; i < materialCount; ++i)
   {
     const auto& src = loader.getMaterial(i);
@@ -189,135 +341,50 @@ void Model::Prepare(D3D12AppBase* app, const char* filename)
     materialParams.diffuse = toFloat4(src.getDiffuse(), src.getAlpha());
     materialParams.ambient = toFloat4(src.getAmbient(), 0.0f);
     materialParams.specular = toFloat4(src.getSpecular(), src.getShininess());
-    materialParams.useTexture = 0;
+    materialParams.useTexture = textureSlots[i] >= 0 ? 1 : 0;
     materialParams.edgeFlag = src.getEdgeFlag();
-
-    auto textureFileName = src.getTexture();
-    auto hasSphereMap = textureFileName.find('*');
-    if (hasSphereMap != std::string::npos)
-    {
-      textureFileName = textureFileName.substr(0, hasSphereMap);
-    }
-    if (!textureFileName.empty())
-    {
-      materialParams.useTexture = 1;
-    }
     Material material(materialParams);
-    auto cbDesc = CD3DX12_RESOURCE_DESC::Buffer(uint32_t(sizeof(materialParams)));
-    auto constantBuffers = app->CreateConstantBuffers(cbDesc, 1);
-    Material::Resource materialCB;
-    materialCB.resource = constantBuffers[0];
-    material.SetConstantBuffer(materialCB);
 
     if (materialParams.useTexture)
     {
-      // eNX`̓ǂݍ.
-      ScratchImage image;
-      HRESULT hr;
-      hr = LoadFromWICFile(book_util::ConvertWstring(textureFileName).c_str(), 0, nullptr, image);
-      ThrowIfFailed(hr, "LoadFromWICFile Failed.");
+      auto& loaded = textures[textureSlots[i]];
+      const auto& image = loaded.image;
+      const auto& texture = loaded.texture;
       auto metadata = image.GetMetadata();
-      
       vector<D3D12_SUBRESOURCE_DATA> subresources;
-      ComPtr<ID3D12Resource> texture;
-      CreateTexture(device.Get(), metadata, &texture);
 
-      // ]ƂȂXe[WOpobt@.
       PrepareUpload( device.Get(),
         image.GetImages(), image.GetImageCount(),
         metadata, subresources);
-      const auto totalBytes = GetRequiredIntermediateSize(
-        texture.Get(), 0, UINT(subresources.size()));
-      auto stagingTex= app->CreateResource(
-        CD3DX12_RESOURCE_DESC::Buffer(totalBytes),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        D3D12_HEAP_TYPE_UPLOAD
-      );
-      // Staging=>Texture].
-      command = app->CreateCommandList();
-      UpdateSubresources(
-        command.Get(),
-        texture.Get(), stagingTex.Get(), 
-        0, 0, uint32_t(subresources.size()),
-        subresources.data());
-
-      // \[XoAZbg
-      auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        texture.Get(),
-        D3D12_RESOURCE_STATE_COPY_DEST, 
-        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-      command->ResourceBarrier(1, &barrier);
-
-      app->FinishCommandList(command);
-
-      // eNX`QƂ̂߂̃fBXNv^.
-      D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-      srvDesc.Format = metadata.format;
-      srvDesc.Texture2D.MipLevels = UINT(metadata.mipLevels);
-      srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-      srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-      auto descriptor = app->GetDescriptorManager()->Alloc();
-      device->CreateShaderResourceView(
-        texture.Get(), &srvDesc, descriptor);
+      uploader->UploadTexture(texture.Get(), 0, subresources.data(), UINT(subresources.size()));
 
       Material::Resource res;
       texture.As(&res.resource);
-      res.descriptor = descriptor;
+      res.descriptor = loaded.descriptor;
       material.SetTexture(res);
     }
 
-    material.Update(app);
     m_materials.emplace_back(material);
   }
+  PrepareMaterialTable(app);
 
-  // `pbV\z.
-  for (uint32_t i = 0,offset=0; i < materialCount; ++i)
-  {
-    const auto& src = loader.getMaterial(i);
-    uint32_t indexCount = src.getNumberOfPolygons();
-
-    m_meshes.emplace_back(
-      Mesh{ offset, indexCount });
-    offset += indexCount;
-  }
-  
   // {[\z.
   uint32_t boneCount = loader.getBoneCount();
-  m_bones.reserve(boneCount);
-  for (uint32_t i = 0; i < boneCount; ++i)
-  {
-    const auto& boneSrc = loader.getBone(i);
-    auto index = boneSrc.getParent();
-
-    auto bone = new Bone(boneSrc.getName());
-    auto translation = boneSrc.getPosition();
-    if (index != 0xFFFFu)
-    {
-      const auto& parent = loader.getBone(boneSrc.getParent());
-      translation = translation - parent.getPosition();
-    }
-    bone->SetTranslation(translation);
-    bone->SetInitialTranslation(translation);
-
-    // oChtsO[oʒu苁߂.
-    auto bonePos = boneSrc.getPosition();
-    auto m = XMMatrixTranslationFromVector(XMLoadFloat3(&bonePos));
-    bone->SetInvBindMatrix(XMMatrixInverse(nullptr, m));
-
-    m_bones.push_back(bone);
-  }
+  m_bones.resize(boneCount);
   for (uint32_t i = 0; i < boneCount; ++i)
   {
     const auto& boneSrc = loader.getBone(i);
-    auto bone = m_bones[i];
-    uint32_t index = boneSrc.getParent();
-    if (index != 0xFFFFu)
+    auto& bone = m_bones[i];
+    bone.name = boneSrc.getName();
+    bone.parent = boneSrc.getParent();
+    bone.position = boneSrc.getPosition();
+    bone.translation = bone.position;
+    if (bone.parent != 0xFFFFu)
     {
-      bone->SetParent(m_bones[index]);
+      const auto& parent = loader.getBone(bone.parent);
+      bone.translation = bone.translation - parent.getPosition();
     }
   }
-  UpdateMatrices();
 
   // \[tǂݍ.
   {
@@ -351,158 +418,175 @@ void Model::Prepare(D3D12AppBase* app, const char* filename)
       memcpy(face.indices.data(), faceSrc.getFaceIndices(), sizeIB);
     }
 
-    m_faceMorphWeights.resize(faceCount);
+    // [tŏ钸_͈̔͂߂Ă(ꂽ_܂).
+    m_morphVertexBegin = UINT_MAX;
+    m_morphVertexEnd = 0;
+    for (auto index : m_faceBaseInfo.indices)
+    {
+      for (auto copy : m_vertexCopies[index])
+      {
+        m_morphVertexBegin = std::min(m_morphVertexBegin, copy);
+        m_morphVertexEnd = std::max(m_morphVertexEnd, copy + 1);
+      }
+    }
+    if (m_morphVertexBegin > m_morphVertexEnd)
+    {
+      m_morphVertexBegin = m_morphVertexEnd = 0;
+    }
   }
 
   // IK{[ǂݍ.
   auto ikBoneCount = loader.getIkCount();
-  m_boneIkList.resize(ikBoneCount);
+  m_iks.resize(ikBoneCount);
   for (uint32_t i = 0; i < ikBoneCount; ++i)
   {
     const auto& ik = loader.getIk(i);
-    auto& boneIk = m_boneIkList[i];
-    auto targetBone = m_bones[ik.getTargetBoneId()];
-    auto effectorBone = m_bones[ik.getBoneEff()];
-
-    boneIk = PMDBoneIK(targetBone, effectorBone);
-    boneIk.SetAngleLimit(ik.getAngleLimit());
-    boneIk.SetIterationCount(ik.getIterations());
-
-    auto chains = ik.getChains();
-    std::vector<Bone*> ikChains;
-    ikChains.reserve(chains.size());
-    for (auto& id : chains)
+    auto& dst = m_iks[i];
+    dst.target = ik.getTargetBoneId();
+    dst.effector = ik.getBoneEff();
+    dst.angleLimit = ik.getAngleLimit();
+    dst.iteration = ik.getIterations();
+    for (auto& id : ik.getChains())
     {
-      ikChains.push_back(m_bones[id]);
+      dst.chains.push_back(id);
     }
-    boneIk.SetIkChains(ikChains);
   }
 
+  // oChX`͔͈͖w̃fBXNv^e[ug Tier2 ȏオKv.
+  D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+  HRESULT hr = device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+  m_isBindlessSupported = SUCCEEDED(hr) &&
+    options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_2 &&
+    !m_materials.empty();
+
   PrepareRootSignature(app);
   PreparePipelineStates(app);
-  PrepareConstantBuffers(app);
   PrepareDummyTexture(app);
-  PrepareBundles(app);
+  // ς񂾓]1œA`L[ GPU Ŋ҂.
+  app->QueueWaitForUpload(uploader->Flush());
+  PrepareBindlessTextureTable(app);
+  ComputeBonePaletteStats();
 }
 
-void Model::Cleanup(D3D12AppBase* app)
+Microsoft::WRL::ComPtr<ID3D12PipelineState> ModelAsset::GetPipelineState(const std::string& name) const
 {
-  for (auto& b : m_bones)
+  auto itr = m_pipelineStates.find(name);
+  if (itr == m_pipelineStates.end())
   {
-    delete b;
+    return nullptr;
   }
-  m_bones.clear();
+  return itr->second;
 }
 
-void Model::UpdateMatrices()
+Microsoft::WRL::ComPtr<ID3D12PipelineState> ModelAsset::GetModelPipelineState(ShaderFeatureMask features) const
 {
-  for (auto& b : m_bones)
+  auto itr = m_modelPipelineStates.find(features);
+  if (itr == m_modelPipelineStates.end())
   {
-    if (b->GetParent())
-      continue;
-
-    b->UpdateMatrices();
+    return nullptr;
   }
+  return itr->second;
 }
 
-void Model::Update(uint32_t imageIndex, D3D12AppBase* app)
+ShaderFeatureMask ModelAsset::GetMaterialFeatures(const Material& material) const
 {
-  auto dstSceneCB = m_sceneParameterCB[imageIndex];
-  app->WriteToUploadHeapMemory(
-    dstSceneCB.Get(), sizeof(SceneParameter), &m_sceneParameter
-  );
+  return material.HasTexture() ? m_useTextureFeature : 0;
+}
 
-  // {[s萔obt@֏.
-  for (uint32_t i = 0; i < uint32_t(m_bones.size()); ++i)
+D3D12_INDEX_BUFFER_VIEW ModelAsset::GetIndexBufferView() const
+{
+  D3D12_INDEX_BUFFER_VIEW ibView{};
+  ibView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+  ibView.Format = DXGI_FORMAT_R32_UINT;
+  ibView.SizeInBytes = m_indexBufferSize;
+  return ibView;
+}
+
+UINT64 ModelAsset::GetGpuMemoryBytes(D3D12AppBase* app) const
+{
+  UINT64 total = GetAllocationBytes(app, m_indexBuffer.Get());
+  total += GetAllocationBytes(app, m_textureDummy.Get());
+  for (const auto& material : m_materials)
   {
-    auto bone = m_bones[i];
-    auto m = bone->GetInvBindMatrix() * bone->GetWorldMatrix();
-    XMStoreFloat4x4(&m_boneMatrices.bone[i], XMMatrixTranspose(m));
+    total += GetAllocationBytes(app, material.GetTexture().resource.Get());
   }
-  auto dstBoneCB = m_boneParameterCB[imageIndex];
-  app->WriteToUploadHeapMemory(
-    dstBoneCB.Get(), sizeof(BoneParameter), &m_boneMatrices
-  );
-
-  // [tvZƒ_obt@̍XV.
-  ComputeMorph();
-  auto dstVB = m_vertexBuffers[imageIndex];
-  uint32_t sizeVB = uint32_t(sizeof(PMDVertex) * m_hostMemVertices.size());
-  app->WriteToUploadHeapMemory(dstVB.Get(), sizeVB, m_hostMemVertices.data());
+  total += m_materialTableStats.packedBytes;
+  return total;
 }
 
-void Model::Draw(D3D12AppBase* app, ComPtr<ID3D12GraphicsCommandList> commandList)
+void ModelAsset::PrepareMaterialTable(D3D12AppBase* app)
 {
-  uint32_t index = app->GetSwapchain()->GetCurrentBackBufferIndex();
-  auto sceneCB = m_sceneParameterCB[index];
-  auto boneCB = m_boneParameterCB[index];
-
-  commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-  commandList->SetGraphicsRootConstantBufferView(0, sceneCB->GetGPUVirtualAddress());
-  commandList->SetGraphicsRootConstantBufferView(1, boneCB->GetGPUVirtualAddress());
-  commandList->SetGraphicsRootDescriptorTable(4, m_shadowMap);
-
-
-  // ݂̒_obt@Zbg.
-  D3D12_VERTEX_BUFFER_VIEW vbView{};
-  vbView.BufferLocation = m_vertexBuffers[index]->GetGPUVirtualAddress();
-  vbView.StrideInBytes = UINT(sizeof(PMDVertex));
-  vbView.SizeInBytes = UINT(vbView.StrideInBytes * m_hostMemVertices.size());
-  commandList->IASetVertexBuffers(0, 1, &vbView);
+  m_materialStride = book_util::RoundupConstantBufferSize(
+    UINT(sizeof(Material::MaterialParameters)));
+  const auto materialCount = UINT(m_materials.size());
+  if (materialCount == 0)
+  {
+    return;
+  }
+  // oChX`ł̓sNZVF[_[ SRV ƂĂQƂ.
+  m_materialTable.Prepare(app, m_materialStride * materialCount,
+    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+  m_materialTable.GetResource()->SetName(L"MaterialTable");
 
-  // ʏ`s.
-  commandList->ExecuteBundle(m_bundleNormalDraw.Get());
+  auto baseAddress = m_materialTable.GetGPUVirtualAddress();
+  for (UINT i = 0; i < materialCount; ++i)
+  {
+    auto& material = m_materials[i];
+    material.SetConstantBufferAddress(baseAddress + m_materialStride * i);
+    m_materialTable.Write(0, m_materialStride * i,
+      &material.GetParameters(), UINT(sizeof(Material::MaterialParameters)));
+  }
+  auto command = app->CreateCommandList();
+  m_materialTable.UploadDirtyRange(command);
+  app->FinishCommandList(command);
 
-  // ֊s`s.
-  commandList->ExecuteBundle(m_bundleOutline.Get());
+  // ȑO̕ł̓}eAɃAbv[hq[ṽobt@mۂĂ.
+  auto legacyDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(Material::MaterialParameters));
+  auto legacyInfo = app->GetDevice()->GetResourceAllocationInfo(0, 1, &legacyDesc);
+  m_materialTableStats.legacyBytes = legacyInfo.SizeInBytes * materialCount;
+  m_materialTableStats.packedBytes = GetAllocationBytes(app, m_materialTable.GetResource().Get())
+    + UINT64(m_materialTable.GetSize()) * D3D12AppBase::FrameBufferCount;
 }
 
-void Model::DrawShadow(D3D12AppBase* app, ComPtr<ID3D12GraphicsCommandList> commandList)
+void ModelAsset::SetMaterialParameters(uint32_t index, uint32_t frameIndex, const Material::MaterialParameters& params)
 {
-  uint32_t index = app->GetSwapchain()->GetCurrentBackBufferIndex();
-  auto sceneCB = m_sceneParameterCB[index];
-  auto boneCB = m_boneParameterCB[index];
-
-  commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-  commandList->SetGraphicsRootConstantBufferView(0, sceneCB->GetGPUVirtualAddress());
-  commandList->SetGraphicsRootConstantBufferView(1, boneCB->GetGPUVirtualAddress());
-
-  // ݂̒_obt@Zbg.
-  D3D12_VERTEX_BUFFER_VIEW vbView{};
-  vbView.BufferLocation = m_vertexBuffers[index]->GetGPUVirtualAddress();
-  vbView.StrideInBytes = UINT(sizeof(PMDVertex));
-  vbView.SizeInBytes = UINT(vbView.StrideInBytes * m_hostMemVertices.size());
-  commandList->IASetVertexBuffers(0, 1, &vbView);
-
-  // VhE}bv̂߂̕`s.
-  commandList->ExecuteBundle(m_bundleShadow.Get());
+  auto& material = m_materials[index];
+  material.SetParameters(params);
+  m_materialTable.Write(frameIndex, m_materialStride * index,
+    &material.GetParameters(), UINT(sizeof(Material::MaterialParameters)));
 }
 
-int Model::GetFaceMorphIndex(const std::string& faceName) const
+void ModelAsset::UploadMaterials(const ComPtr<ID3D12GraphicsCommandList>& commandList)
 {
-  int ret = -1;
-  for (uint32_t i = 0; i < m_faceOffsetInfo.size(); ++i)
+  if (m_materials.empty())
   {
-    const auto& face = m_faceOffsetInfo[i];
-    if (face.name == faceName)
-    {
-      ret = i;
-      break;
-    }
+    return;
   }
-  return ret;
+  m_materialTable.UploadDirtyRange(commandList);
 }
 
-void Model::SetFaceMorphWeight(int index, float weight)
+void ModelAsset::ComputeBonePaletteStats()
 {
-  if (index < 0)
+  // 1t[̕`œ]EQƂpbg̃TCYWv.
+  // O͑S{[(512)̒萔obt@]A`斈ɑŜQƂĂ.
+  const UINT64 legacyPaletteSize = sizeof(XMFLOAT4X4) * 512;
+  uint32_t materialDrawCount = 0;
+  m_paletteStats = BonePaletteStats{ m_bonePaletteBytes, 0 };
+  for (const auto& mesh : m_meshes)
   {
-    return;
+    const auto& material = m_materials[mesh.materialIndex];
+    // ʏ`, VhE`, ֊s`(Ώۂ̂)ŎQƂ.
+    UINT64 drawCount = material.GetEdgeFlag() ? 3 : 2;
+    m_paletteStats.boundBytes += drawCount * sizeof(XMFLOAT4X4) * mesh.palette.size();
   }
-  m_faceMorphWeights[index] = weight;
+  for (const auto& material : m_materials)
+  {
+    materialDrawCount += material.GetEdgeFlag() ? 3 : 2;
+  }
+  m_legacyPaletteStats = BonePaletteStats{ legacyPaletteSize, legacyPaletteSize * materialDrawCount };
 }
 
-void Model::PrepareRootSignature(D3D12AppBase* app)
+void ModelAsset::PrepareRootSignature(D3D12AppBase* app)
 {
   CD3DX12_DESCRIPTOR_RANGE diffuseTexRange;
   diffuseTexRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0); // t0 蓖.
@@ -510,12 +594,22 @@ void Model::PrepareRootSignature(D3D12AppBase* app)
   CD3DX12_DESCRIPTOR_RANGE shadowTexRange;
   shadowTexRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1); // t1 蓖.
 
-  array<CD3DX12_ROOT_PARAMETER, 5> rootParams;
+  CD3DX12_DESCRIPTOR_RANGE bindlessTexRange;
+  bindlessTexRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 2); // t0,space2 ͈͖w.
+
+  vector<CD3DX12_ROOT_PARAMETER> rootParams(5);
   rootParams[0].InitAsConstantBufferView(0); // sceneParameter
   rootParams[1].InitAsConstantBufferView(1); // boneParameter
   rootParams[2].InitAsConstantBufferView(2); // materialParameter
   rootParams[3].InitAsDescriptorTable(1, &diffuseTexRange, D3D12_SHADER_VISIBILITY_PIXEL);
   rootParams[4].InitAsDescriptorTable(1, &shadowTexRange, D3D12_SHADER_VISIBILITY_PIXEL);
+  if (m_isBindlessSupported)
+  {
+    rootParams.resize(8);
+    rootParams[5].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL); // materialIndex
+    rootParams[6].InitAsShaderResourceView(0, 1, D3D12_SHADER_VISIBILITY_PIXEL); // materialTable
+    rootParams[7].InitAsDescriptorTable(1, &bindlessTexRange, D3D12_SHADER_VISIBILITY_PIXEL);
+  }
 
   array<CD3DX12_STATIC_SAMPLER_DESC,2> samplerDesc;
   samplerDesc[0].Init(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
@@ -535,8 +629,9 @@ void Model::PrepareRootSignature(D3D12AppBase* app)
     &signature, &errBlob );
   ThrowIfFailed(hr, "D3D12SerializeRootSignature Failed.");
 
-  auto device = app->GetDevice();
-  hr = device->CreateRootSignature(
+  // e[gVOl`́Aʂ̃fł̂g.
+  auto pipelineCache = app->GetPipelineStateCache();
+  hr = pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_rootSignature)
   );
@@ -554,7 +649,7 @@ static void CheckCompileError(HRESULT hr, Microsoft::WRL::ComPtr<ID3DBlob>& errB
   ThrowIfFailed(hr, "ShaderCompileError");
 }
 
-void Model::PreparePipelineStates(D3D12AppBase* app)
+void ModelAsset::PreparePipelineStates(D3D12AppBase* app)
 {
   HRESULT hr;
   ComPtr<ID3DBlob> errBlob;
@@ -563,24 +658,51 @@ void Model::PreparePipelineStates(D3D12AppBase* app)
   rasterizerDesc.FrontCounterClockwise = true;
   rasterizerDesc.CullMode = D3D12_CULL_MODE_NONE;
 
+  // gVF[_[ɐ錾A܂Ƃ߂ĕɃRpC.
+  // eNX`̗L modelPS.hlsl ̕ώɂĂAsNZɕ򂳂Ȃ.
+  auto modelPermutation = LoadShaderPermutation(L"modelPS.hlsl");
+  m_useTextureFeature = modelPermutation.GetMask("USE_TEXTURE");
+  const ShaderFeatureMask modelVariants[] = { 0, m_useTextureFeature };
+  std::vector<ShaderCompileJob> shaders = {
+    { L"modelVS.hlsl", L"vs_6_0" },
+    { L"outlineVS.hlsl", L"vs_6_0" },
+    { L"outlinePS.hlsl", L"ps_6_0" },
+    { L"shadowVS.hlsl", L"vs_6_0" },
+    { L"shadowPS.hlsl", L"ps_6_0" },
+  };
+  const size_t modelPSIndex = shaders.size();
+  for (auto features : modelVariants)
+  {
+    shaders.emplace_back(L"modelPS.hlsl", L"ps_6_0", modelPermutation.MakeDefines(features));
+  }
+  if (m_isBindlessSupported)
+  {
+    shaders.emplace_back(L"modelBindlessPS.hlsl", L"ps_6_0");
+  }
+  CompileShadersFromFile(shaders);
+  for (auto& shader : shaders)
+  {
+    CheckCompileError(shader.hr, shader.errorBlob);
+  }
+
+  // 萔obt@̍\̂VF[_[ cbuffer Əƍ.
+  // V[̃p[^͑SẴpXŋL邽߁Aǂꂩ̃VF[_[ǂޔ͈͂.
+  std::vector<const ShaderCompileJob*> reflected;
+  for (const auto& shader : shaders)
+  {
+    reflected.push_back(&shader);
+  }
+  auto binding = ReflectConstantBuffers(reflected);
+  CheckConstantBufferLayout(binding, 0, GetSceneParameterFields(), sizeof(SceneParameter));
+  CheckConstantBufferLayout(binding, 1, GetBoneParameterFields(), sizeof(BoneParameter));
+  CheckConstantBufferLayout(binding, 2, Material::GetParameterFields(), sizeof(Material::MaterialParameters));
+  m_sceneParameterRange = binding.GetUsedRange(0, sizeof(SceneParameter));
+
   using Shader = ComPtr<ID3DBlob>;
-  Shader modelVS, modelPS;
-  CheckCompileError(
-    CompileShaderFromFile(L"modelVS.hlsl", L"vs_6_0", modelVS, errBlob), errBlob);
-  CheckCompileError(
-    CompileShaderFromFile(L"modelPS.hlsl", L"ps_6_0", modelPS, errBlob), errBlob);
-
-  Shader modelOutlineVS, modelOutlinePS;
-  CheckCompileError(
-    CompileShaderFromFile(L"outlineVS.hlsl", L"vs_6_0", modelOutlineVS, errBlob), errBlob);
-  CheckCompileError(
-    CompileShaderFromFile(L"outlinePS.hlsl", L"ps_6_0", modelOutlinePS, errBlob), errBlob);
-
-  Shader shadowVS, shadowPS;
-  CheckCompileError(
-    CompileShaderFromFile(L"shadowVS.hlsl", L"vs_6_0", shadowVS, errBlob), errBlob);
-  CheckCompileError(
-    CompileShaderFromFile(L"shadowPS.hlsl", L"ps_6_0", shadowPS, errBlob), errBlob);
+  Shader modelVS = shaders[0].shaderBlob;
+  Shader modelOutlineVS = shaders[1].shaderBlob, modelOutlinePS = shaders[2].shaderBlob;
+  Shader shadowVS = shaders[3].shaderBlob, shadowPS = shaders[4].shaderBlob;
+  Shader modelBindlessPS = m_isBindlessSupported ? shaders.back().shaderBlob : nullptr;
 
   D3D12_INPUT_ELEMENT_DESC inputElementDesc[] = {
     { "POSITION",     0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
@@ -593,7 +715,7 @@ void Model::PreparePipelineStates(D3D12AppBase* app)
 
   auto modelPsoDesc = book_util::CreateDefaultPsoDesc(
     DXGI_FORMAT_R8G8B8A8_UNORM,
-    modelVS, modelPS, rasterizerDesc,
+    modelVS, shaders[modelPSIndex].shaderBlob, rasterizerDesc,
     inputElementDesc, _countof(inputElementDesc),
     m_rootSignature.Get()
   );
@@ -618,110 +740,64 @@ void Model::PreparePipelineStates(D3D12AppBase* app)
   );
   shadowPsoDesc.BlendState.RenderTarget[0].BlendEnable = true;
 
-  auto device = app->GetDevice();
+  // Lq̃pCvC͋LAŐNŕۑ̂΃RpCɓǂݍ.
+  auto pipelineCache = app->GetPipelineStateCache();
   ComPtr<ID3D12PipelineState> pso;
-  hr = device->CreateGraphicsPipelineState(
-    &modelPsoDesc, IID_PPV_ARGS(&pso)
-  );
-  ThrowIfFailed(hr, "CreateGraphicsPipelineState Failed(normalDraw).");
-  m_pipelineStates[DRAW_GROUP_NORMAL] = pso;
-  hr = device->CreateGraphicsPipelineState(
+  for (size_t i = 0; i < _countof(modelVariants); ++i)
+  {
+    auto variantPsoDesc = modelPsoDesc;
+    variantPsoDesc.PS = CD3DX12_SHADER_BYTECODE(shaders[modelPSIndex + i].shaderBlob.Get());
+    hr = pipelineCache->CreateGraphicsPipelineState(
+      &variantPsoDesc, IID_PPV_ARGS(&pso)
+    );
+    ThrowIfFailed(hr, "CreateGraphicsPipelineState Failed(normalDraw).");
+    m_modelPipelineStates[modelVariants[i]] = pso;
+  }
+  hr = pipelineCache->CreateGraphicsPipelineState(
     &outlinePsoDesc, IID_PPV_ARGS(&pso));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState Failed(outlineDraw).");
   m_pipelineStates[DRAW_GROUP_OUTLINE] = pso;
-  hr = device->CreateGraphicsPipelineState(
+  hr = pipelineCache->CreateGraphicsPipelineState(
     &shadowPsoDesc, IID_PPV_ARGS(&pso));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState Failed(shadowDraw).");
   m_pipelineStates[DRAW_GROUP_SHADOW] = pso;
-}
-
-void Model::PrepareConstantBuffers(D3D12AppBase* app)
-{
-  auto sceneParamDesc = CD3DX12_RESOURCE_DESC::Buffer(
-    sizeof(SceneParameter)
-  );
-  m_sceneParameterCB = app->CreateConstantBuffers(sceneParamDesc);
-
-  auto boneParamDesc = CD3DX12_RESOURCE_DESC::Buffer(
-    sizeof(BoneParameter)
-  );
-  m_boneParameterCB = app->CreateConstantBuffers(boneParamDesc);
-}
-
-void Model::PrepareBundles(D3D12AppBase* app)
-{
-  auto imageCount = D3D12AppBase::FrameBufferCount;
-  m_bundleNormalDraw = app->CreateBundleCommandList();
-  ID3D12DescriptorHeap* heaps[] = {
-    app->GetDescriptorManager()->GetHeap().Get(),
-  };
-  m_bundleNormalDraw->SetDescriptorHeaps(1, heaps);
-  m_bundleNormalDraw->SetGraphicsRootSignature(m_rootSignature.Get());
-  m_bundleNormalDraw->SetPipelineState(m_pipelineStates[DRAW_GROUP_NORMAL].Get());
-  m_bundleNormalDraw->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  D3D12_INDEX_BUFFER_VIEW ibView{};
-  ibView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-  ibView.Format = DXGI_FORMAT_R32_UINT;
-  ibView.SizeInBytes = m_indexBufferSize;
-  m_bundleNormalDraw->IASetIndexBuffer(&ibView);
 
-  for (uint32_t i = 0; i < uint32_t(m_materials.size()); ++i)
+  if (m_isBindlessSupported)
   {
-    auto mesh = m_meshes[i];
-    const auto& material = m_materials[i];
-
-    auto materialCB = material.GetConstantBuffer().resource;
-    m_bundleNormalDraw->SetGraphicsRootConstantBufferView(2, materialCB->GetGPUVirtualAddress());
-
-    auto textureDescriptor = m_dummyTexDescriptor;
-    if (material.HasTexture())
-    {
-      textureDescriptor = material.GetTextureDescriptor();
-    }
-    m_bundleNormalDraw->SetGraphicsRootDescriptorTable(3, textureDescriptor);
-    m_bundleNormalDraw->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    auto bindlessPsoDesc = modelPsoDesc;
+    bindlessPsoDesc.PS = CD3DX12_SHADER_BYTECODE(modelBindlessPS.Get());
+    hr = pipelineCache->CreateGraphicsPipelineState(
+      &bindlessPsoDesc, IID_PPV_ARGS(&pso));
+    ThrowIfFailed(hr, "CreateGraphicsPipelineState Failed(normalDrawBindless).");
+    m_pipelineStates[DRAW_GROUP_NORMAL_BINDLESS] = pso;
   }
-  m_bundleNormalDraw->Close();
 
-  // ֊s`pBundle
-  m_bundleOutline = app->CreateBundleCommandList();
-  m_bundleOutline->SetDescriptorHeaps(1, heaps);
-  m_bundleOutline->SetGraphicsRootSignature(m_rootSignature.Get());
-  m_bundleOutline->SetPipelineState(m_pipelineStates[DRAW_GROUP_OUTLINE].Get());
-  m_bundleOutline->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_bundleOutline->IASetIndexBuffer(&ibView);
-  for (uint32_t i = 0; i < uint32_t(m_materials.size()); ++i)
+  // VF[_[̍XVɍ蒼ꂽpCvC֍ւ. }bv̗vf̃AhX͑}ŕςȂ.
+  m_shaderHotReload = app->GetShaderHotReload();
+  // ւVF[_[͕ʂ̕ϐǂނȂ߁Aȍ~̓V[̃p[^̑Ŝ.
+  auto onSwap = [this]() {
+    ++m_pipelineGeneration;
+    m_sceneParameterRange = ConstantBufferRange{ 0, sizeof(SceneParameter) };
+  };
+  for (size_t i = 0; i < _countof(modelVariants); ++i)
   {
-    auto mesh = m_meshes[i];
-    const auto& material = m_materials[i];
-    auto materialCB = material.GetConstantBuffer().resource;
-    if (material.GetEdgeFlag() == 0)
-      continue;
-
-    m_bundleOutline->SetGraphicsRootConstantBufferView(2, materialCB->GetGPUVirtualAddress());
-    m_bundleOutline->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    auto variantPsoDesc = modelPsoDesc;
+    variantPsoDesc.PS = CD3DX12_SHADER_BYTECODE(shaders[modelPSIndex + i].shaderBlob.Get());
+    m_shaderHotReload->Register(this, &m_modelPipelineStates[modelVariants[i]],
+      variantPsoDesc, shaders[0], shaders[modelPSIndex + i], onSwap);
   }
-  m_bundleOutline->Close();
-
-  // VhE`pBundle
-  m_bundleShadow = app->CreateBundleCommandList();
-  m_bundleShadow->SetDescriptorHeaps(1, heaps);
-  m_bundleShadow->SetGraphicsRootSignature(m_rootSignature.Get());
-  m_bundleShadow->SetPipelineState(m_pipelineStates[DRAW_GROUP_SHADOW].Get());
-  m_bundleShadow->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_bundleShadow->IASetIndexBuffer(&ibView);
-  for (uint32_t i = 0; i < uint32_t(m_materials.size()); ++i)
+  m_shaderHotReload->Register(this, &m_pipelineStates[DRAW_GROUP_OUTLINE], outlinePsoDesc, shaders[1], shaders[2], onSwap);
+  m_shaderHotReload->Register(this, &m_pipelineStates[DRAW_GROUP_SHADOW], shadowPsoDesc, shaders[3], shaders[4], onSwap);
+  if (m_isBindlessSupported)
   {
-    auto mesh = m_meshes[i];
-    const auto& material = m_materials[i];
-    auto materialCB = material.GetConstantBuffer().resource;
-    m_bundleShadow->SetGraphicsRootConstantBufferView(2, materialCB->GetGPUVirtualAddress());
-    m_bundleShadow->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    auto bindlessPsoDesc = modelPsoDesc;
+    bindlessPsoDesc.PS = CD3DX12_SHADER_BYTECODE(modelBindlessPS.Get());
+    m_shaderHotReload->Register(this, &m_pipelineStates[DRAW_GROUP_NORMAL_BINDLESS],
+      bindlessPsoDesc, shaders[0], shaders.back(), onSwap);
   }
-  m_bundleShadow->Close();
 }
 
-void Model::PrepareDummyTexture(D3D12AppBase* app)
+void ModelAsset::PrepareDummyTexture(D3D12AppBase* app)
 {
   auto device = app->GetDevice();
   ScratchImage image;
@@ -729,25 +805,12 @@ void Model::PrepareDummyTexture(D3D12AppBase* app)
   auto metadata = image.GetMetadata();
 
   vector<D3D12_SUBRESOURCE_DATA> subresources;
-  ComPtr<ID3D12Resource> texture;
-  CreateTexture(device.Get(), metadata, &texture);
+  auto texture = CreateTextureResource(app, metadata);
 
-  // ]Xe[WOobt@̗p.
   PrepareUpload(device.Get(),
     image.GetImages(), image.GetImageCount(), metadata, subresources);
-  auto totalBytes = GetRequiredIntermediateSize(
-    texture.Get(), 0, UINT(subresources.size()));
-  auto staging = app->CreateResource(
-    CD3DX12_RESOURCE_DESC::Buffer(totalBytes),
-    D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-    D3D12_HEAP_TYPE_UPLOAD );
-
-  // Staging => Texture ].
-  auto command = app->CreateCommandList();
-  UpdateSubresources(command.Get(),
-    texture.Get(), staging.Get(),
-    0, 0, UINT(subresources.size()), subresources.data());
-  app->FinishCommandList(command);
+  app->GetUploadManager()->UploadTexture(
+    texture.Get(), 0, subresources.data(), UINT(subresources.size()));
 
   // eNX`̃fBXNv^.
   D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
@@ -758,22 +821,750 @@ void Model::PrepareDummyTexture(D3D12AppBase* app)
   m_dummyTexDescriptor = app->GetDescriptorManager()->Alloc();
   device->CreateShaderResourceView(
     texture.Get(), &srvDesc, m_dummyTexDescriptor);
+  texture.As(&m_textureDummy);
 }
 
-void Model::ComputeMorph()
+void ModelAsset::PrepareBindlessTextureTable(D3D12AppBase* app)
 {
-  auto vertexCount = m_faceBaseInfo.verticesPos.size();
+  if (!m_isBindlessSupported)
+  {
+    return;
+  }
+  // }eAԍ̂܂܃e[üʒuƂĎg.
+  auto device = app->GetDevice();
+  auto descriptorManager = app->GetDescriptorManager();
+  const auto materialCount = UINT(m_materials.size());
+  m_bindlessTextureTable = descriptorManager->AllocRange(materialCount);
+  auto baseIndex = descriptorManager->GetIndex(m_bindlessTextureTable);
+  for (UINT i = 0; i < materialCount; ++i)
+  {
+    const auto& material = m_materials[i];
+    ID3D12Resource* texture = material.HasTexture() ?
+      material.GetTexture().resource.Get() : m_textureDummy.Get();
+    auto desc = texture->GetDesc();
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+    srvDesc.Format = desc.Format;
+    srvDesc.Texture2D.MipLevels = desc.MipLevels;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    device->CreateShaderResourceView(
+      texture, &srvDesc, descriptorManager->GetHandle(baseIndex + i));
+  }
+}
+
+void ModelAsset::PartitionBonePalettes(
+  uint32_t boneCount,
+  const std::vector<uint32_t>& srcIndices,
+  const std::vector<uint32_t>& materialIndexCounts,
+  std::vector<uint32_t>& dstIndices)
+{
+  auto srcVertices = m_vertices;
+  m_vertices.clear();
+  m_vertices.reserve(srcVertices.size());
+  m_vertexCopies.assign(srcVertices.size(), std::vector<uint32_t>());
+  m_meshes.clear();
+  dstIndices.clear();
+  dstIndices.reserve(srcIndices.size());
+
+  // EFCg 0 ̃{[͎QƂȂ̂ƂĈ.
+  auto isBoneUsed = [](const PMDVertex& v, int slot) {
+    return (slot == 0 ? v.boneWeights.x : v.boneWeights.y) > 0.0f;
+  };
+  auto getBoneIndex = [](const PMDVertex& v, int slot) {
+    return slot == 0 ? v.boneIndices.x : v.boneIndices.y;
+  };
+
+  // ݂̃TubVɂ郍[J{[ԍ (-1 ͖o^).
+  std::vector<int> localIndex(boneCount, -1);
+  uint32_t paletteOffset = 0;
+  for (uint32_t materialIndex = 0, srcOffset = 0; materialIndex < uint32_t(materialIndexCounts.size()); ++materialIndex)
+  {
+    const auto indexCount = materialIndexCounts[materialIndex];
+    Mesh mesh{ uint32_t(dstIndices.size()), 0, materialIndex, 0 };
+
+    // pbgpobt@̈ʒum肳ÃTubVJn.
+    auto closeMesh = [&]() {
+      mesh.indexCount = uint32_t(dstIndices.size()) - mesh.indexOffset;
+      for (auto boneIndex : mesh.palette)
+      {
+        localIndex[boneIndex] = -1;
+      }
+      if (mesh.indexCount > 0)
+      {
+        mesh.paletteOffset = paletteOffset;
+        paletteOffset += book_util::RoundupConstantBufferSize(
+          UINT(sizeof(XMFLOAT4X4) * mesh.palette.size()));
+        m_meshes.emplace_back(mesh);
+      }
+      mesh = Mesh{ uint32_t(dstIndices.size()), 0, materialIndex, 0 };
+    };
+    // Op`ǉ邽߂ɐVɕKvƂȂ{[W߂.
+    auto collectBones = [&](uint32_t first, uint32_t* bones) {
+      uint32_t count = 0;
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        const auto& v = srcVertices[srcIndices[first + k]];
+        for (int slot = 0; slot < 2; ++slot)
+        {
+          auto boneIndex = getBoneIndex(v, slot);
+          if (!isBoneUsed(v, slot) || localIndex[boneIndex] >= 0)
+            continue;
+          if (std::find(bones, bones + count, boneIndex) == bones + count)
+          {
+            bones[count++] = boneIndex;
+          }
+        }
+      }
+      return count;
+    };
+
+    for (uint32_t tri = 0; tri < indexCount; tri += 3)
+    {
+      const auto first = srcOffset + tri;
+      uint32_t requiredBones[6];
+      auto requiredCount = collectBones(first, requiredBones);
+      if (mesh.palette.size() + requiredCount > BonePaletteSize)
+      {
+        closeMesh();
+        requiredCount = collectBones(first, requiredBones);
+      }
+      for (uint32_t i = 0; i < requiredCount; ++i)
+      {
+        localIndex[requiredBones[i]] = int(mesh.palette.size());
+        mesh.palette.push_back(requiredBones[i]);
+      }
+
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        auto srcIndex = srcIndices[first + k];
+        auto v = srcVertices[srcIndex];
+        uint32_t local0 = isBoneUsed(v, 0) ? localIndex[v.boneIndices.x] : localIndex[v.boneIndices.y];
+        uint32_t local1 = isBoneUsed(v, 1) ? localIndex[v.boneIndices.y] : local0;
+        v.boneIndices = XMUINT2(local0, local1);
+
+        // [Jԍɂ΋L.
+        auto& copies = m_vertexCopies[srcIndex];
+        auto itr = std::find_if(copies.begin(), copies.end(),
+          [&](uint32_t idx) {
+            const auto& indices = m_vertices[idx].boneIndices;
+            return indices.x == local0 && indices.y == local1;
+          });
+        if (itr != copies.end())
+        {
+          dstIndices.push_back(*itr);
+        }
+        else
+        {
+          auto dstIndex = uint32_t(m_vertices.size());
+          m_vertices.push_back(v);
+          copies.push_back(dstIndex);
+          dstIndices.push_back(dstIndex);
+        }
+      }
+    }
+    closeMesh();
+    srcOffset += indexCount;
+  }
+  m_bonePaletteBytes = paletteOffset;
+}
+
+ModelInstance::ModelInstance()
+  : m_vertexBufferMode(VERTEX_BUFFER_UPLOAD_HEAP), m_vertexBytesCopied(0), m_sceneParameterAddress(0),
+  m_bundles(), m_bundlesBindless(), m_drawRootParameterChanges(0), m_shadowRootParameterChanges(0), m_isBindless(false), m_pipelineGeneration(0), m_isMorphDirty(true)
+{
+}
+
+void ModelInstance::Prepare(D3D12AppBase* app, const char* filename)
+{
+  Prepare(app, ModelAsset::Load(app, filename));
+}
+
+void ModelInstance::Prepare(D3D12AppBase* app, std::shared_ptr<ModelAsset> asset)
+{
+  m_asset = asset;
+  m_hostMemVertices = m_asset->GetVertices();
+
+  // _obt@쐬.
+  const auto vbSize = UINT(m_hostMemVertices.size() * sizeof(PMDVertex));
+  if (m_vertexBufferMode == VERTEX_BUFFER_DYNAMIC)
+  {
+    // f[^SďłAŏ̓]őŜRs[.
+    m_dynamicVertexBuffer.Prepare(app, vbSize, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    m_dynamicVertexBuffer.Write(0, 0, m_hostMemVertices.data(), vbSize);
+  }
+  else
+  {
+    m_vertexBuffers.resize(D3D12AppBase::FrameBufferCount);
+    auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(vbSize);
+    for (UINT i = 0; i < D3D12AppBase::FrameBufferCount; ++i)
+    {
+      m_vertexBuffers[i] = app->CreateResource(
+        vbDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        D3D12_HEAP_TYPE_UPLOAD
+      );
+    }
+    m_mappedVertexBuffers = MapUploadBuffers(m_vertexBuffers);
+  }
+
+  // {[\z.
+  const auto& boneInfos = m_asset->GetBones();
+  m_bones.reserve(boneInfos.size());
+  for (const auto& info : boneInfos)
+  {
+    auto bone = new Bone(info.name);
+    bone->SetTranslation(info.translation);
+    bone->SetInitialTranslation(info.translation);
+
+    // oChtsO[oʒu苁߂.
+    auto bonePos = info.position;
+    auto m = XMMatrixTranslationFromVector(XMLoadFloat3(&bonePos));
+    bone->SetInvBindMatrix(XMMatrixInverse(nullptr, m));
+
+    m_bones.push_back(bone);
+  }
+  for (uint32_t i = 0; i < uint32_t(boneInfos.size()); ++i)
+  {
+    uint32_t index = boneInfos[i].parent;
+    if (index != 0xFFFFu)
+    {
+      m_bones[i]->SetParent(m_bones[index]);
+    }
+  }
+  UpdateMatrices();
+
+  m_faceMorphWeights.resize(m_asset->GetFaces().size());
+  m_isMorphDirty = true;
+
+  // IK{[\z.
+  const auto& ikInfos = m_asset->GetIKs();
+  m_boneIkList.resize(ikInfos.size());
+  for (uint32_t i = 0; i < uint32_t(ikInfos.size()); ++i)
+  {
+    const auto& ik = ikInfos[i];
+    auto& boneIk = m_boneIkList[i];
+    boneIk = PMDBoneIK(m_bones[ik.target], m_bones[ik.effector]);
+    boneIk.SetAngleLimit(ik.angleLimit);
+    boneIk.SetIterationCount(ik.iteration);
+
+    std::vector<Bone*> ikChains;
+    ikChains.reserve(ik.chains.size());
+    for (auto& id : ik.chains)
+    {
+      ikChains.push_back(m_bones[id]);
+    }
+    boneIk.SetIkChains(ikChains);
+  }
+
+  m_bonePaletteData.resize(m_asset->GetBonePaletteBytes());
+  PrepareConstantBuffers(app);
+  PrepareBundles(app);
+  m_pipelineGeneration = m_asset->GetPipelineGeneration();
+}
+
+void ModelInstance::Cleanup(D3D12AppBase* app)
+{
+  for (auto& b : m_bones)
+  {
+    delete b;
+  }
+  m_bones.clear();
+  ReleaseBundles(app);
+  m_asset.reset();
+}
+
+void ModelInstance::UpdateMatrices()
+{
+  for (auto& b : m_bones)
+  {
+    if (b->GetParent())
+      continue;
+
+    b->UpdateMatrices();
+  }
+}
+
+void ModelInstance::Update(uint32_t imageIndex, D3D12AppBase* app)
+{
+  m_sceneParameterAddress = app->GetUploadRing()->Push(m_sceneParameter, m_asset->GetSceneParameterRange());
+
+  // oh̓pCvCL^Ă邽߁Azbg[hōւL^.
+  // Âoh͕`撆̃t[gIĂ.
+  if (m_pipelineGeneration != m_asset->GetPipelineGeneration())
+  {
+    ReleaseBundles(app);
+    PrepareBundles(app);
+    m_pipelineGeneration = m_asset->GetPipelineGeneration();
+  }
+
+  // {[s߁ATubṼpbg֋l߂ď.
+  std::vector<XMFLOAT4X4> boneMatrices(m_bones.size());
+  for (uint32_t i = 0; i < uint32_t(m_bones.size()); ++i)
+  {
+    auto bone = m_bones[i];
+    auto m = bone->GetInvBindMatrix() * bone->GetWorldMatrix();
+    XMStoreFloat4x4(&boneMatrices[i], XMMatrixTranspose(m));
+  }
+  for (const auto& mesh : m_asset->GetMeshes())
+  {
+    auto dst = reinterpret_cast<XMFLOAT4X4*>(&m_bonePaletteData[mesh.paletteOffset]);
+    for (uint32_t i = 0; i < uint32_t(mesh.palette.size()); ++i)
+    {
+      dst[i] = boneMatrices[mesh.palette[i]];
+    }
+  }
+  memcpy(m_mappedBoneParameter[imageIndex], m_bonePaletteData.data(), m_bonePaletteData.size());
+
+  // [tvZƒ_obt@̍XV.
+  if (m_vertexBufferMode == VERTEX_BUFFER_DYNAMIC)
+  {
+    // d݂ςƂ̂݁A[tΏۂ͈̔͂.
+    const auto morphBegin = m_asset->GetMorphVertexBegin();
+    const auto morphEnd = m_asset->GetMorphVertexEnd();
+    if (m_isMorphDirty && morphBegin < morphEnd)
+    {
+      ComputeMorph();
+      auto offset = uint32_t(sizeof(PMDVertex) * morphBegin);
+      auto size = uint32_t(sizeof(PMDVertex) * (morphEnd - morphBegin));
+      m_dynamicVertexBuffer.Write(
+        imageIndex, offset, &m_hostMemVertices[morphBegin], size);
+    }
+    m_isMorphDirty = false;
+    return;
+  }
+
+  ComputeMorph();
+  memcpy(m_mappedVertexBuffers[imageIndex], m_hostMemVertices.data(), sizeof(PMDVertex) * m_hostMemVertices.size());
+}
+
+void ModelInstance::UploadDynamicBuffers(GraphicsCommandList commandList)
+{
+  // }eA̕ύX͋LAZbg1x].
+  m_asset->UploadMaterials(commandList);
+
+  m_vertexBytesCopied = 0;
+  if (m_vertexBufferMode != VERTEX_BUFFER_DYNAMIC)
+  {
+    return;
+  }
+  m_dynamicVertexBuffer.UploadDirtyRange(commandList);
+  m_vertexBytesCopied = m_dynamicVertexBuffer.GetCopiedBytes();
+}
+
+D3D12_VERTEX_BUFFER_VIEW ModelInstance::GetVertexBufferView(uint32_t imageIndex) const
+{
+  D3D12_VERTEX_BUFFER_VIEW vbView{};
+  if (m_vertexBufferMode == VERTEX_BUFFER_DYNAMIC)
+  {
+    vbView.BufferLocation = m_dynamicVertexBuffer.GetGPUVirtualAddress();
+  }
+  else
+  {
+    vbView.BufferLocation = m_vertexBuffers[imageIndex]->GetGPUVirtualAddress();
+  }
+  vbView.StrideInBytes = UINT(sizeof(PMDVertex));
+  vbView.SizeInBytes = UINT(vbView.StrideInBytes * m_hostMemVertices.size());
+  return vbView;
+}
+
+void ModelInstance::Draw(D3D12AppBase* app, ComPtr<ID3D12GraphicsCommandList> commandList)
+{
+  uint32_t index = app->GetSwapchain()->GetCurrentBackBufferIndex();
+  commandList->SetGraphicsRootSignature(m_asset->GetRootSignature().Get());
+  commandList->SetGraphicsRootConstantBufferView(0, m_sceneParameterAddress);
+  commandList->SetGraphicsRootDescriptorTable(4, m_shadowMap);
+  m_drawRootParameterChanges = 2;
+
+  // ݂̒_obt@Zbg.
+  auto vbView = GetVertexBufferView(index);
+  commandList->IASetVertexBuffers(0, 1, &vbView);
+
+  // ʏ`s.
+  // {[pbg̓TubVɃohŐݒ肳.
+  const auto& bundles = m_isBindless ? m_bundlesBindless : m_bundles;
+  commandList->ExecuteBundle(bundles.normalDraw[index].Get());
+
+  // ֊s`s.
+  commandList->ExecuteBundle(bundles.outline[index].Get());
+}
+
+void ModelInstance::DrawShadow(D3D12AppBase* app, ComPtr<ID3D12GraphicsCommandList> commandList)
+{
+  uint32_t index = app->GetSwapchain()->GetCurrentBackBufferIndex();
+  commandList->SetGraphicsRootSignature(m_asset->GetRootSignature().Get());
+  commandList->SetGraphicsRootConstantBufferView(0, m_sceneParameterAddress);
+  m_shadowRootParameterChanges = 1;
+
+  // ݂̒_obt@Zbg.
+  auto vbView = GetVertexBufferView(index);
+  commandList->IASetVertexBuffers(0, 1, &vbView);
+
+  // VhE}bv̂߂̕`s.
+  const auto& bundles = m_isBindless ? m_bundlesBindless : m_bundles;
+  commandList->ExecuteBundle(bundles.shadow[index].Get());
+}
+
+void ModelInstance::EnqueueDraws(D3D12AppBase* app, DrawQueue& queue, float nearZ, float farZ) const
+{
+  // [x̓CX^XɁA[g̃{[ (Z^[) ݂̌̈ʒu狁߂.
+  // ʏ`Ɨ֊s̓J̃r[Ԃ̐[x (En̂ -z), VhE̓Cg̎ˉe z ŕׂ.
+  auto position = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+  for (const auto& bone : m_bones)
+  {
+    if (bone->GetParent() == nullptr)
+    {
+      position = bone->GetWorldMatrix().r[3];
+      break;
+    }
+  }
+  auto mtxView = XMMatrixTranspose(XMLoadFloat4x4(&m_sceneParameter.view));
+  auto mtxLightViewProj = XMMatrixTranspose(XMLoadFloat4x4(&m_sceneParameter.lightViewProj));
+  auto depthBucket = DrawKey::MakeDepthBucket(-XMVectorGetZ(XMVector3TransformCoord(position, mtxView)), nearZ, farZ);
+  auto shadowDepthBucket = DrawKey::MakeDepthBucket(XMVectorGetZ(XMVector3TransformCoord(position, mtxLightViewProj)), 0.0f, 1.0f);
+
+  uint32_t index = app->GetSwapchain()->GetCurrentBackBufferIndex();
+  auto paletteAddress = m_boneParameterCB[index]->GetGPUVirtualAddress();
+  const auto& meshes = m_asset->GetMeshes();
+  const auto& materials = m_asset->GetMaterials();
+
+  DrawQueue::Packet base{};
+  base.rootSignature = m_asset->GetRootSignature().Get();
+  base.topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+  base.vertexBuffer = GetVertexBufferView(index);
+  base.indexBuffer = m_asset->GetIndexBufferView();
+  base.instanceCount = 1;
+  base.AddRootCBV(0, m_sceneParameterAddress);
+
+  auto shadowPipeline = m_asset->GetPipelineState(DRAW_GROUP_SHADOW).Get();
+  auto outlinePipeline = m_asset->GetPipelineState(DRAW_GROUP_OUTLINE).Get();
+  auto bindlessPipeline = m_isBindless ? m_asset->GetPipelineState(DRAW_GROUP_NORMAL_BINDLESS).Get() : nullptr;
+  auto shadowPipelineId = queue.GetPipelineId(shadowPipeline);
+  auto outlinePipelineId = queue.GetPipelineId(outlinePipeline);
+
+  for (uint32_t i = 0; i < uint32_t(meshes.size()); ++i)
+  {
+    const auto& mesh = meshes[i];
+    const auto& material = materials[mesh.materialIndex];
+    auto packet = base;
+    packet.vertexOrIndexCount = mesh.indexCount;
+    packet.startVertexOrIndex = mesh.indexOffset;
+    packet.AddRootCBV(1, paletteAddress + mesh.paletteOffset);
+
+    // VhEƗ֊s̃VF[_[̓}eAQƂȂߏȂ.
+    // }eA 0 ƂāACX^X̃L[𑵂. \[g͈Ȃ̂ 1 CX^X̃pPbg
+    // A܂܎cA_obt@̐؂ւ̓CX^X1ōς.
+    auto shadow = packet;
+    shadow.pipelineState = shadowPipeline;
+    queue.Add(DrawKey::Make(DRAW_PASS_SHADOW, 0, shadowPipelineId, 0, shadowDepthBucket), shadow);
+    if (material.GetEdgeFlag() != 0)
+    {
+      auto outline = packet;
+      outline.pipelineState = outlinePipeline;
+      queue.Add(DrawKey::Make(DRAW_PASS_OUTLINE, 0, outlinePipelineId, 0, depthBucket), outline);
+    }
+
+    // sȃTubV͏ 0 ƂāApCvCƃ}eAł܂Ƃ߂.
+    // ͍̂̂̌ʂɈˑ邽߁AšɃTubV̏ŕ`.
+    uint32_t order = material.IsTranslucent() ? i + 1 : 0;
+    auto& normal = packet;
+    normal.AddRootTable(4, m_shadowMap);
+    if (m_isBindless)
+    {
+      normal.pipelineState = bindlessPipeline;
+      normal.AddRootConstant(5, mesh.materialIndex);
+      normal.AddRootSRV(6, m_asset->GetMaterialTableAddress());
+      normal.AddRootTable(7, m_asset->GetBindlessTextureTable());
+    }
+    else
+    {
+      auto textureDescriptor = m_asset->GetDummyTextureDescriptor();
+      if (material.HasTexture())
+      {
+        textureDescriptor = material.GetTextureDescriptor();
+      }
+      normal.pipelineState = m_asset->GetModelPipelineState(m_asset->GetMaterialFeatures(material)).Get();
+      normal.AddRootCBV(2, material.GetConstantBufferAddress());
+      normal.AddRootTable(3, textureDescriptor);
+    }
+    queue.Add(DrawKey::Make(DRAW_PASS_NORMAL, order, queue.GetPipelineId(normal.pipelineState), mesh.materialIndex, depthBucket), normal);
+  }
+}
+
+UINT ModelInstance::GetRootParameterChanges() const
+{
+  // oh̐ݒƁA߂ Draw, DrawShadow ohOŐݒ肵.
+  const auto& bundles = m_isBindless ? m_bundlesBindless : m_bundles;
+  return bundles.rootParameterChanges + m_drawRootParameterChanges + m_shadowRootParameterChanges;
+}
+
+int ModelInstance::GetFaceMorphIndex(const std::string& faceName) const
+{
+  int ret = -1;
+  const auto& faces = m_asset->GetFaces();
+  for (uint32_t i = 0; i < faces.size(); ++i)
+  {
+    const auto& face = faces[i];
+    if (face.name == faceName)
+    {
+      ret = i;
+      break;
+    }
+  }
+  return ret;
+}
+
+void ModelInstance::SetFaceMorphWeight(int index, float weight)
+{
+  if (index < 0)
+  {
+    return;
+  }
+  if (m_faceMorphWeights[index] != weight)
+  {
+    m_faceMorphWeights[index] = weight;
+    m_isMorphDirty = true;
+  }
+}
+
+void ModelInstance::PrepareConstantBuffers(D3D12AppBase* app)
+{
+  // STubṼpbg1̃obt@ɔzu.
+  auto boneParamDesc = CD3DX12_RESOURCE_DESC::Buffer(
+    m_bonePaletteData.size()
+  );
+  m_boneParameterCB = app->CreateConstantBuffers(boneParamDesc);
+  m_mappedBoneParameter = MapUploadBuffers(m_boneParameterCB);
+}
+
+void ModelInstance::ReleaseBundles(D3D12AppBase* app)
+{
+  for (auto* bundles : { &m_bundles, &m_bundlesBindless })
+  {
+    for (auto* list : { &bundles->normalDraw, &bundles->outline, &bundles->shadow })
+    {
+      for (auto& bundle : *list)
+      {
+        app->DeferRelease(bundle);
+      }
+      list->clear();
+    }
+  }
+  // AP[^ohƓA`撆̃t[IĂ烊Zbg.
+  app->RetireBundleAllocator(m_bundleAllocator);
+  m_bundleAllocator.Reset();
+}
+
+void ModelInstance::PrepareBundles(D3D12AppBase* app)
+{
+  // L^xɃAP[^ւ邽߁A蒼JԂĂ͑Ȃ.
+  m_bundleAllocator = app->AcquireBundleAllocator();
+  auto allocator = m_bundleAllocator.Get();
+  auto imageCount = D3D12AppBase::FrameBufferCount;
+  ID3D12DescriptorHeap* heaps[] = {
+    app->GetDescriptorManager()->GetHeap().Get(),
+  };
+  auto ibView = m_asset->GetIndexBufferView();
+  auto rootSignature = m_asset->GetRootSignature();
+  const auto& meshes = m_asset->GetMeshes();
+  const auto& materials = m_asset->GetMaterials();
+
+  m_bundles.normalDraw.resize(imageCount);
+  m_bundles.outline.resize(imageCount);
+  m_bundles.shadow.resize(imageCount);
+  m_bundles.rootParameterChanges = 0;
+  for (UINT i = 0; i < imageCount; ++i)
+  {
+    auto paletteAddress = m_boneParameterCB[i]->GetGPUVirtualAddress();
+    UINT rootParameterChanges = 0;
+
+    auto& bundleNormalDraw = m_bundles.normalDraw[i];
+    bundleNormalDraw = app->CreateBundleCommandList(allocator);
+    bundleNormalDraw->SetDescriptorHeaps(1, heaps);
+    bundleNormalDraw->SetGraphicsRootSignature(rootSignature.Get());
+    bundleNormalDraw->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleNormalDraw->IASetIndexBuffer(&ibView);
+
+    // `揇͔̍ɉe邽ߕבւAώ킪ς鏊ł̂݃pCvC؂ւ.
+    ShaderFeatureMask currentFeatures = ~ShaderFeatureMask(0); // ݒ.
+    for (const auto& mesh : meshes)
+    {
+      const auto& material = materials[mesh.materialIndex];
+      auto features = m_asset->GetMaterialFeatures(material);
+      if (features != currentFeatures)
+      {
+        bundleNormalDraw->SetPipelineState(m_asset->GetModelPipelineState(features).Get());
+        currentFeatures = features;
+      }
+
+      auto materialCB = material.GetConstantBufferAddress();
+      bundleNormalDraw->SetGraphicsRootConstantBufferView(1, paletteAddress + mesh.paletteOffset);
+      bundleNormalDraw->SetGraphicsRootConstantBufferView(2, materialCB);
+
+      auto textureDescriptor = m_asset->GetDummyTextureDescriptor();
+      if (material.HasTexture())
+      {
+        textureDescriptor = material.GetTextureDescriptor();
+      }
+      bundleNormalDraw->SetGraphicsRootDescriptorTable(3, textureDescriptor);
+      bundleNormalDraw->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+      rootParameterChanges += 3;
+    }
+    bundleNormalDraw->Close();
+
+    // ֊s`pBundle
+    auto& bundleOutline = m_bundles.outline[i];
+    bundleOutline = app->CreateBundleCommandList(allocator);
+    bundleOutline->SetDescriptorHeaps(1, heaps);
+    bundleOutline->SetGraphicsRootSignature(rootSignature.Get());
+    bundleOutline->SetPipelineState(m_asset->GetPipelineState(DRAW_GROUP_OUTLINE).Get());
+    bundleOutline->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleOutline->IASetIndexBuffer(&ibView);
+    // ֊sƃVhE̓}eA̒萔obt@ǂ܂Ȃߐݒ肵Ȃ.
+    for (const auto& mesh : meshes)
+    {
+      if (materials[mesh.materialIndex].GetEdgeFlag() == 0)
+        continue;
+
+      bundleOutline->SetGraphicsRootConstantBufferView(1, paletteAddress + mesh.paletteOffset);
+      bundleOutline->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+      rootParameterChanges += 1;
+    }
+    bundleOutline->Close();
+
+    // VhE`pBundle
+    auto& bundleShadow = m_bundles.shadow[i];
+    bundleShadow = app->CreateBundleCommandList(allocator);
+    bundleShadow->SetDescriptorHeaps(1, heaps);
+    bundleShadow->SetGraphicsRootSignature(rootSignature.Get());
+    bundleShadow->SetPipelineState(m_asset->GetPipelineState(DRAW_GROUP_SHADOW).Get());
+    bundleShadow->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleShadow->IASetIndexBuffer(&ibView);
+    for (const auto& mesh : meshes)
+    {
+      bundleShadow->SetGraphicsRootConstantBufferView(1, paletteAddress + mesh.paletteOffset);
+      bundleShadow->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+      rootParameterChanges += 1;
+    }
+    bundleShadow->Close();
+    m_bundles.rootParameterChanges = rootParameterChanges;
+  }
+
+  if (m_asset->IsBindlessSupported())
+  {
+    PrepareBindlessBundles(app, allocator);
+  }
+}
+
+void ModelInstance::PrepareBindlessBundles(D3D12AppBase* app, ID3D12CommandAllocator* allocator)
+{
+  auto imageCount = D3D12AppBase::FrameBufferCount;
+  ID3D12DescriptorHeap* heaps[] = {
+    app->GetDescriptorManager()->GetHeap().Get(),
+  };
+  auto ibView = m_asset->GetIndexBufferView();
+  auto rootSignature = m_asset->GetRootSignature();
+  const auto& meshes = m_asset->GetMeshes();
+  const auto& materials = m_asset->GetMaterials();
+
+  // pbgO̕`ƓłΐݒȂ.
+  auto setPalette = [&](Bundle& bundle, D3D12_GPU_VIRTUAL_ADDRESS address, D3D12_GPU_VIRTUAL_ADDRESS& current, UINT& count) {
+    if (address != current)
+    {
+      bundle->SetGraphicsRootConstantBufferView(1, address);
+      current = address;
+      ++count;
+    }
+  };
+
+  m_bundlesBindless.normalDraw.resize(imageCount);
+  m_bundlesBindless.outline.resize(imageCount);
+  m_bundlesBindless.shadow.resize(imageCount);
+  m_bundlesBindless.rootParameterChanges = 0;
+  for (UINT i = 0; i < imageCount; ++i)
+  {
+    auto paletteAddress = m_boneParameterCB[i]->GetGPUVirtualAddress();
+    UINT rootParameterChanges = 0;
+
+    // }eAe[uƃeNX`e[u͐擪1xݒ肵A
+    // `悲Ƃɂ̓}eAԍ݂̂ύX.
+    auto& bundleNormalDraw = m_bundlesBindless.normalDraw[i];
+    bundleNormalDraw = app->CreateBundleCommandList(allocator);
+    bundleNormalDraw->SetDescriptorHeaps(1, heaps);
+    bundleNormalDraw->SetGraphicsRootSignature(rootSignature.Get());
+    bundleNormalDraw->SetPipelineState(m_asset->GetPipelineState(DRAW_GROUP_NORMAL_BINDLESS).Get());
+    bundleNormalDraw->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleNormalDraw->IASetIndexBuffer(&ibView);
+    bundleNormalDraw->SetGraphicsRootShaderResourceView(6, m_asset->GetMaterialTableAddress());
+    bundleNormalDraw->SetGraphicsRootDescriptorTable(7, m_asset->GetBindlessTextureTable());
+    rootParameterChanges += 2;
+    D3D12_GPU_VIRTUAL_ADDRESS currentPalette = 0;
+    for (const auto& mesh : meshes)
+    {
+      setPalette(bundleNormalDraw, paletteAddress + mesh.paletteOffset, currentPalette, rootParameterChanges);
+      bundleNormalDraw->SetGraphicsRoot32BitConstant(5, mesh.materialIndex, 0);
+      bundleNormalDraw->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+      rootParameterChanges += 1;
+    }
+    bundleNormalDraw->Close();
+
+    // ֊sƃVhẼVF[_[̓}eAQƂȂ߁Apbĝݐݒ肷.
+    auto& bundleOutline = m_bundlesBindless.outline[i];
+    bundleOutline = app->CreateBundleCommandList(allocator);
+    bundleOutline->SetDescriptorHeaps(1, heaps);
+    bundleOutline->SetGraphicsRootSignature(rootSignature.Get());
+    bundleOutline->SetPipelineState(m_asset->GetPipelineState(DRAW_GROUP_OUTLINE).Get());
+    bundleOutline->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleOutline->IASetIndexBuffer(&ibView);
+    currentPalette = 0;
+    for (const auto& mesh : meshes)
+    {
+      if (materials[mesh.materialIndex].GetEdgeFlag() == 0)
+        continue;
+      setPalette(bundleOutline, paletteAddress + mesh.paletteOffset, currentPalette, rootParameterChanges);
+      bundleOutline->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    }
+    bundleOutline->Close();
+
+    auto& bundleShadow = m_bundlesBindless.shadow[i];
+    bundleShadow = app->CreateBundleCommandList(allocator);
+    bundleShadow->SetDescriptorHeaps(1, heaps);
+    bundleShadow->SetGraphicsRootSignature(rootSignature.Get());
+    bundleShadow->SetPipelineState(m_asset->GetPipelineState(DRAW_GROUP_SHADOW).Get());
+    bundleShadow->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bundleShadow->IASetIndexBuffer(&ibView);
+    currentPalette = 0;
+    for (const auto& mesh : meshes)
+    {
+      setPalette(bundleShadow, paletteAddress + mesh.paletteOffset, currentPalette, rootParameterChanges);
+      bundleShadow->DrawIndexedInstanced(mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    }
+    bundleShadow->Close();
+    m_bundlesBindless.rootParameterChanges = rootParameterChanges;
+  }
+}
+
+void ModelInstance::ComputeMorph()
+{
+  const auto& faceBase = m_asset->GetFaceBase();
+  const auto& faces = m_asset->GetFaces();
+  const auto& vertexCopies = m_asset->GetVertexCopies();
+  auto vertexCount = faceBase.verticesPos.size();
   // ʒũZbg.
+  // _̓{[pbgŕĂ邽߁ASĂ֔̕f.
   for (uint32_t i = 0; i < vertexCount; ++i)
   {
-    auto offsetIndex = m_faceBaseInfo.indices[i];
-    m_hostMemVertices[offsetIndex].position = m_faceBaseInfo.verticesPos[i];
+    auto offsetIndex = faceBase.indices[i];
+    for (auto copy : vertexCopies[offsetIndex])
+    {
+      m_hostMemVertices[copy].position = faceBase.verticesPos[i];
+    }
   }
 
   // EFCgɉĒ_ύX.
-  for (uint32_t faceIndex = 0; faceIndex < m_faceOffsetInfo.size(); ++faceIndex)
+  for (uint32_t faceIndex = 0; faceIndex < faces.size(); ++faceIndex)
   {
-    const auto& face = m_faceOffsetInfo[faceIndex];
+    const auto& face = faces[faceIndex];
     float w = m_faceMorphWeights[faceIndex];
 
     for (uint32_t i = 0; i < face.indices.size(); ++i)
@@ -781,9 +1572,33 @@ void Model::ComputeMorph()
       auto baseVertexIndex = face.indices[i];
       auto displacement = face.verticesOffset[i];
 
-      auto offsetIndex = m_faceBaseInfo.indices[baseVertexIndex];
+      auto offsetIndex = faceBase.indices[baseVertexIndex];
       XMFLOAT3 offset = displacement * w;
-      m_hostMemVertices[offsetIndex].position += offset;
+      for (auto copy : vertexCopies[offsetIndex])
+      {
+        m_hostMemVertices[copy].position += offset;
+      }
     }
   }
 }
+
+
+UINT64 ModelInstance::GetGpuMemoryBytes(D3D12AppBase* app) const
+{
+  UINT64 total = 0;
+  for (const auto& vb : m_vertexBuffers)
+  {
+    total += GetAllocationBytes(app, vb.Get());
+  }
+  if (m_vertexBufferMode == VERTEX_BUFFER_DYNAMIC)
+  {
+    // DEFAULT q[vƃt[̃Xe[WO.
+    total += GetAllocationBytes(app, m_dynamicVertexBuffer.GetResource().Get());
+    total += UINT64(m_dynamicVertexBuffer.GetSize()) * D3D12AppBase::FrameBufferCount;
+  }
+  for (const auto& cb : m_boneParameterCB)
+  {
+    total += GetAllocationBytes(app, cb.Get());
+  }
+  return total;
+}
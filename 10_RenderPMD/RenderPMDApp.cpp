@@ -9,11 +9,19 @@
 
 #include <DirectXTex.h>
 #include <fstream>
+#include <chrono>
+#include <algorithm>
 
 using namespace DirectX;
 
 RenderPMDApp::RenderPMDApp()  
 {
+  m_drawCount = 1;
+  m_isParallelRecord = true;
+  m_isSortedDraw = false;
+  m_isInstanceBenchmarkRequested = false;
+  m_shadowDrawStats = DrawQueue::Stats{};
+  m_mainDrawStats = DrawQueue::Stats{};
   m_camera.SetLookAt(
     XMFLOAT3(-7.0f, 14.0f, 13.0f),
     XMFLOAT3(-2.0f, 15.0f, 0.0f)
@@ -24,16 +32,22 @@ void RenderPMDApp::Prepare()
 {
   SetTitle("Render PMD file");
 
-  m_commandList->Reset(m_commandAllocators[0].Get(), nullptr);
-  ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(1, heaps);
-  m_commandList->Close();
-  PrepareShadowTargets();
+  PrepareFrameGraph();
 
   // ft@C[h.
   const char* filePath = "~N.pmd";  // eŗpӂĂB
+  using clock = std::chrono::high_resolution_clock;
+  auto memoryBefore = GetMemoryAllocator()->GetStats().total;
+  auto startTime = clock::now();
+  m_model.SetVertexBufferMode(ModelInstance::VERTEX_BUFFER_DYNAMIC);
   m_model.Prepare(this, filePath);
-  m_model.SetShadowMap(m_shadowColor.shaderAccess);
+  m_model.SetBindless(true);
+  auto endTime = clock::now();
+  auto memoryAfter = GetMemoryAllocator()->GetStats().total;
+  m_instanceCosts.push_back(InstanceCost{
+    1, std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+    memoryAfter.used - memoryBefore.used, memoryAfter.reserved - memoryBefore.reserved });
+  m_model.SetShadowMap(m_frameGraphExecutor.GetSRV(m_shadowColorId));
   PrepareImGui();
 
   m_faceWeights.resize(m_model.GetFaceMorphCount());
@@ -41,6 +55,8 @@ void RenderPMDApp::Prepare()
 
 void RenderPMDApp::Cleanup()
 {
+  m_frameGraphExecutor.Cleanup();
+  m_model.Cleanup(this);
   imgui_helper::CleanupImGui();
 }
 
@@ -69,68 +85,55 @@ void RenderPMDApp::OnMouseMove(UINT msg, int dx, int dy)
 }
 
 // VhE}bv`̂߂̃\[X̏.
-void RenderPMDApp::PrepareShadowTargets()
+void RenderPMDApp::PrepareFrameGraph()
 {
-  auto colorTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_R32G32B32A32_FLOAT, ShadowSize, ShadowSize,
-    1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
-  auto depthTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_D32_FLOAT, ShadowSize, ShadowSize,
-    1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-  D3D12_CLEAR_VALUE clearColor{}, clearDepth{};
-  clearColor.Format = colorTexDesc.Format;
-  clearColor.Color[0] = 1.0f; clearColor.Color[1] = 1.0f;
-  clearColor.Color[2] = 1.0f; clearColor.Color[3] = 1.0f;
-  clearDepth.Format = depthTexDesc.Format;
-  clearDepth.DepthStencil.Depth = 1.0f;
-
-  auto stateRenderTarget = D3D12_RESOURCE_STATE_RENDER_TARGET;
-  m_shadowColor.resource = CreateResource(colorTexDesc, stateRenderTarget, &clearColor, D3D12_HEAP_TYPE_DEFAULT);
-  m_shadowColor.resource->SetName(L"ShadowMap(Color)");
-
-  auto stateDepthStencil = D3D12_RESOURCE_STATE_DEPTH_WRITE;
-  m_shadowDepth.resource = CreateResource(depthTexDesc, stateDepthStencil, &clearDepth, D3D12_HEAP_TYPE_DEFAULT);
-  m_shadowDepth.resource->SetName(L"ShadowMap(Depth)");
-
-  // fBXNv^̊蓖ĂƏ(RTV).
-  m_shadowColor.outputBuffer = m_heapRTV->Alloc();
-  D3D12_RENDER_TARGET_VIEW_DESC rtvDesc{};
-  rtvDesc.Format = colorTexDesc.Format;
-  rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
-  m_device->CreateRenderTargetView(
-    m_shadowColor.resource.Get(), &rtvDesc, 
-    m_shadowColor.outputBuffer
-  );
-
-  // fBXNv^̊蓖ĂƏ(DSV).
-  m_shadowDepth.outputBuffer = m_heapDSV->Alloc();
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
-  dsvDesc.Format = depthTexDesc.Format;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  m_device->CreateDepthStencilView(
-    m_shadowDepth.resource.Get(), &dsvDesc,
-    m_shadowDepth.outputBuffer);
-
-  // e^[Qbg̃VF[_[ǂݎpfBXNv^̏.
-  m_shadowColor.shaderAccess = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-  srvDesc.Format = rtvDesc.Format;
-  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  srvDesc.Texture2D.MipLevels = 1;
-  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(
-    m_shadowColor.resource.Get(),
-    &srvDesc,
-    m_shadowColor.shaderAccess
-  );
-  // fvXꉞ.
-  m_shadowDepth.shaderAccess = m_heap->Alloc();
-  srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-  m_device->CreateShaderResourceView(
-    m_shadowDepth.resource.Get(),
-    &srvDesc,
-    m_shadowDepth.shaderAccess
-  );
+  // VhE}bv͈ꎞeNX`ƂAoAƃ̔zu̓Ot̃RpCʂɔC.
+  FrameGraph::TextureDesc shadowColorDesc{
+    ShadowSize, ShadowSize, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, { 1.0f, 1.0f, 1.0f, 1.0f }
+  };
+  FrameGraph::TextureDesc shadowDepthDesc{
+    ShadowSize, ShadowSize, DXGI_FORMAT_D32_FLOAT, 1, { 1.0f }
+  };
+  m_backBufferId = m_frameGraph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  m_depthBufferId = m_frameGraph.ImportTexture("DepthBuffer", FrameGraph::USAGE_DEPTH_WRITE, FrameGraph::USAGE_DEPTH_WRITE);
+  m_shadowColorId = m_frameGraph.CreateTexture("ShadowMap(Color)", shadowColorDesc);
+  m_shadowDepthId = m_frameGraph.CreateTexture("ShadowMap(Depth)", shadowDepthDesc);
+
+  auto shadowPass = m_frameGraph.AddPass("Shadow", [this](FrameGraphContext& context) {
+    auto& commandList = context.GetCommandList();
+    ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+    // VhEpXOɒ_̕ύX͈͂]Ă.
+    m_model.UploadDynamicBuffers(commandList);
+    RenderToTexture(context);
+  });
+  m_frameGraph.Write(shadowPass, m_shadowColorId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(shadowPass, m_shadowDepthId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  auto mainPass = m_frameGraph.AddPass("Main", [this](FrameGraphContext& context) {
+    auto& commandList = context.GetCommandList();
+    ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+    RenderToMain(context);
+  });
+  m_frameGraph.Read(mainPass, m_shadowColorId, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  m_frameGraph.Write(mainPass, m_backBufferId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(mainPass, m_depthBufferId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  auto uiPass = m_frameGraph.AddPass("ImGui", [this](FrameGraphContext& context) {
+    auto& commandList = context.GetCommandList();
+    // ʂ̃Xĝ߁A`͉߂ăZbg.
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv = context.GetRTV(m_backBufferId);
+    commandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+    ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+    RenderImGui(commandList);
+  });
+  m_frameGraph.Write(uiPass, m_backBufferId, FrameGraph::USAGE_RENDER_TARGET);
+
+  // VhE}bv SRV ̓fQƂ邽߁AOt͋N1xRpC.
+  m_frameGraphExecutor.Prepare(this, m_heapRTV, m_heapDSV, m_heap);
+  m_frameGraphExecutor.Compile(m_frameGraph);
 }
 
 void RenderPMDApp::PrepareImGui()
@@ -157,17 +160,18 @@ void RenderPMDApp::Render()
   }
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(), nullptr
-  );
-
-  // Xbv`FC\\烌_[^[Qbg`\
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
-
-  ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  // ǂݍݎ̓]obt@ȂǁAGPU gÎ.
+  CollectDeferredReleases();
+  // v̓t[̋L^n߂Oɍs.
+  if (m_isInstanceBenchmarkRequested)
+  {
+    m_isInstanceBenchmarkRequested = false;
+    MeasureInstanceCost(10);
+    MeasureInstanceCost(100);
+  }
+  // ăRpC̏IVF[_[̃pCvCōւ.
+  m_shaderHotReload->Update();
+  m_uploadRing->BeginFrame(GetCompletedFrameFenceValue());
 
   m_scenePatameters.lightDirection = XMFLOAT4(0.0f, 20.0f,20.0f, 0.0f);
   auto mtxProj = XMMatrixPerspectiveFovRH(XMConvertToRadians(45.0f), float(m_width) / float(m_height), 0.1f, 100.0f);
@@ -200,39 +204,27 @@ void RenderPMDApp::Render()
   }
   auto imageIndex = m_swapchain->GetCurrentBackBufferIndex();
   m_model.Update(imageIndex, this);
-
-
-  RenderToTexture();
-
-  // `AeNX`ƂĎg߂̃oAݒ.
-  auto barrierToSRV = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_shadowColor.resource.Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-  );
-  m_commandList->ResourceBarrier(1, &barrierToSRV);
-
-  // ȍ~obNobt@֕`.
-  RenderToMain();
-
-  RenderImGui();
-
-  // _[^[QbgXbv`FC\\
+  if (m_isSortedDraw)
   {
-    auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-    auto barrierToRT = CD3DX12_RESOURCE_BARRIER::Transition(
-      m_shadowColor.resource.Get(),
-      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET
-    );
-    CD3DX12_RESOURCE_BARRIER barriers[] = {
-      barrierToPresent,
-      barrierToRT
-    };
-
-    m_commandList->ResourceBarrier(_countof(barriers), barriers);
+    // `񐔕̃pPbgςŕׂĂAVhEƃC̊epX͎͈̔͂L^.
+    // [x̃oPbg͎ˉesƓ͈͂ŁACX^Xɋ߂.
+    m_drawQueue.Reset();
+    for (int i = 0; i < m_drawCount; ++i)
+    {
+      m_model.EnqueueDraws(this, m_drawQueue, 0.1f, 100.0f);
+    }
+    m_drawQueue.Sort();
   }
-  m_commandList->Close();
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  ImGui::Render();
+
+  // 荞񂾃eNX`̎̂ݒ肵ĂAVhEACAImGui ̊epXʁX̃R}hXg֋L^A
+  // ̏1œ. pXԂ̃oA̓OtepX̐擪ɂ܂Ƃ߂ċL^.
+  m_frameGraphExecutor.SetImportedTexture(
+    m_backBufferId, m_swapchain->GetImage(m_frameIndex).Get(), m_swapchain->GetCurrentRTV());
+  m_frameGraphExecutor.SetImportedTexture(
+    m_depthBufferId, m_depthBuffer.Get(), D3D12_CPU_DESCRIPTOR_HANDLE(), m_defaultDepthDSV);
+  auto commandLists = m_commandContextPool->Record(m_frameGraphExecutor.GetRecordFuncs(), m_isParallelRecord);
+  m_uploadRing->EndFrame(m_commandContextPool->Submit(commandLists));
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -240,20 +232,21 @@ void RenderPMDApp::Render()
 
 
 
-void RenderPMDApp::RenderToTexture()
+void RenderPMDApp::RenderToTexture(FrameGraphContext& context)
 {
-  auto rtv = m_shadowColor.outputBuffer;
-  auto dsv = m_shadowDepth.outputBuffer;
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_shadowColorId);
+  auto dsv = context.GetDSV(m_shadowDepthId);
 
   // VhE}bṽJ[obt@EfvXobt@̃NA.
   const float clearColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-  m_commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // eNX``ɃZbg.
   D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = dsv;
-  m_commandList->OMSetRenderTargets(
+  commandList->OMSetRenderTargets(
     _countof(colorDescriptors), colorDescriptors, FALSE, &depthDescirptor);
 
   // r[|[gƃVU[̃Zbg.
@@ -261,37 +254,54 @@ void RenderPMDApp::RenderToTexture()
   auto height = ShadowSize;
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(width), float(height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(width), LONG(height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
-  m_model.DrawShadow(this, m_commandList);
+  if (m_isSortedDraw)
+  {
+    m_shadowDrawStats = m_drawQueue.Submit(commandList.Get(), ModelInstance::DRAW_PASS_SHADOW, ModelInstance::DRAW_PASS_SHADOW);
+    return;
+  }
+  for (int i = 0; i < m_drawCount; ++i)
+  {
+    m_model.DrawShadow(this, commandList);
+  }
 }
 
-void RenderPMDApp::RenderToMain()
+void RenderPMDApp::RenderToMain(FrameGraphContext& context)
 {
-  auto rtv = m_swapchain->GetCurrentRTV();
-  auto dsv = m_defaultDepthDSV;
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_backBufferId);
+  auto dsv = context.GetDSV(m_depthBufferId);
 
   // J[obt@(_[^[Qbgr[)̃NA
   float m_clearColor[4] = { 0.5f,0.75f,1.0f,0 };
-  m_commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   // r[|[gƃVU[̃Zbg
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
-  m_model.Draw(this, m_commandList);
+  if (m_isSortedDraw)
+  {
+    m_mainDrawStats = m_drawQueue.Submit(commandList.Get(), ModelInstance::DRAW_PASS_NORMAL, ModelInstance::DRAW_PASS_OUTLINE);
+    return;
+  }
+  for (int i = 0; i < m_drawCount; ++i)
+  {
+    m_model.Draw(this, commandList);
+  }
 }
 
 void RenderPMDApp::UpdateImGui()
@@ -307,6 +317,87 @@ void RenderPMDApp::UpdateImGui()
   XMStoreFloat3(&cameraPos, m_camera.GetPosition());
   ImGui::Text("CameraPos (%.2f, %.2f, %.2f)", cameraPos.x, cameraPos.y, cameraPos.z);
   ImGui::ColorEdit3("Outline", (float*)&m_scenePatameters.outlineColor);
+  ImGui::Text("VB Copy %llu bytes/frame", m_model.GetVertexBytesCopied());
+  auto palette = m_model.GetBonePaletteStats();
+  auto legacyPalette = m_model.GetLegacyBonePaletteStats();
+  ImGui::Text("SubMesh %u", m_model.GetSubMeshCount());
+  ImGui::Text("Palette Upload %llu (%llu) bytes/frame", palette.uploadedBytes, legacyPalette.uploadedBytes);
+  ImGui::Text("Palette Bound %llu (%llu) bytes/frame", palette.boundBytes, legacyPalette.boundBytes);
+  auto materialTable = m_model.GetAsset()->GetMaterialTableStats();
+  ImGui::Text("Material CB %llu KB (%llu KB)", materialTable.packedBytes / 1024, materialTable.legacyBytes / 1024);
+  bool isBindless = m_model.IsBindless();
+  if (m_model.GetAsset()->IsBindlessSupported() && ImGui::Checkbox("Bindless", &isBindless))
+  {
+    m_model.SetBindless(isBindless);
+  }
+  ImGui::Text("Root Param %u/frame", m_model.GetRootParameterChanges());
+  {
+    const auto memStats = GetMemoryAllocator()->GetStats();
+    const auto& heaps = memStats.total;
+    ImGui::Text("Heap %.1f/%.1f MB (%u blocks, frag %.2f)",
+      heaps.used / (1024.0 * 1024.0), heaps.reserved / (1024.0 * 1024.0), heaps.blockCount, heaps.fragmentation);
+    ImGui::Text("Placed %llu, Committed %llu, SmallCB %u",
+      memStats.placedCount, memStats.committedCount, memStats.smallBuffers.allocationCount);
+    const auto uploadStats = GetUploadManager()->GetStats();
+    ImGui::Text("Upload %llu in %llu batches, %.1f MB (peak %.1f MB), wait %.2f ms",
+      uploadStats.uploadCount, uploadStats.batchCount, uploadStats.uploadedBytes / (1024.0 * 1024.0),
+      uploadStats.stagingPeak / (1024.0 * 1024.0), uploadStats.cpuWaitMs);
+    const auto fenceStats = GetQueueFence()->GetStats();
+    ImGui::Text("GPU Wait %.2f ms (%llu waits, %llu timeouts)",
+      fenceStats.blockedMs, fenceStats.blockingWaitCount, fenceStats.timeoutCount);
+  }
+  {
+    ImGui::SliderInt("Draw Count", &m_drawCount, 1, MaxDrawCount);
+    ImGui::Checkbox("Parallel Record", &m_isParallelRecord);
+    ImGui::Checkbox("Sorted Draw", &m_isSortedDraw);
+    if (m_isSortedDraw)
+    {
+      const auto& shadowPass = m_shadowDrawStats;
+      const auto& mainPass = m_mainDrawStats;
+      ImGui::Text("Packets %u, sort %.3f ms, draws %u",
+        m_drawQueue.GetPacketCount(), m_drawQueue.GetSortMs(), shadowPass.drawCount + mainPass.drawCount);
+      ImGui::Text("PSO %u, Root Param %u/frame (bundle %u)",
+        shadowPass.pipelineChanges + mainPass.pipelineChanges,
+        shadowPass.rootParameterChanges + mainPass.rootParameterChanges,
+        m_model.GetRootParameterChanges() * UINT(m_drawCount));
+    }
+    const auto& timing = m_commandContextPool->GetLastRecordTiming();
+    if (timing.passMs.size() == 3)
+    {
+      ImGui::Text("Record shadow %.2f, main %.2f, ui %.2f ms (wall %.2f ms)",
+        timing.passMs[0], timing.passMs[1], timing.passMs[2], timing.wallMs);
+    }
+    const auto poolStats = m_commandContextPool->GetStats();
+    ImGui::Text("Allocators %u (free %u, pending %u), Lists %u",
+      poolStats.allocatorCount, poolStats.freeAllocatorCount, poolStats.pendingAllocatorCount, poolStats.commandListCount);
+    const auto& graphStats = m_frameGraphExecutor.GetStats();
+    ImGui::Text("Graph %u passes (culled %u), barriers %u in %u batches",
+      graphStats.declaredPassCount - graphStats.culledPassCount, graphStats.culledPassCount,
+      graphStats.transitionCount + graphStats.aliasingCount + graphStats.uavCount, graphStats.barrierBatchCount);
+    ImGui::Text("Transient %.1f MB (%.1f MB without aliasing)",
+      graphStats.aliasedBytes / (1024.0 * 1024.0), graphStats.transientBytes / (1024.0 * 1024.0));
+    const auto cacheStats = m_pipelineCache->GetStats();
+    ImGui::Text("Startup %.1f ms, PSO %.1f ms (%s: %u library, %u compiled, %u shared)",
+      GetStartupMs(), cacheStats.pipelineMs, cacheStats.isWarm ? "warm" : "cold",
+      cacheStats.libraryHitCount, cacheStats.compiledCount, cacheStats.memoryHitCount);
+    const auto shaderStats = GetShaderCache().GetStats();
+    ImGui::Text("Shader %.1f ms (%u archive, %u disk, %u compiled %.1f ms, %u shared)",
+      shaderStats.loadMs + shaderStats.compileMs, shaderStats.archiveHitCount, shaderStats.diskHitCount,
+      shaderStats.compiledCount, shaderStats.compileMs, shaderStats.memoryHitCount);
+    const auto reloadStats = m_shaderHotReload->GetStats();
+    ImGui::Text("Reload %u (%u failed, %u swapped, last %.1f ms)",
+      reloadStats.reloadCount, reloadStats.failedCount, reloadStats.swappedCount, reloadStats.lastRebuildMs);
+  }
+  if (ImGui::Button("Measure 10/100 Models"))
+  {
+    m_isInstanceBenchmarkRequested = true;
+  }
+  for (const auto& cost : m_instanceCosts)
+  {
+    ImGui::Text("%3d Models: %.1f ms (%.2f ms/model), used %.2f MB, heap +%.2f MB",
+      cost.count, cost.prepareMs, cost.prepareMs / cost.count,
+      cost.usedBytes / (1024.0 * 1024.0), cost.reservedBytes / (1024.0 * 1024.0));
+  }
   
   for (uint32_t i = 0; i < m_faceWeights.size(); ++i)
   {
@@ -318,9 +409,49 @@ void RenderPMDApp::UpdateImGui()
   ImGui::End();
 }
 
-void RenderPMDApp::RenderImGui()
+void RenderPMDApp::MeasureInstanceCost(int count)
 {
-  ImGui::Render();
-  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_commandList.Get());
+  // ǑvŔjCX^X̃߂Ă瑪.
+  WaitForIdleGPU();
+  CollectDeferredReleases();
+
+  using clock = std::chrono::high_resolution_clock;
+  auto memoryBefore = GetMemoryAllocator()->GetStats().total;
+  auto startTime = clock::now();
+  // 2̖ڈȍ~̓LbVꂽAZbgL邽߁ACX^X̃RXĝ݂ƂȂ.
+  std::vector<std::unique_ptr<ModelInstance>> instances;
+  for (int i = 0; i < count; ++i)
+  {
+    auto instance = std::make_unique<ModelInstance>();
+    instance->SetVertexBufferMode(ModelInstance::VERTEX_BUFFER_DYNAMIC);
+    instance->Prepare(this, m_model.GetAsset());
+    instances.push_back(std::move(instance));
+  }
+  auto endTime = clock::now();
+  auto memoryAfter = GetMemoryAllocator()->GetStats().total;
+
+  InstanceCost cost{
+    count, std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+    memoryAfter.used - memoryBefore.used, memoryAfter.reserved - memoryBefore.reserved };
+  auto itr = std::find_if(m_instanceCosts.begin(), m_instanceCosts.end(),
+    [count](const InstanceCost& v) { return v.count == count; });
+  if (itr != m_instanceCosts.end())
+  {
+    *itr = cost;
+  }
+  else
+  {
+    m_instanceCosts.push_back(cost);
+  }
+
+  for (auto& instance : instances)
+  {
+    instance->Cleanup(this);
+  }
+}
+
+void RenderPMDApp::RenderImGui(GraphicsCommandList commandList)
+{
+  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "FrameGraphExecutor.h"
 #include "DirectXMath.h"
 #include "Camera.h"
 
@@ -18,12 +19,13 @@ public:
   virtual void OnMouseButtonUp(UINT msg);
   virtual void OnMouseMove(UINT msg, int dx, int dy);
 private:
-  void PrepareShadowTargets();
+  void PrepareFrameGraph();
   void PrepareImGui();
   void UpdateImGui();
-  void RenderToTexture();
-  void RenderToMain();
-  void RenderImGui();
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+  void RenderToTexture(FrameGraphContext& context);
+  void RenderToMain(FrameGraphContext& context);
+  void RenderImGui(GraphicsCommandList commandList);
 
   using Buffer = ComPtr<ID3D12Resource1>;
   using Texture = ComPtr<ID3D12Resource1>;
@@ -32,18 +34,38 @@ private:
   enum
   {
     ShadowSize = 1024,
+    MaxDrawCount = 512,
   };
   Camera m_camera;
 
-  Model m_model;
-  Model::SceneParameter m_scenePatameters;
-  std::vector<float> m_faceWeights;
-
-  struct RenderTarget
+  ModelInstance m_model;
+  ModelInstance::SceneParameter m_scenePatameters;
+  // fɉԂƃʂ̌vl.
+  struct InstanceCost
   {
-    ComPtr<ID3D12Resource1> resource;
-    DescriptorHandle  outputBuffer;
-    DescriptorHandle  shaderAccess;
+    int count;
+    double prepareMs;      // count ̂ Prepare ɂ. 1݂̂̂̍s̓AZbg̓ǂݍ݂܂.
+    UINT64 usedBytes;      // AP[^őgp.
+    UINT64 reservedBytes;  // AP[^VɊmۂq[v.
   };
-  RenderTarget m_shadowColor, m_shadowDepth;
+  // AZbgLCX^X count ̎ۂɍAvɔj.
+  void MeasureInstanceCost(int count);
+  std::vector<InstanceCost> m_instanceCosts;
+  bool m_isInstanceBenchmarkRequested;
+  // R}h̋L^ׂv邽߁Afw񐔕`悷.
+  int m_drawCount;
+  bool m_isParallelRecord;
+  // oh̑ɁA\[gL[ŕׂ`pPbgŋL^.
+  bool m_isSortedDraw;
+  DrawQueue m_drawQueue;
+  // VhEƃC͕ʂ̃XbhŋL^邽߁AʂpXɎ.
+  DrawQueue::Stats m_shadowDrawStats;
+  DrawQueue::Stats m_mainDrawStats;
+  std::vector<float> m_faceWeights;
+
+  // VhEACAImGui ̊epXƃVhE}bv̓t[OtŊǗ.
+  FrameGraph m_frameGraph;
+  FrameGraphExecutor m_frameGraphExecutor;
+  FrameGraph::ResourceId m_backBufferId, m_depthBufferId;
+  FrameGraph::ResourceId m_shadowColorId, m_shadowDepthId;
 };
\ No newline at end of file
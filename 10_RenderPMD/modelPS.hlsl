@@ -1,3 +1,5 @@
+// @feature USE_TEXTURE
+
 struct VSOutput
 {
   float4 Position : SV_POSITION;
@@ -26,7 +28,7 @@ cbuffer MaterialParameter : register(b2)
   float4 diffuse;
   float4 ambient;
   float4 specular;
-  uint useTexture;
+  uint useTexture;  // modelPS ł USE_TEXTURE ̕ώňߎQƂȂ.
 }
 
 Texture2D diffuseTexture : register(t0);
@@ -42,10 +44,9 @@ float4 main(VSOutput In) : SV_TARGET
   float3 lightdir = normalize(lightDirection.xyz);
 
   float4 color = diffuse;
-  if (useTexture != 0)
-  {
-    color *= diffuseTexture.Sample(diffuseSampler, In.UV);
-  }
+#if USE_TEXTURE
+  color *= diffuseTexture.Sample(diffuseSampler, In.UV);
+#endif
   float3 baseColor = color.rgb;
 
   //float lmb = (0.5 * dot(lightdir, normal) + 0.5); // half lambert
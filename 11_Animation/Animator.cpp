@@ -266,7 +266,7 @@ void Animator::UpdateMorthAnimation(uint32_t animeFrame)
   }
 }
 
-void Animator::Attach(Model* model)
+void Animator::Attach(ModelInstance* model)
 {
   m_model = model;
 }
@@ -6,7 +6,7 @@
 
 #include <DirectXMath.h>
 
-class Model;
+class ModelInstance;
 class PMDBoneIK;
 
 template<class T>
@@ -87,7 +87,7 @@ public:
 
   void UpdateAnimation(uint32_t animeFrame);
 
-  void Attach(Model* model);
+  void Attach(ModelInstance* model);
 private:
   void UpdateNodeAnimation(uint32_t animeFrame);
   void UpdateMorthAnimation(uint32_t animeFrame);
@@ -100,7 +100,7 @@ private:
   using MorphAnimationMap = std::unordered_map<std::string, MorphAnimation>;
   NodeAnimationMap m_nodeMap;
   MorphAnimationMap m_morphMap;
-  Model* m_model;
+  ModelInstance* m_model;
 
   uint32_t m_framePeriod;
 };
\ No newline at end of file
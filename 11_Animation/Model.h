@@ -1,9 +1,12 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "DynamicBuffer.h"
+#include "DrawQueue.h"
 #include <wrl.h>
 #include <DirectXMath.h>
 
 #include <unordered_map>
+#include <memory>
 
 class Material
 {
@@ -15,12 +18,24 @@ public:
     UINT useTexture;
     UINT edgeFlag;
   };
-  Material(const MaterialParameters& params) : m_parameters(params) { }
+  // VF[_[ MaterialParameter (b2) Ƃ̑Ή.
+  static std::vector<ConstantBufferField> GetParameterFields()
+  {
+    return {
+      CONSTANT_BUFFER_FIELD(MaterialParameters, diffuse, diffuse),
+      CONSTANT_BUFFER_FIELD(MaterialParameters, ambient, ambient),
+      CONSTANT_BUFFER_FIELD(MaterialParameters, specular, specular),
+      CONSTANT_BUFFER_FIELD(MaterialParameters, useTexture, useTexture),
+    };
+  }
+  Material(const MaterialParameters& params) : m_parameters(params), m_constantBufferAddress(0) { }
 
   DirectX::XMFLOAT4 GetDiffuse() const  { return m_parameters.diffuse; }
   DirectX::XMFLOAT4 GetAmbient() const  { return m_parameters.ambient; }
   DirectX::XMFLOAT4 GetSpecular() const { return m_parameters.specular; }
   bool GetEdgeFlag() const { return m_parameters.edgeFlag != 0; }
+  // gUF̃At@ 1 ̂̂𔼓ƂāA`ۂ.
+  bool IsTranslucent() const { return m_parameters.diffuse.w < 1.0f; }
 
   struct Resource
   {
@@ -28,18 +43,20 @@ public:
     DescriptorHandle descriptor;
   };
   void SetTexture(Resource& resource) { m_texture = resource; }
-  void SetConstantBuffer(Resource& resource) { m_materialConstantBuffer = resource; }
+  // p[^̓}eAe[uɔzuÃAhXQƂ.
+  void SetConstantBufferAddress(D3D12_GPU_VIRTUAL_ADDRESS address) { m_constantBufferAddress = address; }
+  void SetParameters(const MaterialParameters& params) { m_parameters = params; }
 
-  Resource GetConstantBuffer() const { return m_materialConstantBuffer; }
+  D3D12_GPU_VIRTUAL_ADDRESS GetConstantBufferAddress() const { return m_constantBufferAddress; }
+  const MaterialParameters& GetParameters() const { return m_parameters; }
+  Resource GetTexture() const { return m_texture; }
   DescriptorHandle GetTextureDescriptor() const { return m_texture.descriptor; }
 
   bool HasTexture() const;
-
-  void Update(D3D12AppBase* app);
 private:
   MaterialParameters m_parameters;
   Resource m_texture;
-  Resource m_materialConstantBuffer;
+  D3D12_GPU_VIRTUAL_ADDRESS m_constantBufferAddress;
 };
 
 class Bone
@@ -127,12 +144,12 @@ private:
   int   m_iteration;
 };
 
-class Model
+// PMD t@C\zACX^XԂŋLsς̃f[^.
+// CfbNXobt@, _, }eA(eNX`), PSO ێ.
+class ModelAsset
 {
   template<class T>
   using ComPtr = Microsoft::WRL::ComPtr<T>;
-  using Bundle = ComPtr<ID3D12GraphicsCommandList>;
-  using BundleList = std::vector<Bundle>;
   using XMFLOAT2 = DirectX::XMFLOAT2;
   using XMFLOAT3 = DirectX::XMFLOAT3;
   using XMFLOAT4 = DirectX::XMFLOAT4;
@@ -143,10 +160,13 @@ class Model
   using RootSignature = ComPtr<ID3D12RootSignature>;
   using Buffer = ComPtr<ID3D12Resource1>;
   using Texture = ComPtr<ID3D12Resource1>;
-  using GraphicsCommandList = ComPtr<ID3D12GraphicsCommandList>;
 public:
-  void Prepare(D3D12AppBase* app, const char* filename);
-  void Cleanup(D3D12AppBase* app);
+  ModelAsset();
+  ~ModelAsset();
+
+  // t@CpXL[ɃLbVꂽAZbgԂ.
+  // [h܂͑SĂ̎QƂς݂̏ꍇ͓ǂݍݒ.
+  static std::shared_ptr<ModelAsset> Load(D3D12AppBase* app, const std::string& filename);
 
   struct PMDVertex
   {
@@ -167,89 +187,319 @@ public:
     XMFLOAT4X4 lightViewProj;
     XMFLOAT4X4 lightViewProjBias;
   };
+  enum
+  {
+    BonePaletteSize = 64, // VF[_[ boneMatrices ̗vfƈv邱.
+  };
+  // TubVPʂœ]{[pbg.
   struct BoneParameter
   {
-    XMFLOAT4X4 bone[512];
+    XMFLOAT4X4 bone[BonePaletteSize];
+  };
+  // VF[_[ SceneParameter (b0), BoneParameter (b1) Ƃ̑Ή. P̃eXgł\[XƏƍ.
+  static std::vector<ConstantBufferField> GetSceneParameterFields()
+  {
+    return {
+      CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+      CONSTANT_BUFFER_FIELD(SceneParameter, proj, proj),
+      CONSTANT_BUFFER_FIELD(SceneParameter, lightDirection, lightDirection),
+      CONSTANT_BUFFER_FIELD(SceneParameter, eyePosition, cameraPos),
+      CONSTANT_BUFFER_FIELD(SceneParameter, outlineColor, outlineColor),
+      CONSTANT_BUFFER_FIELD(SceneParameter, lightViewProj, lightViewProj),
+      CONSTANT_BUFFER_FIELD(SceneParameter, lightViewProjBias, lightViewProjBias),
+    };
+  }
+  static std::vector<ConstantBufferField> GetBoneParameterFields()
+  {
+    return { CONSTANT_BUFFER_FIELD(BoneParameter, bone, boneMatrices) };
+  }
+  // {[pbg1t[̓]ʂƎQƗ.
+  struct BonePaletteStats
+  {
+    UINT64 uploadedBytes;
+    UINT64 boundBytes;
+  };
+  // }eA萔obt@ GPU .
+  struct MaterialTableStats
+  {
+    UINT64 packedBytes;   // }eAe[u(Xe[WO܂).
+    UINT64 legacyBytes;   // }eAɒ萔obt@쐬ꍇ.
+  };
+
+  // Qƃ{[ BonePaletteSize ȉɂȂ悤`P.
+  struct Mesh
+  {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    uint32_t paletteOffset;          // pbgpobt@̈ʒu.
+    std::vector<uint32_t> palette;   // [Jԍ烂f̃{[ԍւ̑Ή.
+  };
+  // {[̏.
+  struct BoneInfo
+  {
+    std::string name;
+    uint32_t parent;        // eꍇ 0xFFFF.
+    XMFLOAT3 translation;   // ȇΈʒu.
+    XMFLOAT3 position;      // O[oʒu.
+  };
+  struct IKInfo
+  {
+    uint32_t target;
+    uint32_t effector;
+    float angleLimit;
+    int iteration;
+    std::vector<uint32_t> chains;
   };
+  // \[tx[X_.
+  struct PMDFaceBaseInfo
+  {
+    std::vector<uint32_t> indices;
+    std::vector<XMFLOAT3> verticesPos;
+  };
+  // \[tItZbg_.
+  struct PMDFaceInfo
+  {
+    std::string name;
+    std::vector<uint32_t> indices;
+    std::vector<XMFLOAT3> verticesOffset;
+  };
+
+  const std::vector<PMDVertex>& GetVertices() const { return m_vertices; }
+  const std::vector<Material>& GetMaterials() const { return m_materials; }
+  const std::vector<Mesh>& GetMeshes() const { return m_meshes; }
+  const std::vector<BoneInfo>& GetBones() const { return m_bones; }
+  const std::vector<IKInfo>& GetIKs() const { return m_iks; }
+  const std::vector<std::vector<uint32_t>>& GetVertexCopies() const { return m_vertexCopies; }
+  const PMDFaceBaseInfo& GetFaceBase() const { return m_faceBaseInfo; }
+  const std::vector<PMDFaceInfo>& GetFaces() const { return m_faceOffsetInfo; }
+  uint32_t GetMorphVertexBegin() const { return m_morphVertexBegin; }
+  uint32_t GetMorphVertexEnd() const { return m_morphVertexEnd; }
+  uint32_t GetBonePaletteBytes() const { return m_bonePaletteBytes; }
+
+  ComPtr<ID3D12RootSignature> GetRootSignature() const { return m_rootSignature; }
+  ComPtr<ID3D12PipelineState> GetPipelineState(const std::string& name) const;
+  // ʏ` modelPS.hlsl ̕ώ했ɃpCvC. features  GetMaterialFeatures ŋ߂.
+  ComPtr<ID3D12PipelineState> GetModelPipelineState(ShaderFeatureMask features) const;
+  ShaderFeatureMask GetMaterialFeatures(const Material& material) const;
+  // VF[_[̃zbg[hŃpCvCւxɑ. oh̋L^Ɏg.
+  UINT GetPipelineGeneration() const { return m_pipelineGeneration; }
+  // SceneParameter ̂ꂩ̃VF[_[ǂޔ͈.
+  ConstantBufferRange GetSceneParameterRange() const { return m_sceneParameterRange; }
+  D3D12_INDEX_BUFFER_VIEW GetIndexBufferView() const;
+  DescriptorHandle GetDummyTextureDescriptor() const { return m_dummyTexDescriptor; }
+
+  // oChX`: S}eÃeNX`1̃e[uɕׁA
+  // `悲Ƃ̃}eAԍ([g萔)ŃeNX`ƃp[^I.
+  // \[XoCfBO Tier2 ȏŗL.
+  bool IsBindlessSupported() const { return m_isBindlessSupported; }
+  DescriptorHandle GetBindlessTextureTable() const { return m_bindlessTextureTable; }
+  D3D12_GPU_VIRTUAL_ADDRESS GetMaterialTableAddress() const { return m_materialTable.GetGPUVirtualAddress(); }
+
+  BonePaletteStats GetBonePaletteStats() const { return m_paletteStats; }
+  BonePaletteStats GetLegacyBonePaletteStats() const { return m_legacyPaletteStats; }
+  MaterialTableStats GetMaterialTableStats() const { return m_materialTableStats; }
+
+  // }eÃp[^ύX. ύX͈͂̂ UploadMaterials œ].
+  void SetMaterialParameters(uint32_t index, uint32_t frameIndex, const Material::MaterialParameters& params);
+  void UploadMaterials(const ComPtr<ID3D12GraphicsCommandList>& commandList);
+
+  // AZbgێ GPU \[X̍vTCY.
+  UINT64 GetGpuMemoryBytes(D3D12AppBase* app) const;
+private:
+  void Prepare(D3D12AppBase* app, const char* filename);
+  void PrepareRootSignature(D3D12AppBase* app);
+  void PreparePipelineStates(D3D12AppBase* app);
+  void PrepareDummyTexture(D3D12AppBase* app);
+  void PrepareMaterialTable(D3D12AppBase* app);
+  void PrepareBindlessTextureTable(D3D12AppBase* app);
+  void PartitionBonePalettes(
+    uint32_t boneCount,
+    const std::vector<uint32_t>& srcIndices,
+    const std::vector<uint32_t>& materialIndexCounts,
+    std::vector<uint32_t>& dstIndices);
+  void ComputeBonePaletteStats();
+
+  static std::unordered_map<std::string, std::weak_ptr<ModelAsset>> s_cache;
+
+  std::vector<PMDVertex> m_vertices;
+  std::vector<Material> m_materials;
+  // S}eÃp[^ 256 oCgEŋl߂Ĕzuobt@.
+  DynamicBuffer m_materialTable;
+  UINT m_materialStride;
+  MaterialTableStats m_materialTableStats;
+  std::vector<Mesh> m_meshes;
+  std::vector<BoneInfo> m_bones;
+  std::vector<IKInfo> m_iks;
+  // ̒_ԍAɂ蕡ꂽ_ԍւ̑Ή.
+  std::vector<std::vector<uint32_t>> m_vertexCopies;
+  uint32_t m_bonePaletteBytes;
+  BonePaletteStats m_paletteStats;
+  BonePaletteStats m_legacyPaletteStats;
+
+  RootSignature m_rootSignature;
+  std::unordered_map<std::string, PipelineState> m_pipelineStates;
+  std::unordered_map<ShaderFeatureMask, PipelineState> m_modelPipelineStates;
+  ShaderFeatureMask m_useTextureFeature;
+  std::shared_ptr<ShaderHotReload> m_shaderHotReload;
+  UINT m_pipelineGeneration;
+  ConstantBufferRange m_sceneParameterRange;
+  // jɃ\[X̓o^O߂Ɏ.
+  std::shared_ptr<ResourceStateTable> m_resourceStates;
+
+  Buffer m_indexBuffer;
+  UINT m_indexBufferSize;
+  Texture m_textureDummy;
+  DescriptorHandle m_dummyTexDescriptor;
+  // }eAԍ̃eNX`(ꍇ̓_~[) SRV.
+  DescriptorHandle m_bindlessTextureTable;
+  bool m_isBindlessSupported;
+
+  PMDFaceBaseInfo m_faceBaseInfo;
+  std::vector<PMDFaceInfo> m_faceOffsetInfo;
+  // \[tŏ钸_͈̔ [begin, end).
+  uint32_t m_morphVertexBegin;
+  uint32_t m_morphVertexEnd;
+};
+
+// ModelAsset QƂĕ`悷X̃f.
+// p, \[t̏d, t[ɏobt@ێ.
+class ModelInstance
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+  using Bundle = ComPtr<ID3D12GraphicsCommandList>;
+  using BundleList = std::vector<Bundle>;
+  using XMFLOAT4X4 = DirectX::XMFLOAT4X4;
+
+  using Buffer = ComPtr<ID3D12Resource1>;
+  using GraphicsCommandList = ComPtr<ID3D12GraphicsCommandList>;
+public:
+  using PMDVertex = ModelAsset::PMDVertex;
+  using SceneParameter = ModelAsset::SceneParameter;
+  using BoneParameter = ModelAsset::BoneParameter;
+  using BonePaletteStats = ModelAsset::BonePaletteStats;
+
+  ModelInstance();
+
+  // _obt@̔zu@.
+  enum VertexBufferMode
+  {
+    VERTEX_BUFFER_UPLOAD_HEAP,  // t[̃Abv[hq[v𒼐ڎQ.
+    VERTEX_BUFFER_DYNAMIC,      // DEFAULT q[v֕ύX͈͂̂ݓ].
+  };
+  // Prepare Oɐݒ肷邱.
+  void SetVertexBufferMode(VertexBufferMode mode) { m_vertexBufferMode = mode; }
+
+  // t@Cw肵ꍇ̓LbVς݂̃AZbgL.
+  void Prepare(D3D12AppBase* app, const char* filename);
+  void Prepare(D3D12AppBase* app, std::shared_ptr<ModelAsset> asset);
+  void Cleanup(D3D12AppBase* app);
 
   void SetSceneParameter(const SceneParameter& params) { m_sceneParameter = params; }
   void SetShadowMap(DescriptorHandle handle) { m_shadowMap = handle; }
 
   void UpdateMatrices();
   void Update(uint32_t imageIndex, D3D12AppBase* app);
+  // }eA̕ύXƁAVERTEX_BUFFER_DYNAMIC ̏ꍇ͒_̓]R}hς.
+  // `OɌĂяo.
+  void UploadDynamicBuffers(GraphicsCommandList commandList);
+  // ߃t[Œ_obt@֓]oCg.
+  UINT64 GetVertexBytesCopied() const { return m_vertexBytesCopied; }
 
   void Draw(D3D12AppBase* app, GraphicsCommandList commandList);
   void DrawShadow(D3D12AppBase* app, GraphicsCommandList commandList);
 
+  // DrawQueue ŕ`ꍇ̃pX. ԍ̏ (VhE}bv, ʏ`, ֊s) ɕ.
+  enum DrawPass
+  {
+    DRAW_PASS_SHADOW,
+    DRAW_PASS_NORMAL,
+    DRAW_PASS_OUTLINE,
+  };
+  // Draw, DrawShadow ̑ɁATubV̕`pPbg queue ֐ς.
+  // [x̃oPbg͂̃CX^X̃r[Ԃ̐[x nearZ  farZ ŋ؂ċ߂. Update ̌ɌĂԂ.
+  void EnqueueDraws(D3D12AppBase* app, DrawQueue& queue, float nearZ, float farZ) const;
+
+  // oChX`̐؂ւ. AZbgΉĂȂꍇ͖.
+  void SetBindless(bool enable) { m_isBindless = enable && m_asset->IsBindlessSupported(); }
+  bool IsBindless() const { return m_isBindless; }
+  // 1t[(Draw  DrawShadow)ł̃[gp[^ݒ.
+  UINT GetRootParameterChanges() const;
+
   // {[
   uint32_t GetBoneCount() const { return uint32_t(m_bones.size()); }
   const Bone* GetBone(int idx) const { return m_bones[idx]; }
   Bone* GetBone(int idx) { return m_bones[idx]; }
 
   // \[t.
-  uint32_t GetFaceMorphCount() const { return uint32_t(m_faceOffsetInfo.size()); }
+  uint32_t GetFaceMorphCount() const { return uint32_t(m_faceMorphWeights.size()); }
   int GetFaceMorphIndex(const std::string& faceName) const;
   void SetFaceMorphWeight(int index, float weight);
 
   // IK
   uint32_t GetBoneIKCount() const { return uint32_t(m_boneIkList.size()); }
   const PMDBoneIK& GetBoneIK(int idx) const { return m_boneIkList[idx]; }
+
+  // {[pbg̏.
+  uint32_t GetSubMeshCount() const { return uint32_t(m_asset->GetMeshes().size()); }
+  BonePaletteStats GetBonePaletteStats() const { return m_asset->GetBonePaletteStats(); }
+  // O(S{[1̒萔obt@ňĂꍇ)̒l.
+  BonePaletteStats GetLegacyBonePaletteStats() const { return m_asset->GetLegacyBonePaletteStats(); }
+
+  std::shared_ptr<ModelAsset> GetAsset() const { return m_asset; }
+  // CX^XŗL GPU \[X̍vTCY(AZbg͊܂܂Ȃ).
+  UINT64 GetGpuMemoryBytes(D3D12AppBase* app) const;
 private:
-  void PrepareRootSignature(D3D12AppBase* app);
-  void PreparePipelineStates(D3D12AppBase* app);
   void PrepareConstantBuffers(D3D12AppBase* app);
   void PrepareBundles(D3D12AppBase* app);
-  void PrepareDummyTexture(D3D12AppBase* app);
+  void PrepareBindlessBundles(D3D12AppBase* app, ID3D12CommandAllocator* allocator);
+  void ReleaseBundles(D3D12AppBase* app);
   void ComputeMorph();
+  D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView(uint32_t imageIndex) const;
 
+  std::shared_ptr<ModelAsset> m_asset;
   SceneParameter m_sceneParameter;
-  BoneParameter m_boneMatrices;
   std::vector<PMDVertex> m_hostMemVertices;
-  std::vector<Material> m_materials;
+  std::vector<Bone*> m_bones;
+  std::vector<uint8_t> m_bonePaletteData;
 
-  struct Mesh
+  // pbg̃AhXt[ɈقȂ邽߁Aoht[ɗpӂ.
+  // pbg̓CX^XɎ߁AohCX^Xŕێ.
+  // ؂ւɍ蒼ɍςނ悤AoChXp킹ċL^Ă.
+  struct BundleSet
   {
-    uint32_t indexOffset;
-    uint32_t indexCount;
+    BundleList normalDraw;
+    BundleList outline;
+    BundleList shadow;
+    UINT rootParameterChanges;  // 1t[(eoh1񂸂)̐ݒ.
   };
-  std::vector<Mesh> m_meshes;
-  std::vector<Bone*> m_bones;
-  
-  RootSignature m_rootSignature;
-  std::unordered_map<std::string, PipelineState> m_pipelineStates;
-  Bundle m_bundleNormalDraw;
-  Bundle m_bundleOutline;
-  Bundle m_bundleShadow;
-  
-  std::vector<BundleList> m_commandsShadow;
+  BundleSet m_bundles;
+  BundleSet m_bundlesBindless;
+  // ̃CX^X̃ohp. L^ۂ͌ÂohƋɕԂ.
+  ComPtr<ID3D12CommandAllocator> m_bundleAllocator;
+  // ߂ Draw, DrawShadow ohOŐݒ肵.
+  UINT m_drawRootParameterChanges;
+  UINT m_shadowRootParameterChanges;
+  bool m_isBindless;
+  // ohɋL^pCvC̐.
+  UINT m_pipelineGeneration;
 
-  Buffer m_indexBuffer;
-  UINT m_indexBufferSize;
   std::vector<Buffer> m_vertexBuffers;
-  std::vector<Buffer> m_sceneParameterCB;
+  VertexBufferMode m_vertexBufferMode;
+  DynamicBuffer m_dynamicVertexBuffer;
+  UINT64 m_vertexBytesCopied;
+  // V[萔͖t[ UploadRing ؂o. Update ŏ݁A`ŎQƂ.
+  D3D12_GPU_VIRTUAL_ADDRESS m_sceneParameterAddress;
+  // {[pbg̓ohɃAhXL^邽߁At[ɌŒ̃obt@g.
   std::vector<Buffer> m_boneParameterCB;
-  Texture m_textureDummy;
+  std::vector<void*> m_mappedBoneParameter;
+  std::vector<void*> m_mappedVertexBuffers;
   
   DescriptorHandle m_shadowMap;
-  DescriptorHandle m_dummyTexDescriptor;
-
 
-  // \[tx[X_.
-  struct PMDFaceBaseInfo
-  {
-    std::vector<uint32_t> indices;
-    std::vector<XMFLOAT3> verticesPos;
-  } m_faceBaseInfo;
-
-  // \[tItZbg_.
-  struct PMDFaceInfo
-  {
-    std::string name;
-    std::vector<uint32_t> indices;
-    std::vector<XMFLOAT3> verticesOffset;
-  };
-  std::vector<PMDFaceInfo> m_faceOffsetInfo;
   std::vector<float> m_faceMorphWeights;
+  bool m_isMorphDirty;
 
   std::vector<PMDBoneIK> m_boneIkList;
 };
@@ -0,0 +1,81 @@
+struct VSOutput
+{
+  float4 Position : SV_POSITION;
+  float2 UV : TEXCOORD0;
+  float3 Normal : TEXCOORD1;
+  float4 WorldPosition  : TEXCOORD2;
+
+  float4 ShadowPos : POSITION_LIGHTSPACE;
+  float4 ShadowPosUV : SHADOWMAP_UV;
+};
+
+cbuffer SceneParameter : register(b0)
+{
+  float4x4 view;
+  float4x4 proj;
+  float4   lightDirection;
+  float4   cameraPos;
+  float4   outlineColor;
+
+  float4x4 lightViewProj;
+  float4x4 lightViewProjBias;
+}
+
+// `悲Ƃɐݒ肳}eAԍ.
+cbuffer DrawParameter : register(b3)
+{
+  uint materialIndex;
+}
+
+// S}eÃp[^. ModelAsset ̃}eAe[uƓ 256 oCgԊu.
+static const uint MaterialStride = 256;
+ByteAddressBuffer materialTable : register(t0, space1);
+
+// }eAԍ̃eNX`(eNX`̖}eA̓_~[).
+Texture2D materialTextures[] : register(t0, space2);
+SamplerState diffuseSampler : register(s0);
+
+Texture2D shadowTexture : register(t1);
+SamplerState shadowSampler : register(s1);
+
+
+float4 main(VSOutput In) : SV_TARGET
+{
+  float3 normal = normalize(In.Normal);
+  float3 lightdir = normalize(lightDirection.xyz);
+
+  uint offset = materialIndex * MaterialStride;
+  float4 diffuse = asfloat(materialTable.Load4(offset));
+  float4 ambient = asfloat(materialTable.Load4(offset + 16));
+  float4 specular = asfloat(materialTable.Load4(offset + 32));
+  uint useTexture = materialTable.Load(offset + 48);
+
+  float4 color = diffuse;
+  if (useTexture != 0)
+  {
+    color *= materialTextures[materialIndex].Sample(diffuseSampler, In.UV);
+  }
+  float3 baseColor = color.rgb;
+
+  //float lmb = (0.5 * dot(lightdir, normal) + 0.5); // half lambert
+  float lmb = saturate(dot(lightdir, normal)); // lambert
+  color.rgb = baseColor * lmb;
+  color.rgb += baseColor * ambient.xyz;
+
+  float3 toEyeDirection = normalize(cameraPos.xyz - In.WorldPosition.xyz);
+  float3 vH = normalize(toEyeDirection + lightdir);
+  float spc = pow(saturate(dot(normal, vH)), specular.w);
+  color.xyz += spc * specular.rgb;
+
+  float4 uv = In.ShadowPosUV / In.ShadowPosUV.w;
+  float depthFromLight = shadowTexture.Sample(shadowSampler, uv).r +0.001;
+
+  float z = In.ShadowPos.z / In.ShadowPos.w;
+  if (depthFromLight < z)
+  {
+    // eɂȂĂ.
+    color.rgb *= 0.7;
+  }
+
+  return color;
+}
\ No newline at end of file
@@ -28,7 +28,7 @@ cbuffer SceneParameter : register(b0)
 
 cbuffer BoneParameter : register(b1)
 {
-  float4x4 boneMatrices[256];
+  float4x4 boneMatrices[64]; // Model::BonePaletteSize
 }
 
 float4 TransformPosition(float4 inPosition, VSInput In)
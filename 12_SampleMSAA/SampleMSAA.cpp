@@ -12,101 +12,54 @@ void SampleMSAAApp::Prepare()
 {
   SetTitle("RenderToTexture");
 
-  // obt@̓]s߂ɃR}hXgĝŏ.
-  m_commandAllocators[m_frameIndex]->Reset();
+  // AvŎgVF[_[ɐ錾A܂Ƃ߂ĕɃRpC.
+  std::vector<ShaderCompileJob> shaders = {
+    { L"modelVS.hlsl", L"vs_6_0" },
+    { L"modelPS.hlsl", L"ps_6_0" },
+    { L"planeVS.hlsl", L"vs_6_0" },
+    { L"planePS.hlsl", L"ps_6_0" },
+  };
+  ThrowIfFailed(CompileShadersFromFile(shaders), "Shader compile error");
 
-  PrepareTeapot();
-  PreparePlane();
+  PrepareTeapot(shaders[0].shaderBlob, shaders[1].shaderBlob);
+  PreparePlane(shaders[2].shaderBlob, shaders[3].shaderBlob);
 
-  auto width = RenderTexWidth;
-  auto height = RenderTexHeight;
-  // eNX`_Op
-  auto colorTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_R8G8B8A8_UNORM, width, height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
-  );
-  auto depthTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_D32_FLOAT, width, height,
-    1, 1, 1, 0,
-    D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
-  );
-  D3D12_CLEAR_VALUE clearColor, clearDepth;
-  clearColor.Format = colorTexDesc.Format;
-  clearColor.Color[0] = 1.0f;
-  clearColor.Color[1] = 0.0f;
-  clearColor.Color[2] = 0.0f;
-  clearColor.Color[3] = 0.0f;
-  clearDepth.Format = DXGI_FORMAT_D32_FLOAT;
-  clearDepth.DepthStencil.Depth = 1.0f;
-  clearDepth.DepthStencil.Stencil = 0;
-
-  m_colorRT = CreateResource(colorTexDesc, D3D12_RESOURCE_STATE_RENDER_TARGET, &clearColor, D3D12_HEAP_TYPE_DEFAULT);
-  m_depthRT = CreateResource(depthTexDesc, D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearDepth, D3D12_HEAP_TYPE_DEFAULT);
-
-  m_hColorRTV = m_heapRTV->Alloc();
-  m_device->CreateRenderTargetView(m_colorRT.Get(), nullptr, m_hColorRTV);
-  m_hDepthDSV = m_heapDSV->Alloc();
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
-  dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  m_device->CreateDepthStencilView(m_depthRT.Get(), &dsvDesc, m_hDepthDSV);
-
-  m_hColorSRV = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-  srvDesc.Format = colorTexDesc.Format;
-  srvDesc.Texture2D.MipLevels = 1;
-  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(m_colorRT.Get(), &srvDesc, m_hColorSRV);
-
-  m_hDepthSRV = m_heap->Alloc();
-  D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc{};
-  depthSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-  depthSrvDesc.Texture2D.MipLevels = 1;
-  depthSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  depthSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  m_device->CreateShaderResourceView(m_depthRT.Get(), &depthSrvDesc, m_hDepthSRV);
-
-  PrepareMsaaResource();
+  PrepareFrameGraph();
 }
 
 void SampleMSAAApp::Cleanup()
 {
+  m_frameGraphExecutor.Cleanup();
 }
 
 void SampleMSAAApp::Render()
 {
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(), nullptr
-  );
+  // pXԂ̃oA̓Ot̃RpCʂAepX̐擪ł܂Ƃ߂ċL^.
+  auto commandList = m_commandContextPool->Begin();
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  RenderToTexture();
-
-  // MSAA obt@̃Xe[gXV.
-  auto barrierMsaaToRT = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_msaaColorTarget.Get(),
-    D3D12_RESOURCE_STATE_RESOLVE_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET
-  );
-  m_commandList->ResourceBarrier(1, &barrierMsaaToRT);
-
-  RenderToMSAA();
-
-  // MSAA `悩obNobt@֓eResolve].
-  ResolveToBackBuffer();
+  m_frameGraphExecutor.SetImportedTexture(
+    m_backBufferId, m_swapchain->GetImage(m_frameIndex).Get(), m_swapchain->GetCurrentRTV());
+  m_frameGraphExecutor.Execute(commandList);
 
-  m_commandList->Close();
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
 
+  if (m_frameCount % 60 == 0)
+  {
+    char title[128];
+    // 1t[̃oA̐ ResourceBarrier ̌Ăяo񐔁AꎞeNX`ʂɊmۂꍇƋLq[ṽTCY.
+    const auto& stats = m_frameGraphExecutor.GetStats();
+    sprintf_s(title, "RenderToTexture : barriers %u / ResourceBarrier %u, transient %.1f MB -> heap %.1f MB",
+      stats.transitionCount + stats.aliasingCount + stats.uavCount, stats.barrierBatchCount,
+      stats.transientBytes / (1024.0 * 1024.0), stats.aliasedBytes / (1024.0 * 1024.0));
+    SetTitle(title);
+  }
   m_frameCount++;
 }
 
@@ -114,31 +67,33 @@ void SampleMSAAApp::OnSizeChanged(UINT width, UINT height, bool isMinimized)
 {
   D3D12AppBase::OnSizeChanged(width, height, isMinimized);
 
-  // MSAA`蒼.
-  if (m_msaaColorTarget)
-  {
-    m_heapRTV->Free(m_hMsaaRTV);
-  }
-  if (m_msaaDepthTarget)
+  // MSAA`蒼. ÂeNX`͕`撆̃t[gIĂ.
+  if (m_frameGraph.GetResourceCount() == 0 || isMinimized)
   {
-    m_heapDSV->Free(m_hMsaaDSV);
+    return;
   }
-  PrepareMsaaResource();
+  m_frameGraph.SetTextureDesc(m_msaaColorId, GetMsaaColorDesc());
+  m_frameGraph.SetTextureDesc(m_msaaDepthId, GetMsaaDepthDesc());
+  m_frameGraphExecutor.Compile(m_frameGraph);
 }
 
-void SampleMSAAApp::RenderToTexture()
+void SampleMSAAApp::RenderToTexture(FrameGraphContext& context)
 {
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_colorRTId);
+  auto dsv = context.GetDSV(m_depthRTId);
+
   const float clearColor[] = {
     1.0f, 0.0f, 0.0f, 0.0f
   };
   // eNX`̃J[obt@EfvXobt@̃NA.
-  m_commandList->ClearRenderTargetView(m_hColorRTV, clearColor, 0, nullptr);
-  m_commandList->ClearDepthStencilView(m_hDepthDSV, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // eNX``ɃZbg.
-  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { m_hColorRTV };
-  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = m_hDepthDSV;
-  m_commandList->OMSetRenderTargets(
+  D3D12_CPU_DESCRIPTOR_HANDLE colorDescriptors[] = { rtv };
+  D3D12_CPU_DESCRIPTOR_HANDLE depthDescirptor = dsv;
+  commandList->OMSetRenderTargets(
     _countof(colorDescriptors), colorDescriptors, FALSE, &depthDescirptor);
 
   // r[|[gƃVU[̃Zbg.
@@ -146,8 +101,8 @@ void SampleMSAAApp::RenderToTexture()
   auto height = RenderTexHeight;
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(width), float(height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(width), LONG(height));
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   // eB[|bg̕`.
   auto cb = m_model.sceneCB[m_frameIndex];
@@ -166,46 +121,41 @@ void SampleMSAAApp::RenderToTexture()
   memcpy(mapped, &sceneParam, sizeof(sceneParam));
   cb->Unmap(0, nullptr);
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-  m_commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
-  m_commandList->SetPipelineState(m_model.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
-  m_commandList->IASetIndexBuffer(&m_model.ibView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
-
-  // `AeNX`ƂĎg߂̃oAݒ.
-  auto barrierToSRV = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_colorRT.Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-  );
-  m_commandList->ResourceBarrier(1, &barrierToSRV);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  commandList->SetGraphicsRootSignature(m_model.rootSig.Get());
+  commandList->SetPipelineState(m_model.pipeline.Get());
+  commandList->IASetVertexBuffers(0, 1, &m_model.vbView);
+  commandList->IASetIndexBuffer(&m_model.ibView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_model.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->DrawIndexedInstanced(m_model.indexCount, 1, 0, 0, 0);
 }
 
-void SampleMSAAApp::RenderToMSAA()
+void SampleMSAAApp::RenderToMSAA(FrameGraphContext& context)
 {
-  //auto rtv = m_swapchain->GetCurrentRTV();
-  //auto dsv = m_defaultDepthDSV;
+  // teapot `悵eNX`̓ǂݎ MSAA obt@ւ̕`̑Jڂ́AOtpX̐擪1ŋL^.
+  auto& commandList = context.GetCommandList();
+  auto rtv = context.GetRTV(m_msaaColorId);
+  auto dsv = context.GetDSV(m_msaaDepthId);
 
   // J[obt@(_[^[Qbgr[)̃NA
   float m_clearColor[4] = { 0.0f,0.0f,0.0f,0 };
-  m_commandList->ClearRenderTargetView(m_hMsaaRTV, m_clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, m_clearColor, 0, nullptr);
 
   // fvXobt@(fvXXeVr[)̃NA
-  m_commandList->ClearDepthStencilView(
-    m_hMsaaDSV, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  commandList->ClearDepthStencilView(
+    dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // `Zbg
-  D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { m_hMsaaRTV };
-  D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = m_hMsaaDSV;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
+  D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   auto viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   auto scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   // r[|[gƃVU[̃Zbg
-  m_commandList->RSSetViewports(1, &viewport);
-  m_commandList->RSSetScissorRects(1, &scissorRect);
+  commandList->RSSetViewports(1, &viewport);
+  commandList->RSSetScissorRects(1, &scissorRect);
 
   auto mtxWorld = XMMatrixRotationY(m_frameCount*0.01f);
   auto mtxView = XMMatrixLookAtRH(
@@ -222,60 +172,32 @@ void SampleMSAAApp::RenderToMSAA()
     m_plane.sceneCB[m_frameIndex]->Unmap(0, nullptr);
   }
 
-  m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-  m_commandList->SetGraphicsRootSignature(m_plane.rootSig.Get());
-  m_commandList->SetPipelineState(m_plane.pipeline.Get());
-  m_commandList->IASetVertexBuffers(0, 1, &m_plane.vbView);
-  m_commandList->SetGraphicsRootConstantBufferView(0, m_plane.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
-  m_commandList->SetGraphicsRootDescriptorTable(1, m_hColorSRV);
-  m_commandList->DrawInstanced(4, 1, 0, 0);
-
-  // teapot`悵eNX`ƂĂ̎gp͏ÎŎɔăoAZbg.
-  auto barrierToRT = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_colorRT.Get(),
-    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET
-  );
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+  commandList->SetGraphicsRootSignature(m_plane.rootSig.Get());
+  commandList->SetPipelineState(m_plane.pipeline.Get());
+  commandList->IASetVertexBuffers(0, 1, &m_plane.vbView);
+  commandList->SetGraphicsRootConstantBufferView(0, m_plane.sceneCB[m_frameIndex]->GetGPUVirtualAddress());
+  commandList->SetGraphicsRootDescriptorTable(1, context.GetSRV(m_colorRTId));
+  commandList->DrawInstanced(4, 1, 0, 0);
 }
 
-void SampleMSAAApp::ResolveToBackBuffer()
+void SampleMSAAApp::ResolveToBackBuffer(FrameGraphContext& context)
 {
-  // MSAAobt@ Resolve ̂߂ɃXe[gJڂ.
-  auto toResolveSource = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_msaaColorTarget.Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_RESOLVE_SOURCE
-  );
-  auto target = m_swapchain->GetImage(m_swapchain->GetCurrentBackBufferIndex());
-  auto barrierDest = CD3DX12_RESOURCE_BARRIER::Transition(
-    target.Get(),
-    D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RESOLVE_DEST
-  );
-  D3D12_RESOURCE_BARRIER resolveBarriers[] = {
-    toResolveSource, barrierDest
-  };
-  m_commandList->ResourceBarrier(
-    UINT(_countof(resolveBarriers)), resolveBarriers
-  );
-  m_commandList->ResolveSubresource(
-    target.Get(), 0, m_msaaColorTarget.Get(), 0, DXGI_FORMAT_R8G8B8A8_UNORM
+  // MSAAobt@ƃobNobt@ Resolve ̂߂̑JڂƁAobNobt@\\֖߂Jڂ̓OtL^.
+  auto& commandList = context.GetCommandList();
+  commandList->ResolveSubresource(
+    context.GetResource(m_backBufferId), 0, context.GetResource(m_msaaColorId), 0, m_swapchain->GetFormat()
   );
-
-  // obNobt@iXbv`FCj̏Ԃ`\֑Jڂ.
-  auto barrierPresent = CD3DX12_RESOURCE_BARRIER::Transition(
-    target.Get(),
-    D3D12_RESOURCE_STATE_RESOLVE_DEST, D3D12_RESOURCE_STATE_PRESENT
-  );
-  m_commandList->ResourceBarrier(1, &barrierPresent);
 }
 
 
-void SampleMSAAApp::PrepareTeapot()
+void SampleMSAAApp::PrepareTeapot(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps)
 {
   void* mapped;
   HRESULT hr;
   CD3DX12_RANGE range(0, 0);
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(TeapotModel::TeapotVerticesPN);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -292,7 +214,7 @@ void SampleMSAAApp::PrepareTeapot()
   m_model.vbView.SizeInBytes = bufferSize;
   m_model.vbView.StrideInBytes = sizeof(TeapotModel::Vertex);
 
-  m_commandList->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_model.resourceVB.Get(), uploadVB.Get());
 
   bufferSize = sizeof(TeapotModel::TeapotIndices);
   auto ibDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -310,31 +232,16 @@ void SampleMSAAApp::PrepareTeapot()
   m_model.ibView.Format = DXGI_FORMAT_R32_UINT;
   m_model.indexCount = _countof(TeapotModel::TeapotIndices);
 
-  m_commandList->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
+  command->CopyResource(m_model.resourceIB.Get(), uploadIB.Get());
 
   // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  auto barrierIB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER
-  );
-  D3D12_RESOURCE_BARRIER barriers[] = {
-    barrierVB, barrierIB,
-  };
-  m_commandList->ResourceBarrier(_countof(barriers), barriers);
-
-  m_commandList->Close();
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  // Xe[ge[uɂf悤AJڂ̓v[ʂ.
+  m_commandContextPool->Transition(command, m_model.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+  m_commandContextPool->Transition(command, m_model.resourceIB.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
-  WaitForIdleGPU(); // ̂҂.
+  FinishCommandList(command); // ̂҂.
 
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"modelVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"modelPS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_ROOT_PARAMETER rootParams[1];
@@ -347,7 +254,7 @@ void SampleMSAAApp::PrepareTeapot()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_model.rootSig)
   );
@@ -364,7 +271,7 @@ void SampleMSAAApp::PrepareTeapot()
     DXGI_FORMAT_R8G8B8A8_UNORM,
     vs, ps, book_util::CreateTeapotModelRasterizerDesc(),
     inputElementDesc, _countof(inputElementDesc), m_model.rootSig);
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_model.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@
@@ -377,7 +284,7 @@ void SampleMSAAApp::PrepareTeapot()
   }
 }
 
-void SampleMSAAApp::PreparePlane()
+void SampleMSAAApp::PreparePlane(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps)
 {
   VertexPT plane[] = {
     { XMFLOAT3(-1.0f, 1.0f, 0.0f), XMFLOAT2(0.0f,0.0f) },
@@ -388,7 +295,7 @@ void SampleMSAAApp::PreparePlane()
   void* mapped;
   HRESULT hr;
 
-  m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr);
+  auto command = CreateCommandList();
 
   UINT bufferSize = sizeof(plane);
   auto vbDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
@@ -404,25 +311,14 @@ void SampleMSAAApp::PreparePlane()
   m_plane.vbView.SizeInBytes = bufferSize;
   m_plane.vbView.StrideInBytes = sizeof(VertexPT);
 
-  m_commandList->CopyResource(m_plane.resourceVB.Get(), uploadVB.Get());
+  command->CopyResource(m_plane.resourceVB.Get(), uploadVB.Get());
 
   // Rs[I͊eobt@̃Xe[gK؂ɕύXĂ.
-  auto barrierVB = CD3DX12_RESOURCE_BARRIER::Transition(
-    m_plane.resourceVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-  );
-  m_commandList->ResourceBarrier(1, &barrierVB);
-  m_commandList->Close();
-
-  ID3D12CommandList* command[] = { m_commandList.Get() };
-  m_commandQueue->ExecuteCommandLists(1, command);
+  m_commandContextPool->Transition(command, m_plane.resourceVB.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-  WaitForIdleGPU(); // ̂҂.
+  FinishCommandList(command); // ̂҂.
 
-  ComPtr<ID3DBlob> errBlob, vs, ps;
-  hr = CompileShaderFromFile(L"planeVS.hlsl", L"vs_6_0", vs, errBlob);
-  ThrowIfFailed(hr, "VertexShader error");
-  hr = CompileShaderFromFile(L"planePS.hlsl", L"ps_6_0", ps, errBlob);
-  ThrowIfFailed(hr, "PixelShader error");
+  ComPtr<ID3DBlob> errBlob;
 
   // [gVOl`\z
   CD3DX12_DESCRIPTOR_RANGE rangeSrv;
@@ -441,7 +337,7 @@ void SampleMSAAApp::PreparePlane()
   ComPtr<ID3DBlob> signature;
   hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &errBlob);
   ThrowIfFailed(hr, "D3D12SerializeRootSignature failed.");
-  hr = m_device->CreateRootSignature(
+  hr = m_pipelineCache->CreateRootSignature(
     0, signature->GetBufferPointer(), signature->GetBufferSize(),
     IID_PPV_ARGS(&m_plane.rootSig)
   );
@@ -465,7 +361,7 @@ void SampleMSAAApp::PreparePlane()
   // MSAA `Ƃ邽 SampleDesc XV.
   psoDesc.SampleDesc.Count = SampleCount;
 
-  hr = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_plane.pipeline));
+  hr = m_pipelineCache->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_plane.pipeline));
   ThrowIfFailed(hr, "CreateGraphicsPipelineState failed.");
 
   // 萔obt@
@@ -478,67 +374,47 @@ void SampleMSAAApp::PreparePlane()
   }
 }
 
-void SampleMSAAApp::PrepareMsaaResource()
+FrameGraph::TextureDesc SampleMSAAApp::GetMsaaColorDesc() const
 {
-  // MSAA `obt@(J[)̏.
-  auto format = m_swapchain->GetFormat();
-  auto width = m_width;
-  auto height = m_height;
-  D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS levels{};
-  levels.Format = format;
-  levels.SampleCount = SampleCount;
-
-  D3D12_CLEAR_VALUE clearColor{};
-  clearColor.Format = format;
-
-  auto msaaColorDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    format, width, height,
-    1, 1, levels.SampleCount
-  );
-  msaaColorDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-  auto hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &msaaColorDesc,
-    D3D12_RESOURCE_STATE_RESOLVE_SOURCE,
-    &clearColor,
-    IID_PPV_ARGS(&m_msaaColorTarget)
-  );
-  ThrowIfFailed(hr, "MSAA Color obt@̐Ɏs.");
+  return FrameGraph::TextureDesc{
+    m_width, m_height, uint32_t(m_swapchain->GetFormat()), SampleCount, { 0.0f, 0.0f, 0.0f, 0.0f }
+  };
+}
+FrameGraph::TextureDesc SampleMSAAApp::GetMsaaDepthDesc() const
+{
+  return FrameGraph::TextureDesc{
+    m_width, m_height, DXGI_FORMAT_D32_FLOAT, SampleCount, { 1.0f }
+  };
+}
 
-  // MSAA `obt@(fvX)̏.
-  auto msaaDepthDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    DXGI_FORMAT_D32_FLOAT, width, height,
-    1, 1, SampleCount
-  );
-  msaaDepthDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-  D3D12_CLEAR_VALUE clearDepth{};
-  clearDepth.Format = msaaDepthDesc.Format;
-  clearDepth.DepthStencil.Depth = 1.0f;
-
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &msaaDepthDesc,
-    D3D12_RESOURCE_STATE_DEPTH_WRITE,
-    &clearDepth,
-    IID_PPV_ARGS(&m_msaaDepthTarget)
-  );
-  ThrowIfFailed(hr, "MSAA Depth obt@̐Ɏs.");
+void SampleMSAAApp::PrepareFrameGraph()
+{
+  FrameGraph::TextureDesc colorTexDesc{
+    RenderTexWidth, RenderTexHeight, DXGI_FORMAT_R8G8B8A8_UNORM, 1, { 1.0f, 0.0f, 0.0f, 0.0f }
+  };
+  FrameGraph::TextureDesc depthTexDesc{
+    RenderTexWidth, RenderTexHeight, DXGI_FORMAT_D32_FLOAT, 1, { 1.0f }
+  };
+  m_backBufferId = m_frameGraph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  m_colorRTId = m_frameGraph.CreateTexture("TeapotColor", colorTexDesc);
+  m_depthRTId = m_frameGraph.CreateTexture("TeapotDepth", depthTexDesc);
+  m_msaaColorId = m_frameGraph.CreateTexture("MsaaColor", GetMsaaColorDesc());
+  m_msaaDepthId = m_frameGraph.CreateTexture("MsaaDepth", GetMsaaDepthDesc());
 
-  // MSAA ɏo͂邽߂̃r[.
-  D3D12_RENDER_TARGET_VIEW_DESC msaaRtvDesc{};
-  msaaRtvDesc.Format = m_swapchain->GetFormat();
-  msaaRtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2DMS;
+  auto teapotPass = m_frameGraph.AddPass("Teapot", [this](FrameGraphContext& context) { RenderToTexture(context); });
+  m_frameGraph.Write(teapotPass, m_colorRTId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(teapotPass, m_depthRTId, FrameGraph::USAGE_DEPTH_WRITE);
 
-  D3D12_DEPTH_STENCIL_VIEW_DESC msaaDsvDesc{};
-  msaaDsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-  msaaDsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DMS;
+  auto msaaPass = m_frameGraph.AddPass("MSAA", [this](FrameGraphContext& context) { RenderToMSAA(context); });
+  m_frameGraph.Read(msaaPass, m_colorRTId, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  m_frameGraph.Write(msaaPass, m_msaaColorId, FrameGraph::USAGE_RENDER_TARGET);
+  m_frameGraph.Write(msaaPass, m_msaaDepthId, FrameGraph::USAGE_DEPTH_WRITE);
+
+  // MSAA `悩obNobt@֓eResolve].
+  auto resolvePass = m_frameGraph.AddPass("Resolve", [this](FrameGraphContext& context) { ResolveToBackBuffer(context); });
+  m_frameGraph.Read(resolvePass, m_msaaColorId, FrameGraph::USAGE_RESOLVE_SOURCE);
+  m_frameGraph.Write(resolvePass, m_backBufferId, FrameGraph::USAGE_RESOLVE_DEST);
 
-  m_hMsaaRTV = m_heapRTV->Alloc();
-  m_hMsaaDSV = m_heapDSV->Alloc();
-  m_device->CreateRenderTargetView(m_msaaColorTarget.Get(), &msaaRtvDesc, m_hMsaaRTV);
-  m_device->CreateDepthStencilView(m_msaaDepthTarget.Get(), &msaaDsvDesc, m_hMsaaDSV);
+  m_frameGraphExecutor.Prepare(this, m_heapRTV, m_heapDSV, m_heap);
+  m_frameGraphExecutor.Compile(m_frameGraph);
 }
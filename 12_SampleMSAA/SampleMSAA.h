@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12AppBase.h"
+#include "FrameGraphExecutor.h"
 #include "DirectXMath.h"
 
 class SampleMSAAApp : public D3D12AppBase {
@@ -30,13 +31,15 @@ public:
 
   virtual void OnSizeChanged(UINT width, UINT height, bool isMinimized);
 private:
-  void RenderToTexture();
-  void RenderToMSAA();
-  void ResolveToBackBuffer();
+  void RenderToTexture(FrameGraphContext& context);
+  void RenderToMSAA(FrameGraphContext& context);
+  void ResolveToBackBuffer(FrameGraphContext& context);
 
-  void PrepareTeapot();
-  void PreparePlane();
-  void PrepareMsaaResource();
+  void PrepareTeapot(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps);
+  void PreparePlane(ComPtr<ID3DBlob> vs, ComPtr<ID3DBlob> ps);
+  void PrepareFrameGraph();
+  FrameGraph::TextureDesc GetMsaaColorDesc() const;
+  FrameGraph::TextureDesc GetMsaaDepthDesc() const;
 
   using Buffer = ComPtr<ID3D12Resource1>;
   using Texture = ComPtr<ID3D12Resource1>;
@@ -57,17 +60,13 @@ private:
   ModelData m_model;
   ModelData m_plane;
 
-  Texture m_colorRT;
-  Texture m_depthRT;
-  DescriptorHandle m_hColorRTV;
-  DescriptorHandle m_hDepthDSV;
-  DescriptorHandle m_hColorSRV;
-  DescriptorHandle m_hDepthSRV;
-
-  Texture m_msaaColorTarget;
-  Texture m_msaaDepthTarget;
-  DescriptorHandle m_hMsaaRTV;
-  DescriptorHandle m_hMsaaDSV;
+  // teapot ̕` MSAA ̕`̓t[OẗꎞeNX`ƂA
+  // gpԂ̏dȂȂ (teapot ̃fvX MSAA ̃J[) ͓̈g.
+  FrameGraph m_frameGraph;
+  FrameGraphExecutor m_frameGraphExecutor;
+  FrameGraph::ResourceId m_backBufferId;
+  FrameGraph::ResourceId m_colorRTId, m_depthRTId;
+  FrameGraph::ResourceId m_msaaColorId, m_msaaDepthId;
 
   UINT m_frameCount;
 };
\ No newline at end of file
@@ -0,0 +1,280 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if _MSC_VER > 1922 && !defined(_SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING)
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+
+#include <dxcapi.h>
+#include <wrl.h>
+
+#include "ShaderArchive.h"
+#include "ShaderCache.h"
+#include "ShaderPermutation.h"
+
+#pragma comment(lib, "dxcompiler.lib")
+
+// サンプルのディレクトリにある全てのシェーダーと、その全ての変種をコンパイルして1つのアーカイブにまとめる.
+//
+//   ShaderArchiver.exe <サンプルのディレクトリ> [出力先]
+//
+// 出力先を省略した場合はサンプルのディレクトリの shaders.pak (D3D12AppBase::ShaderArchiveFileName) に書く.
+// 索引にはビルド構成の最適化フラグが含まれるため、サンプルと同じ構成 (通常は Release) でビルドしたものを使うこと.
+// プロファイルはファイル名から決める (*VS.hlsl, VertexShader.hlsl は vs_6_0, *PS.hlsl, PixelShader.hlsl は ps_6_0).
+
+using namespace Microsoft::WRL;
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+  const wchar_t* DefaultArchiveFileName = L"shaders.pak";
+  // DXIL コンテナ内のリフレクションのパート ("STAT").
+  const UINT32 ReflectionPartKind = UINT32('S') | (UINT32('T') << 8) | (UINT32('A') << 16) | (UINT32('T') << 24);
+
+  using clock = std::chrono::high_resolution_clock;
+  double ElapsedMs(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+
+  bool EndsWith(const std::wstring& text, const std::wstring& suffix)
+  {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+  // ファイル名の規則からプロファイルを決める. 分からなければ空.
+  std::wstring GetProfile(const std::wstring& fileName)
+  {
+    if (EndsWith(fileName, L"VS.hlsl") || fileName == L"VertexShader.hlsl")
+    {
+      return L"vs_6_0";
+    }
+    if (EndsWith(fileName, L"PS.hlsl") || fileName == L"PixelShader.hlsl")
+    {
+      return L"ps_6_0";
+    }
+    return std::wstring();
+  }
+
+  bool ReadTextFile(const std::wstring& path, std::string& data)
+  {
+    std::ifstream infile(fs::path(path), std::ifstream::binary);
+    if (!infile)
+    {
+      return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  std::vector<uint8_t> ToBytes(const void* data, size_t size)
+  {
+    auto p = static_cast<const uint8_t*>(data);
+    return std::vector<uint8_t>(p, p + size);
+  }
+
+  // DXIL からリフレクションのパートを取り出す. 無ければ空.
+  std::vector<uint8_t> ExtractReflection(IDxcContainerReflection* reflection, ID3DBlob* shader)
+  {
+    ComPtr<IDxcBlob> container;
+    ComPtr<IDxcBlob> part;
+    UINT32 index = 0;
+    if (FAILED(shader->QueryInterface(IID_PPV_ARGS(&container))) ||
+      FAILED(reflection->Load(container.Get())) ||
+      FAILED(reflection->FindFirstPartKind(ReflectionPartKind, &index)) ||
+      FAILED(reflection->GetPartContent(index, &part)))
+    {
+      return std::vector<uint8_t>();
+    }
+    return ToBytes(part->GetBufferPointer(), part->GetBufferSize());
+  }
+
+  bool WriteArchive(const std::wstring& path, const std::vector<uint8_t>& data)
+  {
+    auto tempPath = path + L".tmp";
+    {
+      std::ofstream outfile(fs::path(tempPath), std::ofstream::binary | std::ofstream::trunc);
+      if (!outfile.write(reinterpret_cast<const char*>(data.data()), data.size()))
+      {
+        return false;
+      }
+    }
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+      DeleteFileW(tempPath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  int Run(const std::wstring& sampleDirectory, std::wstring archivePath)
+  {
+    if (archivePath.empty())
+    {
+      archivePath = (fs::path(sampleDirectory) / DefaultArchiveFileName).wstring();
+    }
+    archivePath = fs::absolute(archivePath).wstring();
+    // 実行時と同じくシェーダーのファイル名をサンプルのディレクトリからの相対で扱う.
+    if (!SetCurrentDirectoryW(sampleDirectory.c_str()))
+    {
+      wprintf(L"directory not found: %ls\n", sampleDirectory.c_str());
+      return 1;
+    }
+
+    std::vector<ShaderCompileJob> jobs;
+    std::vector<ShaderArchive::Source> sources;
+    for (const auto& item : fs::directory_iterator(L"."))
+    {
+      auto fileName = item.path().filename().wstring();
+      if (item.path().extension() != L".hlsl")
+      {
+        continue;
+      }
+      auto profile = GetProfile(fileName);
+      if (profile.empty())
+      {
+        wprintf(L"skip %ls: unknown profile\n", fileName.c_str());
+        continue;
+      }
+      std::string source;
+      if (!ReadTextFile(fileName, source))
+      {
+        wprintf(L"skip %ls: cannot read\n", fileName.c_str());
+        continue;
+      }
+      // 宣言された機能キーの全ての組み合わせを入れる. 宣言も入れ、ソースが無くても変種を選べるようにする.
+      ShaderPermutation permutation(source);
+      for (ShaderFeatureMask mask = 0; ; ++mask)
+      {
+        jobs.emplace_back(fileName, profile, permutation.MakeDefines(mask));
+        if (mask == permutation.GetAllMask())
+        {
+          break;
+        }
+      }
+      if (!permutation.GetFeatures().empty())
+      {
+        std::string declarations;
+        for (const auto& feature : permutation.GetFeatures())
+        {
+          declarations += "// @feature " + feature + "\n";
+        }
+        sources.push_back(ShaderArchive::Source{
+          ShaderArchive::MakeFeatureRequest(fileName), 0, ToBytes(declarations.data(), declarations.size()), {} });
+      }
+    }
+    if (jobs.empty())
+    {
+      wprintf(L"no shaders in %ls\n", sampleDirectory.c_str());
+      return 1;
+    }
+
+    // サンプルと同じディスクキャッシュを使い、変更の無いシェーダーはコンパイルし直さない.
+    ShaderCache cache;
+    cache.SetDirectory(L"ShaderCache");
+    auto start = clock::now();
+    HRESULT hr = cache.CompileBatch(jobs);
+    double buildMs = ElapsedMs(start);
+    for (const auto& job : jobs)
+    {
+      if (FAILED(job.hr))
+      {
+        wprintf(L"%ls (%ls): compile error\n", job.fileName.c_str(), job.profile.c_str());
+        if (job.errorBlob)
+        {
+          printf("%.*s\n", int(job.errorBlob->GetBufferSize()), static_cast<const char*>(job.errorBlob->GetBufferPointer()));
+        }
+      }
+    }
+    if (FAILED(hr))
+    {
+      return 1;
+    }
+
+    ComPtr<IDxcContainerReflection> reflection;
+    hr = DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&reflection));
+    if (FAILED(hr))
+    {
+      wprintf(L"DxcCreateInstance(DxcContainerReflection) failed.\n");
+      return 1;
+    }
+    size_t dxilBytes = 0, reflectionBytes = 0;
+    for (const auto& job : jobs)
+    {
+      ShaderArchive::Source source{
+        ShaderCache::MakeRequest(job.fileName, job.profile, job.defines), job.keyHash,
+        ToBytes(job.shaderBlob->GetBufferPointer(), job.shaderBlob->GetBufferSize()),
+        ExtractReflection(reflection.Get(), job.shaderBlob.Get())
+      };
+      dxilBytes += source.dxil.size();
+      reflectionBytes += source.reflection.size();
+      sources.push_back(std::move(source));
+    }
+
+    auto data = ShaderArchive::Build(sources);
+    if (!WriteArchive(archivePath, data))
+    {
+      wprintf(L"cannot write %ls\n", archivePath.c_str());
+      return 1;
+    }
+
+    // 書いたものを実行時と同じく開き、全ての要求が引けることと、その時間を確かめる.
+    ShaderCache archived;
+    if (!archived.OpenArchive(archivePath))
+    {
+      wprintf(L"cannot open %ls\n", archivePath.c_str());
+      return 1;
+    }
+    start = clock::now();
+    for (const auto& job : jobs)
+    {
+      ComPtr<ID3DBlob> shaderBlob, errorBlob;
+      hr = archived.Compile(job.fileName, job.profile, job.defines, shaderBlob, errorBlob);
+      if (FAILED(hr) || shaderBlob->GetBufferSize() != job.shaderBlob->GetBufferSize() ||
+        memcmp(shaderBlob->GetBufferPointer(), job.shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()) != 0)
+      {
+        wprintf(L"%ls (%ls): archive mismatch\n", job.fileName.c_str(), job.profile.c_str());
+        return 1;
+      }
+    }
+    double lookupMs = ElapsedMs(start);
+    if (archived.GetStats().archiveHitCount != jobs.size())
+    {
+      wprintf(L"some shaders were not found in the archive\n");
+      return 1;
+    }
+
+    auto stats = cache.GetStats();
+    wprintf(L"%ls: %zu shaders, %zu bytes (DXIL %zu, reflection %zu)\n",
+      archivePath.c_str(), jobs.size(), data.size(), dxilBytes, reflectionBytes);
+    wprintf(L"  from source: %.1f ms (%u compiled %.1f ms, %u from disk cache, key %.1f ms)\n",
+      buildMs, stats.compiledCount, stats.compileMs, stats.diskHitCount, stats.loadMs);
+    wprintf(L"  from archive: %.3f ms\n", lookupMs);
+    return 0;
+  }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  if (argc < 2)
+  {
+    wprintf(L"usage: ShaderArchiver <sample directory> [archive path]\n");
+    return 1;
+  }
+  try
+  {
+    return Run(argv[1], argc > 2 ? argv[2] : L"");
+  }
+  catch (std::exception& e)
+  {
+    printf("%s\n", e.what());
+    return 1;
+  }
+}
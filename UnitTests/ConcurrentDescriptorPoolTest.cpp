@@ -0,0 +1,180 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "UnitTest.h"
+#include "ConcurrentDescriptorPool.h"
+
+using ThreadCache = ConcurrentDescriptorPool::ThreadCache;
+
+TEST_CASE("ConcurrentDescriptorPool/SingleThreadExhaust")
+{
+  // 端数のブロックを含む大きさでも、全ての位置を1回ずつ払い出す.
+  const uint32_t base = 100, count = 37;
+  ConcurrentDescriptorPool pool;
+  pool.Reset(base, count);
+  std::vector<int> seen(count, 0);
+  {
+    ThreadCache cache(pool);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      auto index = cache.Allocate();
+      CHECK(pool.Contains(index));
+      if (pool.Contains(index))
+      {
+        ++seen[index - base];
+      }
+    }
+    CHECK_EQUAL(uint32_t(ConcurrentDescriptorPool::InvalidIndex), cache.Allocate());
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      cache.Free(base + i);
+    }
+  }
+  CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+
+  // キャッシュの破棄で全て戻っている.
+  ThreadCache cache(pool);
+  uint32_t allocated = 0;
+  while (cache.Allocate() != ConcurrentDescriptorPool::InvalidIndex)
+  {
+    ++allocated;
+  }
+  CHECK_EQUAL(count, allocated);
+}
+
+TEST_CASE("ConcurrentDescriptorPool/FreeBatching")
+{
+  ConcurrentDescriptorPool pool;
+  pool.Reset(0, 256);
+  ThreadCache cache(pool);
+  std::vector<uint32_t> indices;
+  for (int i = 0; i < 64; ++i)
+  {
+    indices.push_back(cache.Allocate());
+  }
+  for (auto index : indices)
+  {
+    cache.Free(index);
+    // 2ブロックに達した時点で1ブロック戻すため、手元は常に2ブロック未満.
+    CHECK(cache.GetCachedCount() < ConcurrentDescriptorPool::BlockSize * 2);
+  }
+  cache.Flush();
+  CHECK_EQUAL(size_t(0), cache.GetCachedCount());
+}
+
+TEST_CASE("ConcurrentDescriptorPool/MultiThreadNoDuplicates")
+{
+  // 各スレッドが確保と解放を繰り返しながら、同じ位置を同時に持っていないことを確かめる.
+  const uint32_t count = 1024;
+  const int threadCount = 8;
+  ConcurrentDescriptorPool pool;
+  pool.Reset(0, count);
+  std::unique_ptr<std::atomic<int>[]> owners(new std::atomic<int>[count]);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    owners[i].store(-1);
+  }
+  std::atomic<int> errors(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      ThreadCache cache(pool);
+      std::vector<uint32_t> held;
+      for (int step = 0; step < 20000; ++step)
+      {
+        if (held.size() < 64 && (step % 3) != 2)
+        {
+          auto index = cache.Allocate();
+          if (index == ConcurrentDescriptorPool::InvalidIndex)
+            continue;
+          int expected = -1;
+          if (!owners[index].compare_exchange_strong(expected, t))
+          {
+            ++errors;
+          }
+          held.push_back(index);
+        }
+        else if (!held.empty())
+        {
+          auto index = held.back();
+          held.pop_back();
+          owners[index].store(-1);
+          cache.Free(index);
+        }
+      }
+      for (auto index : held)
+      {
+        owners[index].store(-1);
+        cache.Free(index);
+      }
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  CHECK_EQUAL(0, errors.load());
+
+  // 全てのスレッドのキャッシュが戻った後は、全数を確保できる.
+  ThreadCache cache(pool);
+  std::vector<int> seen(count, 0);
+  uint32_t allocated = 0, index;
+  while ((index = cache.Allocate()) != ConcurrentDescriptorPool::InvalidIndex)
+  {
+    ++seen[index];
+    ++allocated;
+  }
+  CHECK_EQUAL(count, allocated);
+  CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+}
+
+BENCHMARK_CASE("ConcurrentDescriptorPool/AllocationsPerSecond")
+{
+  // 1 から 16 スレッドで、それぞれが確保と解放を繰り返したときの全体の確保数/秒.
+  const uint32_t count = 65536;
+  const int iterations = 1000000;
+  for (int threadCount = 1; threadCount <= 16; threadCount *= 2)
+  {
+    ConcurrentDescriptorPool pool;
+    pool.Reset(0, count);
+    std::atomic<bool> isStarted(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+      threads.emplace_back([&]() {
+        ThreadCache cache(pool);
+        uint32_t held[32];
+        while (!isStarted.load())
+        {
+          std::this_thread::yield();
+        }
+        for (int i = 0; i < iterations / 32; ++i)
+        {
+          for (auto& index : held)
+          {
+            index = cache.Allocate();
+          }
+          for (auto index : held)
+          {
+            cache.Free(index);
+          }
+        }
+      });
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    isStarted.store(true);
+    for (auto& t : threads)
+    {
+      t.join();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::printf("  %2d threads: %.1f M allocations/s\n", threadCount,
+      double(iterations / 32 * 32) * threadCount / seconds * 1.0e-6);
+  }
+}
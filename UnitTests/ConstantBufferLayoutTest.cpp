@@ -0,0 +1,211 @@
+﻿#include <string>
+#include <vector>
+
+#include "UnitTest.h"
+#include "ConstantBufferLayout.h"
+
+namespace
+{
+  ConstantBufferLayouts Parse(const std::string& source)
+  {
+    ConstantBufferLayouts layouts;
+    std::string error;
+    CHECK(ParseConstantBuffers(source, layouts, &error));
+    CHECK(error.empty());
+    return layouts;
+  }
+
+  bool HasVariable(const ConstantBufferLayout& layout, const char* name, uint32_t offset, uint32_t size)
+  {
+    auto variable = layout.FindVariable(name);
+    return variable && variable->offset == offset && variable->size == size;
+  }
+
+  ConstantBufferLayout MakeLayout(std::vector<ConstantBufferVariable> variables, uint32_t bindPoint = 0)
+  {
+    return ConstantBufferLayout{ "Test", bindPoint, 0, 256, variables };
+  }
+
+  bool HasErrorContaining(const std::vector<std::string>& errors, const char* text)
+  {
+    for (const auto& error : errors)
+    {
+      if (error.find(text) != std::string::npos)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // C++ 側の構造体の例. ボーン行列の数をシェーダーより少なくした場合を確かめる.
+  struct Matrix { float m[16]; };
+  struct SmallBoneParameter
+  {
+    Matrix bone[256];
+  };
+  struct SceneParameter
+  {
+    Matrix view;
+    float lightDirection[4];
+    float time;
+  };
+}
+
+TEST_CASE("ConstantBufferLayout/ParsePackingRules")
+{
+  auto layouts = Parse(
+    "#define LIGHT_COUNT 3\n"
+    "struct Light { float3 direction; float intensity; };\n"
+    "struct VSInput { float4 position : POSITION; Texture2D tex; };\n"
+    "cbuffer Packing : register(b3, space1)\n"
+    "{\n"
+    "  float3 a;              // 0\n"
+    "  float b;               // 12 (同じレジスタに詰める)\n"
+    "  float2 c;              // 16\n"
+    "  float3 d;              // 32 (レジスタをまたがない)\n"
+    "  float e[3];            // 48 (配列はレジスタの先頭から, 最後の要素の後ろは詰めない)\n"
+    "  float f;               // 84\n"
+    "  float4x4 m;            // 96\n"
+    "  row_major float3x4 r;  // 160 (行毎に1レジスタ)\n"
+    "  float4x3 cm;           // 208 (列毎に1レジスタ)\n"
+    "  Light lights[LIGHT_COUNT]; // 256\n"
+    "};\n"
+    "static const uint BONE_COUNT = 4;\n"
+    "cbuffer Default { float4x4 bones[BONE_COUNT]; }\n");
+  CHECK_EQUAL(size_t(2), layouts.size());
+  if (layouts.size() != 2)
+  {
+    return;
+  }
+  const auto& packing = layouts[0];
+  CHECK(packing.name == "Packing");
+  CHECK_EQUAL(3u, packing.bindPoint);
+  CHECK_EQUAL(1u, packing.space);
+  CHECK(HasVariable(packing, "a", 0, 12));
+  CHECK(HasVariable(packing, "b", 12, 4));
+  CHECK(HasVariable(packing, "c", 16, 8));
+  CHECK(HasVariable(packing, "d", 32, 12));
+  CHECK(HasVariable(packing, "e", 48, 36));
+  CHECK(HasVariable(packing, "f", 84, 4));
+  CHECK(HasVariable(packing, "m", 96, 64));
+  CHECK(HasVariable(packing, "r", 160, 48));
+  CHECK(HasVariable(packing, "cm", 208, 48));
+  CHECK(HasVariable(packing, "lights", 256, 48));
+  CHECK_EQUAL(304u, packing.size);
+
+  const auto& bones = layouts[1];
+  CHECK_EQUAL(0u, bones.bindPoint);
+  CHECK(HasVariable(bones, "bones", 0, 256));
+  CHECK(bones.variables.size() == 1 && bones.variables[0].isUsed);
+}
+
+TEST_CASE("ConstantBufferLayout/ParseRejectsUnsupported")
+{
+  ConstantBufferLayouts layouts;
+  std::string error;
+  CHECK(!ParseConstantBuffers("cbuffer A { float4 x : packoffset(c0); };", layouts, &error));
+  CHECK(error.find("packoffset") != std::string::npos);
+  CHECK(!ParseConstantBuffers("cbuffer A { Unknown x; };", layouts, &error));
+  CHECK(!ParseConstantBuffers("cbuffer A { float x[COUNT]; };", layouts, &error));
+  CHECK(!ParseConstantBuffers("cbuffer A : register(t0) { float x; };", layouts, &error));
+  CHECK(!ParseConstantBuffers("cbuffer A { float x;", layouts, &error));
+}
+
+TEST_CASE("ConstantBufferLayout/ValidateDetectsMismatch")
+{
+  // シェーダーは 512 個のボーン行列を読むが、C++ 側は 256 個しか持たない.
+  auto bones = MakeLayout({ { "boneMatrices", 0, 512 * 64, true } }, 1);
+  auto errors = ValidateConstantBuffer(bones,
+    { CONSTANT_BUFFER_FIELD(SmallBoneParameter, bone, boneMatrices) }, sizeof(SmallBoneParameter));
+  CHECK(HasErrorContaining(errors, "size 16384 (C++) < 32768 (HLSL)"));
+  CHECK(HasErrorContaining(errors, "shader reads up to 32768 bytes"));
+
+  auto scene = MakeLayout({
+    { "view", 0, 64, true },
+    { "lightDirection", 64, 16, true },
+    { "time", 84, 4, true },        // C++ 側は 80.
+    { "unusedValue", 96, 4, false },
+    { "cameraPos", 112, 16, true },
+  });
+  const std::vector<ConstantBufferField> fields = {
+    CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+    CONSTANT_BUFFER_FIELD(SceneParameter, lightDirection, lightDirection),
+    CONSTANT_BUFFER_FIELD(SceneParameter, time, time),
+    CONSTANT_BUFFER_FIELD(SceneParameter, time, removedValue),
+  };
+  errors = ValidateConstantBuffer(scene, fields, sizeof(SceneParameter));
+  CHECK(HasErrorContaining(errors, "time offset 80 (C++) != 84 (HLSL)"));
+  CHECK(HasErrorContaining(errors, "cameraPos has no C++ field"));
+  CHECK(HasErrorContaining(errors, "removedValue is not declared"));
+  CHECK(!HasErrorContaining(errors, "unusedValue"));
+  CHECK(!HasErrorContaining(errors, "view"));
+}
+
+TEST_CASE("ConstantBufferLayout/ValidateAcceptsMatchingStruct")
+{
+  auto scene = MakeLayout({
+    { "view", 0, 64, true },
+    { "lightDirection", 64, 16, false },
+    { "time", 80, 4, true },
+  });
+  auto errors = ValidateConstantBuffer(scene, {
+    CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+    CONSTANT_BUFFER_FIELD(SceneParameter, lightDirection, lightDirection),
+    CONSTANT_BUFFER_FIELD(SceneParameter, time, time),
+  }, sizeof(SceneParameter));
+  CHECK(errors.empty());
+
+  // 参照の無い cbuffer は変数が出てこないため、対応の無い変数を問わない.
+  errors = ValidateConstantBuffer(MakeLayout({}), { CONSTANT_BUFFER_FIELD(SceneParameter, time, time) }, sizeof(SceneParameter));
+  CHECK(errors.empty());
+}
+
+TEST_CASE("ConstantBufferLayout/BindingMergesShaders")
+{
+  // 頂点シェーダーは view, ピクセルシェーダーは time だけを読む.
+  ConstantBufferLayouts vs = { MakeLayout({ { "view", 0, 64, true }, { "time", 80, 4, false } }) };
+  ConstantBufferLayouts ps = { MakeLayout({ { "view", 0, 64, false }, { "time", 80, 4, true } }) };
+  ConstantBufferBinding binding;
+  CHECK(binding.IsEmpty());
+  // リフレクションが無ければ構造体の全体を書く.
+  auto whole = binding.GetUsedRange(0, sizeof(SceneParameter));
+  CHECK_EQUAL(0u, whole.begin);
+  CHECK_EQUAL(uint32_t(sizeof(SceneParameter)), whole.end);
+
+  binding.Add(vs);
+  auto vsRange = binding.GetUsedRange(0, sizeof(SceneParameter));
+  CHECK_EQUAL(0u, vsRange.begin);
+  CHECK_EQUAL(64u, vsRange.end);
+  binding.Add(ps);
+  auto range = binding.GetUsedRange(0, sizeof(SceneParameter));
+  CHECK_EQUAL(0u, range.begin);
+  CHECK_EQUAL(84u, range.end);
+  // どのシェーダーも参照しないレジスタは書かない.
+  CHECK(binding.GetUsedRange(5, sizeof(SceneParameter)).IsEmpty());
+  CHECK(binding.Validate(0, {
+    CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+    CONSTANT_BUFFER_FIELD(SceneParameter, time, time),
+  }, sizeof(SceneParameter)).empty());
+
+  // 同じ名前の変数の位置がシェーダー毎に違えば誤り.
+  binding.Add({ MakeLayout({ { "time", 96, 4, true } }) });
+  auto errors = binding.Validate(0, {
+    CONSTANT_BUFFER_FIELD(SceneParameter, view, view),
+    CONSTANT_BUFFER_FIELD(SceneParameter, time, time),
+  }, sizeof(SceneParameter));
+  CHECK(HasErrorContaining(errors, "time differs between shaders"));
+}
+
+TEST_CASE("ConstantBufferLayout/UsedRangeClampedToStruct")
+{
+  ConstantBufferBinding binding;
+  binding.Add({ MakeLayout({ { "a", 16, 16, false }, { "b", 32, 64, true } }) });
+  auto range = binding.GetUsedRange(0, 48);
+  CHECK_EQUAL(32u, range.begin);
+  CHECK_EQUAL(48u, range.end);
+  CHECK_EQUAL(16u, range.GetSize());
+  range = binding.GetUsedRange(0, 16);
+  CHECK(range.IsEmpty());
+  CHECK_EQUAL(0u, range.GetSize());
+}
@@ -0,0 +1,138 @@
+﻿#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "UnitTest.h"
+#include "DeferredReleaseQueue.h"
+
+namespace
+{
+  // D3D12 のフェンスの代わり. Signal した値を GPU が順に完了させる.
+  struct FakeFence
+  {
+    uint64_t nextValue = 1;
+    uint64_t completedValue = 0;
+    uint64_t Signal() { return nextValue++; }
+    void Complete(uint64_t value) { completedValue = value; }
+  };
+
+  // 解放された順番を記録する.
+  struct ReleaseLog
+  {
+    std::vector<int> released;
+    DeferredReleaseQueue::ReleaseFunc Make(int id)
+    {
+      return [this, id]() { released.push_back(id); };
+    }
+  };
+}
+
+TEST_CASE("DeferredReleaseQueue/CollectsOnlyCompletedValues")
+{
+  FakeFence fence;
+  ReleaseLog log;
+  DeferredReleaseQueue queue;
+  auto first = fence.Signal();
+  auto second = fence.Signal();
+  queue.Enqueue(first, log.Make(1));
+  queue.Enqueue(second, log.Make(2));
+  CHECK_EQUAL(size_t(2), queue.GetPendingCount());
+
+  // 完了前は何も解放しない.
+  CHECK_EQUAL(size_t(0), queue.Collect(fence.completedValue));
+  CHECK(log.released.empty());
+
+  // 完了した値ちょうどまでを解放する.
+  fence.Complete(first);
+  CHECK_EQUAL(size_t(1), queue.Collect(fence.completedValue));
+  CHECK(log.released == std::vector<int>({ 1 }));
+  CHECK_EQUAL(size_t(1), queue.GetPendingCount());
+
+  // 後から先の値まで完了しても、まとめて解放する.
+  fence.Complete(second + 10);
+  CHECK_EQUAL(size_t(1), queue.Collect(fence.completedValue));
+  CHECK(log.released == std::vector<int>({ 1, 2 }));
+  CHECK_EQUAL(size_t(0), queue.GetPendingCount());
+  CHECK_EQUAL(uint64_t(2), queue.GetReleasedCount());
+}
+
+TEST_CASE("DeferredReleaseQueue/OutOfOrderEnqueueReleasedByValue")
+{
+  // 別のキューのフェンス値などで昇順に積まれなくても、値の順に解放する. 同じ値は積んだ順.
+  ReleaseLog log;
+  DeferredReleaseQueue queue;
+  queue.Enqueue(5, log.Make(5));
+  queue.Enqueue(2, log.Make(2));
+  queue.Enqueue(8, log.Make(8));
+  queue.Enqueue(2, log.Make(3));
+  queue.Enqueue(1, log.Make(1));
+
+  CHECK_EQUAL(size_t(3), queue.Collect(2));
+  CHECK(log.released == std::vector<int>({ 1, 2, 3 }));
+  CHECK_EQUAL(size_t(1), queue.Collect(7));
+  CHECK(log.released == std::vector<int>({ 1, 2, 3, 5 }));
+  CHECK_EQUAL(size_t(1), queue.Collect(8));
+  CHECK(log.released == std::vector<int>({ 1, 2, 3, 5, 8 }));
+}
+
+TEST_CASE("DeferredReleaseQueue/EnqueueFromReleaseCallback")
+{
+  // 解放処理の中で次の解放を積んでも、取りこぼしや二重の解放が起きない.
+  ReleaseLog log;
+  DeferredReleaseQueue queue;
+  queue.Enqueue(1, [&]() {
+    log.released.push_back(1);
+    // 完了済みの値で積んだものは次の Collect で解放する.
+    queue.Enqueue(1, log.Make(10));
+    queue.Enqueue(3, log.Make(30));
+  });
+  CHECK_EQUAL(size_t(1), queue.Collect(1));
+  CHECK(log.released == std::vector<int>({ 1 }));
+  CHECK_EQUAL(size_t(2), queue.GetPendingCount());
+
+  CHECK_EQUAL(size_t(1), queue.Collect(2));
+  CHECK(log.released == std::vector<int>({ 1, 10 }));
+  CHECK_EQUAL(size_t(1), queue.Collect(3));
+  CHECK(log.released == std::vector<int>({ 1, 10, 30 }));
+}
+
+TEST_CASE("DeferredReleaseQueue/ReleaseAllRunsNestedEnqueues")
+{
+  // 終了時は未完了のものも全て解放する. 解放の中で積まれたものも残さない.
+  ReleaseLog log;
+  DeferredReleaseQueue queue;
+  queue.Enqueue(100, log.Make(1));
+  queue.Enqueue(200, [&]() {
+    log.released.push_back(2);
+    queue.Enqueue(300, log.Make(3));
+  });
+  CHECK_EQUAL(size_t(3), queue.ReleaseAll());
+  CHECK(log.released == std::vector<int>({ 1, 2, 3 }));
+  CHECK_EQUAL(size_t(0), queue.GetPendingCount());
+  CHECK_EQUAL(size_t(0), queue.ReleaseAll());
+}
+
+TEST_CASE("DeferredReleaseQueue/DestructorReleasesPending")
+{
+  // リソースの代わりに shared_ptr の参照を持たせ、破棄で手放されることを確かめる.
+  auto resource = std::make_shared<int>(42);
+  std::weak_ptr<int> weak = resource;
+  ReleaseLog log;
+  {
+    DeferredReleaseQueue queue;
+    queue.Enqueue(10, [resource, &log]() { log.released.push_back(*resource); });
+    resource.reset();
+    CHECK(!weak.expired());
+  }
+  CHECK(log.released == std::vector<int>({ 42 }));
+  CHECK(weak.expired());
+}
+
+TEST_CASE("DeferredReleaseQueue/EmptyFunctionCounted")
+{
+  // 空の関数は呼ばずに解放済みとして数える.
+  DeferredReleaseQueue queue;
+  queue.Enqueue(1, DeferredReleaseQueue::ReleaseFunc());
+  CHECK_EQUAL(size_t(1), queue.Collect(1));
+  CHECK_EQUAL(uint64_t(1), queue.GetReleasedCount());
+}
@@ -0,0 +1,231 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "DescriptorAllocator.h"
+
+namespace
+{
+  // ヒープの代わりに、位置からハンドルのアドレスを作って重なりを確かめる.
+  struct FakeDescriptorHeap
+  {
+    enum : uint64_t { HeapStart = 0x10000, IncrementSize = 32 };
+    explicit FakeDescriptorHeap(uint32_t capacity) : owner(capacity, -1) { }
+
+    static uint64_t GetHandle(uint32_t index) { return HeapStart + uint64_t(index) * IncrementSize; }
+    static uint32_t GetIndex(uint64_t handle) { return uint32_t((handle - HeapStart) / IncrementSize); }
+
+    // 範囲を所有者 id で埋める. 既に誰かのものであれば false.
+    bool Claim(uint64_t handle, uint32_t count, int id)
+    {
+      auto index = GetIndex(handle);
+      if (index + count > owner.size())
+        return false;
+      for (uint32_t i = index; i < index + count; ++i)
+      {
+        if (owner[i] != -1)
+          return false;
+        owner[i] = id;
+      }
+      return true;
+    }
+    void Release(uint64_t handle, uint32_t count)
+    {
+      auto index = GetIndex(handle);
+      std::fill(owner.begin() + index, owner.begin() + index + count, -1);
+    }
+    std::vector<int> owner;
+  };
+
+  // 空き範囲の最大長をビットから数え直す.
+  uint32_t CountLargestFreeRange(const DescriptorAllocator& allocator)
+  {
+    uint32_t run = 0, largest = 0;
+    for (uint32_t i = 0; i < allocator.GetCapacity(); ++i)
+    {
+      run = allocator.IsAllocated(i) ? 0 : run + 1;
+      largest = std::max(largest, run);
+    }
+    return largest;
+  }
+}
+
+TEST_CASE("DescriptorAllocator/AllocateUntilExhausted")
+{
+  DescriptorAllocator allocator(100);
+  std::vector<bool> isUsed(100, false);
+  for (int i = 0; i < 100; ++i)
+  {
+    auto index = allocator.Allocate();
+    CHECK(index < 100);
+    CHECK(!isUsed[index]);
+    isUsed[index] = true;
+  }
+  CHECK_EQUAL(DescriptorAllocator::InvalidIndex, allocator.Allocate());
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(100u, stats.used);
+  CHECK_EQUAL(100u, stats.peakUsed);
+  CHECK_EQUAL(1u, stats.failedCount);
+  CHECK_EQUAL(0u, stats.largestFreeRange);
+  CHECK_EQUAL(0u, stats.freeRangeCount);
+}
+
+TEST_CASE("DescriptorAllocator/RangeAndCoalesce")
+{
+  DescriptorAllocator allocator(64);
+  auto a = allocator.AllocateRange(16);
+  auto b = allocator.AllocateRange(16);
+  auto c = allocator.AllocateRange(32);
+  CHECK(a != DescriptorAllocator::InvalidIndex);
+  CHECK(b != DescriptorAllocator::InvalidIndex);
+  CHECK(c != DescriptorAllocator::InvalidIndex);
+  CHECK_EQUAL(DescriptorAllocator::InvalidIndex, allocator.AllocateRange(1));
+
+  // 間を空けても、隣同士を戻せば1つの範囲になる.
+  allocator.Free(a, 16);
+  allocator.Free(c, 32);
+  CHECK_EQUAL(2u, allocator.GetStats().freeRangeCount);
+  CHECK_EQUAL(DescriptorAllocator::InvalidIndex, allocator.AllocateRange(33));
+  allocator.Free(b, 16);
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(1u, stats.freeRangeCount);
+  CHECK_EQUAL(64u, stats.largestFreeRange);
+  CHECK_EQUAL(0u, stats.used);
+  CHECK_EQUAL(0u, allocator.AllocateRange(64));
+}
+
+TEST_CASE("DescriptorAllocator/NonPowerOfTwoFit")
+{
+  // 2 の冪でない大きさでも、ちょうど収まる範囲があれば使う.
+  DescriptorAllocator allocator(101);
+  CHECK_EQUAL(0u, allocator.AllocateRange(101));
+  allocator.Free(0, 101);
+
+  auto a = allocator.AllocateRange(3);
+  auto b = allocator.AllocateRange(5);
+  auto rest = allocator.AllocateRange(101 - 8);
+  CHECK(rest != DescriptorAllocator::InvalidIndex);
+  allocator.Free(b, 5);
+  // 空きは 5 の範囲のみ. 5 は [4, 8) のクラスに入るため、リストを辿って見つける.
+  CHECK_EQUAL(b, allocator.AllocateRange(5));
+  allocator.Free(a, 3);
+  CHECK_EQUAL(a, allocator.AllocateRange(3));
+}
+
+TEST_CASE("DescriptorAllocator/InvalidFree")
+{
+#if defined(NDEBUG)
+  // assert が無効な構成では、無視して数えるだけで使用数は変わらない.
+  DescriptorAllocator allocator(16);
+  auto a = allocator.AllocateRange(4);
+  allocator.Free(a, 4);
+  allocator.Free(a, 4);     // 二重の解放.
+  allocator.Free(12, 8);    // 範囲外.
+  allocator.Free(0xFFFFFFF0u, 32);
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(0u, stats.used);
+  CHECK_EQUAL(3u, stats.invalidFreeCount);
+  CHECK_EQUAL(16u, stats.largestFreeRange);
+#else
+  std::printf("  skipped (assert is enabled)\n");
+#endif
+}
+
+TEST_CASE("DescriptorAllocator/StressAgainstFakeHeap")
+{
+  const uint32_t capacity = 2048;
+  DescriptorAllocator allocator(capacity);
+  FakeDescriptorHeap heap(capacity);
+  struct Live { uint64_t handle; uint32_t count; };
+  std::vector<Live> live;
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<uint32_t> sizeDist(1, 40);
+  uint32_t used = 0;
+
+  for (int step = 0; step < 200000; ++step)
+  {
+    const bool isAlloc = live.empty() || (rng() % 100) < 55;
+    if (isAlloc)
+    {
+      auto count = (rng() % 4 == 0) ? sizeDist(rng) : 1u;
+      auto index = allocator.AllocateRange(count);
+      if (index == DescriptorAllocator::InvalidIndex)
+      {
+        // 確保できないのは、本当に収まる範囲が無い場合のみ.
+        CHECK(CountLargestFreeRange(allocator) < count);
+        continue;
+      }
+      auto handle = FakeDescriptorHeap::GetHandle(index);
+      CHECK(heap.Claim(handle, count, step));
+      live.push_back(Live{ handle, count });
+      used += count;
+    }
+    else
+    {
+      auto pick = rng() % live.size();
+      heap.Release(live[pick].handle, live[pick].count);
+      allocator.Free(FakeDescriptorHeap::GetIndex(live[pick].handle), live[pick].count);
+      used -= live[pick].count;
+      live[pick] = live.back();
+      live.pop_back();
+    }
+    if (step % 1000 == 0)
+    {
+      auto stats = allocator.GetStats();
+      CHECK_EQUAL(used, stats.used);
+      CHECK_EQUAL(CountLargestFreeRange(allocator), stats.largestFreeRange);
+    }
+  }
+  for (const auto& l : live)
+  {
+    allocator.Free(FakeDescriptorHeap::GetIndex(l.handle), l.count);
+  }
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(0u, stats.used);
+  CHECK_EQUAL(1u, stats.freeRangeCount);
+  CHECK_EQUAL(capacity, stats.largestFreeRange);
+  CHECK_EQUAL(0u, stats.invalidFreeCount);
+}
+
+BENCHMARK_CASE("DescriptorAllocator/ChurnAtHighOccupancy")
+{
+  // 9 割を埋めた状態で、単体とテーブル用の範囲の確保と解放を繰り返す.
+  const uint32_t capacity = 65536;
+  DescriptorAllocator allocator(capacity);
+  struct Live { uint32_t index; uint32_t count; };
+  std::vector<Live> live;
+  std::mt19937 rng(42);
+  uint32_t used = 0;
+  while (used < capacity * 9 / 10)
+  {
+    uint32_t count = (rng() % 4 == 0) ? uint32_t(1 + rng() % 16) : 1u;
+    auto index = allocator.AllocateRange(count);
+    if (index == DescriptorAllocator::InvalidIndex)
+      break;
+    live.push_back(Live{ index, count });
+    used += count;
+  }
+  const int iterations = 1000000;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    auto pick = rng() % live.size();
+    allocator.Free(live[pick].index, live[pick].count);
+    uint32_t count = (rng() % 4 == 0) ? uint32_t(1 + rng() % 16) : 1u;
+    auto index = allocator.AllocateRange(count);
+    if (index == DescriptorAllocator::InvalidIndex)
+    {
+      live[pick] = live.back();
+      live.pop_back();
+      continue;
+    }
+    live[pick] = Live{ index, count };
+  }
+  auto ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  auto stats = allocator.GetStats();
+  std::printf("  %d free+alloc pairs: %.1f ns/pair, used=%u/%u freeRanges=%u failed=%u\n",
+    iterations, ms * 1.0e6 / iterations, stats.used, stats.capacity, stats.freeRangeCount, stats.failedCount);
+}
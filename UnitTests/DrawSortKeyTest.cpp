@@ -0,0 +1,170 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "DrawSortKey.h"
+
+namespace
+{
+  // 描画パケットを想定したキー (少ないパスとパイプライン、多めのマテリアル、ばらばらの深度).
+  std::vector<DrawSortItem> MakeItems(uint32_t count, uint32_t seed)
+  {
+    std::mt19937 random(seed);
+    std::vector<DrawSortItem> items(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      items[i].key = DrawKey::Make(random() % 4, 0, random() % 32, random() % 1024, random() & 0xFFFF);
+      items[i].index = i;
+    }
+    return items;
+  }
+
+  void StableSortItems(std::vector<DrawSortItem>& items)
+  {
+    std::stable_sort(items.begin(), items.end(),
+      [](const DrawSortItem& a, const DrawSortItem& b) { return a.key < b.key; });
+  }
+
+  bool IsSameOrder(const std::vector<DrawSortItem>& a, const std::vector<DrawSortItem>& b)
+  {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+      [](const DrawSortItem& x, const DrawSortItem& y) { return x.key == y.key && x.index == y.index; });
+  }
+
+  // DrawIdTable はポインタを比べるだけのため、配列の要素をオブジェクトの代わりにする.
+  struct FakePipeline
+  {
+    int value;
+  };
+}
+
+TEST_CASE("DrawSortKey/FieldsMaskedAndOrdered")
+{
+  // 上位のフィールドほど順序に効き、幅を超えた値は切り捨てる.
+  CHECK(DrawKey::Make(1, 0, 0, 0, 0) > DrawKey::Make(0, 4095, 4095, 0xFFFFF, 0xFFFF));
+  CHECK(DrawKey::Make(0, 1, 0, 0, 0) > DrawKey::Make(0, 0, 4095, 0xFFFFF, 0xFFFF));
+  CHECK(DrawKey::Make(0, 0, 1, 0, 0) > DrawKey::Make(0, 0, 0, 0xFFFFF, 0xFFFF));
+  CHECK_EQUAL(DrawKey::Make(0, 0, 0, 0, 0), DrawKey::Make(16, 4096, 4096, 0x100000, 0x10000));
+  CHECK_EQUAL(3u, DrawKey::GetPass(DrawKey::Make(3, 5, 6, 7, 8)));
+
+  // パスの範囲にはそのパスの全てのキーが入る.
+  auto key = DrawKey::Make(2, 4095, 4095, 0xFFFFF, 0xFFFF);
+  CHECK(DrawKey::GetPassBegin(2) <= key && key <= DrawKey::GetPassEnd(2));
+  CHECK(DrawKey::GetPassEnd(1) < DrawKey::Make(2, 0, 0, 0, 0));
+}
+
+TEST_CASE("DrawSortKey/DepthBucketClampsToRange")
+{
+  CHECK_EQUAL(0u, DrawKey::MakeDepthBucket(0.05f, 0.1f, 100.0f));
+  CHECK_EQUAL(0xFFFFu, DrawKey::MakeDepthBucket(150.0f, 0.1f, 100.0f));
+  CHECK(DrawKey::MakeDepthBucket(10.0f, 0.1f, 100.0f) < DrawKey::MakeDepthBucket(20.0f, 0.1f, 100.0f));
+  // ライトの射影後の z のように 0 から 1 の範囲でも使える.
+  CHECK(DrawKey::MakeDepthBucket(0.25f, 0.0f, 1.0f) < DrawKey::MakeDepthBucket(0.5f, 0.0f, 1.0f));
+  // 範囲が壊れていても端にまとめる.
+  CHECK_EQUAL(0u, DrawKey::MakeDepthBucket(1.0f, 1.0f, 1.0f));
+}
+
+TEST_CASE("DrawSortKey/RadixMatchesStableSort")
+{
+  std::vector<DrawSortItem> scratch;
+  const uint32_t counts[] = { 0, 1, 2, 3, 255, 256, 1000, 20000 };
+  for (auto count : counts)
+  {
+    auto items = MakeItems(count, count + 1);
+    auto expected = items;
+    StableSortItems(expected);
+    RadixSortDrawItems(items, scratch);
+    CHECK(IsSameOrder(expected, items));
+  }
+
+  // 1 桁以外が全て同じ場合も、飛ばした桁の後で元の配列へ戻す.
+  std::vector<DrawSortItem> items;
+  for (uint32_t i = 0; i < 500; ++i)
+  {
+    items.push_back(DrawSortItem{ DrawKey::Make(1, 0, 0, 0, (i * 37) & 0xFF), i });
+  }
+  auto expected = items;
+  StableSortItems(expected);
+  RadixSortDrawItems(items, scratch);
+  CHECK(IsSameOrder(expected, items));
+}
+
+TEST_CASE("DrawSortKey/IdTableKeepsIdsWhileUsed")
+{
+  FakePipeline pipelines[3] = {};
+  DrawIdTable<FakePipeline> table;
+  auto a = table.Get(&pipelines[0]);
+  auto b = table.Get(&pipelines[1]);
+  CHECK(a != b);
+  CHECK_EQUAL(a, table.Get(&pipelines[0]));
+  // 毎フレーム使う間は同じ番号.
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    table.NextFrame();
+    CHECK_EQUAL(a, table.Get(&pipelines[0]));
+    CHECK_EQUAL(b, table.Get(&pipelines[1]));
+  }
+  CHECK_EQUAL(size_t(2), table.GetSize());
+
+  // 使われなくなったものは次のフレームで外れ、その番号を次のものが使う.
+  table.NextFrame();
+  CHECK_EQUAL(a, table.Get(&pipelines[0]));
+  table.NextFrame();
+  CHECK_EQUAL(size_t(1), table.GetSize());
+  CHECK_EQUAL(b, table.Get(&pipelines[2]));
+}
+
+TEST_CASE("DrawSortKey/IdTableBoundedAcrossReloads")
+{
+  // ホットリロードで毎フレーム新しいパイプラインに差し替わっても、表と番号は増え続けない.
+  std::vector<FakePipeline> pipelines(5000);
+  DrawIdTable<FakePipeline> table;
+  auto shadow = table.Get(&pipelines[0]);
+  uint32_t maxId = 0;
+  for (size_t frame = 1; frame < pipelines.size(); ++frame)
+  {
+    table.NextFrame();
+    CHECK_EQUAL(shadow, table.Get(&pipelines[0]));
+    maxId = (std::max)(maxId, table.Get(&pipelines[frame]));
+  }
+  // 直前のフレームで使ったものは次の NextFrame まで残る.
+  CHECK_EQUAL(size_t(3), table.GetSize());
+  CHECK(maxId < 3u);
+}
+
+BENCHMARK_CASE("DrawSortKey/RadixVsStableSort")
+{
+  // 10, 11 で最大の描画回数 (512 体, 1 体 17 サブメッシュ, 3 パス) 程度から 10 万個まで.
+  const uint32_t counts[] = { 1000, 26112, 100000 };
+  const int repeatCount = 20;
+  using clock = std::chrono::high_resolution_clock;
+  for (auto count : counts)
+  {
+    const auto source = MakeItems(count, 1);
+    std::vector<DrawSortItem> items, scratch;
+    scratch.reserve(count);
+
+    double radixMs = 0.0, stableMs = 0.0;
+    for (int i = 0; i < repeatCount; ++i)
+    {
+      items = source;
+      auto start = clock::now();
+      RadixSortDrawItems(items, scratch);
+      radixMs += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+    auto radixResult = items;
+    for (int i = 0; i < repeatCount; ++i)
+    {
+      items = source;
+      auto start = clock::now();
+      StableSortItems(items);
+      stableMs += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+    CHECK(IsSameOrder(items, radixResult));
+    std::printf("  %6u keys: radix %.3f ms, stable_sort %.3f ms (x%.2f)\n",
+      count, radixMs / repeatCount, stableMs / repeatCount, stableMs / radixMs);
+  }
+}
@@ -0,0 +1,169 @@
+﻿#include <memory>
+#include <vector>
+
+#include "UnitTest.h"
+#include "FencedPool.h"
+
+namespace
+{
+  // コマンドアロケータの代わり. GPU が使用中のままリセットされたかを記録する.
+  struct FakeAllocator
+  {
+    int id;
+    int resetCount;
+    uint64_t usedUntil;   // このフェンス値が完了するまで GPU が参照する.
+    bool isResetWhileInUse;
+  };
+  using AllocatorPtr = std::shared_ptr<FakeAllocator>;
+
+  // D3D12AppBase のフェンスの進み方を真似る. frameCount だけ先行して記録できる.
+  struct FakeQueue
+  {
+    uint64_t nextFrame = 1;
+    uint64_t completed = 0;
+    void Present(uint64_t frameLatency)
+    {
+      ++nextFrame;
+      if (nextFrame > frameLatency + 1)
+      {
+        completed = nextFrame - frameLatency - 1;
+      }
+    }
+  };
+
+  struct ReloadSimulation
+  {
+    FencedPool<AllocatorPtr> pool;
+    FakeQueue queue;
+    int nextId = 0;
+
+    AllocatorPtr Acquire()
+    {
+      auto completed = queue.completed;
+      return pool.Acquire(completed,
+        [&]() { return std::make_shared<FakeAllocator>(FakeAllocator{ nextId++, 0, 0, false }); },
+        [&](AllocatorPtr& a) {
+          if (a->usedUntil > completed)
+            a->isResetWhileInUse = true;
+          ++a->resetCount;
+        });
+    }
+    // ModelInstance::ReleaseBundles と同じく、記録中のフレームが終わるまで預ける.
+    void Retire(AllocatorPtr a)
+    {
+      pool.Release(a, queue.nextFrame);
+    }
+  };
+}
+
+TEST_CASE("FencedPool/ResetsOnlyAfterTicketCompletes")
+{
+  FencedPool<int> pool;
+  std::vector<int> resets;
+  int next = 100;
+  auto create = [&]() { return next++; };
+  auto reset = [&](int& v) { resets.push_back(v); };
+
+  auto a = pool.Acquire(0, create, reset);
+  auto b = pool.Acquire(0, create, reset);
+  CHECK_EQUAL(100, a);
+  CHECK_EQUAL(101, b);
+  pool.Release(a, 5);
+  pool.Release(b, 6);
+  CHECK_EQUAL(size_t(2), pool.GetPendingCount());
+
+  // どちらも未完了なら新しく作る.
+  auto c = pool.Acquire(4, create, reset);
+  CHECK_EQUAL(102, c);
+  CHECK(resets.empty());
+
+  // 5 まで完了すれば a だけを回収する.
+  auto d = pool.Acquire(5, create, reset);
+  CHECK_EQUAL(100, d);
+  CHECK_EQUAL(size_t(1), resets.size());
+  CHECK_EQUAL(size_t(1), pool.GetPendingCount());
+  CHECK_EQUAL(size_t(3), pool.GetCreatedCount());
+
+  pool.Clear();
+  CHECK_EQUAL(size_t(0), pool.GetPendingCount());
+  CHECK_EQUAL(size_t(0), pool.GetFreeCount());
+}
+
+TEST_CASE("FencedPool/ReloadEveryFrameStaysBounded")
+{
+  // ホットリロードが毎フレーム起きた場合. 作られるアロケータは同時に参照され得る数(遅延 + 1)に収まる.
+  const uint64_t frameLatency = 2;
+  ReloadSimulation sim;
+  auto current = sim.Acquire();
+  std::vector<AllocatorPtr> all{ current };
+  for (int frame = 0; frame < 1000; ++frame)
+  {
+    // 古いバンドルを返してから作り直す.
+    sim.Retire(current);
+    current = sim.Acquire();
+    // 新しいバンドルをこのフレームで使う.
+    current->usedUntil = sim.queue.nextFrame;
+    all.push_back(current);
+    sim.queue.Present(frameLatency);
+  }
+  CHECK(sim.pool.GetCreatedCount() <= size_t(frameLatency + 2));
+  for (auto& a : all)
+    CHECK(!a->isResetWhileInUse);
+  // 再利用されたものは作り直しの度にリセットされている.
+  CHECK(current->resetCount > 0);
+}
+
+TEST_CASE("FencedPool/SparseReloadsReuseOneAllocator")
+{
+  // 通常はリロードの間に十分フレームが進むため、同じアロケータを使い回す.
+  const uint64_t frameLatency = 2;
+  ReloadSimulation sim;
+  auto current = sim.Acquire();
+  for (int reload = 0; reload < 100; ++reload)
+  {
+    for (int frame = 0; frame < 10; ++frame)
+    {
+      current->usedUntil = sim.queue.nextFrame;
+      sim.queue.Present(frameLatency);
+    }
+    sim.Retire(current);
+    current = sim.Acquire();
+    CHECK(!current->isResetWhileInUse);
+  }
+  // 預けているのは直前に返した1つだけ.
+  CHECK(sim.pool.GetCreatedCount() <= size_t(2));
+  CHECK_EQUAL(size_t(1), sim.pool.GetPendingCount());
+}
+
+TEST_CASE("FencedPool/ManyInstancesShareThePool")
+{
+  // 複数のインスタンスが同じフレームでリロードしても、返した順に回収される.
+  const uint64_t frameLatency = 2;
+  const int instanceCount = 8;
+  ReloadSimulation sim;
+  std::vector<AllocatorPtr> current;
+  std::vector<AllocatorPtr> all;
+  for (int i = 0; i < instanceCount; ++i)
+  {
+    current.push_back(sim.Acquire());
+    all.push_back(current.back());
+  }
+  for (int frame = 0; frame < 300; ++frame)
+  {
+    if (frame % 3 == 0)
+    {
+      for (auto& a : current)
+      {
+        sim.Retire(a);
+        a = sim.Acquire();
+        all.push_back(a);
+      }
+    }
+    for (auto& a : current)
+      a->usedUntil = sim.queue.nextFrame;
+    sim.queue.Present(frameLatency);
+  }
+  CHECK(sim.pool.GetCreatedCount() <= size_t(instanceCount * 2));
+  for (auto& a : all)
+    CHECK(!a->isResetWhileInUse);
+}
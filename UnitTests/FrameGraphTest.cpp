@@ -0,0 +1,279 @@
+﻿#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "FrameGraph.h"
+
+namespace
+{
+  enum : uint32_t
+  {
+    FORMAT_R8G8B8A8_UNORM = 28,   // DXGI_FORMAT の値. FrameGraph は中身を解釈しない.
+    FORMAT_D32_FLOAT = 40,
+  };
+
+  // GetResourceAllocationInfo の代わり. 1 ピクセル 4 バイトとし、D3D12 と同じく MSAA は 4MB、それ以外は 64KB に揃える.
+  FrameGraph::SizeInfo GetSizeInfo(const FrameGraph::TextureDesc& desc, uint32_t)
+  {
+    const uint64_t samples = desc.sampleCount > 0 ? desc.sampleCount : 1;
+    return FrameGraph::SizeInfo{ uint64_t(desc.width) * desc.height * 4 * samples, samples > 1 ? 4u << 20 : 64u << 10 };
+  }
+
+  FrameGraph::TextureDesc MakeDesc(uint32_t width, uint32_t height, uint32_t format, uint32_t sampleCount = 1)
+  {
+    return FrameGraph::TextureDesc{ width, height, format, sampleCount, { 0.0f, 0.0f, 0.0f, 0.0f } };
+  }
+
+  const FrameGraph::CompiledPass* FindPass(const FrameGraph::CompileResult& result, FrameGraph::PassId pass)
+  {
+    for (const auto& compiled : result.passes)
+    {
+      if (compiled.pass == pass)
+        return &compiled;
+    }
+    return nullptr;
+  }
+
+  bool HasTransition(const std::vector<FrameGraph::Barrier>& barriers, FrameGraph::ResourceId resource, uint32_t before, uint32_t after)
+  {
+    for (const auto& barrier : barriers)
+    {
+      if (barrier.type == FrameGraph::Barrier::TYPE_TRANSITION && barrier.resource == resource &&
+        barrier.before == before && barrier.after == after)
+        return true;
+    }
+    return false;
+  }
+
+  // 使用期間が重なる一時テクスチャ同士が、ヒープ内で重ならないこと.
+  bool IsPlacementValid(const FrameGraph& graph, const FrameGraph::CompileResult& result)
+  {
+    for (FrameGraph::ResourceId a = 0; a < graph.GetResourceCount(); ++a)
+    {
+      const auto& ra = result.resources[a];
+      if (graph.IsImported(a) || !ra.isUsed)
+        continue;
+      if (ra.heapOffset + ra.size > result.heapSize)
+        return false;
+      for (FrameGraph::ResourceId b = a + 1; b < graph.GetResourceCount(); ++b)
+      {
+        const auto& rb = result.resources[b];
+        if (graph.IsImported(b) || !rb.isUsed)
+          continue;
+        bool isLifetimeOverlapped = ra.firstPass <= rb.lastPass && rb.firstPass <= ra.lastPass;
+        bool isMemoryOverlapped = ra.heapOffset < rb.heapOffset + rb.size && rb.heapOffset < ra.heapOffset + ra.size;
+        if (isLifetimeOverlapped && isMemoryOverlapped)
+          return false;
+      }
+    }
+    return true;
+  }
+}
+
+TEST_CASE("FrameGraph/CullsPassesWithoutOutput")
+{
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto unused = graph.CreateTexture("Unused", MakeDesc(256, 256, FORMAT_R8G8B8A8_UNORM));
+  auto scene = graph.CreateTexture("Scene", MakeDesc(256, 256, FORMAT_R8G8B8A8_UNORM));
+
+  auto unusedPass = graph.AddPass("Unused", nullptr);
+  graph.Write(unusedPass, unused, FrameGraph::USAGE_RENDER_TARGET);
+  auto scenePass = graph.AddPass("Scene", nullptr);
+  graph.Write(scenePass, scene, FrameGraph::USAGE_RENDER_TARGET);
+  auto sideEffectPass = graph.AddPass("Readback", nullptr);
+  graph.SetSideEffect(sideEffectPass);
+  auto mainPass = graph.AddPass("Main", nullptr);
+  graph.Read(mainPass, scene, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  graph.Write(mainPass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+
+  const auto& result = graph.Compile(GetSizeInfo);
+  CHECK_EQUAL(4u, result.stats.declaredPassCount);
+  CHECK_EQUAL(1u, result.stats.culledPassCount);
+  CHECK(FindPass(result, unusedPass) == nullptr);
+  CHECK(FindPass(result, scenePass) != nullptr);
+  CHECK(FindPass(result, sideEffectPass) != nullptr);
+  CHECK(FindPass(result, mainPass) != nullptr);
+  // 除去したパスだけが使うテクスチャは確保しない.
+  CHECK(!result.resources[unused].isUsed);
+  CHECK_EQUAL(1u, result.stats.transientCount);
+}
+
+TEST_CASE("FrameGraph/ImportedTextureReturnsToFinalUsage")
+{
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto pass = graph.AddPass("Main", nullptr);
+  graph.Write(pass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+  auto uiPass = graph.AddPass("ImGui", nullptr);
+  graph.Write(uiPass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+
+  const auto& result = graph.Compile(GetSizeInfo);
+  CHECK_EQUAL(size_t(2), result.passes.size());
+  CHECK(HasTransition(result.passes[0].barriers, backBuffer, FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_RENDER_TARGET));
+  // 同じステートが続くパスにはバリアを出さない.
+  CHECK(result.passes[1].barriers.empty());
+  CHECK_EQUAL(size_t(1), result.finalBarriers.size());
+  CHECK(HasTransition(result.finalBarriers, backBuffer, FrameGraph::USAGE_RENDER_TARGET, FrameGraph::USAGE_PRESENT));
+  CHECK_EQUAL(2u, result.stats.transitionCount);
+  CHECK_EQUAL(2u, result.stats.barrierBatchCount);
+}
+
+TEST_CASE("FrameGraph/ConsecutiveReadsMergedIntoOneTransition")
+{
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto shadow = graph.CreateTexture("Shadow", MakeDesc(1024, 1024, FORMAT_D32_FLOAT));
+
+  auto shadowPass = graph.AddPass("Shadow", nullptr);
+  graph.Write(shadowPass, shadow, FrameGraph::USAGE_DEPTH_WRITE);
+  auto readPass1 = graph.AddPass("Lighting", nullptr);
+  graph.Read(readPass1, shadow, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  graph.Write(readPass1, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+  auto readPass2 = graph.AddPass("Particles", nullptr);
+  graph.Read(readPass2, shadow, FrameGraph::USAGE_NON_PIXEL_SHADER_RESOURCE);
+  graph.Write(readPass2, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+
+  const auto& result = graph.Compile(GetSizeInfo);
+  const uint32_t merged = FrameGraph::USAGE_PIXEL_SHADER_RESOURCE | FrameGraph::USAGE_NON_PIXEL_SHADER_RESOURCE;
+  // 2つの読み取りは最初の読み取りの前の1回の遷移で済ませる.
+  CHECK(HasTransition(result.passes[1].barriers, shadow, FrameGraph::USAGE_DEPTH_WRITE, merged));
+  for (const auto& barrier : result.passes[2].barriers)
+    CHECK(barrier.resource != shadow);
+  // 一時テクスチャはフレーム終了時のステートから始まり、先頭のパスで書き込みへ戻す.
+  CHECK_EQUAL(merged, result.resources[shadow].startUsage);
+  CHECK(HasTransition(result.passes[0].barriers, shadow, merged, FrameGraph::USAGE_DEPTH_WRITE));
+}
+
+TEST_CASE("FrameGraph/UavBarrierBetweenWrites")
+{
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto buffer = graph.CreateTexture("Work", MakeDesc(64, 64, FORMAT_R8G8B8A8_UNORM));
+  auto pass1 = graph.AddPass("Compute1", nullptr);
+  graph.Write(pass1, buffer, FrameGraph::USAGE_UNORDERED_ACCESS);
+  auto pass2 = graph.AddPass("Compute2", nullptr);
+  graph.Write(pass2, buffer, FrameGraph::USAGE_UNORDERED_ACCESS);
+  auto mainPass = graph.AddPass("Main", nullptr);
+  graph.Read(mainPass, buffer, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  graph.Write(mainPass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+
+  const auto& result = graph.Compile(GetSizeInfo);
+  // 最初の書き込みは前の内容を使わないため UAV バリアは不要. 2回目の書き込みの前にだけ出す.
+  CHECK_EQUAL(1u, result.stats.uavCount);
+  bool hasUav = false;
+  for (const auto& barrier : result.passes[1].barriers)
+    hasUav |= barrier.type == FrameGraph::Barrier::TYPE_UAV && barrier.resource == buffer;
+  CHECK(hasUav);
+}
+
+TEST_CASE("FrameGraph/SampleMSAAGraphAliasesTeapotDepth")
+{
+  // 12_SampleMSAA と同じ構成. teapot のデプスは teapot のパスでしか使わないため、
+  // 後のパスで使う MSAA のカラーと同じ領域に置かれる.
+  const uint32_t width = 1280, height = 720;
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto teapotColor = graph.CreateTexture("TeapotColor", MakeDesc(512, 512, FORMAT_R8G8B8A8_UNORM));
+  auto teapotDepth = graph.CreateTexture("TeapotDepth", MakeDesc(512, 512, FORMAT_D32_FLOAT));
+  auto msaaColor = graph.CreateTexture("MsaaColor", MakeDesc(width, height, FORMAT_R8G8B8A8_UNORM, 4));
+  auto msaaDepth = graph.CreateTexture("MsaaDepth", MakeDesc(width, height, FORMAT_D32_FLOAT, 4));
+
+  auto teapotPass = graph.AddPass("Teapot", nullptr);
+  graph.Write(teapotPass, teapotColor, FrameGraph::USAGE_RENDER_TARGET);
+  graph.Write(teapotPass, teapotDepth, FrameGraph::USAGE_DEPTH_WRITE);
+  auto msaaPass = graph.AddPass("MSAA", nullptr);
+  graph.Read(msaaPass, teapotColor, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  graph.Write(msaaPass, msaaColor, FrameGraph::USAGE_RENDER_TARGET);
+  graph.Write(msaaPass, msaaDepth, FrameGraph::USAGE_DEPTH_WRITE);
+  auto resolvePass = graph.AddPass("Resolve", nullptr);
+  graph.Read(resolvePass, msaaColor, FrameGraph::USAGE_RESOLVE_SOURCE);
+  graph.Write(resolvePass, backBuffer, FrameGraph::USAGE_RESOLVE_DEST);
+
+  const auto& result = graph.Compile(GetSizeInfo);
+  CHECK_EQUAL(size_t(3), result.passes.size());
+  CHECK_EQUAL(4u, result.stats.transientCount);
+  CHECK(IsPlacementValid(graph, result));
+
+  const auto& depth = result.resources[teapotDepth];
+  const auto& color = result.resources[msaaColor];
+  CHECK(depth.heapOffset < color.heapOffset + color.size && color.heapOffset < depth.heapOffset + depth.size);
+  CHECK_EQUAL(result.stats.transientBytes - depth.size, result.heapSize);
+  std::printf("  transient %.1f MB -> heap %.1f MB\n",
+    result.stats.transientBytes / (1024.0 * 1024.0), result.heapSize / (1024.0 * 1024.0));
+
+  // MSAA のカラーの最初の使用の前に、直前に同じ領域を使った teapot のデプスからのエイリアシングバリアを出す.
+  bool hasAliasing = false;
+  for (const auto& barrier : result.passes[1].barriers)
+  {
+    if (barrier.type == FrameGraph::Barrier::TYPE_ALIASING && barrier.resource == msaaColor)
+    {
+      hasAliasing = true;
+      CHECK_EQUAL(teapotDepth, barrier.aliasBefore);
+    }
+  }
+  CHECK(hasAliasing);
+  // teapot のデプスもフレームを跨いで MSAA のカラーと領域を共有するため、先頭でエイリアシングバリアを出す.
+  bool hasDepthAliasing = false;
+  for (const auto& barrier : result.passes[0].barriers)
+    hasDepthAliasing |= barrier.type == FrameGraph::Barrier::TYPE_ALIASING && barrier.resource == teapotDepth;
+  CHECK(hasDepthAliasing);
+
+  CHECK(HasTransition(result.passes[2].barriers, msaaColor, FrameGraph::USAGE_RENDER_TARGET, FrameGraph::USAGE_RESOLVE_SOURCE));
+  CHECK(HasTransition(result.passes[2].barriers, backBuffer, FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_RESOLVE_DEST));
+  CHECK(HasTransition(result.finalBarriers, backBuffer, FrameGraph::USAGE_RESOLVE_DEST, FrameGraph::USAGE_PRESENT));
+}
+
+TEST_CASE("FrameGraph/RecompileAfterResize")
+{
+  FrameGraph graph;
+  auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+  auto scene = graph.CreateTexture("Scene", MakeDesc(640, 480, FORMAT_R8G8B8A8_UNORM));
+  auto scenePass = graph.AddPass("Scene", nullptr);
+  graph.Write(scenePass, scene, FrameGraph::USAGE_RENDER_TARGET);
+  auto mainPass = graph.AddPass("Main", nullptr);
+  graph.Read(mainPass, scene, FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+  graph.Write(mainPass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+
+  auto before = graph.Compile(GetSizeInfo).heapSize;
+  graph.SetTextureDesc(scene, MakeDesc(1920, 1080, FORMAT_R8G8B8A8_UNORM));
+  const auto& result = graph.Compile(GetSizeInfo);
+  CHECK(result.heapSize > before);
+  // サイズはアライメントへ切り上げる.
+  const uint64_t alignment = 64 << 10;
+  CHECK_EQUAL((uint64_t(1920) * 1080 * 4 + alignment - 1) / alignment * alignment, result.resources[scene].size);
+  CHECK_EQUAL(size_t(2), result.passes.size());
+}
+
+TEST_CASE("FrameGraph/RandomGraphsPlacementNeverOverlaps")
+{
+  std::mt19937 random(11);
+  for (int iteration = 0; iteration < 200; ++iteration)
+  {
+    FrameGraph graph;
+    auto backBuffer = graph.ImportTexture("BackBuffer", FrameGraph::USAGE_PRESENT, FrameGraph::USAGE_PRESENT);
+    std::vector<FrameGraph::ResourceId> textures;
+    const int textureCount = 2 + int(random() % 8);
+    for (int i = 0; i < textureCount; ++i)
+    {
+      auto size = 64u << (random() % 5);
+      auto samples = random() % 4 == 0 ? 4u : 1u;
+      textures.push_back(graph.CreateTexture("T", MakeDesc(size, size, FORMAT_R8G8B8A8_UNORM, samples)));
+    }
+    const int passCount = 2 + int(random() % 8);
+    for (int p = 0; p < passCount; ++p)
+    {
+      auto pass = graph.AddPass("P", nullptr);
+      graph.Write(pass, textures[random() % textures.size()], FrameGraph::USAGE_RENDER_TARGET);
+      if (p > 0)
+        graph.Read(pass, textures[random() % textures.size()], FrameGraph::USAGE_PIXEL_SHADER_RESOURCE);
+      if (p + 1 == passCount)
+        graph.Write(pass, backBuffer, FrameGraph::USAGE_RENDER_TARGET);
+    }
+    const auto& result = graph.Compile(GetSizeInfo);
+    CHECK(IsPlacementValid(graph, result));
+    CHECK(result.heapSize <= result.stats.transientBytes);
+    CHECK_EQUAL(result.heapSize, result.stats.aliasedBytes);
+  }
+}
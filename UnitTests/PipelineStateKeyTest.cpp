@@ -0,0 +1,174 @@
+﻿#include <string>
+#include <vector>
+
+#include "UnitTest.h"
+#include "PipelineStateKey.h"
+
+namespace
+{
+  const uint8_t VertexShaderCode[] = { 'D', 'X', 'B', 'C', 1, 2, 3, 4 };
+  const uint8_t PixelShaderCode[] = { 'D', 'X', 'B', 'C', 5, 6, 7, 8 };
+  const D3D12_INPUT_ELEMENT_DESC InputElements[] = {
+    { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+  };
+  const uint64_t RootSignatureHash = 0x1234;
+
+  // サンプルでよく使う、不透明のメッシュを描く設定.
+  D3D12_GRAPHICS_PIPELINE_STATE_DESC MakeDesc()
+  {
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc{};
+    desc.VS = { VertexShaderCode, sizeof(VertexShaderCode) };
+    desc.PS = { PixelShaderCode, sizeof(PixelShaderCode) };
+    for (auto& rt : desc.BlendState.RenderTarget)
+    {
+      rt.SrcBlend = rt.SrcBlendAlpha = D3D12_BLEND_ONE;
+      rt.DestBlend = rt.DestBlendAlpha = D3D12_BLEND_ZERO;
+      rt.BlendOp = rt.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+      rt.LogicOp = D3D12_LOGIC_OP_NOOP;
+      rt.RenderTargetWriteMask = 0xF;
+    }
+    desc.SampleMask = 0xFFFFFFFFu;
+    desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+    desc.RasterizerState.DepthClipEnable = 1;
+    desc.DepthStencilState.DepthEnable = 1;
+    desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+    desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+    desc.InputLayout = { InputElements, 2 };
+    desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    desc.NumRenderTargets = 1;
+    desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+    desc.SampleDesc = { 1, 0 };
+    return desc;
+  }
+  PipelineStateKey MakeKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash = RootSignatureHash)
+  {
+    return PipelineStateKey::FromGraphicsDesc(desc, rootSignatureHash);
+  }
+}
+
+TEST_CASE("PipelineStateKey/SameContentDifferentPointers")
+{
+  // 別に読み込んだバイトコードやレイアウトでも、中身が同じなら同じキー.
+  std::vector<uint8_t> vsCopy(std::begin(VertexShaderCode), std::end(VertexShaderCode));
+  std::vector<D3D12_INPUT_ELEMENT_DESC> layoutCopy(std::begin(InputElements), std::end(InputElements));
+  char normal[] = "normal";
+  layoutCopy[1].SemanticName = normal;  // セマンティクス名は大文字小文字を区別しない.
+
+  auto a = MakeDesc();
+  auto b = MakeDesc();
+  b.VS = { vsCopy.data(), vsCopy.size() };
+  b.InputLayout = { layoutCopy.data(), UINT(layoutCopy.size()) };
+  b.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(0x100);  // ポインタではなくハッシュを見る.
+  b.CachedPSO = { VertexShaderCode, sizeof(VertexShaderCode) };
+  CHECK(MakeKey(a) == MakeKey(b));
+  CHECK_EQUAL(MakeKey(a).GetHash(), MakeKey(b).GetHash());
+}
+
+TEST_CASE("PipelineStateKey/IgnoresUnusedState")
+{
+  const auto base = MakeKey(MakeDesc());
+
+  // ブレンドが無効なら係数は結果に影響しない.
+  auto desc = MakeDesc();
+  desc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+  desc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+  desc.BlendState.RenderTarget[0].LogicOp = D3D12_LOGIC_OP_CLEAR;
+  CHECK(base == MakeKey(desc));
+
+  // IndependentBlendEnable でなければ RenderTarget[1] 以降は使われない.
+  desc = MakeDesc();
+  desc.BlendState.RenderTarget[3].BlendEnable = 1;
+  CHECK(base == MakeKey(desc));
+
+  // 使わないターゲットのフォーマット.
+  desc = MakeDesc();
+  desc.RTVFormats[2] = DXGI_FORMAT_R32_UINT;
+  CHECK(base == MakeKey(desc));
+
+  // ステンシルが無効なら面毎の設定は見ない.
+  desc = MakeDesc();
+  desc.DepthStencilState.StencilReadMask = 0xFF;
+  desc.DepthStencilState.FrontFace.StencilPassOp = D3D12_STENCIL_OP_REPLACE;
+  CHECK(base == MakeKey(desc));
+
+  // 頂点毎のデータのステップレート.
+  std::vector<D3D12_INPUT_ELEMENT_DESC> layout(std::begin(InputElements), std::end(InputElements));
+  layout[0].InstanceDataStepRate = 3;
+  desc = MakeDesc();
+  desc.InputLayout = { layout.data(), UINT(layout.size()) };
+  CHECK(base == MakeKey(desc));
+}
+
+TEST_CASE("PipelineStateKey/DistinguishesUsedState")
+{
+  const auto base = MakeKey(MakeDesc());
+  auto desc = MakeDesc();
+  desc.PS = { VertexShaderCode, sizeof(VertexShaderCode) };
+  CHECK(base != MakeKey(desc));
+
+  CHECK(base != MakeKey(MakeDesc(), RootSignatureHash + 1));
+
+  desc = MakeDesc();
+  desc.RasterizerState.CullMode = D3D12_CULL_MODE_FRONT;   // 輪郭線の描画.
+  CHECK(base != MakeKey(desc));
+
+  desc = MakeDesc();
+  desc.BlendState.RenderTarget[0].BlendEnable = 1;
+  CHECK(base != MakeKey(desc));
+
+  desc = MakeDesc();
+  desc.DepthStencilState.DepthEnable = 0;
+  CHECK(base != MakeKey(desc));
+
+  desc = MakeDesc();
+  desc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+  CHECK(base != MakeKey(desc));
+
+  desc = MakeDesc();
+  desc.SampleDesc.Count = 4;
+  CHECK(base != MakeKey(desc));
+
+  std::vector<D3D12_INPUT_ELEMENT_DESC> layout(std::begin(InputElements), std::end(InputElements));
+  layout[1].AlignedByteOffset = 16;
+  desc = MakeDesc();
+  desc.InputLayout = { layout.data(), UINT(layout.size()) };
+  CHECK(base != MakeKey(desc));
+}
+
+TEST_CASE("PipelineStateKey/Name")
+{
+  CHECK(PipelineStateKey::MakeName(0x0123456789abcdefull) == L"PSO_0123456789abcdef");
+  CHECK(PipelineStateKey::MakeName(0) == L"PSO_0000000000000000");
+}
+
+TEST_CASE("PipelineCacheFile/RoundTripAndInvalidation")
+{
+  PipelineCacheFile::AdapterInfo adapter{ 0x10DE, 0x1B80, 1, 2, 0x0017000100000000ull };
+  std::vector<uint64_t> keys = { 1, 2, 3 };
+  std::vector<uint8_t> library = { 9, 8, 7, 6, 5 };
+  auto data = PipelineCacheFile::Write(adapter, keys, library.data(), library.size());
+
+  PipelineCacheFile file;
+  CHECK(PipelineCacheFile::Read(data, adapter, file) == nullptr);
+  CHECK(file.keys == keys);
+  CHECK(file.library == library);
+
+  auto other = adapter;
+  other.driverVersion += 1;
+  CHECK(std::string(PipelineCacheFile::Read(data, other, file)) == "driver changed");
+  CHECK(file.keys.empty());
+  other = adapter;
+  other.deviceId += 1;
+  CHECK(std::string(PipelineCacheFile::Read(data, other, file)) == "adapter changed");
+
+  auto truncated = data;
+  truncated.pop_back();
+  CHECK(std::string(PipelineCacheFile::Read(truncated, adapter, file)) == "truncated");
+  auto old = data;
+  old[4] ^= 1;  // 版.
+  CHECK(std::string(PipelineCacheFile::Read(old, adapter, file)) == "format changed");
+  CHECK(std::string(PipelineCacheFile::Read(std::vector<uint8_t>(), adapter, file)) == "no file");
+}
@@ -0,0 +1,151 @@
+﻿#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "RangeAllocator.h"
+
+TEST_CASE("RangeAllocator/AllocatesFromFront")
+{
+  RangeAllocator allocator(100);
+  CHECK_EQUAL(0u, allocator.Allocate(10));
+  CHECK_EQUAL(10u, allocator.Allocate(20));
+  CHECK_EQUAL(30u, allocator.GetUsedSize());
+  CHECK(allocator.Allocate(0) == RangeAllocator::InvalidOffset);
+}
+
+TEST_CASE("RangeAllocator/BestFitChoosesSmallestBlock")
+{
+  // 空き: [0,30) [40,50) [60,100) を作る.
+  RangeAllocator allocator(100);
+  CHECK_EQUAL(0u, allocator.Allocate(30));
+  CHECK_EQUAL(30u, allocator.Allocate(10));
+  CHECK_EQUAL(40u, allocator.Allocate(10));
+  CHECK_EQUAL(50u, allocator.Allocate(10));
+  allocator.Free(0, 30);
+  allocator.Free(40, 10);
+
+  // 先頭の 30 ではなく、収まる中で最小の [40,50) を使う.
+  CHECK_EQUAL(40u, allocator.Allocate(8));
+  // 残りの 2 に収まらない 20 は [0,30) から取る.
+  CHECK_EQUAL(0u, allocator.Allocate(20));
+  // ちょうどの大きさの空きがあればそれを使う.
+  CHECK_EQUAL(48u, allocator.Allocate(2));
+}
+
+TEST_CASE("RangeAllocator/FreeCoalescesBothNeighbors")
+{
+  RangeAllocator allocator(30);
+  CHECK_EQUAL(0u, allocator.Allocate(10));
+  CHECK_EQUAL(10u, allocator.Allocate(10));
+  CHECK_EQUAL(20u, allocator.Allocate(10));
+
+  allocator.Free(0, 10);
+  allocator.Free(20, 10);
+  CHECK_EQUAL(2u, allocator.GetStats().freeBlockCount);
+
+  // 中央を解放すると前後の空きと1つにまとまる.
+  allocator.Free(10, 10);
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(1u, stats.freeBlockCount);
+  CHECK_EQUAL(30u, stats.largestFreeBlock);
+  CHECK_EQUAL(0u, allocator.Allocate(30));
+}
+
+TEST_CASE("RangeAllocator/Exhaustion")
+{
+  RangeAllocator allocator(64);
+  CHECK_EQUAL(0u, allocator.Allocate(64));
+  CHECK(allocator.Allocate(1) == RangeAllocator::InvalidOffset);
+  allocator.Free(0, 64);
+
+  // 合計では足りても、連続した空きが無ければ確保できない.
+  CHECK_EQUAL(0u, allocator.Allocate(16));
+  CHECK_EQUAL(16u, allocator.Allocate(16));
+  CHECK_EQUAL(32u, allocator.Allocate(16));
+  CHECK_EQUAL(48u, allocator.Allocate(16));
+  allocator.Free(0, 16);
+  allocator.Free(32, 16);
+  CHECK(allocator.Allocate(32) == RangeAllocator::InvalidOffset);
+  CHECK_EQUAL(32u, allocator.GetUsedSize());
+
+  RangeAllocator empty;
+  CHECK(empty.Allocate(1) == RangeAllocator::InvalidOffset);
+}
+
+TEST_CASE("RangeAllocator/StatsAndFragmentation")
+{
+  RangeAllocator allocator(100);
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(100u, stats.totalSize);
+  CHECK_EQUAL(0u, stats.usedSize);
+  CHECK_EQUAL(1u, stats.freeBlockCount);
+  CHECK_EQUAL(100u, stats.largestFreeBlock);
+  CHECK(stats.fragmentation == 0.0f);
+
+  // 空き: [0,20) [40,100) => 空き 80 のうち最大 60.
+  CHECK_EQUAL(0u, allocator.Allocate(20));
+  CHECK_EQUAL(20u, allocator.Allocate(20));
+  allocator.Free(0, 20);
+  stats = allocator.GetStats();
+  CHECK_EQUAL(20u, stats.usedSize);
+  CHECK_EQUAL(2u, stats.freeBlockCount);
+  CHECK_EQUAL(60u, stats.largestFreeBlock);
+  CHECK(stats.fragmentation > 0.2499f && stats.fragmentation < 0.2501f);
+
+  // 全て使い切った状態では断片化を 0 とする.
+  CHECK_EQUAL(40u, allocator.Allocate(60));
+  CHECK_EQUAL(0u, allocator.Allocate(20));
+  stats = allocator.GetStats();
+  CHECK_EQUAL(0u, stats.freeBlockCount);
+  CHECK(stats.fragmentation == 0.0f);
+}
+
+TEST_CASE("RangeAllocator/RandomNoOverlapAndFullCoalesce")
+{
+  const uint32_t size = 1 << 16;
+  RangeAllocator allocator(size);
+  std::mt19937 random(7);
+  std::vector<int> owner(size, -1);
+  struct Live { uint32_t offset, size; int id; };
+  std::vector<Live> live;
+  int nextId = 0;
+  uint32_t used = 0;
+  for (int i = 0; i < 20000; ++i)
+  {
+    if (live.empty() || random() % 3 != 0)
+    {
+      uint32_t count = 1 + random() % 512;
+      auto offset = allocator.Allocate(count);
+      if (offset == RangeAllocator::InvalidOffset)
+        continue;
+      CHECK(offset + count <= size);
+      for (auto j = offset; j < offset + count; ++j)
+      {
+        CHECK_EQUAL(-1, owner[j]);
+        owner[j] = nextId;
+      }
+      live.push_back(Live{ offset, count, nextId++ });
+      used += count;
+    }
+    else
+    {
+      auto index = random() % live.size();
+      auto l = live[index];
+      for (auto j = l.offset; j < l.offset + l.size; ++j)
+        owner[j] = -1;
+      allocator.Free(l.offset, l.size);
+      used -= l.size;
+      live[index] = live.back();
+      live.pop_back();
+    }
+    CHECK_EQUAL(used, allocator.GetUsedSize());
+  }
+  for (const auto& l : live)
+    allocator.Free(l.offset, l.size);
+
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(0u, stats.usedSize);
+  CHECK_EQUAL(1u, stats.freeBlockCount);
+  CHECK_EQUAL(size, stats.largestFreeBlock);
+  CHECK(stats.fragmentation == 0.0f);
+}
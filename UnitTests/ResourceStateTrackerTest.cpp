@@ -0,0 +1,330 @@
+﻿#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "ResourceStateTracker.h"
+
+namespace
+{
+  // D3D12_RESOURCE_STATES と同じ値.
+  enum : uint32_t
+  {
+    STATE_COMMON = 0,
+    STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+    STATE_INDEX_BUFFER = 0x2,
+    STATE_RENDER_TARGET = 0x4,
+    STATE_UNORDERED_ACCESS = 0x8,
+    STATE_DEPTH_WRITE = 0x10,
+    STATE_PIXEL_SHADER_RESOURCE = 0x80,
+    STATE_COPY_DEST = 0x400,
+    STATE_COPY_SOURCE = 0x800,
+    STATE_RESOLVE_SOURCE = 0x2000,
+  };
+  using Barrier = ResourceStateTracker::Barrier;
+
+  // キーはアドレスとして扱うだけなので、配列の要素を使う.
+  int s_resources[8];
+  ResourceStateTracker::ResourceKey Key(int index) { return &s_resources[index]; }
+
+  std::vector<Barrier> FlushAll(ResourceStateTracker& tracker)
+  {
+    std::vector<Barrier> barriers;
+    tracker.Flush(barriers);
+    return barriers;
+  }
+}
+
+TEST_CASE("ResourceStateTracker/SkipsCoveredTransitions")
+{
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_COPY_DEST);
+  ResourceStateTracker tracker(&table);
+
+  // 初めて使うリソースはその場では出さず、投入時に前へ置く.
+  tracker.Transition(Key(0), STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE);
+  CHECK(!tracker.HasPendingBarriers());
+  // 読み取りステートに含まれるものは出さない.
+  tracker.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  tracker.Transition(Key(0), STATE_VERTEX_AND_CONSTANT_BUFFER);
+  CHECK(!tracker.HasPendingBarriers());
+  CHECK_EQUAL(uint64_t(2), tracker.GetStats().skippedCount);
+
+  tracker.Transition(Key(0), STATE_COPY_DEST);
+  auto barriers = FlushAll(tracker);
+  CHECK_EQUAL(size_t(1), barriers.size());
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE), barriers[0].before);
+  CHECK_EQUAL(uint32_t(STATE_COPY_DEST), barriers[0].after);
+
+  std::vector<Barrier> resolved;
+  tracker.Resolve(table, resolved);
+  CHECK_EQUAL(size_t(1), resolved.size());
+  CHECK_EQUAL(uint32_t(STATE_COPY_DEST), resolved[0].before);
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE), resolved[0].after);
+  CHECK_EQUAL(uint32_t(STATE_COPY_DEST), table.GetState(Key(0), 0));
+}
+
+TEST_CASE("ResourceStateTracker/CoveredFirstUseKeepsTableState")
+{
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE);
+  std::vector<Barrier> resolved;
+
+  // 読み取りステートに含まれるだけなら前には何も置かず、テーブルも元のステートのまま.
+  ResourceStateTracker reader(&table);
+  reader.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  reader.Resolve(table, resolved);
+  CHECK(resolved.empty());
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE), table.GetState(Key(0), 0));
+
+  // リスト内で遷移する場合は、その遷移前のステートへちょうど移しておく.
+  ResourceStateTracker writer(&table);
+  writer.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  writer.Transition(Key(0), STATE_COPY_DEST);
+  auto barriers = FlushAll(writer);
+  CHECK_EQUAL(uint32_t(STATE_PIXEL_SHADER_RESOURCE), barriers[0].before);
+  writer.Resolve(table, resolved);
+  CHECK_EQUAL(size_t(1), resolved.size());
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE), resolved[0].before);
+  CHECK_EQUAL(uint32_t(STATE_PIXEL_SHADER_RESOURCE), resolved[0].after);
+  CHECK_EQUAL(uint32_t(STATE_COPY_DEST), table.GetState(Key(0), 0));
+}
+
+TEST_CASE("ResourceStateTracker/PendingTransitionsMerged")
+{
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_COMMON);
+  table.Register(Key(1), 1, STATE_COMMON);
+  ResourceStateTracker tracker(&table);
+  tracker.Transition(Key(0), STATE_COMMON);
+  tracker.Transition(Key(1), STATE_COMMON);
+
+  // 出す前の遷移は1つにまとめる.
+  tracker.Transition(Key(0), STATE_COPY_DEST);
+  tracker.Transition(Key(0), STATE_VERTEX_AND_CONSTANT_BUFFER);
+  // 元へ戻るものは取り除く.
+  tracker.Transition(Key(1), STATE_COPY_SOURCE);
+  tracker.Transition(Key(1), STATE_COMMON);
+  auto barriers = FlushAll(tracker);
+  CHECK_EQUAL(size_t(1), barriers.size());
+  CHECK(barriers[0].resource == Key(0));
+  CHECK_EQUAL(uint32_t(STATE_COMMON), barriers[0].before);
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER), barriers[0].after);
+  CHECK_EQUAL(uint64_t(1), tracker.GetStats().flushCount);
+}
+
+TEST_CASE("ResourceStateTracker/AliasingAndUavKeepOrder")
+{
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_RESOLVE_SOURCE);
+  table.Register(Key(1), 1, STATE_DEPTH_WRITE);
+  ResourceStateTracker tracker(&table);
+  tracker.Transition(Key(0), STATE_RESOLVE_SOURCE);
+
+  // 切り替えの前後の遷移はまとめない.
+  tracker.Transition(Key(0), STATE_COPY_SOURCE);
+  tracker.AliasingBarrier(Key(1), Key(0));
+  tracker.Transition(Key(0), STATE_RENDER_TARGET);
+  auto barriers = FlushAll(tracker);
+  CHECK_EQUAL(size_t(3), barriers.size());
+  CHECK_EQUAL(int(Barrier::TYPE_TRANSITION), int(barriers[0].type));
+  CHECK_EQUAL(int(Barrier::TYPE_ALIASING), int(barriers[1].type));
+  CHECK(barriers[1].resourceBefore == Key(1));
+  CHECK(barriers[1].resource == Key(0));
+  CHECK_EQUAL(int(Barrier::TYPE_TRANSITION), int(barriers[2].type));
+  CHECK_EQUAL(uint32_t(STATE_COPY_SOURCE), barriers[2].before);
+
+  tracker.Transition(Key(0), STATE_UNORDERED_ACCESS);
+  tracker.UAVBarrier(Key(0));
+  tracker.Transition(Key(0), STATE_RENDER_TARGET);
+  barriers = FlushAll(tracker);
+  CHECK_EQUAL(size_t(3), barriers.size());
+  CHECK_EQUAL(int(Barrier::TYPE_UAV), int(barriers[1].type));
+}
+
+TEST_CASE("ResourceStateTracker/ResolveInSubmitOrder")
+{
+  // 2つのリストを並列に記録し、投入順に共有テーブルと突き合わせる.
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_PIXEL_SHADER_RESOURCE);
+  ResourceStateTracker shadow(&table), main(&table);
+  shadow.Transition(Key(0), STATE_RENDER_TARGET);
+  shadow.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  main.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  CHECK_EQUAL(size_t(1), FlushAll(shadow).size());
+  CHECK(!main.HasPendingBarriers());
+
+  std::vector<Barrier> resolved;
+  shadow.Resolve(table, resolved);
+  CHECK_EQUAL(size_t(1), resolved.size());
+  CHECK_EQUAL(uint32_t(STATE_RENDER_TARGET), resolved[0].after);
+  // 1つ目のリストの終わりで読み取りへ戻っているため、2つ目の前には何も置かない.
+  main.Resolve(table, resolved);
+  CHECK(resolved.empty());
+  CHECK_EQUAL(uint32_t(STATE_PIXEL_SHADER_RESOURCE), table.GetState(Key(0), 0));
+}
+
+TEST_CASE("ResourceStateTracker/SubresourcesResolvedTogether")
+{
+  ResourceStateTable table;
+  table.Register(Key(0), 4, STATE_COPY_DEST);
+  ResourceStateTracker tracker(&table);
+  tracker.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  std::vector<Barrier> resolved;
+  tracker.Resolve(table, resolved);
+  // 全サブリソースが同じ遷移なら1つにまとめる.
+  CHECK_EQUAL(size_t(1), resolved.size());
+  CHECK_EQUAL(uint32_t(ResourceStateTracker::AllSubresources), resolved[0].subresource);
+
+  tracker.Reset(&table);
+  tracker.Transition(Key(0), STATE_RENDER_TARGET, 2);
+  tracker.Transition(Key(0), STATE_PIXEL_SHADER_RESOURCE);
+  auto barriers = FlushAll(tracker);
+  CHECK_EQUAL(size_t(1), barriers.size());
+  CHECK_EQUAL(uint32_t(2), barriers[0].subresource);
+  tracker.Resolve(table, resolved);
+  CHECK_EQUAL(size_t(1), resolved.size());
+  CHECK_EQUAL(uint32_t(2), resolved[0].subresource);
+  for (uint32_t i = 0; i < 4; ++i)
+    CHECK_EQUAL(uint32_t(STATE_PIXEL_SHADER_RESOURCE), table.GetState(Key(0), i));
+}
+
+TEST_CASE("ResourceStateTracker/UnregisterDropsStaleState")
+{
+  // DynamicBuffer のように COPY_DEST で作って利用時のステートへ移したリソースを手放し、
+  // 同じアドレスに別のリソースが作られた場合.
+  ResourceStateTable table;
+  table.Register(Key(0), 1, STATE_COPY_DEST);
+  ResourceStateTracker tracker(&table);
+  tracker.Transition(Key(0), STATE_COPY_DEST);
+  tracker.Transition(Key(0), STATE_VERTEX_AND_CONSTANT_BUFFER);
+  FlushAll(tracker);
+  std::vector<Barrier> resolved;
+  tracker.Resolve(table, resolved);
+  CHECK_EQUAL(uint32_t(STATE_VERTEX_AND_CONSTANT_BUFFER), table.GetState(Key(0), 0));
+
+  table.Unregister(Key(0));
+  CHECK(!table.IsRegistered(Key(0)));
+  table.Register(Key(0), 1, STATE_COPY_DEST);
+  tracker.Reset(&table);
+  tracker.Transition(Key(0), STATE_COPY_DEST);
+  tracker.Resolve(table, resolved);
+  // 古いステートからの遷移を出さない.
+  CHECK(resolved.empty());
+
+  // 登録の無いリソースは最初に必要としたステートにあったものとして扱い、以降は追跡する.
+  tracker.Reset(&table);
+  tracker.Transition(Key(1), STATE_RENDER_TARGET);
+  tracker.Resolve(table, resolved);
+  CHECK(resolved.empty());
+  CHECK_EQUAL(uint32_t(STATE_RENDER_TARGET), table.GetState(Key(1), 0));
+}
+
+TEST_CASE("ResourceStateTracker/RandomListsMatchSimulatedGpu")
+{
+  // 記録したバリアを投入順に適用した GPU 側のステートと、各 Transition で要求したステートが常に一致する.
+  const uint32_t states[] = {
+    STATE_COMMON, STATE_VERTEX_AND_CONSTANT_BUFFER, STATE_INDEX_BUFFER, STATE_RENDER_TARGET,
+    STATE_UNORDERED_ACCESS, STATE_PIXEL_SHADER_RESOURCE, STATE_COPY_DEST, STATE_COPY_SOURCE,
+    STATE_VERTEX_AND_CONSTANT_BUFFER | STATE_PIXEL_SHADER_RESOURCE,
+  };
+  const uint32_t subresourceCounts[] = { 1, 3, 1, 2 };
+  const int resourceCount = int(sizeof(subresourceCounts) / sizeof(subresourceCounts[0]));
+  ResourceStateTable table;
+  std::vector<std::vector<uint32_t>> gpu(resourceCount);
+  for (int r = 0; r < resourceCount; ++r)
+  {
+    table.Register(Key(r), subresourceCounts[r], STATE_COMMON);
+    gpu[r].assign(subresourceCounts[r], STATE_COMMON);
+  }
+
+  struct Event
+  {
+    std::vector<Barrier> barriers;
+    int resource;
+    uint32_t subresource;
+    uint32_t state;
+  };
+  auto apply = [&](const std::vector<Barrier>& barriers) {
+    for (const auto& b : barriers)
+    {
+      if (b.type != Barrier::TYPE_TRANSITION)
+        continue;
+      int r = int(static_cast<const int*>(b.resource) - s_resources);
+      for (uint32_t i = 0; i < subresourceCounts[r]; ++i)
+      {
+        if (b.subresource != ResourceStateTracker::AllSubresources && b.subresource != i)
+          continue;
+        CHECK_EQUAL(gpu[r][i], b.before);
+        gpu[r][i] = b.after;
+      }
+    }
+  };
+
+  std::mt19937 random(11);
+  for (int submit = 0; submit < 500; ++submit)
+  {
+    // 1回の投入で複数のリストを並べる.
+    const int listCount = 1 + int(random() % 3);
+    std::vector<ResourceStateTracker> trackers(listCount, ResourceStateTracker(&table));
+    std::vector<std::vector<Event>> events(listCount);
+    for (int l = 0; l < listCount; ++l)
+    {
+      const int opCount = int(random() % 12);
+      for (int op = 0; op < opCount; ++op)
+      {
+        int r = int(random() % resourceCount);
+        uint32_t state = states[random() % (sizeof(states) / sizeof(states[0]))];
+        uint32_t subresource = random() % 2 == 0 ? uint32_t(ResourceStateTracker::AllSubresources) : uint32_t(random() % subresourceCounts[r]);
+        trackers[l].Transition(Key(r), state, subresource);
+        Event e{ {}, r, subresource, state };
+        // 描画の直前と同じく、ときどきまとめて出す.
+        if (random() % 3 == 0)
+          trackers[l].Flush(e.barriers);
+        events[l].push_back(e);
+      }
+      Event last{ {}, -1, 0, 0 };
+      trackers[l].Flush(last.barriers);
+      events[l].push_back(last);
+    }
+    for (int l = 0; l < listCount; ++l)
+    {
+      std::vector<Barrier> resolved;
+      trackers[l].Resolve(table, resolved);
+      apply(resolved);
+      // 要求したステートは、その後に出したバリアを全て適用した時点で満たされていればよい.
+      std::vector<std::pair<size_t, const Event*>> checks;
+      for (size_t i = 0; i < events[l].size(); ++i)
+      {
+        const auto& e = events[l][i];
+        if (e.resource >= 0)
+          checks.emplace_back(i, &e);
+        if (e.barriers.empty())
+          continue;
+        apply(e.barriers);
+        for (auto& check : checks)
+        {
+          const auto* c = check.second;
+          bool isLater = false;
+          for (size_t j = check.first + 1; j < i + 1 && !isLater; ++j)
+          {
+            const auto& later = events[l][j];
+            isLater = later.resource == c->resource &&
+              (later.subresource == c->subresource || later.subresource == ResourceStateTracker::AllSubresources ||
+               c->subresource == ResourceStateTracker::AllSubresources);
+          }
+          if (isLater)
+            continue;
+          for (uint32_t s = 0; s < subresourceCounts[c->resource]; ++s)
+          {
+            if (c->subresource == ResourceStateTracker::AllSubresources || c->subresource == s)
+              CHECK(ResourceStateTracker::IsCovered(gpu[c->resource][s], c->state));
+          }
+        }
+        checks.clear();
+      }
+    }
+    for (int r = 0; r < resourceCount; ++r)
+      for (uint32_t s = 0; s < subresourceCounts[r]; ++s)
+        CHECK_EQUAL(gpu[r][s], table.GetState(Key(r), s));
+  }
+}
@@ -0,0 +1,251 @@
+﻿#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "RingAllocator.h"
+
+namespace
+{
+  // GPU の代わりに、投入したフレームを latency フレーム遅れて完了させる.
+  struct FakeQueue
+  {
+    explicit FakeQueue(uint32_t latency) : latency(latency), nextFenceValue(1), completed(0) { }
+    uint64_t Signal()
+    {
+      submitted.push_back(nextFenceValue);
+      while (submitted.size() > latency)
+      {
+        completed = submitted.front();
+        submitted.pop_front();
+      }
+      return nextFenceValue++;
+    }
+    void WaitIdle()
+    {
+      if (!submitted.empty())
+      {
+        completed = submitted.back();
+        submitted.clear();
+      }
+    }
+    uint32_t latency;
+    uint64_t nextFenceValue;
+    uint64_t completed;
+    std::deque<uint64_t> submitted;
+  };
+
+  struct Region
+  {
+    uint32_t offset;
+    uint32_t count;
+    uint64_t fenceValue;
+  };
+  bool IsOverlapped(const Region& a, const Region& b)
+  {
+    return a.offset < b.offset + b.count && b.offset < a.offset + a.count;
+  }
+}
+
+TEST_CASE("RingAllocator/WrapDiscardsTail")
+{
+  RingAllocator ring(10);
+  CHECK_EQUAL(0u, ring.Allocate(4));
+  CHECK_EQUAL(4u, ring.Allocate(4));
+  ring.EndFrame(1);
+  ring.Retire(1);
+  CHECK_EQUAL(0u, ring.GetUsed());
+  // 末尾の 2 に 3 は収まらないため、先頭へ戻る. 捨てた 2 もこのフレームの使用量に入る.
+  CHECK_EQUAL(0u, ring.Allocate(3));
+  CHECK_EQUAL(1u, ring.GetWrapCount());
+  CHECK_EQUAL(5u, ring.GetUsed());
+  ring.EndFrame(2);
+  CHECK_EQUAL(3u, ring.Allocate(5));
+  CHECK_EQUAL(uint32_t(RingAllocator::InvalidOffset), ring.Allocate(1));
+  ring.Retire(2);
+  CHECK_EQUAL(5u, ring.GetUsed());
+  CHECK_EQUAL(8u, ring.Allocate(2));
+  CHECK_EQUAL(1u, ring.GetWrapCount());
+}
+
+TEST_CASE("RingAllocator/FullWithoutRetire")
+{
+  RingAllocator ring(8);
+  CHECK_EQUAL(0u, ring.Allocate(8));
+  CHECK_EQUAL(uint32_t(RingAllocator::InvalidOffset), ring.Allocate(1));
+  CHECK_EQUAL(uint32_t(RingAllocator::InvalidOffset), ring.Allocate(0));
+  CHECK_EQUAL(uint32_t(RingAllocator::InvalidOffset), ring.Allocate(9));
+  ring.EndFrame(5);
+  ring.Retire(4);
+  CHECK_EQUAL(uint32_t(RingAllocator::InvalidOffset), ring.Allocate(1));
+  ring.Retire(5);
+  CHECK_EQUAL(0u, ring.Allocate(8));
+}
+
+TEST_CASE("RingAllocator/FenceSimulation")
+{
+  // DescriptorRing と同じ使い方 (BeginFrame で Retire, 投入後に EndFrame) を、
+  // 2 フレーム遅れて完了するキューで繰り返し、GPU が使用中の領域を再び払い出さないことを確かめる.
+  const uint32_t capacity = 1024;
+  RingAllocator ring(capacity);
+  FakeQueue queue(2);
+  std::mt19937 rng(7);
+  std::vector<Region> inFlight;
+  uint64_t previousWrapCount = 0;
+  int failedFrames = 0;
+
+  for (int frame = 0; frame < 5000; ++frame)
+  {
+    ring.Retire(queue.completed);
+    std::vector<Region> thisFrame;
+    const auto tableCount = 1 + rng() % 20;
+    for (uint32_t i = 0; i < tableCount; ++i)
+    {
+      const auto count = uint32_t(1 + rng() % 16);
+      auto offset = ring.Allocate(count);
+      if (offset == RingAllocator::InvalidOffset)
+      {
+        ++failedFrames;
+        break;
+      }
+      CHECK(offset + count <= capacity);
+      Region region{ offset, count, 0 };
+      for (const auto& busy : inFlight)
+      {
+        if (busy.fenceValue > queue.completed)
+        {
+          CHECK(!IsOverlapped(region, busy));
+        }
+      }
+      for (const auto& own : thisFrame)
+      {
+        CHECK(!IsOverlapped(region, own));
+      }
+      thisFrame.push_back(region);
+    }
+    auto fenceValue = queue.Signal();
+    ring.EndFrame(fenceValue);
+    for (auto& region : thisFrame)
+    {
+      region.fenceValue = fenceValue;
+      inFlight.push_back(region);
+    }
+    // 完了したものは追跡から外す.
+    std::vector<Region> remain;
+    for (const auto& region : inFlight)
+    {
+      if (region.fenceValue > queue.completed)
+        remain.push_back(region);
+    }
+    inFlight.swap(remain);
+    CHECK(ring.GetUsed() <= capacity);
+    CHECK(ring.GetWrapCount() >= previousWrapCount);
+    previousWrapCount = ring.GetWrapCount();
+  }
+  // 1 フレームの使用量は末尾で捨てる分を含めても 335 以下で、3 フレーム分が収まるため不足は起きない.
+  CHECK_EQUAL(0, failedFrames);
+  CHECK(ring.GetWrapCount() > 100);
+
+  queue.WaitIdle();
+  ring.Retire(queue.completed);
+  CHECK_EQUAL(0u, ring.GetUsed());
+  CHECK_EQUAL(0u, ring.GetPendingFrameCount());
+}
+
+namespace
+{
+  // UploadRing と同じく、256 バイト単位でリングを管理して CPU 側のバッファへ書き込む.
+  const uint32_t UploadAlignment = 256;
+  uint32_t ToUnits(uint32_t size) { return (size + UploadAlignment - 1) / UploadAlignment; }
+}
+
+TEST_CASE("RingAllocator/UploadRingWrapKeepsInFlightData")
+{
+  // フレーム毎に大きさの異なる定数を書き込み、GPU が読む (完了する) 時点で内容が残っていることを確かめる.
+  const uint32_t capacity = 64 * 1024;
+  std::vector<uint8_t> buffer(capacity);
+  RingAllocator ring(capacity / UploadAlignment);
+  FakeQueue queue(2);
+  std::mt19937 rng(11);
+  struct Written { uint32_t offset; uint32_t size; uint8_t value; uint64_t fenceValue; };
+  std::deque<Written> inFlight;
+  int corruptCount = 0;
+
+  for (int frame = 0; frame < 3000; ++frame)
+  {
+    ring.Retire(queue.completed);
+    auto value = uint8_t(frame);
+    std::vector<Written> thisFrame;
+    const auto drawCount = 1 + rng() % 40;
+    for (uint32_t i = 0; i < drawCount; ++i)
+    {
+      // SceneParameter から 512 個のボーン行列まで、様々な大きさ.
+      const auto size = uint32_t(64 + rng() % (512 * 64));
+      auto offset = ring.Allocate(ToUnits(size));
+      if (offset == RingAllocator::InvalidOffset)
+        break;
+      const auto byteOffset = offset * UploadAlignment;
+      CHECK(byteOffset % UploadAlignment == 0);
+      CHECK(byteOffset + size <= capacity);
+      memset(buffer.data() + byteOffset, value, size);
+      thisFrame.push_back(Written{ byteOffset, size, value, 0 });
+    }
+    auto fenceValue = queue.Signal();
+    ring.EndFrame(fenceValue);
+    for (auto& written : thisFrame)
+    {
+      written.fenceValue = fenceValue;
+      inFlight.push_back(written);
+    }
+    // 完了したフレームの内容を GPU が読んだものとして確かめる.
+    while (!inFlight.empty() && inFlight.front().fenceValue <= queue.completed)
+    {
+      const auto& written = inFlight.front();
+      for (uint32_t i = 0; i < written.size; ++i)
+      {
+        if (buffer[written.offset + i] != written.value)
+        {
+          ++corruptCount;
+          break;
+        }
+      }
+      inFlight.pop_front();
+    }
+  }
+  CHECK_EQUAL(0, corruptCount);
+  CHECK(ring.GetWrapCount() > 0);
+}
+
+BENCHMARK_CASE("RingAllocator/UploadRingAllocationsPerSecond")
+{
+  // UploadRing::Push と同じく、確保して 256 バイトの定数を書き込む. 3 フレーム遅れて完了する.
+  const uint32_t capacity = 4 * 1024 * 1024;
+  std::vector<uint8_t> buffer(capacity);
+  RingAllocator ring(capacity / UploadAlignment);
+  FakeQueue queue(3);
+  uint8_t constants[UploadAlignment] = {};
+  const int frameCount = 1000, drawCount = 4000;
+  uint64_t allocations = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < frameCount; ++frame)
+  {
+    ring.Retire(queue.completed);
+    for (int i = 0; i < drawCount; ++i)
+    {
+      auto offset = ring.Allocate(1);
+      if (offset == RingAllocator::InvalidOffset)
+        break;
+      memcpy(buffer.data() + offset * UploadAlignment, constants, sizeof(constants));
+      ++allocations;
+    }
+    ring.EndFrame(queue.Signal());
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+  std::printf("  %llu allocations: %.1f M allocations/s (%.1f ns each, wraps=%llu)\n",
+    (unsigned long long)allocations, allocations / seconds * 1.0e-6, seconds * 1.0e9 / allocations,
+    (unsigned long long)ring.GetWrapCount());
+}
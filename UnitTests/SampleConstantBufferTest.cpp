@@ -0,0 +1,127 @@
+﻿#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "UnitTest.h"
+#include "ConstantBufferLayout.h"
+#include "ShaderCache.h"
+#include "../08_PostEffect/PostEffectApp.h"
+// 10_RenderPMD の Model.h は 11_Animation と同じ内容のため、11_Animation のものを両方のシェーダーと照合する.
+#include "../11_Animation/Model.h"
+
+// サンプルの定数バッファの構造体を、シェーダーの cbuffer と照合する.
+// ソースの宣言との照合はコンパイラ無しで行い、リフレクションとの照合は DXC でコンパイルして行う.
+// アプリケーションの起動時にも同じ照合をするが、ここでは GPU 無しで全てのシェーダーを確かめる.
+// UnitTests のディレクトリで実行すること.
+
+namespace
+{
+  struct ConstantBufferCheck
+  {
+    uint32_t bindPoint;
+    std::vector<ConstantBufferField> fields;
+    uint32_t structSize;
+  };
+  struct SampleShaders
+  {
+    std::wstring directory;
+    std::vector<std::pair<std::wstring, std::wstring>> shaders;   // ファイル名とプロファイル.
+    std::vector<ConstantBufferCheck> checks;
+  };
+
+  std::vector<SampleShaders> GetSampleShaders()
+  {
+    const std::vector<ConstantBufferCheck> modelChecks = {
+      { 0, ModelAsset::GetSceneParameterFields(), uint32_t(sizeof(ModelAsset::SceneParameter)) },
+      { 1, ModelAsset::GetBoneParameterFields(), uint32_t(sizeof(ModelAsset::BoneParameter)) },
+      { 2, Material::GetParameterFields(), uint32_t(sizeof(Material::MaterialParameters)) },
+    };
+    const std::vector<std::pair<std::wstring, std::wstring>> modelShaders = {
+      { L"modelVS.hlsl", L"vs_6_0" }, { L"modelPS.hlsl", L"ps_6_0" }, { L"modelBindlessPS.hlsl", L"ps_6_0" },
+      { L"outlineVS.hlsl", L"vs_6_0" }, { L"outlinePS.hlsl", L"ps_6_0" },
+      { L"shadowVS.hlsl", L"vs_6_0" }, { L"shadowPS.hlsl", L"ps_6_0" },
+    };
+    const std::vector<ConstantBufferCheck> effectChecks = {
+      { 0, PostEffectApp::GetEffectParameterFields(), uint32_t(sizeof(PostEffectApp::EffectParameter)) },
+    };
+    return {
+      { L"../10_RenderPMD/", modelShaders, modelChecks },
+      { L"../11_Animation/", modelShaders, modelChecks },
+      {
+        L"../08_PostEffect/", { { L"sceneVS.hlsl", L"vs_6_0" }, { L"scenePS.hlsl", L"ps_6_0" } }, {
+          { 0, PostEffectApp::GetSceneParameterFields(), uint32_t(sizeof(PostEffectApp::SceneParameter)) },
+          { 1, PostEffectApp::GetInstanceParameterFields(), uint32_t(sizeof(PostEffectApp::InstanceParameter)) },
+        }
+      },
+      { L"../08_PostEffect/", { { L"mosaicVS.hlsl", L"vs_6_0" }, { L"mosaicPS.hlsl", L"ps_6_0" } }, effectChecks },
+      { L"../08_PostEffect/", { { L"waterVS.hlsl", L"vs_6_0" }, { L"waterPS.hlsl", L"ps_6_0" } }, effectChecks },
+    };
+  }
+
+  bool ReadTextFile(const std::wstring& path, std::string& data)
+  {
+    std::ifstream infile(path, std::ifstream::binary);
+    if (!infile)
+    {
+      return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  void CheckBinding(const ConstantBufferBinding& binding, const SampleShaders& sample)
+  {
+    for (const auto& check : sample.checks)
+    {
+      auto errors = binding.Validate(check.bindPoint, check.fields, check.structSize);
+      for (const auto& error : errors)
+      {
+        std::printf("  %ls: %s\n", sample.directory.c_str(), error.c_str());
+      }
+      CHECK(errors.empty());
+    }
+  }
+}
+
+TEST_CASE("SampleConstantBuffer/MatchesSourceDeclarations")
+{
+  for (const auto& sample : GetSampleShaders())
+  {
+    ConstantBufferBinding binding;
+    for (const auto& shader : sample.shaders)
+    {
+      std::string source, error;
+      ConstantBufferLayouts layouts;
+      CHECK(ReadTextFile(sample.directory + shader.first, source));
+      CHECK(ParseConstantBuffers(source, layouts, &error));
+      binding.Add(layouts);
+    }
+    CHECK(!binding.IsEmpty());
+    CheckBinding(binding, sample);
+  }
+}
+
+TEST_CASE("SampleConstantBuffer/MatchesReflection")
+{
+  // リフレクションでは参照の有無も分かるため、構造体が読まれる範囲を覆っているかも確かめる.
+  ShaderCache cache;
+  for (const auto& sample : GetSampleShaders())
+  {
+    ConstantBufferBinding binding;
+    for (const auto& shader : sample.shaders)
+    {
+      ShaderCache::ComPtr<ID3DBlob> shaderBlob, errorBlob;
+      ConstantBufferLayouts layouts;
+      auto fileName = sample.directory + shader.first;
+      std::string source;
+      CHECK(ReadTextFile(fileName, source));
+      // 変種のあるシェーダーは全ての機能を有効にしたもので照合する.
+      ShaderPermutation permutation(source);
+      CHECK(SUCCEEDED(cache.Compile(fileName, shader.second, permutation.MakeDefines(permutation.GetAllMask()), shaderBlob, errorBlob)));
+      CHECK(ShaderCache::ReflectConstantBuffers(shaderBlob.Get(), layouts));
+      binding.Add(layouts);
+    }
+    CheckBinding(binding, sample);
+  }
+}
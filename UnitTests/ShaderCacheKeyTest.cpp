@@ -0,0 +1,274 @@
+﻿#include <map>
+#include <string>
+#include <vector>
+
+#include "UnitTest.h"
+#include "ShaderArchive.h"
+#include "ShaderCacheKey.h"
+
+namespace
+{
+  const std::string CompilerVersion = "dxc 1.7 flags 0";
+
+  // ファイルシステムの代わり. 読まれたパスを記録する.
+  struct MemoryFiles
+  {
+    std::map<std::wstring, std::string> files;
+    std::vector<std::wstring> reads;
+
+    ShaderCacheKey::ReadFileFunc GetReader()
+    {
+      return [this](const std::wstring& path, std::string& data)
+      {
+        reads.push_back(path);
+        auto itr = files.find(path);
+        if (itr == files.end())
+        {
+          return false;
+        }
+        data = itr->second;
+        return true;
+      };
+    }
+  };
+
+  ShaderCacheKey::Request MakeRequest(const std::wstring& fileName = L"shaders/modelPS.hlsl")
+  {
+    return ShaderCacheKey::Request{ fileName, L"main", L"ps_6_0", { L"/O2" }, {} };
+  }
+
+  ShaderCacheKey::Result Compute(MemoryFiles& files, const ShaderCacheKey::Request& request,
+    const std::string& compilerVersion = CompilerVersion)
+  {
+    ShaderCacheKey::Result result{};
+    CHECK(ShaderCacheKey::Compute(request, compilerVersion, files.GetReader(), result));
+    return result;
+  }
+
+  bool Contains(const std::vector<std::wstring>& paths, const std::wstring& path)
+  {
+    for (const auto& p : paths)
+    {
+      if (p == path)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+TEST_CASE("ShaderCacheKey/HashIsFnv1a")
+{
+  CHECK_EQUAL(0xcbf29ce484222325ull, ShaderCacheKey::Hash("", 0));
+  CHECK_EQUAL(0xaf63dc4c8601ec8cull, ShaderCacheKey::Hash("a", 1));
+}
+
+TEST_CASE("ShaderCacheKey/FindIncludesSkipsComments")
+{
+  auto names = ShaderCacheKey::FindIncludes(
+    "#include \"common.hlsli\"\n"
+    "  #  include <lighting.hlsli>\n"
+    "// #include \"line_comment.hlsli\"\n"
+    "/* #include \"block_comment.hlsli\"\n"
+    "#include \"still_in_comment.hlsli\" */\n"
+    "float4 x = 0; #include \"not_line_start.hlsli\"\n"
+    "#include \"unterminated.hlsli\n"
+    "#include \"last.hlsli\"");
+  CHECK_EQUAL(size_t(3), names.size());
+  if (names.size() == 3)
+  {
+    CHECK(names[0] == "common.hlsli");
+    CHECK(names[1] == "lighting.hlsli");
+    CHECK(names[2] == "last.hlsli");
+  }
+}
+
+TEST_CASE("ShaderCacheKey/SourceMissing")
+{
+  MemoryFiles files;
+  ShaderCacheKey::Result result{};
+  CHECK(!ShaderCacheKey::Compute(MakeRequest(), CompilerVersion, files.GetReader(), result));
+}
+
+TEST_CASE("ShaderCacheKey/IncludesResolvedFromIncluderDirectoryFirst")
+{
+  // shaders/common.hlsli と作業ディレクトリの common.hlsli があれば、インクルードした側のディレクトリを使う.
+  MemoryFiles files;
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"common.hlsli\"\n#include \"shared.hlsli\"\n";
+  files.files[L"shaders/common.hlsli"] = "#include \"detail/math.hlsli\"\n";
+  files.files[L"common.hlsli"] = "// used only from the working directory\n";
+  files.files[L"shared.hlsli"] = "float4 shared;\n";
+  files.files[L"shaders/detail/math.hlsli"] = "float pi;\n";
+
+  auto result = Compute(files, MakeRequest());
+  CHECK_EQUAL(size_t(4), result.files.size());
+  CHECK(!result.files.empty() && result.files[0] == L"shaders/modelPS.hlsl");
+  CHECK(Contains(result.files, L"shaders/common.hlsli"));
+  CHECK(Contains(result.files, L"shared.hlsli"));
+  CHECK(Contains(result.files, L"shaders/detail/math.hlsli"));
+  CHECK(!Contains(result.files, L"common.hlsli"));
+
+  // 使っていない作業ディレクトリの common.hlsli を変えてもキーは変わらない.
+  files.files[L"common.hlsli"] = "// changed\n";
+  CHECK_EQUAL(result.hash, Compute(files, MakeRequest()).hash);
+}
+
+TEST_CASE("ShaderCacheKey/IncludeCyclesVisitedOnce")
+{
+  MemoryFiles files;
+  files.files[L"a.hlsl"] = "#include \"b.hlsli\"\n#include \"b.hlsli\"\n";
+  files.files[L"b.hlsli"] = "#include \"a.hlsl\"\n";
+  auto result = Compute(files, MakeRequest(L"a.hlsl"));
+  CHECK_EQUAL(size_t(2), result.files.size());
+}
+
+TEST_CASE("ShaderCacheKey/ContentChangesKey")
+{
+  MemoryFiles files;
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return color; }\n";
+  files.files[L"shaders/common.hlsli"] = "#include \"nested.hlsli\"\n";
+  files.files[L"shaders/nested.hlsli"] = "cbuffer Scene : register(b0) { float4 color; }\n";
+  const auto base = Compute(files, MakeRequest()).hash;
+  CHECK_EQUAL(base, Compute(files, MakeRequest()).hash);
+
+  // 2段目のインクルードの変更も検出する.
+  files.files[L"shaders/nested.hlsli"] = "cbuffer Scene : register(b1) { float4 color; }\n";
+  const auto nestedChanged = Compute(files, MakeRequest()).hash;
+  CHECK(nestedChanged != base);
+
+  // ソースの変更.
+  files.files[L"shaders/nested.hlsli"] = "cbuffer Scene : register(b0) { float4 color; }\n";
+  CHECK_EQUAL(base, Compute(files, MakeRequest()).hash);
+  files.files[L"shaders/modelPS.hlsl"] += "// comment\n";
+  CHECK(Compute(files, MakeRequest()).hash != base);
+}
+
+TEST_CASE("ShaderCacheKey/RequestChangesKey")
+{
+  MemoryFiles files;
+  files.files[L"shaders/modelPS.hlsl"] = "float4 main() : SV_Target { return 1; }\n";
+  const auto request = MakeRequest();
+  const auto base = Compute(files, request).hash;
+
+  auto profile = request;
+  profile.profile = L"ps_6_1";
+  auto entryPoint = request;
+  entryPoint.entryPoint = L"mainAlt";
+  auto arguments = request;
+  arguments.arguments = { L"/Zi", L"/O0" };
+  auto defines = request;
+  defines.defines = { { L"USE_TEXTURE", L"1" } };
+  auto defineValue = request;
+  defineValue.defines = { { L"USE_TEXTURE", L"0" } };
+  // 区切りが曖昧にならないこと. "AB"="" と "A"="B" は別.
+  auto joinedA = request;
+  joinedA.defines = { { L"AB", L"" } };
+  auto joinedB = request;
+  joinedB.defines = { { L"A", L"B" } };
+
+  const std::vector<uint64_t> hashes = {
+    base,
+    Compute(files, profile).hash,
+    Compute(files, entryPoint).hash,
+    Compute(files, arguments).hash,
+    Compute(files, defines).hash,
+    Compute(files, defineValue).hash,
+    Compute(files, joinedA).hash,
+    Compute(files, joinedB).hash,
+    Compute(files, request, "dxc 1.8 flags 0").hash,
+  };
+  for (size_t i = 0; i < hashes.size(); ++i)
+  {
+    for (size_t j = i + 1; j < hashes.size(); ++j)
+    {
+      CHECK(hashes[i] != hashes[j]);
+    }
+  }
+}
+
+TEST_CASE("ShaderCacheKey/MissingIncludeHashedByName")
+{
+  // 見つからないインクルードは両方の候補を探し、名前をキーに含める. 後で追加されればキーが変わる.
+  MemoryFiles files;
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"missing.hlsli\"\n";
+  const auto missing = Compute(files, MakeRequest());
+  CHECK_EQUAL(size_t(1), missing.files.size());
+  CHECK(Contains(files.reads, L"shaders/missing.hlsli"));
+  CHECK(Contains(files.reads, L"missing.hlsli"));
+
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"other.hlsli\"\n";
+  CHECK(Compute(files, MakeRequest()).hash != missing.hash);
+
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"missing.hlsli\"\n";
+  files.files[L"missing.hlsli"] = "";
+  const auto found = Compute(files, MakeRequest());
+  CHECK_EQUAL(size_t(2), found.files.size());
+  CHECK(found.hash != missing.hash);
+}
+
+TEST_CASE("ShaderCacheKey/CacheFileRoundTrip")
+{
+  const uint8_t dxil[] = { 'D', 'X', 'B', 'C', 1, 2, 3, 4, 5 };
+  const uint64_t hash = 0x0123456789abcdefull;
+  CHECK(ShaderCacheKey::MakeFileName(hash) == L"0123456789abcdef.dxil");
+
+  auto data = ShaderCacheKey::EncodeFile(hash, dxil, sizeof(dxil));
+  std::vector<uint8_t> decoded;
+  CHECK(ShaderCacheKey::DecodeFile(data, hash, decoded));
+  CHECK(decoded == std::vector<uint8_t>(std::begin(dxil), std::end(dxil)));
+
+  // 別のキー, 途中で切れたもの, 中身の壊れたものは読まない.
+  CHECK(!ShaderCacheKey::DecodeFile(data, hash + 1, decoded));
+  CHECK(decoded.empty());
+  auto truncated = data;
+  truncated.pop_back();
+  CHECK(!ShaderCacheKey::DecodeFile(truncated, hash, decoded));
+  auto corrupted = data;
+  corrupted.back() ^= 0xFF;
+  CHECK(!ShaderCacheKey::DecodeFile(corrupted, hash, decoded));
+  CHECK(!ShaderCacheKey::DecodeFile(std::vector<uint8_t>(4), hash, decoded));
+}
+
+TEST_CASE("ShaderCacheKey/ArchiveEntryCheckedAgainstSource")
+{
+  // ShaderArchiver と同じく、作成時のキーを sourceHash に入れたアーカイブを引く.
+  MemoryFiles files;
+  files.files[L"shaders/modelPS.hlsl"] = "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return Color; }\n";
+  files.files[L"shaders/common.hlsli"] = "static const float4 Color = 1;\n";
+  const auto request = MakeRequest();
+  const auto built = Compute(files, request);
+  const uint8_t dxil[] = { 'D', 'X', 'I', 'L' };
+  std::vector<ShaderArchive::Source> sources{
+    ShaderArchive::Source{ request, built.hash, std::vector<uint8_t>(std::begin(dxil), std::end(dxil)), {} }
+  };
+  auto data = ShaderArchive::Build(sources);
+  ShaderArchive archive;
+  CHECK(archive.Open(data.data(), data.size()));
+  ShaderArchive::View view{};
+  CHECK(archive.Find(request, view));
+
+  // 変更が無ければ使い、ホットリロードで監視するファイルも返す.
+  ShaderCacheKey::Result key{};
+  CHECK_EQUAL(int(ShaderArchive::SOURCE_MATCHED),
+    int(ShaderArchive::CheckSource(view, request, CompilerVersion, files.GetReader(), key)));
+  CHECK_EQUAL(size_t(2), key.files.size());
+  CHECK(Contains(key.files, L"shaders/common.hlsli"));
+
+  // インクルードだけを編集しても使わない.
+  files.files[L"shaders/common.hlsli"] = "static const float4 Color = 0.5;\n";
+  CHECK_EQUAL(int(ShaderArchive::SOURCE_CHANGED),
+    int(ShaderArchive::CheckSource(view, request, CompilerVersion, files.GetReader(), key)));
+  CHECK(key.hash != view.sourceHash);
+
+  // コンパイラが変わった場合も作り直す.
+  files.files[L"shaders/common.hlsli"] = "static const float4 Color = 1;\n";
+  CHECK_EQUAL(int(ShaderArchive::SOURCE_CHANGED),
+    int(ShaderArchive::CheckSource(view, request, "dxc 1.8 flags 0", files.GetReader(), key)));
+
+  // ソースを置かずに配布した場合はそのまま使う.
+  files.files.clear();
+  CHECK_EQUAL(int(ShaderArchive::SOURCE_MISSING),
+    int(ShaderArchive::CheckSource(view, request, CompilerVersion, files.GetReader(), key)));
+  CHECK(key.files.empty());
+}
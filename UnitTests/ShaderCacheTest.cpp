@@ -0,0 +1,274 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#if _MSC_VER > 1922 && !defined(_SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING)
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+
+#include "UnitTest.h"
+#include "ShaderCache.h"
+#include "ShaderPermutation.h"
+
+#pragma comment(lib, "dxcompiler.lib")
+
+// DXC を使うテスト. GPU は使わないが dxcompiler.dll が必要.
+// リポジトリのシェーダーはサンプルのディレクトリ (UnitTests の隣) から探すため、UnitTests のディレクトリで実行すること.
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+  using clock = std::chrono::high_resolution_clock;
+  double ElapsedMs(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+
+  bool EndsWith(const std::wstring& text, const std::wstring& suffix)
+  {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+  // ShaderArchiver と同じ規則でファイル名からプロファイルを決める. 分からなければ空.
+  std::wstring GetProfile(const std::wstring& fileName)
+  {
+    if (EndsWith(fileName, L"VS.hlsl") || fileName == L"VertexShader.hlsl")
+    {
+      return L"vs_6_0";
+    }
+    if (EndsWith(fileName, L"PS.hlsl") || fileName == L"PixelShader.hlsl")
+    {
+      return L"ps_6_0";
+    }
+    return std::wstring();
+  }
+
+  bool ReadTextFile(const std::wstring& path, std::string& data)
+  {
+    std::ifstream infile(fs::path(path), std::ifstream::binary);
+    if (!infile)
+    {
+      return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  // リポジトリにある全ての .hlsl と、その全ての変種.
+  std::vector<ShaderCompileJob> MakeRepositoryJobs()
+  {
+    std::vector<ShaderCompileJob> jobs;
+    for (const auto& directory : fs::directory_iterator(L".."))
+    {
+      if (!fs::is_directory(directory.path()))
+      {
+        continue;
+      }
+      for (const auto& item : fs::directory_iterator(directory.path()))
+      {
+        auto profile = GetProfile(item.path().filename().wstring());
+        std::string source;
+        if (item.path().extension() != L".hlsl" || profile.empty() || !ReadTextFile(item.path().wstring(), source))
+        {
+          continue;
+        }
+        ShaderPermutation permutation(source);
+        for (ShaderFeatureMask mask = 0; ; ++mask)
+        {
+          jobs.emplace_back(item.path().wstring(), profile, permutation.MakeDefines(mask));
+          if (mask == permutation.GetAllMask())
+          {
+            break;
+          }
+        }
+      }
+    }
+    return jobs;
+  }
+
+  // 空の一時ディレクトリ. ディスクキャッシュの保存先にする.
+  std::wstring MakeEmptyDirectory(const wchar_t* name)
+  {
+    auto path = fs::temp_directory_path() / name;
+    std::error_code ec;
+    fs::remove_all(path, ec);
+    return path.wstring();
+  }
+
+  bool IsSameBlob(ID3DBlob* a, ID3DBlob* b)
+  {
+    return a && b && a->GetBufferSize() == b->GetBufferSize() &&
+      memcmp(a->GetBufferPointer(), b->GetBufferPointer(), a->GetBufferSize()) == 0;
+  }
+}
+
+TEST_CASE("ShaderCache/DiskHitReturnsCompiledDxil")
+{
+  auto jobs = MakeRepositoryJobs();
+  CHECK(!jobs.empty());
+  if (jobs.empty())
+  {
+    return;
+  }
+  const auto& job = jobs.front();
+  auto directory = MakeEmptyDirectory(L"UnitTestsShaderCacheDisk");
+
+  ShaderCache::ComPtr<ID3DBlob> compiled, loaded, memory, errorBlob;
+  uint64_t compiledKey = 0, loadedKey = 0;
+  {
+    ShaderCache cache;
+    cache.SetDirectory(directory);
+    CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, compiled, errorBlob, nullptr, &compiledKey)));
+    CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, memory, errorBlob)));
+    auto stats = cache.GetStats();
+    CHECK_EQUAL(1u, stats.compiledCount);
+    CHECK_EQUAL(1u, stats.memoryHitCount);
+    CHECK(IsSameBlob(compiled.Get(), memory.Get()));
+  }
+  CHECK(fs::exists(fs::path(directory) / ShaderCacheKey::MakeFileName(compiledKey)));
+
+  // 別のインスタンス (次回の起動) ではコンパイルせずにファイルから読む.
+  ShaderCache cache;
+  cache.SetDirectory(directory);
+  std::vector<std::wstring> files;
+  CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, loaded, errorBlob, &files, &loadedKey)));
+  auto stats = cache.GetStats();
+  CHECK_EQUAL(0u, stats.compiledCount);
+  CHECK_EQUAL(1u, stats.diskHitCount);
+  CHECK_EQUAL(compiledKey, loadedKey);
+  CHECK(!files.empty() && files[0] == fs::path(job.fileName).wstring());
+  CHECK(IsSameBlob(compiled.Get(), loaded.Get()));
+}
+
+TEST_CASE("ShaderCache/StaleArchiveEntryIsRecompiled")
+{
+  // 一時ディレクトリのシェーダーでアーカイブを作り、インクルードを編集した後に引く.
+  auto directory = fs::path(MakeEmptyDirectory(L"UnitTestsShaderCacheArchive"));
+  fs::create_directories(directory);
+  auto sourcePath = (directory / L"archivePS.hlsl").wstring();
+  auto includePath = (directory / L"archive.hlsli").wstring();
+  auto archivePath = (directory / L"shaders.pak").wstring();
+  auto writeText = [](const std::wstring& path, const char* text) {
+    std::ofstream(fs::path(path), std::ofstream::binary | std::ofstream::trunc) << text;
+  };
+  writeText(sourcePath, "#include \"archive.hlsli\"\nfloat4 main() : SV_Target { return Color; }\n");
+  writeText(includePath, "static const float4 Color = 1;\n");
+
+  ShaderCompileJob job(sourcePath, L"ps_6_0");
+  {
+    ShaderCache cache;
+    CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, job.shaderBlob, job.errorBlob, nullptr, &job.keyHash)));
+  }
+  auto dxil = static_cast<const uint8_t*>(job.shaderBlob->GetBufferPointer());
+  std::vector<ShaderArchive::Source> sources{ ShaderArchive::Source{
+    ShaderCache::MakeRequest(job.fileName, job.profile, job.defines), job.keyHash,
+    std::vector<uint8_t>(dxil, dxil + job.shaderBlob->GetBufferSize()), {} } };
+  auto data = ShaderArchive::Build(sources);
+  {
+    std::ofstream outfile(fs::path(archivePath), std::ofstream::binary | std::ofstream::trunc);
+    outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+
+  // 変更が無ければアーカイブから返し、監視するファイルも返す.
+  ShaderCache cache;
+  CHECK(cache.OpenArchive(archivePath));
+  ShaderCache::ComPtr<ID3DBlob> archived, recompiled, errorBlob;
+  std::vector<std::wstring> files;
+  CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, archived, errorBlob, &files)));
+  CHECK_EQUAL(1u, cache.GetStats().archiveHitCount);
+  CHECK_EQUAL(size_t(2), files.size());
+  CHECK(IsSameBlob(job.shaderBlob.Get(), archived.Get()));
+
+  // インクルードを編集すると、アーカイブの結果を使わずにコンパイルする.
+  writeText(includePath, "static const float4 Color = 0.5;\n");
+  uint64_t keyHash = 0;
+  CHECK(SUCCEEDED(cache.Compile(job.fileName, job.profile, job.defines, recompiled, errorBlob, &files, &keyHash)));
+  auto stats = cache.GetStats();
+  CHECK_EQUAL(1u, stats.archiveHitCount);
+  CHECK_EQUAL(1u, stats.archiveStaleCount);
+  CHECK_EQUAL(1u, stats.compiledCount);
+  CHECK(keyHash != job.keyHash);
+  CHECK_EQUAL(size_t(2), files.size());
+  CHECK(!IsSameBlob(archived.Get(), recompiled.Get()));
+}
+
+BENCHMARK_CASE("ShaderCache/ColdVsWarmAllShaders")
+{
+  // リポジトリの全シェーダーを1スレッドで、空のキャッシュ, ディスクキャッシュ, メモリの順に引いて比べる.
+  auto directory = MakeEmptyDirectory(L"UnitTestsShaderCacheBench");
+  auto run = [&](ShaderCache& cache, const char* label)
+  {
+    auto jobs = MakeRepositoryJobs();
+    auto start = clock::now();
+    CHECK(SUCCEEDED(cache.CompileBatch(jobs, 1)));
+    double ms = ElapsedMs(start);
+    auto stats = cache.GetStats();
+    std::printf("  %-6s %3zu shaders: %9.2f ms (compiled %u, disk %u, memory %u)\n",
+      label, jobs.size(), ms, stats.compiledCount, stats.diskHitCount, stats.memoryHitCount);
+  };
+  {
+    ShaderCache cold;
+    cold.SetDirectory(directory);
+    run(cold, "cold");
+  }
+  ShaderCache warm;
+  warm.SetDirectory(directory);
+  run(warm, "warm");
+  run(warm, "memory");
+}
+
+TEST_CASE("ShaderCache/CompileBatchMatchesSerial")
+{
+  // 並列にコンパイルしても、1件ずつ Compile した場合と同じ結果とキーになる.
+  auto jobs = MakeRepositoryJobs();
+  ShaderCache parallelCache;
+  CHECK(SUCCEEDED(parallelCache.CompileBatch(jobs)));
+  CHECK_EQUAL(UINT(jobs.size()), parallelCache.GetStats().compiledCount);
+
+  ShaderCache serialCache;
+  for (const auto& job : jobs)
+  {
+    ShaderCache::ComPtr<ID3DBlob> shaderBlob, errorBlob;
+    uint64_t keyHash = 0;
+    CHECK(SUCCEEDED(job.hr));
+    CHECK(SUCCEEDED(serialCache.Compile(job.fileName, job.profile, job.defines, shaderBlob, errorBlob, nullptr, &keyHash)));
+    CHECK_EQUAL(job.keyHash, keyHash);
+    CHECK(IsSameBlob(job.shaderBlob.Get(), shaderBlob.Get()));
+  }
+}
+
+BENCHMARK_CASE("ShaderCache/SerialVsParallelAllShaders")
+{
+  // ディスクキャッシュを使わず、リポジトリの全シェーダーをスレッド数を変えてコンパイルする.
+  // ワーカースレッドは CompileBatch の度に作られるため、スレッド毎の DXC の生成も時間に含まれる.
+  const unsigned hardwareThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+  double serialMs = 0.0;
+  for (unsigned threadCount = 1; ; threadCount *= 2)
+  {
+    threadCount = (std::min)(threadCount, hardwareThreads);
+    auto jobs = MakeRepositoryJobs();
+    ShaderCache cache;
+    auto start = clock::now();
+    CHECK(SUCCEEDED(cache.CompileBatch(jobs, threadCount)));
+    double ms = ElapsedMs(start);
+    if (threadCount == 1)
+    {
+      serialMs = ms;
+    }
+    std::printf("  %2u threads, %3zu shaders: %9.2f ms (x%.2f, compile total %.2f ms)\n",
+      threadCount, jobs.size(), ms, serialMs / ms, cache.GetStats().compileMs);
+    if (threadCount == hardwareThreads)
+    {
+      break;
+    }
+  }
+}
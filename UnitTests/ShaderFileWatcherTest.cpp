@@ -0,0 +1,206 @@
+﻿#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if _MSC_VER > 1922 && !defined(_SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING)
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+
+#include "UnitTest.h"
+#include "ShaderFileWatcher.h"
+
+// 一時ディレクトリに実際のファイルを書き、監視スレッド (Start) から呼ばれる様子を確かめる.
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+  using clock = std::chrono::steady_clock;
+
+  // ShaderHotReload と同じく、最終更新時刻とサイズをスタンプにする.
+  bool GetFileStamp(const std::wstring& path, uint64_t& stamp)
+  {
+    std::error_code ec;
+    auto time = fs::last_write_time(fs::path(path), ec);
+    if (ec)
+    {
+      return false;
+    }
+    auto size = fs::file_size(fs::path(path), ec);
+    if (ec)
+    {
+      return false;
+    }
+    stamp = uint64_t(time.time_since_epoch().count()) * 1000003ull ^ uint64_t(size);
+    return true;
+  }
+
+  // 更新時刻の分解能が粗くても変化が分かるよう、書く度に大きさを変える.
+  void WriteText(const fs::path& path, const std::string& text)
+  {
+    std::ofstream outfile(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    outfile << text;
+  }
+
+  struct TempShaders
+  {
+    fs::path directory;
+    std::wstring source1, source2, include;
+
+    TempShaders()
+    {
+      directory = fs::temp_directory_path() / L"UnitTestsShaderFileWatcher";
+      std::error_code ec;
+      fs::remove_all(directory, ec);
+      fs::create_directories(directory);
+      source1 = (directory / L"watchPS.hlsl").wstring();
+      source2 = (directory / L"watchVS.hlsl").wstring();
+      include = (directory / L"watch.hlsli").wstring();
+      WriteText(source1, "#include \"watch.hlsli\"\nfloat4 main() : SV_Target { return Color; }\n");
+      WriteText(source2, "#include \"watch.hlsli\"\nfloat4 main() : SV_Position { return Color; }\n");
+      WriteText(include, "static const float4 Color = 1;\n");
+    }
+    ~TempShaders()
+    {
+      std::error_code ec;
+      fs::remove_all(directory, ec);
+    }
+  };
+
+  // Start のコールバックを受け取り、待ち合わせる.
+  struct CallbackLog
+  {
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::vector<std::vector<uint32_t>> calls;
+    std::vector<clock::time_point> times;
+
+    void OnChanged(const std::vector<uint32_t>& ids)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.push_back(ids);
+        times.push_back(clock::now());
+      }
+      arrived.notify_all();
+    }
+    // count 回目の呼び出しを待つ. 来なければ false.
+    bool Wait(size_t count, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      return arrived.wait_for(lock, timeout, [&]() { return calls.size() >= count; });
+    }
+    size_t GetCount()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return calls.size();
+    }
+  };
+}
+
+TEST_CASE("ShaderFileWatcher/DebounceWaitsForStableStamp")
+{
+  TempShaders shaders;
+  ShaderFileWatcher watcher(GetFileStamp);
+  watcher.Track(1, { shaders.source1, shaders.include });
+  watcher.Track(2, { shaders.source2, shaders.include });
+  CHECK_EQUAL(size_t(3), watcher.GetFileCount());
+  CHECK(watcher.Poll().empty());
+
+  // 変化を見つけた確認では返さず、次の確認でも同じであれば返す.
+  WriteText(shaders.source1, "float4 main() : SV_Target { return 0; }\n");
+  CHECK(watcher.Poll().empty());
+  CHECK(watcher.Poll() == std::vector<uint32_t>({ 1 }));
+  CHECK(watcher.Poll().empty());
+
+  // 保存の途中 (確認の間に続けて書かれた) は、落ち着くまで待つ.
+  WriteText(shaders.include, "static const float4 Color = 0.5;\n");
+  CHECK(watcher.Poll().empty());
+  WriteText(shaders.include, "static const float4 Color = 0.25;\n// saved\n");
+  CHECK(watcher.Poll().empty());
+  CHECK(watcher.Poll() == std::vector<uint32_t>({ 1, 2 }));
+}
+
+TEST_CASE("ShaderFileWatcher/DeleteThenRecreate")
+{
+  TempShaders shaders;
+  ShaderFileWatcher watcher(GetFileStamp);
+  watcher.Track(1, { shaders.source1, shaders.include });
+  watcher.Track(2, { shaders.source2, shaders.include });
+
+  // 削除は更新とみなさない (エディタが置き換えで保存する途中など).
+  fs::remove(fs::path(shaders.include));
+  CHECK(watcher.Poll().empty());
+  CHECK(watcher.Poll().empty());
+
+  // 作り直されたら、依存する全ての id を返す.
+  WriteText(shaders.include, "static const float4 Color = 0.0;\n");
+  CHECK(watcher.Poll().empty());
+  CHECK(watcher.Poll() == std::vector<uint32_t>({ 1, 2 }));
+
+  // 監視を外した id は返さない.
+  watcher.Untrack(1);
+  CHECK_EQUAL(size_t(2), watcher.GetFileCount());
+  WriteText(shaders.include, "static const float4 Color = 0.75;\n");
+  watcher.Poll();
+  CHECK(watcher.Poll() == std::vector<uint32_t>({ 2 }));
+}
+
+TEST_CASE("ShaderFileWatcher/StartCallsBackOnEdits")
+{
+  const uint32_t intervalMs = 20;
+  TempShaders shaders;
+  ShaderFileWatcher watcher(GetFileStamp);
+  watcher.Track(1, { shaders.source1, shaders.include });
+  watcher.Track(2, { shaders.source2, shaders.include });
+  CallbackLog log;
+  watcher.Start(intervalMs, [&](const std::vector<uint32_t>& ids) { log.OnChanged(ids); });
+
+  auto latencyMs = [&](size_t call, clock::time_point edited)
+  {
+    std::lock_guard<std::mutex> lock(log.mutex);
+    return std::chrono::duration<double, std::milli>(log.times[call] - edited).count();
+  };
+
+  // ソースの編集はそのソースの id だけ.
+  auto edited = clock::now();
+  WriteText(shaders.source1, "#include \"watch.hlsli\"\nfloat4 main() : SV_Target { return Color * 2; }\n");
+  CHECK(log.Wait(1));
+  double sourceMs = log.GetCount() >= 1 ? latencyMs(0, edited) : -1.0;
+
+  // インクルードの編集は両方の id を1度の呼び出しで.
+  edited = clock::now();
+  WriteText(shaders.include, "static const float4 Color = 0.5;\n// edited\n");
+  CHECK(log.Wait(2));
+  double includeMs = log.GetCount() >= 2 ? latencyMs(1, edited) : -1.0;
+
+  // 削除しても呼ばれず、作り直すと呼ばれる.
+  fs::remove(fs::path(shaders.include));
+  std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs * 5));
+  CHECK_EQUAL(size_t(2), log.GetCount());
+  edited = clock::now();
+  WriteText(shaders.include, "static const float4 Color = 1;\n// recreated\n");
+  CHECK(log.Wait(3));
+  double recreateMs = log.GetCount() >= 3 ? latencyMs(2, edited) : -1.0;
+  watcher.Stop();
+
+  {
+    std::lock_guard<std::mutex> lock(log.mutex);
+    CHECK_EQUAL(size_t(3), log.calls.size());
+    if (log.calls.size() == 3)
+    {
+      CHECK(log.calls[0] == std::vector<uint32_t>({ 1 }));
+      CHECK(log.calls[1] == std::vector<uint32_t>({ 1, 2 }));
+      CHECK(log.calls[2] == std::vector<uint32_t>({ 1, 2 }));
+    }
+  }
+  // 変化を見つけた次の確認で返すため、編集から呼び出しまでは間隔の1回分以上かかる.
+  CHECK(sourceMs >= double(intervalMs) * 0.5);
+  std::printf("  interval %u ms: edit to callback source %.1f ms, include %.1f ms, recreate %.1f ms\n",
+    intervalMs, sourceMs, includeMs, recreateMs);
+}
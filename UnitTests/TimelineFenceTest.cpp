@@ -0,0 +1,221 @@
+﻿#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "UnitTest.h"
+#include "TimelineFence.h"
+
+namespace
+{
+  // GPU の代わりのキュー. Signal した値を積んでおき、Step で先頭から完了させる.
+  // QueueWait で積んだ待機は、相手のキューが値に達するまでそれ以降の完了を止める.
+  class SoftwareQueueFence : public TimelineFence::Backend
+  {
+  public:
+    SoftwareQueueFence() : m_completed(0) { }
+
+    void Signal(uint64_t value) override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_commands.push_back(Command{ nullptr, value });
+      signaledValues.push_back(value);
+    }
+    uint64_t GetCompletedValue() const override
+    {
+      return m_completed.load();
+    }
+    bool Wait(uint64_t value, uint32_t timeoutMs) override
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      auto isReached = [&]() { return m_completed.load() >= value; };
+      if (timeoutMs == TimelineFence::InfiniteTimeout)
+      {
+        m_completedChanged.wait(lock, isReached);
+        return true;
+      }
+      return m_completedChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), isReached);
+    }
+    void QueueWait(TimelineFence::Backend& other, uint64_t value) override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_commands.push_back(Command{ static_cast<SoftwareQueueFence*>(&other), value });
+    }
+
+    // 先頭のコマンドを1つ進める. 他のキューを待っていて進めない場合は false.
+    bool Step()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_commands.empty())
+        return false;
+      auto& command = m_commands.front();
+      if (command.waitFor)
+      {
+        if (command.waitFor->GetCompletedValue() < command.value)
+          return false;
+      }
+      else
+      {
+        m_completed.store(command.value);
+        m_completedChanged.notify_all();
+      }
+      m_commands.pop_front();
+      return true;
+    }
+    void Drain()
+    {
+      while (Step())
+      {
+      }
+    }
+
+    std::vector<uint64_t> signaledValues;
+  private:
+    struct Command
+    {
+      SoftwareQueueFence* waitFor;  // nullptr なら Signal.
+      uint64_t value;
+    };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_completedChanged;
+    std::deque<Command> m_commands;
+    std::atomic<uint64_t> m_completed;
+  };
+
+  struct FenceWithQueue
+  {
+    FenceWithQueue()
+    {
+      auto backend = std::unique_ptr<SoftwareQueueFence>(new SoftwareQueueFence());
+      queue = backend.get();
+      fence = std::make_unique<TimelineFence>(std::move(backend));
+    }
+    SoftwareQueueFence* queue;
+    std::unique_ptr<TimelineFence> fence;
+  };
+}
+
+TEST_CASE("TimelineFence/TicketsCompleteInOrder")
+{
+  FenceWithQueue q;
+  auto t1 = q.fence->Signal();
+  auto t2 = q.fence->Signal();
+  auto t3 = q.fence->Signal();
+  CHECK(t1 < t2 && t2 < t3);
+  CHECK_EQUAL(t3, q.fence->GetLastSignaled());
+  CHECK(!q.fence->IsComplete(t1));
+
+  q.queue->Step();
+  CHECK(q.fence->IsComplete(t1));
+  CHECK(!q.fence->IsComplete(t2));
+  q.queue->Drain();
+  CHECK(q.fence->IsComplete(t3));
+  CHECK_EQUAL(t3, q.fence->GetCompletedValue());
+  // 完了済みのチケットは CPU を止めない.
+  CHECK(q.fence->WaitFor(t2));
+  CHECK_EQUAL(uint64_t(0), q.fence->GetStats().blockingWaitCount);
+  CHECK_EQUAL(uint64_t(3), q.fence->GetStats().signalCount);
+}
+
+TEST_CASE("TimelineFence/WaitTimeoutAndBlockedTime")
+{
+  FenceWithQueue q;
+  auto ticket = q.fence->Signal();
+  CHECK(!q.fence->WaitFor(ticket, 10));
+  auto stats = q.fence->GetStats();
+  CHECK_EQUAL(uint64_t(1), stats.timeoutCount);
+  CHECK(stats.blockedMs >= 5.0);
+
+  std::thread gpu([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.queue->Drain();
+  });
+  CHECK(q.fence->WaitFor(ticket));
+  gpu.join();
+  stats = q.fence->GetStats();
+  CHECK_EQUAL(uint64_t(2), stats.blockingWaitCount);
+  CHECK_EQUAL(uint64_t(1), stats.timeoutCount);
+  CHECK(q.fence->IsComplete(ticket));
+}
+
+TEST_CASE("TimelineFence/CrossQueueWait")
+{
+  // 描画キューがコピーキューの転送を待つ. コピーが完了するまで描画キューの以降の Signal は完了しない.
+  FenceWithQueue copy, graphics;
+  auto upload = copy.fence->Signal();
+  graphics.fence->QueueWait(*copy.fence, upload);
+  auto draw = graphics.fence->Signal();
+  CHECK_EQUAL(uint64_t(1), graphics.fence->GetStats().queueWaitCount);
+
+  graphics.queue->Drain();
+  CHECK(!graphics.fence->IsComplete(draw));
+  copy.queue->Drain();
+  graphics.queue->Drain();
+  CHECK(graphics.fence->IsComplete(draw));
+
+  // 完了済みのチケットを待つ場合はコマンドを積まない.
+  graphics.fence->QueueWait(*copy.fence, upload);
+  CHECK_EQUAL(uint64_t(1), graphics.fence->GetStats().queueWaitCount);
+}
+
+TEST_CASE("TimelineFence/ConcurrentSignalAndQuery")
+{
+  // 複数スレッドから Signal しても、キューへ積む値は狭義単調増加のまま重複しない.
+  FenceWithQueue q;
+  const int threadCount = 4, signalsPerThread = 5000;
+  std::atomic<bool> isRunning(true);
+  std::atomic<int> regressions(0);
+  std::thread gpu([&]() {
+    while (isRunning.load())
+    {
+      q.queue->Step();
+    }
+  });
+  std::thread observer([&]() {
+    uint64_t last = 0;
+    while (isRunning.load())
+    {
+      auto completed = q.fence->GetCompletedValue();
+      if (completed < last)
+        ++regressions;
+      last = completed;
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < signalsPerThread; ++i)
+      {
+        auto ticket = q.fence->Signal();
+        if (i % 500 == 0)
+        {
+          q.fence->WaitFor(ticket);
+        }
+      }
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  const auto last = q.fence->GetLastSignaled();
+  q.fence->WaitFor(last);
+  isRunning.store(false);
+  gpu.join();
+  observer.join();
+
+  CHECK_EQUAL(uint64_t(threadCount * signalsPerThread), last);
+  CHECK_EQUAL(0, regressions.load());
+  const auto& values = q.queue->signaledValues;
+  CHECK_EQUAL(size_t(last), values.size());
+  bool isIncreasing = true;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    isIncreasing = isIncreasing && values[i] == i + 1;
+  }
+  CHECK(isIncreasing);
+}
@@ -0,0 +1,219 @@
+﻿#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "UnitTest.h"
+#include "TlsfAllocator.h"
+
+namespace
+{
+  // HeapBlockPool のコールバックの代わりに、生成と破棄を記録する.
+  struct FakeBlocks
+  {
+    std::vector<uint64_t> sizes;    // 0 は未生成または破棄済み.
+    int createCount = 0;
+    int destroyCount = 0;
+    bool isCreateFailing = false;
+
+    void Reset(HeapBlockPool& pool, uint64_t blockSize)
+    {
+      pool.Reset(blockSize,
+        [this](uint32_t index, uint64_t size)
+        {
+          if (isCreateFailing)
+            return false;
+          if (index >= sizes.size())
+            sizes.resize(index + 1, 0);
+          sizes[index] = size;
+          ++createCount;
+          return true;
+        },
+        [this](uint32_t index)
+        {
+          sizes[index] = 0;
+          ++destroyCount;
+        });
+    }
+    int CountAlive() const
+    {
+      int count = 0;
+      for (auto size : sizes)
+        count += size != 0 ? 1 : 0;
+      return count;
+    }
+  };
+}
+
+TEST_CASE("TlsfAllocator/WholeRegionExactSize")
+{
+  // クラスの境界に無いサイズでも、領域全体をちょうど確保できる.
+  const uint64_t sizes[] = { 1, 15, 16, 17, 101, 1000, 4097, 65536 + 3 };
+  for (auto size : sizes)
+  {
+    TlsfAllocator allocator(size);
+    CHECK_EQUAL(uint64_t(0), allocator.Allocate(size));
+    CHECK_EQUAL(size, allocator.GetUsed());
+    CHECK(allocator.Allocate(1) == TlsfAllocator::InvalidOffset);
+    CHECK(allocator.Free(0));
+    CHECK(allocator.IsEmpty());
+  }
+}
+
+TEST_CASE("TlsfAllocator/WholeRegionWithAlignment")
+{
+  // 先頭は常に揃っているため、アライメントを指定しても領域全体を確保できる.
+  TlsfAllocator allocator(65536 * 3);
+  CHECK_EQUAL(uint64_t(0), allocator.Allocate(65536 * 3, 65536));
+  CHECK(allocator.Free(0));
+}
+
+TEST_CASE("TlsfAllocator/AlignmentPaddingStaysFree")
+{
+  TlsfAllocator allocator(1024);
+  CHECK_EQUAL(uint64_t(0), allocator.Allocate(10));
+  auto offset = allocator.Allocate(100, 256);
+  CHECK_EQUAL(uint64_t(256), offset);
+  // 先頭の余り [10, 256) は空きとして残り、後から使える.
+  CHECK_EQUAL(uint64_t(10), allocator.Allocate(200));
+  CHECK_EQUAL(uint64_t(310), allocator.GetUsed());
+}
+
+TEST_CASE("TlsfAllocator/FreeCoalescesNeighbours")
+{
+  TlsfAllocator allocator(300);
+  auto a = allocator.Allocate(100);
+  auto b = allocator.Allocate(100);
+  auto c = allocator.Allocate(100);
+  CHECK(a != TlsfAllocator::InvalidOffset && b != TlsfAllocator::InvalidOffset && c != TlsfAllocator::InvalidOffset);
+  CHECK(allocator.Free(a));
+  CHECK(allocator.Free(c));
+  CHECK_EQUAL(2u, allocator.GetStats().freeBlockCount);
+  CHECK(allocator.Free(b));
+  auto stats = allocator.GetStats();
+  CHECK_EQUAL(1u, stats.freeBlockCount);
+  CHECK_EQUAL(uint64_t(300), stats.largestFreeBlock);
+  // 結合した後は再び全体を確保できる.
+  CHECK_EQUAL(uint64_t(0), allocator.Allocate(300));
+}
+
+TEST_CASE("TlsfAllocator/InvalidFree")
+{
+  TlsfAllocator allocator(256);
+  auto offset = allocator.Allocate(64);
+  CHECK(!allocator.Free(offset + 1));
+  CHECK(allocator.Free(offset));
+  CHECK(!allocator.Free(offset));
+}
+
+TEST_CASE("TlsfAllocator/RandomNoOverlap")
+{
+  const uint64_t size = 1 << 20;
+  TlsfAllocator allocator(size);
+  std::mt19937 random(7);
+  std::vector<int> owner(size / 16, -1);
+  struct Live { uint64_t offset, size; int id; };
+  std::vector<Live> live;
+  int nextId = 0;
+  for (int i = 0; i < 20000; ++i)
+  {
+    if (live.empty() || random() % 3 != 0)
+    {
+      uint64_t bytes = 16 * (1 + random() % 256);
+      uint64_t alignment = uint64_t(16) << (random() % 5);
+      auto offset = allocator.Allocate(bytes, alignment);
+      if (offset == TlsfAllocator::InvalidOffset)
+        continue;
+      CHECK_EQUAL(uint64_t(0), offset % alignment);
+      for (auto j = offset / 16; j < (offset + bytes) / 16; ++j)
+      {
+        CHECK_EQUAL(-1, owner[j]);
+        owner[j] = nextId;
+      }
+      live.push_back(Live{ offset, bytes, nextId++ });
+    }
+    else
+    {
+      auto index = random() % live.size();
+      auto l = live[index];
+      for (auto j = l.offset / 16; j < (l.offset + l.size) / 16; ++j)
+        owner[j] = -1;
+      CHECK(allocator.Free(l.offset));
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  for (const auto& l : live)
+    CHECK(allocator.Free(l.offset));
+  CHECK(allocator.IsEmpty());
+  CHECK_EQUAL(size, allocator.GetStats().largestFreeBlock);
+}
+
+TEST_CASE("HeapBlockPool/DedicatedBlockFitsRequest")
+{
+  HeapBlockPool pool;
+  FakeBlocks blocks;
+  blocks.Reset(pool, 64 * 1024);
+
+  // ブロックより大きい要求は、要求をアライメントへ切り上げたサイズの専用ブロックになる.
+  HeapBlockPool::Allocation allocation{};
+  CHECK(pool.Allocate(100 * 1024 + 3, 64 * 1024, allocation));
+  CHECK_EQUAL(uint64_t(0), allocation.offset);
+  CHECK_EQUAL(uint64_t(128 * 1024), blocks.sizes[allocation.blockIndex]);
+
+  // アライメントの倍数ちょうどの要求は同じサイズのブロックになり、クラスの境界に無くても収まる.
+  HeapBlockPool::Allocation exact{};
+  CHECK(pool.Allocate(69 * 4096, 4096, exact));
+  CHECK_EQUAL(uint64_t(69 * 4096), blocks.sizes[exact.blockIndex]);
+  CHECK_EQUAL(2, blocks.CountAlive());
+
+  // 専用ブロックは空になると破棄する.
+  pool.Free(allocation);
+  pool.Free(exact);
+  CHECK_EQUAL(0, blocks.CountAlive());
+  CHECK_EQUAL(0u, pool.GetStats().blockCount);
+}
+
+TEST_CASE("HeapBlockPool/SharedBlockReused")
+{
+  HeapBlockPool pool;
+  FakeBlocks blocks;
+  blocks.Reset(pool, 64 * 1024);
+
+  std::vector<HeapBlockPool::Allocation> allocations(4);
+  for (auto& a : allocations)
+    CHECK(pool.Allocate(16 * 1024, 4096, a));
+  CHECK_EQUAL(1, blocks.createCount);
+  // 満杯になると次のブロックを追加する.
+  HeapBlockPool::Allocation extra{};
+  CHECK(pool.Allocate(16 * 1024, 4096, extra));
+  CHECK_EQUAL(2, blocks.createCount);
+  CHECK(extra.blockIndex != allocations[0].blockIndex);
+
+  // 通常のブロックは空になっても 1 つは残す.
+  pool.Free(extra);
+  for (auto& a : allocations)
+    pool.Free(a);
+  CHECK_EQUAL(1, blocks.CountAlive());
+  pool.Clear();
+  CHECK_EQUAL(0, blocks.CountAlive());
+}
+
+TEST_CASE("HeapBlockPool/FailedAllocationDestroysNewBlock")
+{
+  HeapBlockPool pool;
+  FakeBlocks blocks;
+  blocks.Reset(pool, 64 * 1024);
+
+  // 追加したブロックから切り出せない要求(サイズ 0)でも、空のブロックを残さない.
+  HeapBlockPool::Allocation allocation{};
+  CHECK(!pool.Allocate(0, 256, allocation));
+  CHECK(!pool.Allocate(0, 256, allocation));
+  CHECK_EQUAL(blocks.createCount, blocks.destroyCount);
+  CHECK_EQUAL(0, blocks.CountAlive());
+  CHECK_EQUAL(0u, pool.GetStats().blockCount);
+
+  // 生成に失敗した場合も何も残らない.
+  blocks.isCreateFailing = true;
+  CHECK(!pool.Allocate(1024, 256, allocation));
+  CHECK_EQUAL(0u, pool.GetStats().blockCount);
+}
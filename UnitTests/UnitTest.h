@@ -0,0 +1,62 @@
+﻿#pragma once
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// GPU を使わずに common のクラスを確かめる小さなテストの仕組み.
+// TEST_CASE で登録した関数を main から順に呼び、CHECK の失敗を数える.
+namespace unit_test
+{
+  struct TestCase
+  {
+    const char* name;
+    std::function<void()> func;
+    bool isBenchmark;
+  };
+
+  inline std::vector<TestCase>& GetTestCases()
+  {
+    static std::vector<TestCase> testCases;
+    return testCases;
+  }
+  inline int& GetFailureCount()
+  {
+    static int failureCount = 0;
+    return failureCount;
+  }
+
+  struct Registrar
+  {
+    Registrar(const char* name, std::function<void()> func, bool isBenchmark)
+    {
+      GetTestCases().push_back(TestCase{ name, func, isBenchmark });
+    }
+  };
+
+  inline void ReportFailure(const char* file, int line, const char* expr)
+  {
+    std::printf("  FAILED %s(%d): %s\n", file, line, expr);
+    ++GetFailureCount();
+  }
+}
+
+#define UNIT_TEST_CONCAT_(a, b) a##b
+#define UNIT_TEST_CONCAT(a, b) UNIT_TEST_CONCAT_(a, b)
+#define UNIT_TEST_REGISTER(name, isBenchmark) \
+  static void UNIT_TEST_CONCAT(UnitTestFunc_, __LINE__)(); \
+  static unit_test::Registrar UNIT_TEST_CONCAT(s_unitTestRegistrar_, __LINE__)(name, &UNIT_TEST_CONCAT(UnitTestFunc_, __LINE__), isBenchmark); \
+  static void UNIT_TEST_CONCAT(UnitTestFunc_, __LINE__)()
+
+// テストの本体. 名前は "クラス名/内容" とする.
+#define TEST_CASE(name) UNIT_TEST_REGISTER(name, false)
+// 時間を計って表示するだけのもの. main に /bench を渡した場合のみ実行する.
+#define BENCHMARK_CASE(name) UNIT_TEST_REGISTER(name, true)
+
+#define CHECK(expr) \
+  do { if (!(expr)) { unit_test::ReportFailure(__FILE__, __LINE__, #expr); } } while (0)
+#define CHECK_EQUAL(expected, actual) \
+  do { if (!((expected) == (actual))) { unit_test::ReportFailure(__FILE__, __LINE__, #expected " == " #actual); } } while (0)
+#define CHECK_THROWS(expr) \
+  do { bool isThrown_ = false; try { expr; } catch (...) { isThrown_ = true; } \
+    if (!isThrown_) { unit_test::ReportFailure(__FILE__, __LINE__, "throws " #expr); } } while (0)
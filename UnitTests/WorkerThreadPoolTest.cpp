@@ -0,0 +1,156 @@
+﻿#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "UnitTest.h"
+#include "WorkerThreadPool.h"
+
+namespace
+{
+  // 描画コマンド1つ分の記録の代わりに、結果を捨てられない程度の計算をする.
+  uint32_t SimulateDraw(uint32_t seed)
+  {
+    for (int i = 0; i < 64; ++i)
+    {
+      seed = seed * 1664525u + 1013904223u;
+    }
+    return seed;
+  }
+  // 10, 11 のフレームに合わせ、シャドウとメインはモデル毎のサブメッシュを、ImGui は少しだけ記録する.
+  uint32_t SimulatePass(size_t pass, int modelCount, int meshCount)
+  {
+    const int drawCount = pass == 2 ? 32 : modelCount * meshCount;
+    uint32_t result = uint32_t(pass);
+    for (int i = 0; i < drawCount; ++i)
+    {
+      result ^= SimulateDraw(uint32_t(i));
+    }
+    return result;
+  }
+}
+
+TEST_CASE("WorkerThreadPool/RunsEveryIndexOnce")
+{
+  WorkerThreadPool pool(3);
+  CHECK_EQUAL(3u, pool.GetWorkerCount());
+  const size_t counts[] = { 1, 2, 3, 4, 17, 1000 };
+  for (auto count : counts)
+  {
+    std::vector<std::atomic<int>> visited(count);
+    for (auto& v : visited)
+      v = 0;
+    pool.Run(count, [&](size_t i) { ++visited[i]; });
+    for (auto& v : visited)
+      CHECK_EQUAL(1, v.load());
+  }
+  // 0 件では何も呼ばない.
+  bool isCalled = false;
+  pool.Run(0, [&](size_t) { isCalled = true; });
+  CHECK(!isCalled);
+}
+
+TEST_CASE("WorkerThreadPool/ReusedAcrossManyRuns")
+{
+  // フレーム毎の Record と同じく、少ない件数で何度も呼んでも取りこぼしや待ち合わせの漏れが無い.
+  WorkerThreadPool pool(2);
+  std::atomic<int> total(0);
+  for (int frame = 0; frame < 2000; ++frame)
+  {
+    pool.Run(3, [&](size_t i) { total += int(i) + 1; });
+  }
+  CHECK_EQUAL(2000 * 6, total.load());
+}
+
+TEST_CASE("WorkerThreadPool/UsesWorkerThreads")
+{
+  WorkerThreadPool pool(3);
+  std::vector<std::thread::id> ids(4);
+  std::atomic<int> arrived(0);
+  // 全員が揃うまで待たせ、4 件が別々のスレッドで同時に動くことを確かめる.
+  pool.Run(4, [&](size_t i) {
+    ids[i] = std::this_thread::get_id();
+    ++arrived;
+    auto start = std::chrono::steady_clock::now();
+    while (arrived < 4 && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+      std::this_thread::yield();
+  });
+  CHECK_EQUAL(4, arrived.load());
+  for (size_t i = 0; i < ids.size(); ++i)
+    for (size_t j = i + 1; j < ids.size(); ++j)
+      CHECK(ids[i] != ids[j]);
+}
+
+TEST_CASE("WorkerThreadPool/RethrowsLowestIndexAfterAll")
+{
+  WorkerThreadPool pool(2);
+  std::atomic<int> finished(0);
+  int caught = -1;
+  try
+  {
+    pool.Run(8, [&](size_t i) {
+      if (i == 5 || i == 2)
+        throw std::runtime_error(i == 2 ? "2" : "5");
+      ++finished;
+    });
+  }
+  catch (const std::runtime_error& e)
+  {
+    caught = e.what()[0] - '0';
+  }
+  CHECK_EQUAL(2, caught);
+  CHECK_EQUAL(6, finished.load());
+  // 例外の後も続けて使える.
+  std::atomic<int> count(0);
+  pool.Run(4, [&](size_t) { ++count; });
+  CHECK_EQUAL(4, count.load());
+}
+
+BENCHMARK_CASE("WorkerThreadPool/RecordManyModelsPerFrame")
+{
+  // 11_Animation で描画回数を最大 (512 体, 1 体 17 サブメッシュ) にした場合のパス構成で、
+  // パス毎にスレッドを作る方式と常駐ワーカーとでフレーム当たりの時間を比べる.
+  const int modelCounts[] = { 1, 64, 512 };
+  const int meshCount = 17;
+  const size_t passCount = 3;
+  const int frameCount = 300;
+  std::vector<uint32_t> results(passCount);
+  WorkerThreadPool pool(unsigned(passCount - 1));
+
+  for (auto modelCount : modelCounts)
+  {
+    auto record = [&](size_t pass) { results[pass] = SimulatePass(pass, modelCount, meshCount); };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+      for (size_t i = 0; i < passCount; ++i)
+        record(i);
+    }
+    auto serialMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+      std::vector<std::thread> threads;
+      for (size_t i = 1; i < passCount; ++i)
+        threads.emplace_back(record, i);
+      record(0);
+      for (auto& t : threads)
+        t.join();
+    }
+    auto spawnMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+      pool.Run(passCount, record);
+    }
+    auto poolMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::printf("  %3d models: serial %.3f ms/frame, thread per pass %.3f ms/frame, workers %.3f ms/frame\n",
+      modelCount, serialMs / frameCount, spawnMs / frameCount, poolMs / frameCount);
+  }
+}
@@ -0,0 +1,59 @@
+﻿#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include "UnitTest.h"
+
+// common のクラスのうち、GPU を使わずに動かせるものの単体テスト.
+//
+//   UnitTests.exe [/bench] [名前の一部]
+//
+// 名前の一部を渡した場合は、名前にそれを含むテストのみ実行する.
+// /bench を渡すとベンチマークも実行する. 時間は Release 構成で計ること.
+// 失敗したテストがあれば 1 を返す.
+int main(int argc, char* argv[])
+{
+  bool isBenchmarkEnabled = false;
+  const char* filter = nullptr;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "/bench") == 0)
+    {
+      isBenchmarkEnabled = true;
+    }
+    else
+    {
+      filter = argv[i];
+    }
+  }
+
+  int runCount = 0, failedCount = 0;
+  for (const auto& testCase : unit_test::GetTestCases())
+  {
+    if (testCase.isBenchmark && !isBenchmarkEnabled)
+      continue;
+    if (filter && std::strstr(testCase.name, filter) == nullptr)
+      continue;
+
+    std::printf("[ RUN  ] %s\n", testCase.name);
+    const int failuresBefore = unit_test::GetFailureCount();
+    auto start = std::chrono::high_resolution_clock::now();
+    try
+    {
+      testCase.func();
+    }
+    catch (const std::exception& e)
+    {
+      std::printf("  FAILED exception: %s\n", e.what());
+      ++unit_test::GetFailureCount();
+    }
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    const bool isFailed = unit_test::GetFailureCount() != failuresBefore;
+    std::printf("[ %s ] %s (%.2f ms)\n", isFailed ? "FAIL" : " OK ", testCase.name, ms);
+    ++runCount;
+    failedCount += isFailed ? 1 : 0;
+  }
+  std::printf("%d tests, %d failed.\n", runCount, failedCount);
+  return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+﻿#include "CommandContextPool.h"
+#include "D3D12BookUtil.h"
+
+#include <chrono>
+#include <exception>
+
+CommandContextPool::CommandContextPool()
+  : m_type(D3D12_COMMAND_LIST_TYPE_DIRECT), m_stats(), m_lastTiming()
+{
+}
+
+CommandContextPool::~CommandContextPool()
+{
+  Cleanup();
+}
+
+void CommandContextPool::Prepare(
+  ComPtr<ID3D12Device> device,
+  ComPtr<ID3D12CommandQueue> queue,
+  std::shared_ptr<TimelineFence> queueFence,
+  D3D12_COMMAND_LIST_TYPE type,
+  std::shared_ptr<ResourceStateTable> stateTable)
+{
+  m_device = device;
+  m_queue = queue;
+  m_queueFence = queueFence;
+  m_type = type;
+  // 共有のテーブルが無い場合も、リスト内の追跡とまとめは行えるよう専用のものを持つ.
+  m_stateTable = stateTable ? stateTable : std::make_shared<ResourceStateTable>();
+  m_stats = Stats{};
+}
+
+void CommandContextPool::Cleanup()
+{
+  // GPU の完了は呼び出し側で待っておくこと.
+  m_recordWorkers.reset();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_recording.clear();
+  m_freeCommandLists.clear();
+  m_allocators.Clear();
+  m_queueFence.reset();
+  m_stateTable.reset();
+  m_queue.Reset();
+  m_device.Reset();
+}
+
+CommandContextPool::GraphicsCommandList CommandContextPool::Begin()
+{
+  HRESULT hr;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto allocator = AcquireAllocator();
+
+  GraphicsCommandList commandList;
+  if (m_freeCommandLists.empty())
+  {
+    hr = m_device->CreateCommandList(0, m_type, allocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
+    ThrowIfFailed(hr, "CreateCommandList Failed.");
+    ++m_stats.commandListCount;
+  }
+  else
+  {
+    commandList = m_freeCommandLists.back();
+    m_freeCommandLists.pop_back();
+    hr = commandList->Reset(allocator.Get(), nullptr);
+    ThrowIfFailed(hr, "CommandList Reset Failed.");
+  }
+  auto states = std::make_shared<ResourceStateTracker>(m_stateTable.get());
+  m_recording[commandList.Get()] = RecordingState{ allocator, false, states };
+  return commandList;
+}
+
+void CommandContextPool::Close(GraphicsCommandList& commandList)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itr = m_recording.find(commandList.Get());
+    if (itr == m_recording.end() || itr->second.isClosed)
+    {
+      return;
+    }
+    itr->second.isClosed = true;
+  }
+  FlushBarriers(commandList);
+  commandList->Close();
+}
+
+void CommandContextPool::Transition(const GraphicsCommandList& commandList, ID3D12Resource* resource,
+  D3D12_RESOURCE_STATES state, UINT subresource)
+{
+  GetStateTracker(commandList.Get())->Transition(resource, uint32_t(state), subresource);
+}
+
+void CommandContextPool::UAVBarrier(const GraphicsCommandList& commandList, ID3D12Resource* resource)
+{
+  GetStateTracker(commandList.Get())->UAVBarrier(resource);
+}
+
+void CommandContextPool::AliasingBarrier(const GraphicsCommandList& commandList, ID3D12Resource* resourceBefore, ID3D12Resource* resource)
+{
+  GetStateTracker(commandList.Get())->AliasingBarrier(resourceBefore, resource);
+}
+
+void CommandContextPool::FlushBarriers(const GraphicsCommandList& commandList)
+{
+  auto states = GetStateTracker(commandList.Get());
+  if (!states->HasPendingBarriers())
+  {
+    return;
+  }
+  std::vector<ResourceStateTracker::Barrier> barriers;
+  states->Flush(barriers);
+  RecordBarriers(commandList.Get(), barriers);
+}
+
+TimelineFence::Ticket CommandContextPool::Submit(const GraphicsCommandList* commandLists, UINT count)
+{
+  // 各リストで初めて使ったリソースの遷移は、投入順にステートを確定させながら、そのリストの前に置く.
+  std::vector<GraphicsCommandList> submitted;
+  std::vector<ResourceStateTracker::Barrier> barriers;
+  for (UINT i = 0; i < count; ++i)
+  {
+    auto states = GetStateTracker(commandLists[i].Get());
+    if (!states)
+    {
+      submitted.push_back(commandLists[i]);
+      continue;
+    }
+    auto commandList = commandLists[i];
+    Close(commandList);
+    states->Resolve(*m_stateTable, barriers);
+    if (!barriers.empty())
+    {
+      auto fixup = Begin();
+      RecordBarriers(fixup.Get(), barriers);
+      Close(fixup);
+      submitted.push_back(fixup);
+    }
+    submitted.push_back(commandList);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    AddTrackerStats(*states);
+  }
+
+  count = UINT(submitted.size());
+  std::vector<ID3D12CommandList*> lists(count);
+  std::vector<ComPtr<ID3D12CommandAllocator>> allocators;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (UINT i = 0; i < count; ++i)
+    {
+      auto commandList = submitted[i].Get();
+      auto itr = m_recording.find(commandList);
+      if (itr != m_recording.end())
+      {
+        allocators.push_back(itr->second.allocator);
+        m_recording.erase(itr);
+        // 投入後のリストはすぐにリセットできるため、プールへ戻す.
+        m_freeCommandLists.push_back(submitted[i]);
+      }
+      lists[i] = commandList;
+    }
+  }
+  TimelineFence::Ticket ticket;
+  {
+    // チケットがこの投入の位置を指すよう、実行と Signal の間に他のスレッドの投入を入れない.
+    std::lock_guard<std::mutex> lock(m_submitMutex);
+    m_queue->ExecuteCommandLists(count, lists.data());
+    ticket = m_queueFence->Signal();
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& allocator : allocators)
+  {
+    m_allocators.Release(allocator, ticket);
+  }
+  ++m_stats.submitCount;
+  m_stats.submittedListCount += count;
+  return ticket;
+}
+
+std::vector<CommandContextPool::GraphicsCommandList> CommandContextPool::Record(const std::vector<RecordFunc>& passes, bool isParallel)
+{
+  using clock = std::chrono::high_resolution_clock;
+  const auto passCount = passes.size();
+  std::vector<GraphicsCommandList> commandLists(passCount);
+  std::vector<std::exception_ptr> errors(passCount);
+  m_lastTiming.passMs.assign(passCount, 0.0);
+
+  auto record = [&](size_t i) {
+    try
+    {
+      auto start = clock::now();
+      commandLists[i] = Begin();
+      passes[i](commandLists[i]);
+      Close(commandLists[i]);
+      m_lastTiming.passMs[i] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  auto start = clock::now();
+  if (isParallel && passCount > 1)
+  {
+    // 呼び出したスレッドも記録に加わるため、ワーカーはパス数 - 1 本あればよい.
+    // パスが増えた場合に限り作り直す.
+    if (!m_recordWorkers || m_recordWorkers->GetWorkerCount() < passCount - 1)
+    {
+      m_recordWorkers.reset();
+      m_recordWorkers.reset(new WorkerThreadPool(unsigned(passCount - 1)));
+    }
+    m_recordWorkers->Run(passCount, record);
+  }
+  else
+  {
+    for (size_t i = 0; i < passCount; ++i)
+    {
+      record(i);
+    }
+  }
+  m_lastTiming.wallMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+  for (auto& error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+  return commandLists;
+}
+
+CommandContextPool::Stats CommandContextPool::GetStats()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto stats = m_stats;
+  stats.freeAllocatorCount = UINT(m_allocators.GetFreeCount());
+  stats.pendingAllocatorCount = UINT(m_allocators.GetPendingCount());
+  return stats;
+}
+
+std::shared_ptr<ResourceStateTracker> CommandContextPool::GetStateTracker(ID3D12GraphicsCommandList* commandList)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto itr = m_recording.find(commandList);
+  return itr != m_recording.end() ? itr->second.states : nullptr;
+}
+
+void CommandContextPool::RecordBarriers(ID3D12GraphicsCommandList* commandList, const std::vector<ResourceStateTracker::Barrier>& barriers)
+{
+  std::vector<D3D12_RESOURCE_BARRIER> d3dBarriers;
+  d3dBarriers.reserve(barriers.size());
+  for (const auto& barrier : barriers)
+  {
+    // キーは ID3D12Resource のアドレス.
+    auto resource = static_cast<ID3D12Resource*>(const_cast<void*>(barrier.resource));
+    switch (barrier.type)
+    {
+    case ResourceStateTracker::Barrier::TYPE_TRANSITION:
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+        D3D12_RESOURCE_STATES(barrier.before), D3D12_RESOURCE_STATES(barrier.after), barrier.subresource));
+      break;
+    case ResourceStateTracker::Barrier::TYPE_ALIASING:
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+        static_cast<ID3D12Resource*>(const_cast<void*>(barrier.resourceBefore)), resource));
+      break;
+    case ResourceStateTracker::Barrier::TYPE_UAV:
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+      break;
+    }
+  }
+  commandList->ResourceBarrier(UINT(d3dBarriers.size()), d3dBarriers.data());
+}
+
+void CommandContextPool::AddTrackerStats(const ResourceStateTracker& states)
+{
+  const auto& stats = states.GetStats();
+  m_stats.barrierCount += stats.barrierCount;
+  m_stats.barrierBatchCount += stats.flushCount + (stats.resolvedCount > 0 ? 1 : 0);
+  m_stats.skippedBarrierCount += stats.skippedCount + stats.elidedCount;
+  m_stats.resolvedBarrierCount += stats.resolvedCount;
+}
+
+CommandContextPool::ComPtr<ID3D12CommandAllocator> CommandContextPool::AcquireAllocator()
+{
+  // 完了したチケットのアロケータはリセットして再利用する.
+  return m_allocators.Acquire(m_queueFence->GetCompletedValue(),
+    [this]() {
+      ComPtr<ID3D12CommandAllocator> allocator;
+      HRESULT hr = m_device->CreateCommandAllocator(m_type, IID_PPV_ARGS(&allocator));
+      ThrowIfFailed(hr, "CreateCommandAllocator Failed.");
+      ++m_stats.allocatorCount;
+      return allocator;
+    },
+    [](ComPtr<ID3D12CommandAllocator>& allocator) { allocator->Reset(); });
+}
@@ -0,0 +1,112 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "TimelineFence.h"
+#include "FencedPool.h"
+#include "ResourceStateTracker.h"
+#include "WorkerThreadPool.h"
+
+// コマンドアロケータとコマンドリストのプール.
+// Begin で取り出したリストは、Submit でキューへ投入した時点でプールへ戻る.
+// アロケータは投入時のチケットが完了するまで使用中として扱い、完了後にリセットして再利用する.
+// Begin/Close はどのスレッドからでも呼べるため、パス毎にスレッドを分けて記録できる.
+// リスト毎にリソースステートを追跡し、Transition で積んだバリアは FlushBarriers か Close でまとめて記録する.
+// リスト内で初めて使うリソースの遷移は、投入時に共有のステートテーブルと比べて前に置く.
+class CommandContextPool
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+  using GraphicsCommandList = ComPtr<ID3D12GraphicsCommandList>;
+  using RecordFunc = std::function<void(GraphicsCommandList& commandList)>;
+
+  struct Stats
+  {
+    UINT allocatorCount;         // 生成したアロケータの数.
+    UINT freeAllocatorCount;
+    UINT pendingAllocatorCount;  // GPU の完了待ち.
+    UINT commandListCount;       // 生成したコマンドリストの数.
+    UINT64 submitCount;          // ExecuteCommandLists の呼び出し回数.
+    UINT64 submittedListCount;
+    UINT64 barrierCount;         // 記録したバリアの累計 (投入時に前へ置いたものを含む).
+    UINT64 barrierBatchCount;    // ResourceBarrier の呼び出し回数の累計.
+    UINT64 skippedBarrierCount;  // 不要として出さなかった遷移の累計.
+    UINT64 resolvedBarrierCount; // 投入時に前へ置いたバリアの累計.
+  };
+  // 直近の Record での記録時間.
+  struct RecordTiming
+  {
+    std::vector<double> passMs;  // パス毎の記録時間 (Close を含む).
+    double wallMs;               // 全パスの記録にかかった時間.
+  };
+
+  CommandContextPool();
+  ~CommandContextPool();
+
+  void Prepare(
+    ComPtr<ID3D12Device> device,
+    ComPtr<ID3D12CommandQueue> queue,
+    std::shared_ptr<TimelineFence> queueFence,
+    D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+    std::shared_ptr<ResourceStateTable> stateTable = nullptr);
+  void Cleanup();
+
+  // 記録可能な状態のコマンドリストを返す.
+  GraphicsCommandList Begin();
+  // 記録を終える. 投入前であれば Submit で閉じられるため、呼ばなくてもよい.
+  void Close(GraphicsCommandList& commandList);
+
+  // resource を state へ遷移させるバリアを積む. 既にそのステートであれば何もしない.
+  void Transition(const GraphicsCommandList& commandList, ID3D12Resource* resource,
+    D3D12_RESOURCE_STATES state, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+  void UAVBarrier(const GraphicsCommandList& commandList, ID3D12Resource* resource);
+  void AliasingBarrier(const GraphicsCommandList& commandList, ID3D12Resource* resourceBefore, ID3D12Resource* resource);
+  // 積んだバリアを1回の ResourceBarrier として記録する. 描画やコピーの直前に呼ぶ.
+  void FlushBarriers(const GraphicsCommandList& commandList);
+  // 渡した順で1回の ExecuteCommandLists として投入し、完了を示すチケットを返す.
+  TimelineFence::Ticket Submit(const GraphicsCommandList* commandLists, UINT count);
+  TimelineFence::Ticket Submit(std::vector<GraphicsCommandList>& commandLists)
+  {
+    return Submit(commandLists.data(), UINT(commandLists.size()));
+  }
+
+  // パス毎にコマンドリストを用意して記録する. isParallel ならパス毎に別スレッドで記録する.
+  // スレッドは初回に作って常駐させ、以降のフレームでも使い回す.
+  // 戻り値は passes と同じ順で、記録済み(Close 済み)のリスト.
+  std::vector<GraphicsCommandList> Record(const std::vector<RecordFunc>& passes, bool isParallel);
+
+  Stats GetStats();
+  const RecordTiming& GetLastRecordTiming() const { return m_lastTiming; }
+private:
+  struct RecordingState
+  {
+    ComPtr<ID3D12CommandAllocator> allocator;
+    bool isClosed;
+    std::shared_ptr<ResourceStateTracker> states;
+  };
+  ComPtr<ID3D12CommandAllocator> AcquireAllocator();
+  std::shared_ptr<ResourceStateTracker> GetStateTracker(ID3D12GraphicsCommandList* commandList);
+  void RecordBarriers(ID3D12GraphicsCommandList* commandList, const std::vector<ResourceStateTracker::Barrier>& barriers);
+  void AddTrackerStats(const ResourceStateTracker& states);
+
+  ComPtr<ID3D12Device> m_device;
+  ComPtr<ID3D12CommandQueue> m_queue;
+  std::shared_ptr<TimelineFence> m_queueFence;
+  D3D12_COMMAND_LIST_TYPE m_type;
+  std::shared_ptr<ResourceStateTable> m_stateTable;
+
+  std::mutex m_mutex;
+  std::mutex m_submitMutex;
+  FencedPool<ComPtr<ID3D12CommandAllocator>> m_allocators;
+  std::vector<GraphicsCommandList> m_freeCommandLists;
+  std::unordered_map<ID3D12GraphicsCommandList*, RecordingState> m_recording;
+  Stats m_stats;
+  RecordTiming m_lastTiming;
+  std::unique_ptr<WorkerThreadPool> m_recordWorkers;
+};
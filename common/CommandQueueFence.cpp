@@ -0,0 +1,45 @@
+﻿#include "CommandQueueFence.h"
+#include "D3D12BookUtil.h"
+
+CommandQueueFence::CommandQueueFence(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue)
+  : m_queue(queue)
+{
+  HRESULT hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence));
+  ThrowIfFailed(hr, "CreateFence 失敗");
+  m_waitEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+CommandQueueFence::~CommandQueueFence()
+{
+  CloseHandle(m_waitEvent);
+}
+
+std::shared_ptr<TimelineFence> CommandQueueFence::CreateTimeline(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue)
+{
+  return std::make_shared<TimelineFence>(std::make_unique<CommandQueueFence>(device, queue));
+}
+
+void CommandQueueFence::Signal(uint64_t value)
+{
+  HRESULT hr = m_queue->Signal(m_fence.Get(), value);
+  ThrowIfFailed(hr, "Signal 失敗");
+}
+
+uint64_t CommandQueueFence::GetCompletedValue() const
+{
+  return m_fence->GetCompletedValue();
+}
+
+bool CommandQueueFence::Wait(uint64_t value, uint32_t timeoutMs)
+{
+  HRESULT hr = m_fence->SetEventOnCompletion(value, m_waitEvent);
+  ThrowIfFailed(hr, "SetEventOnCompletion 失敗");
+  return WaitForSingleObject(m_waitEvent, timeoutMs) == WAIT_OBJECT_0;
+}
+
+void CommandQueueFence::QueueWait(TimelineFence::Backend& other, uint64_t value)
+{
+  auto& otherFence = static_cast<CommandQueueFence&>(other);
+  HRESULT hr = m_queue->Wait(otherFence.m_fence.Get(), value);
+  ThrowIfFailed(hr, "Wait 失敗");
+}
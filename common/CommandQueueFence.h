@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+
+#include "TimelineFence.h"
+
+// コマンドキューと ID3D12Fence による TimelineFence の実装.
+class CommandQueueFence : public TimelineFence::Backend
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  CommandQueueFence(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue);
+  ~CommandQueueFence();
+
+  // queue 用の TimelineFence を生成する.
+  static std::shared_ptr<TimelineFence> CreateTimeline(ComPtr<ID3D12Device> device, ComPtr<ID3D12CommandQueue> queue);
+
+  void Signal(uint64_t value) override;
+  uint64_t GetCompletedValue() const override;
+  bool Wait(uint64_t value, uint32_t timeoutMs) override;
+  // other も CommandQueueFence であること.
+  void QueueWait(TimelineFence::Backend& other, uint64_t value) override;
+
+  ComPtr<ID3D12CommandQueue> GetQueue() const { return m_queue; }
+  ComPtr<ID3D12Fence> GetFence() const { return m_fence; }
+private:
+  ComPtr<ID3D12CommandQueue> m_queue;
+  ComPtr<ID3D12Fence> m_fence;
+  HANDLE m_waitEvent;
+};
@@ -0,0 +1,187 @@
+﻿#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// 複数スレッドから並行してディスクリプタのインデックスを確保・解放するためのプール.
+// インデックスは BlockSize 個ずつのブロックにまとめ、ロックフリーのスタックで共有する.
+// 各スレッドは ThreadCache を持ち、ブロック単位で取り出して手元で払い出す.
+// 解放されたインデックスも手元に溜めてから、ブロック単位でまとめて戻す.
+// D3D12 には依存しないため、ヒープを作らずに動作を確認できる.
+class ConcurrentDescriptorPool
+{
+public:
+  enum : uint32_t {
+    BlockSize = 16,
+    InvalidIndex = 0xFFFFFFFFu,
+  };
+
+  // スレッドごとに用意する. 複数スレッドで1つのキャッシュを共有してはならない.
+  class ThreadCache
+  {
+  public:
+    explicit ThreadCache(ConcurrentDescriptorPool& pool) : m_pool(pool)
+    {
+      m_indices.reserve(BlockSize * 2);
+    }
+    ~ThreadCache() { Flush(); }
+    ThreadCache(const ThreadCache&) = delete;
+    ThreadCache& operator=(const ThreadCache&) = delete;
+
+    // 1つ確保する. プール全体に空きが無い場合は InvalidIndex.
+    uint32_t Allocate()
+    {
+      if (m_indices.empty() && !m_pool.PopBlock(m_indices))
+      {
+        return InvalidIndex;
+      }
+      auto index = m_indices.back();
+      m_indices.pop_back();
+      return index;
+    }
+
+    void Free(uint32_t index)
+    {
+      m_indices.push_back(index);
+      // 2ブロック分溜まったら1ブロック分を戻す(確保と解放の繰り返しで往復しないように).
+      if (m_indices.size() >= BlockSize * 2)
+      {
+        m_pool.PushBlock(m_indices.data() + m_indices.size() - BlockSize, BlockSize);
+        m_indices.resize(m_indices.size() - BlockSize);
+      }
+    }
+
+    // 手元のインデックスをすべてプールへ戻す.
+    void Flush()
+    {
+      while (!m_indices.empty())
+      {
+        auto count = std::min<size_t>(m_indices.size(), BlockSize);
+        m_pool.PushBlock(m_indices.data() + m_indices.size() - count, uint32_t(count));
+        m_indices.resize(m_indices.size() - count);
+      }
+    }
+    size_t GetCachedCount() const { return m_indices.size(); }
+  private:
+    ConcurrentDescriptorPool& m_pool;
+    std::vector<uint32_t> m_indices;
+  };
+
+  ConcurrentDescriptorPool() : m_baseIndex(0), m_count(0), m_fullHead(InvalidIndex), m_emptyHead(InvalidIndex) { }
+  ConcurrentDescriptorPool(const ConcurrentDescriptorPool&) = delete;
+  ConcurrentDescriptorPool& operator=(const ConcurrentDescriptorPool&) = delete;
+
+  // [baseIndex, baseIndex + count) を管理対象にする. 他スレッドが使用していない状態で呼ぶこと.
+  void Reset(uint32_t baseIndex, uint32_t count)
+  {
+    m_baseIndex = baseIndex;
+    m_count = count;
+    // 端数のブロックが増えても足りるよう、スロットはインデックスと同数用意する.
+    m_blocks.reset(new Block[count]);
+    m_next.reset(new std::atomic<uint32_t>[count]);
+    m_fullHead.store(InvalidIndex);
+    m_emptyHead.store(InvalidIndex);
+    uint32_t slot = 0;
+    for (uint32_t offset = 0; offset < count; offset += BlockSize, ++slot)
+    {
+      auto& block = m_blocks[slot];
+      block.count = std::min<uint32_t>(BlockSize, count - offset);
+      for (uint32_t i = 0; i < block.count; ++i)
+      {
+        block.indices[i] = baseIndex + offset + i;
+      }
+    }
+    // スタックは先頭から取り出されるよう逆順に積む.
+    for (uint32_t i = slot; i > 0; --i)
+    {
+      Push(m_fullHead, i - 1);
+    }
+    for (uint32_t i = count; i > slot; --i)
+    {
+      Push(m_emptyHead, i - 1);
+    }
+  }
+
+  bool Contains(uint32_t index) const
+  {
+    return index >= m_baseIndex && index - m_baseIndex < m_count;
+  }
+  uint32_t GetBaseIndex() const { return m_baseIndex; }
+  uint32_t GetCount() const { return m_count; }
+
+private:
+  struct Block
+  {
+    uint32_t count;
+    uint32_t indices[BlockSize];
+  };
+
+  // 1ブロック取り出して dst に追加する.
+  bool PopBlock(std::vector<uint32_t>& dst)
+  {
+    auto slot = Pop(m_fullHead);
+    if (slot == InvalidIndex)
+    {
+      return false;
+    }
+    const auto& block = m_blocks[slot];
+    dst.insert(dst.end(), block.indices, block.indices + block.count);
+    Push(m_emptyHead, slot);
+    return true;
+  }
+
+  void PushBlock(const uint32_t* indices, uint32_t count)
+  {
+    // 戻す側は未登録のインデックスを持っているため、空きスロットは必ず存在する.
+    // 他スレッドが一時的に取り出している間だけ待つ.
+    uint32_t slot;
+    while ((slot = Pop(m_emptyHead)) == InvalidIndex)
+    {
+      std::this_thread::yield();
+    }
+    auto& block = m_blocks[slot];
+    block.count = count;
+    std::copy(indices, indices + count, block.indices);
+    Push(m_fullHead, slot);
+  }
+
+  // 上位 32bit をタグとして更新ごとに進め、ABA 問題を避ける.
+  uint32_t Pop(std::atomic<uint64_t>& head)
+  {
+    auto old = head.load(std::memory_order_acquire);
+    for (;;)
+    {
+      auto slot = uint32_t(old);
+      if (slot == InvalidIndex)
+      {
+        return InvalidIndex;
+      }
+      auto next = m_next[slot].load(std::memory_order_relaxed);
+      auto desired = (((old >> 32) + 1) << 32) | next;
+      if (head.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        return slot;
+      }
+    }
+  }
+  void Push(std::atomic<uint64_t>& head, uint32_t slot)
+  {
+    auto old = head.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do
+    {
+      m_next[slot].store(uint32_t(old), std::memory_order_relaxed);
+      desired = (((old >> 32) + 1) << 32) | slot;
+    } while (!head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  std::unique_ptr<Block[]> m_blocks;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+  uint32_t m_baseIndex;
+  uint32_t m_count;
+  std::atomic<uint64_t> m_fullHead;
+  std::atomic<uint64_t> m_emptyHead;
+};
@@ -0,0 +1,633 @@
+﻿#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// シェーダーの定数バッファ (cbuffer) のレイアウトと、それを書き込む C++ の構造体との照合.
+// レイアウトは DXC のリフレクション (ShaderCache::ReflectConstantBuffers) か、HLSL のソースの cbuffer の宣言
+// (ParseConstantBuffers) から作る. 後者はコンパイラ無しで使えるが、変数を参照しているかは分からないため全て参照扱いにする.
+
+struct ConstantBufferVariable
+{
+  std::string name;
+  uint32_t offset;
+  uint32_t size;    // 配列の最後の要素の後ろの詰め物は含まない.
+  bool isUsed;      // シェーダーが参照している.
+};
+
+// [begin, end) のバイト範囲.
+struct ConstantBufferRange
+{
+  uint32_t begin;
+  uint32_t end;
+
+  bool IsEmpty() const { return begin >= end; }
+  uint32_t GetSize() const { return IsEmpty() ? 0 : end - begin; }
+  void Merge(const ConstantBufferRange& other)
+  {
+    if (other.IsEmpty())
+    {
+      return;
+    }
+    if (IsEmpty())
+    {
+      *this = other;
+      return;
+    }
+    begin = std::min(begin, other.begin);
+    end = std::max(end, other.end);
+  }
+};
+
+struct ConstantBufferLayout
+{
+  std::string name;
+  uint32_t bindPoint;   // register(bN) の N.
+  uint32_t space;
+  uint32_t size;        // 16 バイト単位.
+  std::vector<ConstantBufferVariable> variables;
+
+  const ConstantBufferVariable* FindVariable(const std::string& variableName) const
+  {
+    for (const auto& variable : variables)
+    {
+      if (variable.name == variableName)
+      {
+        return &variable;
+      }
+    }
+    return nullptr;
+  }
+  // シェーダーが参照する変数を全て含む範囲. 参照が無ければ空.
+  ConstantBufferRange GetUsedRange() const
+  {
+    ConstantBufferRange range{ 0, 0 };
+    for (const auto& variable : variables)
+    {
+      if (variable.isUsed)
+      {
+        range.Merge(ConstantBufferRange{ variable.offset, variable.offset + variable.size });
+      }
+    }
+    return range;
+  }
+};
+using ConstantBufferLayouts = std::vector<ConstantBufferLayout>;
+
+// C++ の構造体のメンバーと、それに対応する cbuffer の変数.
+struct ConstantBufferField
+{
+  const char* variable;
+  uint32_t offset;
+  uint32_t size;
+};
+// type::member を cbuffer の variable に対応付ける. 名前が同じなら member と同じものを書く.
+#define CONSTANT_BUFFER_FIELD(type, member, variable) \
+  ConstantBufferField{ #variable, uint32_t(offsetof(type, member)), uint32_t(sizeof(type::member)) }
+
+// layout と C++ の構造体 (fields, structSize) を照合し、食い違いを返す. 一致すれば空.
+// 参照される変数は全て fields に対応があり、オフセットが等しく、C++ 側が変数の全体を覆い、
+// シェーダーの読む範囲が構造体に収まっていること. 構造体にだけあるメンバーは問わない.
+inline std::vector<std::string> ValidateConstantBuffer(
+  const ConstantBufferLayout& layout, const std::vector<ConstantBufferField>& fields, uint32_t structSize)
+{
+  std::vector<std::string> errors;
+  auto prefix = layout.name + " (b" + std::to_string(layout.bindPoint) + "): ";
+  for (const auto& field : fields)
+  {
+    auto variable = layout.FindVariable(field.variable);
+    if (variable == nullptr)
+    {
+      // 参照の無い cbuffer はリフレクションに出てこないことがあるため、変数が1つも無い場合は問わない.
+      if (!layout.variables.empty())
+      {
+        errors.push_back(prefix + field.variable + " is not declared in the shader");
+      }
+      continue;
+    }
+    if (field.offset != variable->offset)
+    {
+      errors.push_back(prefix + field.variable + " offset " + std::to_string(field.offset) +
+        " (C++) != " + std::to_string(variable->offset) + " (HLSL)");
+    }
+    if (field.size < variable->size)
+    {
+      errors.push_back(prefix + field.variable + " size " + std::to_string(field.size) +
+        " (C++) < " + std::to_string(variable->size) + " (HLSL)");
+    }
+  }
+  for (const auto& variable : layout.variables)
+  {
+    if (!variable.isUsed)
+    {
+      continue;
+    }
+    auto itr = std::find_if(fields.begin(), fields.end(),
+      [&](const ConstantBufferField& field) { return variable.name == field.variable; });
+    if (itr == fields.end())
+    {
+      errors.push_back(prefix + variable.name + " has no C++ field");
+    }
+  }
+  auto used = layout.GetUsedRange();
+  if (used.end > structSize)
+  {
+    errors.push_back(prefix + "shader reads up to " + std::to_string(used.end) +
+      " bytes but the C++ struct is " + std::to_string(structSize) + " bytes");
+  }
+  return errors;
+}
+
+// パイプラインを構成するシェーダーの cbuffer をレジスタ毎にまとめたもの.
+// 照合 (Validate) と、書き込む範囲 (GetUsedRange) を求めるのに使う.
+class ConstantBufferBinding
+{
+public:
+  // 1つのシェーダーの cbuffer を加える. 同じレジスタのものは変数毎に参照の有無を合わせる.
+  void Add(const ConstantBufferLayouts& layouts)
+  {
+    for (const auto& layout : layouts)
+    {
+      auto key = std::make_pair(layout.space, layout.bindPoint);
+      auto itr = m_layouts.find(key);
+      if (itr == m_layouts.end())
+      {
+        m_layouts.emplace(key, layout);
+        continue;
+      }
+      auto& merged = itr->second;
+      merged.size = std::max(merged.size, layout.size);
+      for (const auto& variable : layout.variables)
+      {
+        auto existing = std::find_if(merged.variables.begin(), merged.variables.end(),
+          [&](const ConstantBufferVariable& v) { return v.name == variable.name; });
+        if (existing == merged.variables.end())
+        {
+          merged.variables.push_back(variable);
+          continue;
+        }
+        if (existing->offset != variable.offset || existing->size != variable.size)
+        {
+          m_conflicts.push_back(merged.name + " (b" + std::to_string(merged.bindPoint) + "): " +
+            variable.name + " differs between shaders");
+        }
+        existing->isUsed = existing->isUsed || variable.isUsed;
+      }
+    }
+  }
+  bool IsEmpty() const { return m_layouts.empty(); }
+
+  const ConstantBufferLayout* Find(uint32_t bindPoint, uint32_t space = 0) const
+  {
+    auto itr = m_layouts.find(std::make_pair(space, bindPoint));
+    return itr != m_layouts.end() ? &itr->second : nullptr;
+  }
+
+  // register(b<bindPoint>) の cbuffer と構造体を照合する. レイアウトが無い (どのシェーダーも参照しない) 場合は空.
+  std::vector<std::string> Validate(
+    uint32_t bindPoint, const std::vector<ConstantBufferField>& fields, uint32_t structSize, uint32_t space = 0) const
+  {
+    std::vector<std::string> errors;
+    auto layout = Find(bindPoint, space);
+    if (layout == nullptr)
+    {
+      return errors;
+    }
+    auto prefix = layout->name + " (b" + std::to_string(layout->bindPoint) + "): ";
+    for (const auto& conflict : m_conflicts)
+    {
+      if (conflict.compare(0, prefix.size(), prefix) == 0)
+      {
+        errors.push_back(conflict);
+      }
+    }
+    auto result = ValidateConstantBuffer(*layout, fields, structSize);
+    errors.insert(errors.end(), result.begin(), result.end());
+    return errors;
+  }
+
+  // register(b<bindPoint>) の cbuffer のうちシェーダーが読む範囲. structSize を超えない.
+  // どのシェーダーも参照しない場合は空. リフレクションが得られなかった (何も Add していない) 場合は構造体の全体.
+  ConstantBufferRange GetUsedRange(uint32_t bindPoint, uint32_t structSize, uint32_t space = 0) const
+  {
+    if (IsEmpty())
+    {
+      return ConstantBufferRange{ 0, structSize };
+    }
+    auto layout = Find(bindPoint, space);
+    if (layout == nullptr)
+    {
+      return ConstantBufferRange{ 0, 0 };
+    }
+    auto range = layout->GetUsedRange();
+    range.end = std::min(range.end, structSize);
+    range.begin = std::min(range.begin, range.end);
+    return range;
+  }
+private:
+  std::map<std::pair<uint32_t, uint32_t>, ConstantBufferLayout> m_layouts;
+  std::vector<std::string> m_conflicts;
+};
+
+// HLSL のソースから cbuffer の宣言を読み、定数バッファのパッキング規則でオフセットを求める.
+// 扱うのは cbuffer に並べたスカラー, ベクトル, 行列 (row_major/column_major), 配列, 同じソースの struct で、
+// 配列の要素数は数値か、#define / static const で定義した名前. packoffset とインクルード先の宣言は扱わない.
+// 読めない宣言があれば false を返し、error に理由を入れる.
+class ConstantBufferParser
+{
+public:
+  static bool Parse(const std::string& source, ConstantBufferLayouts& layouts, std::string* error = nullptr)
+  {
+    ConstantBufferParser parser(source);
+    layouts.clear();
+    if (!parser.ParseSource(layouts))
+    {
+      if (error)
+      {
+        *error = parser.m_error;
+      }
+      return false;
+    }
+    return true;
+  }
+private:
+  enum : uint32_t { RegisterSize = 16 };
+
+  struct Type
+  {
+    uint32_t size;        // 詰め物を含まない大きさ.
+    bool isAligned;       // レジスタ (16 バイト) の先頭から置く (構造体, 配列, 行列).
+    std::vector<ConstantBufferVariable> members;
+  };
+
+  explicit ConstantBufferParser(const std::string& source) : m_position(0)
+  {
+    Tokenize(source);
+  }
+
+  static uint32_t AlignUp(uint32_t value) { return (value + RegisterSize - 1) / RegisterSize * RegisterSize; }
+
+  void Tokenize(const std::string& source)
+  {
+    size_t i = 0;
+    while (i < source.size())
+    {
+      char c = source[i];
+      if (c == '/' && i + 1 < source.size() && source[i + 1] == '/')
+      {
+        i = source.find('\n', i);
+        i = (i == std::string::npos) ? source.size() : i;
+        continue;
+      }
+      if (c == '/' && i + 1 < source.size() && source[i + 1] == '*')
+      {
+        i = source.find("*/", i + 2);
+        i = (i == std::string::npos) ? source.size() : i + 2;
+        continue;
+      }
+      if (c == '#')
+      {
+        // #define NAME 数値 だけを読む. 他のディレクティブは無視する.
+        auto end = source.find('\n', i);
+        end = (end == std::string::npos) ? source.size() : end;
+        ParseDefine(source.substr(i + 1, end - i - 1));
+        i = end;
+        continue;
+      }
+      if (isspace(static_cast<unsigned char>(c)))
+      {
+        ++i;
+        continue;
+      }
+      if (isalnum(static_cast<unsigned char>(c)) || c == '_')
+      {
+        size_t start = i;
+        while (i < source.size() && (isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_'))
+        {
+          ++i;
+        }
+        m_tokens.push_back(source.substr(start, i - start));
+        continue;
+      }
+      m_tokens.push_back(std::string(1, c));
+      ++i;
+    }
+  }
+  void ParseDefine(const std::string& line)
+  {
+    ConstantBufferParser directive(line);
+    if (directive.m_tokens.size() == 3 && directive.m_tokens[0] == "define" && IsNumber(directive.m_tokens[2]))
+    {
+      m_constants[directive.m_tokens[1]] = uint32_t(strtoul(directive.m_tokens[2].c_str(), nullptr, 0));
+    }
+  }
+  static bool IsNumber(const std::string& token)
+  {
+    return !token.empty() && isdigit(static_cast<unsigned char>(token[0]));
+  }
+
+  bool IsEnd() const { return m_position >= m_tokens.size(); }
+  const std::string& Peek(size_t offset = 0) const
+  {
+    static const std::string empty;
+    return m_position + offset < m_tokens.size() ? m_tokens[m_position + offset] : empty;
+  }
+  bool Accept(const std::string& token)
+  {
+    if (Peek() != token)
+    {
+      return false;
+    }
+    ++m_position;
+    return true;
+  }
+  bool Expect(const std::string& token)
+  {
+    if (Accept(token))
+    {
+      return true;
+    }
+    return Fail("expected '" + token + "' but found '" + Peek() + "'");
+  }
+  bool Fail(const std::string& message)
+  {
+    if (m_error.empty())
+    {
+      m_error = message;
+    }
+    return false;
+  }
+  // 対応する閉じ括弧の次まで飛ばす. 現在位置は開き括弧.
+  void SkipBlock()
+  {
+    int depth = 0;
+    do
+    {
+      if (Peek() == "{")
+      {
+        ++depth;
+      }
+      else if (Peek() == "}")
+      {
+        --depth;
+      }
+      ++m_position;
+    } while (!IsEnd() && depth > 0);
+  }
+
+  bool ParseSource(ConstantBufferLayouts& layouts)
+  {
+    while (!IsEnd())
+    {
+      if (Peek() == "struct" && Peek(2) == "{")
+      {
+        // 定数バッファに置けない型を含む構造体 (入出力など) は読み飛ばす. cbuffer で使えば未知の型になる.
+        auto name = Peek(1);
+        m_position += 2;
+        auto start = m_position;
+        Type type;
+        if (ParseMembers(type.members, type.size))
+        {
+          type.isAligned = true;
+          m_structs[name] = type;
+        }
+        else
+        {
+          m_position = start;
+          m_error.clear();
+          SkipBlock();
+        }
+        continue;
+      }
+      if (Peek() == "cbuffer")
+      {
+        ++m_position;
+        ConstantBufferLayout layout{ Peek(), 0, 0, 0, {} };
+        ++m_position;
+        if (!ParseRegister(layout) || !ParseMembers(layout.variables, layout.size))
+        {
+          return false;
+        }
+        layout.size = AlignUp(layout.size);
+        layouts.push_back(std::move(layout));
+        continue;
+      }
+      if (Peek() == "static" && Peek(1) == "const" && Peek(4) == "=" && IsNumber(Peek(5)))
+      {
+        m_constants[Peek(3)] = uint32_t(strtoul(Peek(5).c_str(), nullptr, 0));
+        m_position += 6;
+        continue;
+      }
+      if (Peek() == "{")
+      {
+        SkipBlock();
+        continue;
+      }
+      ++m_position;
+    }
+    return true;
+  }
+  // ": register(bN[, spaceM])". 省略時は b0, space0.
+  bool ParseRegister(ConstantBufferLayout& layout)
+  {
+    if (!Accept(":"))
+    {
+      return true;
+    }
+    if (!Expect("register") || !Expect("("))
+    {
+      return false;
+    }
+    auto slot = Peek();
+    if (slot.size() < 2 || slot[0] != 'b' || !IsNumber(slot.substr(1)))
+    {
+      return Fail("unsupported register '" + slot + "'");
+    }
+    layout.bindPoint = uint32_t(strtoul(slot.c_str() + 1, nullptr, 10));
+    ++m_position;
+    if (Accept(","))
+    {
+      auto space = Peek();
+      if (space.compare(0, 5, "space") != 0 || !IsNumber(space.substr(5)))
+      {
+        return Fail("unsupported space '" + space + "'");
+      }
+      layout.space = uint32_t(strtoul(space.c_str() + 5, nullptr, 10));
+      ++m_position;
+    }
+    return Expect(")");
+  }
+  // "{ 宣言; ... }" を読み、パッキング規則で並べる. size は最後の変数の末尾.
+  bool ParseMembers(std::vector<ConstantBufferVariable>& variables, uint32_t& size)
+  {
+    if (!Expect("{"))
+    {
+      return false;
+    }
+    size = 0;
+    while (!Accept("}"))
+    {
+      if (IsEnd())
+      {
+        return Fail("unexpected end of source");
+      }
+      bool isRowMajor = false;
+      while (Peek() == "row_major" || Peek() == "column_major" || Peek() == "precise" ||
+        Peek() == "nointerpolation" || Peek() == "linear" || Peek() == "noperspective" || Peek() == "centroid")
+      {
+        isRowMajor = isRowMajor || Peek() == "row_major";
+        ++m_position;
+      }
+      Type type;
+      if (!ResolveType(Peek(), isRowMajor, type))
+      {
+        return false;
+      }
+      ++m_position;
+      // "float a, b;" のように並べた宣言も読む.
+      do
+      {
+        ConstantBufferVariable variable{ Peek(), 0, type.size, true };
+        ++m_position;
+        uint32_t count = 1;
+        bool isArray = false;
+        while (Accept("["))
+        {
+          uint32_t dimension = 0;
+          if (IsNumber(Peek()))
+          {
+            dimension = uint32_t(strtoul(Peek().c_str(), nullptr, 0));
+          }
+          else if (m_constants.count(Peek()) > 0)
+          {
+            dimension = m_constants[Peek()];
+          }
+          else
+          {
+            return Fail("unknown array size '" + Peek() + "'");
+          }
+          ++m_position;
+          if (!Expect("]"))
+          {
+            return false;
+          }
+          count *= dimension;
+          isArray = true;
+        }
+        if (Peek() == ":")
+        {
+          // 構造体のセマンティクスは読み飛ばす. cbuffer の packoffset は扱わない.
+          if (Peek(1) == "packoffset")
+          {
+            return Fail("packoffset is not supported");
+          }
+          m_position += 2;
+        }
+        if (isArray)
+        {
+          // 配列の各要素はレジスタの先頭から置く. 最後の要素の後ろに詰め物は付かない.
+          variable.size = count == 0 ? 0 : AlignUp(type.size) * (count - 1) + type.size;
+        }
+        bool isAligned = type.isAligned || isArray;
+        uint32_t offset = size;
+        if (isAligned || (offset % RegisterSize) + variable.size > RegisterSize)
+        {
+          offset = AlignUp(offset);
+        }
+        variable.offset = offset;
+        size = offset + variable.size;
+        variables.push_back(variable);
+      } while (Accept(","));
+      if (!Expect(";"))
+      {
+        return false;
+      }
+    }
+    Accept(";");
+    return true;
+  }
+  bool ResolveType(const std::string& name, bool isRowMajor, Type& type)
+  {
+    auto itr = m_structs.find(name);
+    if (itr != m_structs.end())
+    {
+      type = itr->second;
+      return true;
+    }
+    // 要素の型と、ベクトルの次元 (float3) または行列の行数と列数 (float4x4).
+    static const char* scalars[] = { "float", "int", "uint", "bool", "dword", "half", "double", "min16float", "min16int", "min16uint" };
+    std::string base, suffix;
+    if (name == "matrix")
+    {
+      base = "float";
+      suffix = "4x4";
+    }
+    else if (name == "vector")
+    {
+      base = "float";
+      suffix = "4";
+    }
+    for (auto scalar : scalars)
+    {
+      if (base.empty() && name.compare(0, strlen(scalar), scalar) == 0)
+      {
+        base = scalar;
+        suffix = name.substr(base.size());
+      }
+    }
+    auto isDimension = [](char c) { return c >= '1' && c <= '4'; };
+    uint32_t rows = 1, columns = 1;
+    bool isMatrix = false;
+    if (suffix.size() == 1 && isDimension(suffix[0]))
+    {
+      columns = uint32_t(suffix[0] - '0');
+    }
+    else if (suffix.size() == 3 && isDimension(suffix[0]) && suffix[1] == 'x' && isDimension(suffix[2]))
+    {
+      rows = uint32_t(suffix[0] - '0');
+      columns = uint32_t(suffix[2] - '0');
+      isMatrix = true;
+    }
+    else if (!suffix.empty())
+    {
+      base.clear();
+    }
+    if (base.empty())
+    {
+      return Fail("unknown type '" + name + "'");
+    }
+    uint32_t scalarSize = base == "double" ? 8 : 4;
+    type.members.clear();
+    if (isMatrix)
+    {
+      // column_major (既定) は列毎、row_major は行毎に1レジスタを使う.
+      uint32_t registers = isRowMajor ? rows : columns;
+      uint32_t components = isRowMajor ? columns : rows;
+      type.size = RegisterSize * (registers - 1) + scalarSize * components;
+      type.isAligned = true;
+    }
+    else
+    {
+      type.size = scalarSize * columns;
+      type.isAligned = false;
+    }
+    return true;
+  }
+
+  std::vector<std::string> m_tokens;
+  size_t m_position;
+  std::map<std::string, Type> m_structs;
+  std::map<std::string, uint32_t> m_constants;
+  std::string m_error;
+};
+
+inline bool ParseConstantBuffers(const std::string& source, ConstantBufferLayouts& layouts, std::string* error = nullptr)
+{
+  return ConstantBufferParser::Parse(source, layouts, error);
+}
@@ -1,6 +1,8 @@
 ﻿#include "D3D12AppBase.h"
 #include <exception>
+#include <chrono>
 #include <fstream>
+#include <iterator>
 #if _MSC_VER > 1922 && !defined(_SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING)
 #define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
 #endif
@@ -17,13 +19,12 @@ using namespace Microsoft::WRL;
 D3D12AppBase::D3D12AppBase()
 {
   m_frameIndex = 0;
-  m_waitFence = CreateEvent(NULL, FALSE, FALSE, NULL);
+  m_startupMs = 0.0;
 }
 
 
 D3D12AppBase::~D3D12AppBase()
 {
-  CloseHandle(m_waitFence);
 }
 
 void D3D12AppBase::SetTitle(const std::string& title)
@@ -34,6 +35,7 @@ void D3D12AppBase::SetTitle(const std::string& title)
 void D3D12AppBase::Initialize(HWND hwnd, DXGI_FORMAT format, bool isFullscreen)
 {
   m_hwnd = hwnd;
+  auto startupBegin = chrono::high_resolution_clock::now();
   HRESULT hr;
   UINT dxgiFlags = 0;
 #if defined(_DEBUG)
@@ -85,6 +87,34 @@ void D3D12AppBase::Initialize(HWND hwnd, DXGI_FORMAT format, bool isFullscreen)
   hr = m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue));
   ThrowIfFailed(hr, "CreateCommandQueue 失敗");
 
+  m_queueFence = CommandQueueFence::CreateTimeline(m_device, m_commandQueue);
+  m_resourceStates = std::make_shared<ResourceStateTable>();
+  m_commandContextPool = std::make_shared<CommandContextPool>();
+  m_commandContextPool->Prepare(m_device, m_commandQueue, m_queueFence, D3D12_COMMAND_LIST_TYPE_DIRECT, m_resourceStates);
+
+  m_memoryAllocator = std::make_shared<GpuMemoryAllocator>();
+  m_memoryAllocator->Prepare(m_device);
+  m_uploadRing = std::make_shared<UploadRing>();
+  m_uploadRing->Prepare(this, UploadRingSize);
+  m_uploadManager = std::make_shared<UploadManager>();
+  m_uploadManager->Prepare(this, UploadStagingSize);
+  m_pipelineCache = std::make_shared<PipelineStateCache>();
+  m_pipelineCache->Prepare(m_device, PipelineCacheFileName);
+  m_shaderHotReload = std::make_shared<ShaderHotReload>();
+  m_shaderHotReload->Prepare(&GetShaderCache(), m_pipelineCache,
+    [this](ComPtr<IUnknown> old) { DeferRelease(old); }, ShaderPollIntervalMs);
+  m_shaderHotReload->SetEventCallback([](const ShaderHotReload::Event& event) {
+    char buf[256];
+    sprintf_s(buf, "Shader reload %ls: %s (%u pipelines, %.1f ms)\n",
+      event.fileName.c_str(), event.isSucceeded ? "succeeded" : "failed", event.pipelineCount, event.rebuildMs);
+    OutputDebugStringA(buf);
+    if (!event.isSucceeded)
+    {
+      OutputDebugStringA(event.message.c_str());
+      OutputDebugStringA("\n");
+    }
+  });
+
   // 各ディスクリプタヒープの準備.
   PrepareDescriptorHeaps();
 
@@ -155,8 +185,9 @@ void D3D12AppBase::Initialize(HWND hwnd, DXGI_FORMAT format, bool isFullscreen)
       nullptr,
       &swapchain);
     ThrowIfFailed(hr, "CreateSwapChainForHwnd 失敗");
-    m_swapchain = std::make_shared<Swapchain>(swapchain, m_heapRTV);
+    m_swapchain = std::make_shared<Swapchain>(swapchain, m_heapRTV, m_queueFence);
   }
+  RegisterSwapchainImages();
 
   factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER);
   m_surfaceFormat = m_swapchain->GetFormat();
@@ -164,75 +195,78 @@ void D3D12AppBase::Initialize(HWND hwnd, DXGI_FORMAT format, bool isFullscreen)
   //// デプスバッファ関連の準備.
   CreateDefaultDepthBuffer(m_width, m_height);
 
-  // コマンドアロケータ－の準備.
-  CreateCommandAllocators();
-
-  // コマンドリストの生成.
-  hr = m_device->CreateCommandList(
-    0,
-    D3D12_COMMAND_LIST_TYPE_DIRECT,
-    m_commandAllocators[0].Get(),
-    nullptr,
-    IID_PPV_ARGS(&m_commandList)
-  );
-  ThrowIfFailed(hr, "CreateCommandList 失敗");
-  m_commandList->Close();
-
   m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, float(m_width), float(m_height));
   m_scissorRect = CD3DX12_RECT(0, 0, LONG(m_width), LONG(m_height));
 
   Prepare();
+
+  m_startupMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startupBegin).count();
+  auto cacheStats = m_pipelineCache->GetStats();
+  char buf[256];
+  sprintf_s(buf, "Startup %.1f ms (pipeline cache %s: %u requests, %u from library, %u compiled, %.1f ms)\n",
+    m_startupMs, cacheStats.isWarm ? "warm" : "cold", cacheStats.requestCount,
+    cacheStats.libraryHitCount, cacheStats.compiledCount, cacheStats.pipelineMs);
+  OutputDebugStringA(buf);
+  auto shaderStats = GetShaderCache().GetStats();
+  sprintf_s(buf, "Shader cache: %u requests, %u from archive (%zu bytes, %u stale), %u from disk, %u compiled (%.1f ms), load %.1f ms, batch wall %.1f ms\n",
+    shaderStats.requestCount, shaderStats.archiveHitCount, GetShaderCache().GetArchiveSize(),
+    shaderStats.archiveStaleCount, shaderStats.diskHitCount, shaderStats.compiledCount,
+    shaderStats.compileMs, shaderStats.loadMs, shaderStats.batchMs);
+  OutputDebugStringA(buf);
+  for (const auto& variant : GetShaderCache().GetVariantReport())
+  {
+    sprintf_s(buf, "  %ls (%ls): %u variants, %u compiled, %.1f ms\n",
+      variant.fileName.c_str(), variant.profile.c_str(),
+      variant.variantCount, variant.compiledCount, variant.compileMs);
+    OutputDebugStringA(buf);
+  }
 }
 
 void D3D12AppBase::Terminate()
 {
+  m_uploadManager->Cleanup();
   WaitForIdleGPU();
+  // 監視スレッドが作るパイプラインを止めてからキャッシュを保存する.
+  m_shaderHotReload->Cleanup();
   Cleanup();
+  m_pipelineCache->Cleanup();
+  m_releaseQueue.ReleaseAll();
+  m_bundleAllocators.Clear();
 }
 
 
 void D3D12AppBase::Render()
 {
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
-
-  m_commandAllocators[m_frameIndex]->Reset();
-  m_commandList->Reset(
-    m_commandAllocators[m_frameIndex].Get(),
-    nullptr
-  );
+  auto commandList = m_commandContextPool->Begin();
+  auto backBuffer = m_swapchain->GetImage(m_frameIndex);
 
   // スワップチェイン表示可能からレンダーターゲット描画可能へ
-  auto barrierToRT = m_swapchain->GetBarrierToRenderTarget();
-  m_commandList->ResourceBarrier(1, &barrierToRT);
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+  m_commandContextPool->FlushBarriers(commandList);
 
   auto rtv = m_swapchain->GetCurrentRTV();
   auto dsv = m_defaultDepthDSV;
 
   // カラーバッファ(レンダーターゲットビュー)のクリア
   const float clearColor[] = { 0.5f,0.75f,1.0f,0.0f }; // クリア色
-  m_commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+  commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
   
   // デプスバッファ(デプスステンシルビュー)のクリア
-  m_commandList->ClearDepthStencilView(
+  commandList->ClearDepthStencilView(
     dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
   // 描画先をセット
   D3D12_CPU_DESCRIPTOR_HANDLE handleRtvs[] = { rtv };
   D3D12_CPU_DESCRIPTOR_HANDLE handleDsv = dsv;
-  m_commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
+  commandList->OMSetRenderTargets(1, handleRtvs, FALSE, &handleDsv);
 
   ID3D12DescriptorHeap* heaps[] = { m_heap->GetHeap().Get() };
-  m_commandList->SetDescriptorHeaps(_countof(heaps), heaps);
-
-  // レンダーターゲットからスワップチェイン表示可能へ
-  auto barrierToPresent = m_swapchain->GetBarrierToPresent();
-  m_commandList->ResourceBarrier(1, &barrierToPresent);
-
-  m_commandList->Close();
-
-  ID3D12CommandList* lists[] = { m_commandList.Get() };
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  m_commandQueue->ExecuteCommandLists(1, lists);
+  // レンダーターゲットからスワップチェイン表示可能へ. バリアは Submit で閉じる際に記録される.
+  m_commandContextPool->Transition(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  m_commandContextPool->Submit(&commandList, 1);
 
   m_swapchain->Present(1, 0);
   m_swapchain->WaitPreviousFrame(m_commandQueue, m_frameIndex, GpuWaitTimeout);
@@ -245,19 +279,34 @@ D3D12AppBase::ComPtr<ID3D12Resource1> D3D12AppBase::CreateResource(
   const D3D12_CLEAR_VALUE* clearValue,
   D3D12_HEAP_TYPE heapType )
 {
-  HRESULT hr;
-  ComPtr<ID3D12Resource1> ret;
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(heapType);
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &desc,
-    resourceStates,
-    clearValue,
-    IID_PPV_ARGS(&ret)
-  );
-  ThrowIfFailed(hr, "CreateCommittedResource Failed.");
-  return ret;
+  auto resource = m_memoryAllocator->CreateResource(desc, resourceStates, clearValue, heapType);
+  // UPLOAD/READBACK ヒープのリソースはステートが変わらないため登録しない.
+  if (heapType == D3D12_HEAP_TYPE_DEFAULT)
+  {
+    RegisterResourceState(resource.Get(), resourceStates);
+  }
+  return resource;
+}
+
+void D3D12AppBase::RegisterResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+  auto desc = resource->GetDesc();
+  UINT subresourceCount = 1;
+  if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+  {
+    UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+    subresourceCount = desc.MipLevels * arraySize * D3D12GetFormatPlaneCount(m_device.Get(), desc.Format);
+  }
+  m_resourceStates->Register(resource, subresourceCount, uint32_t(state));
+}
+
+void D3D12AppBase::RegisterSwapchainImages()
+{
+  for (UINT i = 0; i < FrameBufferCount; ++i)
+  {
+    auto image = m_swapchain->GetImage(i);
+    RegisterResourceState(image.Get(), D3D12_RESOURCE_STATE_PRESENT);
+  }
 }
 
 std::vector<ComPtr<ID3D12Resource1>> D3D12AppBase::CreateConstantBuffers(const CD3DX12_RESOURCE_DESC& desc, int count)
@@ -275,42 +324,55 @@ std::vector<ComPtr<ID3D12Resource1>> D3D12AppBase::CreateConstantBuffers(const C
 
 D3D12AppBase::ComPtr<ID3D12GraphicsCommandList> D3D12AppBase::CreateCommandList()
 {
-  HRESULT hr;
-  ComPtr<ID3D12GraphicsCommandList> command;
-  hr = m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_oneshotCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&command));
-  ThrowIfFailed(hr, "CreateCommandList(OneShot) Failed.");
+  CollectDeferredReleases();
+  auto command = m_commandContextPool->Begin();
   command->SetName(L"OneShotCommand");
-  
   return command;
 }
 
 void D3D12AppBase::FinishCommandList(ComPtr<ID3D12GraphicsCommandList>& command)
 {
-  ID3D12CommandList* commandList[] = {
-    command.Get()
-  };
-  command->Close();
-  m_commandQueue->ExecuteCommandLists(1, commandList);
-  HRESULT hr;
-  ComPtr<ID3D12Fence1> fence;
-  hr = m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
-  ThrowIfFailed(hr, "CreateFence Failed.");
-  const UINT64 expectValue = 1;
-  m_commandQueue->Signal(fence.Get(), expectValue);
-  do
+  auto fenceValue = SubmitCommandList(command);
+  WaitForFrameFence(fenceValue);
+  CollectDeferredReleases();
+}
+
+UINT64 D3D12AppBase::SubmitCommandList(ComPtr<ID3D12GraphicsCommandList>& command)
+{
+  // アロケータは実行が終わるまでリセットできないため、プール側で完了後に再利用する.
+  return m_commandContextPool->Submit(&command, 1);
+}
+
+D3D12AppBase::ComPtr<ID3D12CommandAllocator> D3D12AppBase::AcquireBundleAllocator()
+{
+  return m_bundleAllocators.Acquire(m_queueFence->GetCompletedValue(),
+    [this]() {
+      ComPtr<ID3D12CommandAllocator> allocator;
+      HRESULT hr = m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&allocator));
+      ThrowIfFailed(hr, "CreateCommandAllocator Failed(bundle)");
+      return allocator;
+    },
+    [](ComPtr<ID3D12CommandAllocator>& allocator) { allocator->Reset(); });
+}
+
+void D3D12AppBase::RetireBundleAllocator(ComPtr<ID3D12CommandAllocator> allocator)
+{
+  if (allocator)
   {
-  } while (fence->GetCompletedValue() != expectValue);
-  m_oneshotCommandAllocator->Reset();
+    // 記録中のフレームが古いバンドルを使い終えるまではリセットしない.
+    m_bundleAllocators.Release(allocator, GetNextFrameFenceValue());
+  }
 }
 
-ComPtr<ID3D12GraphicsCommandList> D3D12AppBase::CreateBundleCommandList()
+ComPtr<ID3D12GraphicsCommandList> D3D12AppBase::CreateBundleCommandList(ID3D12CommandAllocator* allocator)
 {
   ComPtr<ID3D12GraphicsCommandList> command;
-  m_device->CreateCommandList(
+  HRESULT hr = m_device->CreateCommandList(
     0, D3D12_COMMAND_LIST_TYPE_BUNDLE,
-    m_bundleCommandAllocator.Get(),
+    allocator,
     nullptr, IID_PPV_ARGS(&command)
   );
+  ThrowIfFailed(hr, "CreateCommandList Failed(bundle)");
   return command;
 }
 
@@ -329,8 +391,10 @@ void D3D12AppBase::WriteToUploadHeapMemory(ID3D12Resource1* resource, uint32_t s
 void D3D12AppBase::PrepareDescriptorHeaps()
 {
   const int MaxDescriptorCount = 2048; // SRV,CBV,UAV など.
+  const int ConcurrentDescriptorCount = 512; // うち、ロード用スレッドから確保する分.
   const int MaxDescriptorCountRTV = 100;
   const int MaxDescriptorCountDSV = 100;
+  const int MaxDescriptorCountStaging = 256;
 
   // RTV のディスクリプタヒープ
   D3D12_DESCRIPTOR_HEAP_DESC heapDescRTV{
@@ -358,6 +422,16 @@ void D3D12AppBase::PrepareDescriptorHeaps()
     0
   };
   m_heap = std::make_shared<DescriptorManager>(m_device, heapDesc);
+  m_heap->EnableConcurrentAlloc(ConcurrentDescriptorCount);
+
+  // CPU 専用の SRV ディスクリプタヒープ(コピー元)
+  D3D12_DESCRIPTOR_HEAP_DESC heapDescStaging{
+    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+    MaxDescriptorCountStaging,
+    D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
+    0
+  };
+  m_heapStaging = std::make_shared<DescriptorManager>(m_device, heapDescStaging);
 }
 
 void D3D12AppBase::CreateDefaultDepthBuffer(int width, int height)
@@ -376,17 +450,12 @@ void D3D12AppBase::CreateDefaultDepthBuffer(int width, int height)
   depthClearValue.DepthStencil.Depth = 1.0f;
   depthClearValue.DepthStencil.Stencil = 0;
 
-  const auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-  HRESULT hr;
-  hr = m_device->CreateCommittedResource(
-    &heapProps,
-    D3D12_HEAP_FLAG_NONE,
-    &depthBufferDesc,
+  m_depthBuffer = CreateResource(
+    depthBufferDesc,
     D3D12_RESOURCE_STATE_DEPTH_WRITE,
     &depthClearValue,
-    IID_PPV_ARGS(&m_depthBuffer)
+    D3D12_HEAP_TYPE_DEFAULT
   );
-  ThrowIfFailed(hr, "CreateCommittedResource 失敗");
 
   // デプスステンシルビュー生成
   m_defaultDepthDSV = m_heapDSV->Alloc();
@@ -402,48 +471,60 @@ void D3D12AppBase::CreateDefaultDepthBuffer(int width, int height)
   m_device->CreateDepthStencilView(m_depthBuffer.Get(), &dsvDesc, m_defaultDepthDSV);
 }
 
-void D3D12AppBase::CreateCommandAllocators()
+ 
+void D3D12AppBase::WaitForFrameFence(UINT64 fenceValue)
 {
-  HRESULT hr;
-  m_commandAllocators.resize(FrameBufferCount);
-  for (UINT i = 0; i < FrameBufferCount; ++i)
+  m_queueFence->WaitFor(fenceValue);
+}
+
+void D3D12AppBase::DeferRelease(ComPtr<IUnknown> object)
+{
+  DeferRelease(object, GetNextFrameFenceValue());
+}
+
+void D3D12AppBase::DeferRelease(ComPtr<IUnknown> object, UINT64 fenceValue)
+{
+  if (!object)
   {
-    hr = m_device->CreateCommandAllocator(
-      D3D12_COMMAND_LIST_TYPE_DIRECT,
-      IID_PPV_ARGS(&m_commandAllocators[i])
-    );
-    if (FAILED(hr))
+    return;
+  }
+  // 参照をキューが保持し、完了時に手放す. 同じアドレスに別のリソースが作られる前にステートの登録も外す.
+  auto states = m_resourceStates;
+  m_releaseQueue.Enqueue(fenceValue, [object, states]() mutable {
+    ComPtr<ID3D12Resource> resource;
+    if (states && SUCCEEDED(object.As(&resource)))
     {
-      throw std::runtime_error("Failed CreateCommandAllocator");
+      states->Unregister(resource.Get());
     }
-  }
-  hr = m_device->CreateCommandAllocator(
-    D3D12_COMMAND_LIST_TYPE_DIRECT,
-    IID_PPV_ARGS(&m_oneshotCommandAllocator)
-  );
-  ThrowIfFailed(hr, "CreateCommandAllocator Failed(oneShot)");
+    object.Reset();
+  });
+}
 
-  hr = m_device->CreateCommandAllocator(
-    D3D12_COMMAND_LIST_TYPE_BUNDLE,
-    IID_PPV_ARGS(&m_bundleCommandAllocator)
-  );
-  ThrowIfFailed(hr, "CreateCommandAllocator Failed(bundle)");
+void D3D12AppBase::DeferFree(std::shared_ptr<DescriptorManager> heap, DescriptorHandle handle)
+{
+  m_releaseQueue.Enqueue(GetNextFrameFenceValue(), [heap, handle]() { heap->Free(handle); });
 }
- 
+
+void D3D12AppBase::DeferFree(const GpuMemoryAllocator::SmallBuffer& buffer)
+{
+  auto allocator = m_memoryAllocator;
+  m_releaseQueue.Enqueue(GetNextFrameFenceValue(), [allocator, buffer]() { allocator->FreeSmallBuffer(buffer); });
+}
+
+void D3D12AppBase::QueueWaitForUpload(UploadManager::Ticket ticket)
+{
+  m_uploadManager->QueueWait(*m_queueFence, ticket);
+}
+
+void D3D12AppBase::CollectDeferredReleases()
+{
+  m_releaseQueue.Collect(m_queueFence->GetCompletedValue());
+}
+
 void D3D12AppBase::WaitForIdleGPU()
 {
   // 全ての発行済みコマンドの終了を待つ.
-  ComPtr<ID3D12Fence1> fence;
-  const UINT64 expectValue = 1;
-  HRESULT hr = m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
-  ThrowIfFailed(hr, "CreateFence 失敗");
-
-  m_commandQueue->Signal(fence.Get(), expectValue);
-  if (fence->GetCompletedValue() != expectValue)
-  {
-    fence->SetEventOnCompletion(expectValue, m_waitFence);
-    WaitForSingleObject(m_waitFence, INFINITE);
-  }
+  m_queueFence->WaitIdle();
 }
 void D3D12AppBase::OnSizeChanged(UINT width, UINT height, bool isMinimized)
 {
@@ -452,13 +533,21 @@ void D3D12AppBase::OnSizeChanged(UINT width, UINT height, bool isMinimized)
   if (!m_swapchain || isMinimized)
     return;
 
-  // 処理の完了を待ってからサイズ変更の処理を開始.
-  WaitForIdleGPU();
+  // デプスバッファは描画中のフレームが使い終えてから解放する.
+  DeferRelease(m_depthBuffer);
+  DeferFree(m_heapDSV, m_defaultDepthDSV);
+  m_depthBuffer.Reset();
+
+  // スワップチェインのバッファは ResizeBuffers の前に GPU の使用が終わっている必要がある.
+  WaitForFrameFence(SignalFrameFence());
+  for (UINT i = 0; i < FrameBufferCount; ++i)
+  {
+    m_resourceStates->Unregister(m_swapchain->GetImage(i).Get());
+  }
   m_swapchain->ResizeBuffers(width, height);
+  RegisterSwapchainImages();
+  CollectDeferredReleases();
 
-  // デプスバッファの作り直し.
-  m_depthBuffer.Reset();
-  m_heapDSV->Free(m_defaultDepthDSV);
   CreateDefaultDepthBuffer(m_width, m_height);
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
@@ -497,52 +586,76 @@ void D3D12AppBase::ToggleFullscreen()
 HRESULT CompileShaderFromFile(
   const std::wstring& fileName, const std::wstring& profile, ComPtr<ID3DBlob>& shaderBlob, ComPtr<ID3DBlob>& errorBlob)
 {
-  using namespace std::experimental::filesystem;
-  path filePath(fileName);
-  std::ifstream infile(filePath, std::ifstream::binary);
-  std::vector<char> srcData;
-  if (!infile)
-    throw std::runtime_error("shader not found");
-  srcData.resize(uint32_t(infile.seekg(0, infile.end).tellg()));
-  infile.seekg(0, infile.beg).read(srcData.data(), srcData.size());
-
-  // DXC によるコンパイル処理
-  ComPtr<IDxcLibrary> library;
-  ComPtr<IDxcCompiler> compiler;
-  ComPtr<IDxcBlobEncoding> source;
-  ComPtr<IDxcOperationResult> dxcResult;
-
-  DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&library));
-  library->CreateBlobWithEncodingFromPinned(srcData.data(), UINT(srcData.size()), CP_ACP, &source);
-  DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
-
-  LPCWSTR compilerFlags[] = {
-#if _DEBUG
-    L"/Zi", L"/O0",
-#else
-    L"/O2" // リリースビルドでは最適化
-#endif
-  };
-  compiler->Compile(source.Get(), filePath.wstring().c_str(),
-    L"main", profile.c_str(),
-    compilerFlags, _countof(compilerFlags),
-    nullptr, 0, // Defines
-    nullptr,
-    &dxcResult);
+  return CompileShaderFromFile(fileName, profile, ShaderDefines(), shaderBlob, errorBlob);
+}
 
-  HRESULT hr;
-  dxcResult->GetStatus(&hr);
-  if (SUCCEEDED(hr))
+HRESULT CompileShaderFromFile(
+  const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines,
+  ComPtr<ID3DBlob>& shaderBlob, ComPtr<ID3DBlob>& errorBlob)
+{
+  return GetShaderCache().Compile(fileName, profile, defines, shaderBlob, errorBlob);
+}
+
+HRESULT CompileShadersFromFile(std::vector<ShaderCompileJob>& jobs)
+{
+  return GetShaderCache().CompileBatch(jobs);
+}
+
+ShaderPermutation LoadShaderPermutation(const std::wstring& fileName)
+{
+  return ShaderPermutation::FromFile(fileName, [](const std::wstring& name, std::string& source)
   {
-    dxcResult->GetResult(
-      reinterpret_cast<IDxcBlob**>(shaderBlob.GetAddressOf())
-    );
+    // アーカイブにはソースの代わりに機能キーの宣言が入っている.
+    if (GetShaderCache().FindFeatureDeclarations(name, source))
+    {
+      return true;
+    }
+    std::ifstream infile(std::experimental::filesystem::path(name), std::ifstream::binary);
+    if (!infile)
+    {
+      return false;
+    }
+    source.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+  });
+}
+
+ConstantBufferBinding ReflectConstantBuffers(const std::vector<const ShaderCompileJob*>& jobs)
+{
+  ConstantBufferBinding binding;
+  for (auto job : jobs)
+  {
+    ConstantBufferLayouts layouts;
+    if (!ShaderCache::ReflectConstantBuffers(job->shaderBlob.Get(), layouts))
+    {
+      return ConstantBufferBinding();
+    }
+    binding.Add(layouts);
   }
-  else
+  return binding;
+}
+
+void CheckConstantBufferLayout(
+  const ConstantBufferBinding& binding, UINT bindPoint, const std::vector<ConstantBufferField>& fields, UINT structSize)
+{
+  auto errors = binding.Validate(bindPoint, fields, structSize);
+  for (const auto& error : errors)
   {
-    dxcResult->GetErrorBuffer(
-      reinterpret_cast<IDxcBlobEncoding**>(errorBlob.GetAddressOf())
-    );
+    OutputDebugStringA((error + "\n").c_str());
+  }
+  if (!errors.empty())
+  {
+    throw book_util::DX12Exception("Constant buffer layout mismatch. " + errors.front());
   }
-  return hr;
+}
+
+ShaderCache& GetShaderCache()
+{
+  static ShaderCache cache;
+  static std::once_flag flag;
+  std::call_once(flag, []() {
+    cache.SetDirectory(D3D12AppBase::ShaderCacheDirectory);
+    cache.OpenArchive(D3D12AppBase::ShaderArchiveFileName);
+  });
+  return cache;
 }
\ No newline at end of file
@@ -8,8 +8,20 @@
 #include <wrl.h>
 
 #include "DescriptorManager.h"
+#include "CommandQueueFence.h"
+#include "CommandContextPool.h"
+#include "FencedPool.h"
+#include "DeferredReleaseQueue.h"
+#include "GpuMemoryAllocator.h"
+#include "UploadRing.h"
+#include "UploadManager.h"
+#include "PipelineStateCache.h"
+#include "ShaderCache.h"
+#include "ShaderPermutation.h"
+#include "ShaderHotReload.h"
 #include "Swapchain.h"
 #include <memory>
+#include <unordered_map>
 
 
 #pragma comment(lib, "d3d12.lib")
@@ -34,6 +46,13 @@ public:
 
   const UINT GpuWaitTimeout = (10 * 1000);  // 10s
   static const UINT FrameBufferCount = 2;
+  static const UINT UploadRingSize = 4 * 1024 * 1024;
+  static const UINT UploadStagingSize = 32 * 1024 * 1024;
+  static constexpr const wchar_t* PipelineCacheFileName = L"PipelineCache.bin";
+  static constexpr const wchar_t* ShaderCacheDirectory = L"ShaderCache";
+  // ShaderArchiver ō쐬A[JCu. ƃfBNgɂ΁A\[XD悵Ďg.
+  static constexpr const wchar_t* ShaderArchiveFileName = L"shaders.pak";
+  static const UINT ShaderPollIntervalMs = 250;
 
   virtual void OnSizeChanged(UINT width, UINT height, bool isMinimized);
   virtual void OnMouseButtonDown(UINT msg) { }
@@ -47,7 +66,7 @@ public:
   ComPtr<ID3D12Device> GetDevice() { return m_device; }
   std::shared_ptr<Swapchain> GetSwapchain() { return m_swapchain; }
 
-  // \[X
+  // \[X. q[vʂƂ̑傫ȃq[vzu\[XƂĐ؂o.
   ComPtr<ID3D12Resource1> CreateResource(
     const CD3DX12_RESOURCE_DESC& desc, 
     D3D12_RESOURCE_STATES resourceStates, 
@@ -61,22 +80,83 @@ public:
 
   // R}hobt@֘A
   ComPtr<ID3D12GraphicsCommandList>  CreateCommandList();
+  // sĊ܂őҋ@.
   void FinishCommandList(ComPtr<ID3D12GraphicsCommandList>& command);
-  ComPtr<ID3D12GraphicsCommandList> CreateBundleCommandList();
+  // ŝݍsAtFXlԂ. ]̃obt@ DeferRelease ֓n.
+  UINT64 SubmitCommandList(ComPtr<ID3D12GraphicsCommandList>& command);
+  // oh̃AP[^͎喈Ɏo. oh蒼ۂ́AÂoh DeferRelease A
+  // AP[^ RetireBundleAllocator ֕ԂĂV̂o.
+  // ԂAP[^ GPU ÂohgIĂ烊Zbgčėp.
+  ComPtr<ID3D12CommandAllocator> AcquireBundleAllocator();
+  void RetireBundleAllocator(ComPtr<ID3D12CommandAllocator> allocator);
+  ComPtr<ID3D12GraphicsCommandList> CreateBundleCommandList(ID3D12CommandAllocator* allocator);
+  size_t GetBundleAllocatorCount() const { return m_bundleAllocators.GetCreatedCount(); }
 
   void WriteToUploadHeapMemory(ID3D12Resource1* resource, uint32_t size, const void* pData);
 
+  std::shared_ptr<GpuMemoryAllocator> GetMemoryAllocator() { return m_memoryAllocator; }
+  // t[ɏ萔Ȃǂ̒uꏊ. BeginFrame/EndFrame ̓t[̊JnƓɌĂԂ.
+  std::shared_ptr<UploadRing> GetUploadRing() { return m_uploadRing; }
+  // AZbg̓]Rs[L[ł܂Ƃ߂čs.
+  std::shared_ptr<UploadManager> GetUploadManager() { return m_uploadManager; }
+  // `L[]̊ GPU ő҂悤ɂ. ]߂ĎgR}h̓OɌĂԂ.
+  void QueueWaitForUpload(UploadManager::Ticket ticket);
+
   std::shared_ptr<DescriptorManager> GetDescriptorManager() { return m_heap; }
+  // CPU p̃q[v. DescriptorRing փRs[錳̃fBXNv^u.
+  std::shared_ptr<DescriptorManager> GetStagingDescriptorManager() { return m_heapStaging; }
+
+  // ς݂̃R}hɂ\[XXe[g. CommandContextPool  Transition QƂ.
+  // CreateResource Ő DEFAULT q[ṽ\[XƃXbv`FC̃C[W͓o^ς.
+  std::shared_ptr<ResourceStateTable> GetResourceStateTable() { return m_resourceStates; }
+  void RegisterResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+
+  // [gVOl`ƃpCvCXe[g̐͂ʂ. ê͋LAt@C֕ۑĎ̋N𑬂.
+  std::shared_ptr<PipelineStateCache> GetPipelineStateCache() { return m_pipelineCache; }
+  // Initialize ̊Jn Prepare ̊܂ł̎.
+  double GetStartupMs() const { return m_startupMs; }
+
+  // VF[_[̃zbg[h. pCvCo^ĂƁAVF[_[̍XVɍ蒼čւ.
+  // ւ Update Ă񂾎_ōs邽߁At[̊JnɌĂԂ.
+  std::shared_ptr<ShaderHotReload> GetShaderHotReload() { return m_shaderHotReload; }
+
+  // `L[p̃R}hXg̃v[. pX̕L^ƈꊇɎg.
+  std::shared_ptr<CommandContextPool> GetCommandContextPool() { return m_commandContextPool; }
+
+  // `L[̃tFX. CPU ̑ҋ@L[Ԃ̑ҋ@͂ʂčs.
+  std::shared_ptr<TimelineFence> GetQueueFence() { return m_queueFence; }
+  // R}h̓ Signal A̒lԂ.
+  UINT64 SignalFrameFence() { return m_queueFence->Signal(); }
+  UINT64 GetCompletedFrameFenceValue() const { return m_queueFence->GetCompletedValue(); }
+  //  Signal l. ς݂̃R}hƁÃt[ŋL^̃R}h̊\.
+  // t[̏Iɂ͕K Signal 邽߁A Signal ȂĂ҂Ă.
+  UINT64 GetNextFrameFenceValue() const { return m_queueFence->GetLastSignaled() + 1; }
+
+  // GPU gpIĂ. fenceValue ȗꍇ GetNextFrameFenceValue ̊҂.
+  // ̓x Signal Ȃ߁At[ŉ̂1̃tFXlɂ܂Ƃ܂.
+  void DeferRelease(ComPtr<IUnknown> object);
+  void DeferRelease(ComPtr<IUnknown> object, UINT64 fenceValue);
+  void DeferFree(std::shared_ptr<DescriptorManager> heap, DescriptorHandle handle);
+  void DeferFree(const GpuMemoryAllocator::SmallBuffer& buffer);
+  // ̂. t[̊JnȂǂɌĂ.
+  void CollectDeferredReleases();
+  size_t GetPendingReleaseCount() const { return m_releaseQueue.GetPendingCount(); }
 protected:
 
   void PrepareDescriptorHeaps();
   
   void CreateDefaultDepthBuffer(int width, int height);
-  void CreateCommandAllocators();
+  void RegisterSwapchainImages();
   void WaitForIdleGPU();
+  void WaitForFrameFence(UINT64 fenceValue);
 
   ComPtr<ID3D12Device> m_device;
   ComPtr<ID3D12CommandQueue> m_commandQueue;
+  std::shared_ptr<GpuMemoryAllocator> m_memoryAllocator;
+  std::shared_ptr<UploadRing> m_uploadRing;
+  std::shared_ptr<UploadManager> m_uploadManager;
+  std::shared_ptr<PipelineStateCache> m_pipelineCache;
+  std::shared_ptr<ShaderHotReload> m_shaderHotReload;
  
   std::shared_ptr<Swapchain> m_swapchain;
 
@@ -88,19 +168,22 @@ protected:
   DXGI_FORMAT  m_surfaceFormat;
 
   
-  std::vector<ComPtr<ID3D12CommandAllocator>> m_commandAllocators;
-  ComPtr<ID3D12CommandAllocator> m_oneshotCommandAllocator;
-  ComPtr<ID3D12CommandAllocator> m_bundleCommandAllocator;
+  // `PR}h̃R}hXg͑SĂo. AP[^͎sɍėp.
+  std::shared_ptr<CommandContextPool> m_commandContextPool;
+  std::shared_ptr<ResourceStateTable> m_resourceStates;
+  FencedPool<ComPtr<ID3D12CommandAllocator>> m_bundleAllocators;
 
   std::shared_ptr<DescriptorManager> m_heapRTV;
   std::shared_ptr<DescriptorManager> m_heapDSV;
   std::shared_ptr<DescriptorManager> m_heap;
+  std::shared_ptr<DescriptorManager> m_heapStaging;
 
   DescriptorHandle m_defaultDepthDSV;
-  ComPtr<ID3D12GraphicsCommandList> m_commandList;
-  HANDLE m_waitFence;
+  std::shared_ptr<TimelineFence> m_queueFence;
+  DeferredReleaseQueue m_releaseQueue;
 
   UINT m_frameIndex;
+  double m_startupMs;
 
 
   UINT m_width;
@@ -114,3 +197,21 @@ HRESULT CompileShaderFromFile(
   const std::wstring& profile, 
   Microsoft::WRL::ComPtr<ID3DBlob>& shaderBlob, 
   Microsoft::WRL::ComPtr<ID3DBlob>& errorBlob);
+// }N`tŃRpC. ʂ ShaderCache ʂĕۑ/ėp.
+HRESULT CompileShaderFromFile(
+  const std::wstring& fileName,
+  const std::wstring& profile,
+  const ShaderDefines& defines,
+  Microsoft::WRL::ComPtr<ID3DBlob>& shaderBlob,
+  Microsoft::WRL::ComPtr<ID3DBlob>& errorBlob);
+// jobs ɃRpC. ŏɎŝ HRESULT ԂAʂ̌ʂ͊e job ɓ.
+HRESULT CompileShadersFromFile(std::vector<ShaderCompileJob>& jobs);
+// fileName 錾@\L[ ("// @feature NAME") ǂ.
+ShaderPermutation LoadShaderPermutation(const std::wstring& fileName);
+ShaderCache& GetShaderCache();
+// jobs ̃VF[_[̒萔obt@tNVł܂Ƃ߂. 1łǂ߂Ȃ΋ԂA
+// ̏ꍇ GetUsedRange ͍\̂̑ŜɂȂACheckConstantBufferLayout ƍȂ.
+ConstantBufferBinding ReflectConstantBuffers(const std::vector<const ShaderCompileJob*>& jobs);
+// binding  register(b<bindPoint>)  C++ ̍\̂ƍ. HႢΏo͂ėO𓊂.
+void CheckConstantBufferLayout(
+  const ConstantBufferBinding& binding, UINT bindPoint, const std::vector<ConstantBufferField>& fields, UINT structSize);
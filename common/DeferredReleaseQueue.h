@@ -0,0 +1,87 @@
+﻿#pragma once
+#include <deque>
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <cstdint>
+
+// GPU が使用中の可能性があるオブジェクトの解放を、フェンス値の完了まで遅らせるキュー.
+// 解放処理は関数として登録するため、リソースの他にディスクリプタの返却なども扱える.
+// D3D12 には依存しないため、フェンス値を直接与えて動作を確認できる.
+class DeferredReleaseQueue
+{
+public:
+  using ReleaseFunc = std::function<void()>;
+
+  DeferredReleaseQueue() : m_releasedCount(0) { }
+  ~DeferredReleaseQueue() { ReleaseAll(); }
+  DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+  DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+
+  // fenceValue が完了した後に release を実行する.
+  void Enqueue(uint64_t fenceValue, ReleaseFunc release)
+  {
+    // 通常はフェンス値の昇順に積まれるため、末尾から挿入位置を探す.
+    auto itr = m_entries.end();
+    while (itr != m_entries.begin() && std::prev(itr)->fenceValue > fenceValue)
+    {
+      --itr;
+    }
+    m_entries.insert(itr, Entry{ fenceValue, std::move(release) });
+  }
+
+  // completedFenceValue までに完了したものを解放する. 解放した数を返す.
+  size_t Collect(uint64_t completedFenceValue)
+  {
+    // 解放処理の中から Enqueue されてもよいよう、取り出してから実行する.
+    std::vector<ReleaseFunc> releases;
+    while (!m_entries.empty() && m_entries.front().fenceValue <= completedFenceValue)
+    {
+      releases.push_back(std::move(m_entries.front().release));
+      m_entries.pop_front();
+    }
+    return Run(releases);
+  }
+
+  // GPU の完了を待った後など、全てを即座に解放してよい場合に使う.
+  size_t ReleaseAll()
+  {
+    size_t count = 0;
+    while (!m_entries.empty())
+    {
+      std::vector<ReleaseFunc> releases;
+      for (auto& entry : m_entries)
+      {
+        releases.push_back(std::move(entry.release));
+      }
+      m_entries.clear();
+      count += Run(releases);
+    }
+    return count;
+  }
+
+  size_t GetPendingCount() const { return m_entries.size(); }
+  uint64_t GetReleasedCount() const { return m_releasedCount; }
+private:
+  struct Entry
+  {
+    uint64_t fenceValue;
+    ReleaseFunc release;
+  };
+
+  size_t Run(std::vector<ReleaseFunc>& releases)
+  {
+    for (auto& release : releases)
+    {
+      if (release)
+      {
+        release();
+      }
+    }
+    m_releasedCount += releases.size();
+    return releases.size();
+  }
+
+  std::deque<Entry> m_entries;
+  uint64_t m_releasedCount;
+};
@@ -0,0 +1,275 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ディスクリプタヒープ内の位置(インデックス)を管理するアロケータ.
+// 空き範囲をサイズのクラス(2 の冪)毎の双方向リストで持ち、空きのあるクラスをビットマスクで引くため、
+// 単体確保も範囲の確保も探索なしで行える. 解放時は前後の空き範囲と結合する.
+// 使用状況はビットマップでも持ち、範囲外や二重の解放を検出する.
+// D3D12 には依存しないため、ヒープを作らずに動作を確認できる.
+class DescriptorAllocator
+{
+public:
+  enum : uint32_t { InvalidIndex = 0xFFFFFFFFu };
+
+  struct Stats
+  {
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t peakUsed;
+    uint32_t largestFreeRange;
+    uint32_t freeRangeCount;
+    uint32_t failedCount;       // 空きが足りずに確保できなかった回数.
+    uint32_t invalidFreeCount;  // 範囲外や確保されていない位置の解放として無視した回数.
+  };
+
+  DescriptorAllocator() { Reset(0); }
+  explicit DescriptorAllocator(uint32_t capacity) { Reset(capacity); }
+
+  void Reset(uint32_t capacity)
+  {
+    m_capacity = capacity;
+    m_used = 0;
+    m_peakUsed = 0;
+    m_failedCount = 0;
+    m_invalidFreeCount = 0;
+    m_bits.assign((capacity + 63) / 64, 0);
+    m_rangeSize.assign(capacity, 0);
+    m_rangeStart.assign(capacity, InvalidIndex);
+    m_next.assign(capacity, InvalidIndex);
+    m_prev.assign(capacity, InvalidIndex);
+    std::fill(std::begin(m_heads), std::end(m_heads), InvalidIndex);
+    m_classMask = 0;
+    if (capacity > 0)
+    {
+      InsertFreeRange(0, capacity);
+    }
+  }
+
+  // 1つ確保する. 空きが無い場合は InvalidIndex.
+  uint32_t Allocate()
+  {
+    return AllocateRange(1);
+  }
+
+  // 連続した count 個を確保する. 空きが無い場合は InvalidIndex.
+  // count 以上が必ず収まるクラスの先頭から切り出す. そのクラスが空の場合に限り、
+  // count を含むクラスのリストを辿って収まる範囲を探す.
+  uint32_t AllocateRange(uint32_t count)
+  {
+    if (count == 0)
+    {
+      return InvalidIndex;
+    }
+    if (count > m_capacity)
+    {
+      ++m_failedCount;
+      return InvalidIndex;
+    }
+    uint32_t start = InvalidIndex;
+    const uint32_t fitClass = GetClass(count) + ((count & (count - 1)) ? 1 : 0);
+    const uint32_t candidates = fitClass < ClassCount ? (m_classMask & ~((uint32_t(1) << fitClass) - 1)) : 0;
+    if (candidates != 0)
+    {
+      start = m_heads[FindFirstSetBit(candidates)];
+    }
+    else
+    {
+      for (auto i = m_heads[GetClass(count)]; i != InvalidIndex; i = m_next[i])
+      {
+        if (m_rangeSize[i] >= count)
+        {
+          start = i;
+          break;
+        }
+      }
+    }
+    if (start == InvalidIndex)
+    {
+      ++m_failedCount;
+      return InvalidIndex;
+    }
+
+    const uint32_t size = m_rangeSize[start];
+    RemoveFreeRange(start);
+    if (size > count)
+    {
+      InsertFreeRange(start + count, size - count);
+    }
+    SetBits(start, count, true);
+    m_used += count;
+    m_peakUsed = std::max(m_peakUsed, m_used);
+    return start;
+  }
+
+  // 確保した範囲を戻す. 範囲外や確保されていない位置を含む場合は何もしない(デバッグビルドでは assert).
+  void Free(uint32_t index, uint32_t count = 1)
+  {
+    if (index == InvalidIndex || count == 0)
+    {
+      return;
+    }
+    const bool isValid = index < m_capacity && count <= m_capacity - index && IsRangeAllocated(index, count);
+    assert(isValid && "DescriptorAllocator: out of range or double free.");
+    if (!isValid)
+    {
+      ++m_invalidFreeCount;
+      return;
+    }
+    SetBits(index, count, false);
+    m_used -= count;
+
+    // 前後の空き範囲と結合する.
+    uint32_t start = index, size = count;
+    if (start > 0 && !IsAllocated(start - 1))
+    {
+      const uint32_t prev = m_rangeStart[start - 1];
+      size += m_rangeSize[prev];
+      RemoveFreeRange(prev);
+      start = prev;
+    }
+    const uint32_t end = index + count;
+    if (end < m_capacity && !IsAllocated(end))
+    {
+      size += m_rangeSize[end];
+      RemoveFreeRange(end);
+    }
+    InsertFreeRange(start, size);
+  }
+
+  bool IsAllocated(uint32_t index) const
+  {
+    return (m_bits[index / 64] & (uint64_t(1) << (index % 64))) != 0;
+  }
+
+  Stats GetStats() const
+  {
+    Stats stats{};
+    stats.capacity = m_capacity;
+    stats.used = m_used;
+    stats.peakUsed = m_peakUsed;
+    stats.failedCount = m_failedCount;
+    stats.invalidFreeCount = m_invalidFreeCount;
+    for (uint32_t c = 0; c < ClassCount; ++c)
+    {
+      for (auto i = m_heads[c]; i != InvalidIndex; i = m_next[i])
+      {
+        ++stats.freeRangeCount;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, m_rangeSize[i]);
+      }
+    }
+    return stats;
+  }
+  uint32_t GetCapacity() const { return m_capacity; }
+  uint32_t GetUsed() const { return m_used; }
+
+private:
+  enum : uint32_t { ClassCount = 32 };
+
+  static uint32_t FindFirstSetBit(uint32_t v)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctz(v));
+#endif
+  }
+  // size を含むクラス. [2^c, 2^(c+1)) の範囲がクラス c に入る.
+  static uint32_t GetClass(uint32_t size)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, size);
+    return uint32_t(index);
+#else
+    return uint32_t(31 - __builtin_clz(size));
+#endif
+  }
+
+  // 空き範囲はその先頭にサイズとリストのつながりを、末尾に先頭の位置を置く.
+  void InsertFreeRange(uint32_t start, uint32_t size)
+  {
+    const uint32_t c = GetClass(size);
+    m_rangeSize[start] = size;
+    m_rangeStart[start + size - 1] = start;
+    m_prev[start] = InvalidIndex;
+    m_next[start] = m_heads[c];
+    if (m_heads[c] != InvalidIndex)
+    {
+      m_prev[m_heads[c]] = start;
+    }
+    m_heads[c] = start;
+    m_classMask |= uint32_t(1) << c;
+  }
+  void RemoveFreeRange(uint32_t start)
+  {
+    const uint32_t c = GetClass(m_rangeSize[start]);
+    if (m_prev[start] != InvalidIndex)
+    {
+      m_next[m_prev[start]] = m_next[start];
+    }
+    else
+    {
+      m_heads[c] = m_next[start];
+    }
+    if (m_next[start] != InvalidIndex)
+    {
+      m_prev[m_next[start]] = m_prev[start];
+    }
+    if (m_heads[c] == InvalidIndex)
+    {
+      m_classMask &= ~(uint32_t(1) << c);
+    }
+    m_rangeSize[start] = 0;
+  }
+
+  bool IsRangeAllocated(uint32_t index, uint32_t count) const
+  {
+    for (uint32_t i = index; i < index + count; )
+    {
+      const uint32_t bit = i % 64;
+      const uint32_t n = std::min(64 - bit, index + count - i);
+      const uint64_t mask = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+      if ((m_bits[i / 64] & mask) != mask)
+      {
+        return false;
+      }
+      i += n;
+    }
+    return true;
+  }
+  void SetBits(uint32_t index, uint32_t count, bool used)
+  {
+    for (uint32_t i = index; i < index + count; )
+    {
+      const uint32_t bit = i % 64;
+      const uint32_t n = std::min(64 - bit, index + count - i);
+      const uint64_t mask = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+      if (used)
+        m_bits[i / 64] |= mask;
+      else
+        m_bits[i / 64] &= ~mask;
+      i += n;
+    }
+  }
+
+  std::vector<uint64_t> m_bits;       // 1 が使用中.
+  std::vector<uint32_t> m_rangeSize;  // 空き範囲の先頭に置くサイズ.
+  std::vector<uint32_t> m_rangeStart; // 空き範囲の末尾に置く先頭の位置.
+  std::vector<uint32_t> m_next;
+  std::vector<uint32_t> m_prev;
+  uint32_t m_heads[ClassCount];
+  uint32_t m_classMask;               // 1 が空き範囲のあるクラス.
+  uint32_t m_capacity;
+  uint32_t m_used;
+  uint32_t m_peakUsed;
+  uint32_t m_failedCount;
+  uint32_t m_invalidFreeCount;
+};
@@ -1,8 +1,12 @@
 #pragma once
 #include <wrl.h>
-#include <list>
+#include <string>
+#include <memory>
+#include <mutex>
 
 #include "D3D12BookUtil.h"
+#include "DescriptorAllocator.h"
+#include "ConcurrentDescriptorPool.h"
 #include "d3dx12.h"
 
 class DescriptorHandle
@@ -28,9 +32,10 @@ class DescriptorManager
 public:
   template<class T>
   using ComPtr = Microsoft::WRL::ComPtr<T>;
+  using ThreadCache = ConcurrentDescriptorPool::ThreadCache;
 
   DescriptorManager(ComPtr<ID3D12Device> device, const D3D12_DESCRIPTOR_HEAP_DESC& desc)
-    : m_index(0), m_incrementSize(0)
+    : m_incrementSize(0), m_allocator(desc.NumDescriptors)
   {
     HRESULT hr = device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_heap));
     ThrowIfFailed(hr, "CreateDescriptorHeap Ɏs.");
@@ -43,34 +48,103 @@ public:
 
   DescriptorHandle Alloc()
   {
-    if (!m_freeList.empty())
+    return AllocRange(1);
+  }
+
+  // fBXNv^e[upɘA count mۂA擪̃nhԂ.
+  // q[vɋ󂫂ꍇ͗O𓊂.
+  DescriptorHandle AllocRange(UINT count)
+  {
+    auto index = m_allocator.AllocateRange(count);
+    if (index == DescriptorAllocator::InvalidIndex)
     {
-      auto ret = m_freeList.front();
-      m_freeList.pop_front();
-      return ret;
+      auto stats = m_allocator.GetStats();
+      throw book_util::DX12Exception(
+        "DescriptorHeap exhausted. request=" + std::to_string(count) +
+        " used=" + std::to_string(stats.used) + "/" + std::to_string(stats.capacity));
     }
+    return GetHandle(index);
+  }
 
-    UINT use = m_index++;
-    auto ret = DescriptorHandle(
-      m_handleCpu.Offset(use, m_incrementSize),
-      m_handleGpu.Offset(use, m_incrementSize)
-    );
+  void Free(const DescriptorHandle& handle)
+  {
+    FreeRange(handle, 1);
+  }
+  void FreeRange(const DescriptorHandle& handle, UINT count)
+  {
+    auto index = GetIndex(handle);
+    if (m_concurrentPool.Contains(index))
+    {
+      // smۗp̗̈̓Xbh킸ł悤ALLbV֖߂.
+      std::lock_guard<std::mutex> lock(m_sharedCacheMutex);
+      for (UINT i = 0; i < count; ++i)
+      {
+        m_sharedCache->Free(index + i);
+      }
+      return;
+    }
+    m_allocator.Free(index, count);
+  }
 
-    return ret;
+  // Xbh̊mۗp count \񂷂. XbhgpĂȂԂŌĂԂ.
+  // \񂵂̈ ThreadCache n Alloc/Free ň. ʏ Alloc Ƃ͓ƗĂ.
+  void EnableConcurrentAlloc(UINT count)
+  {
+    auto index = m_allocator.AllocateRange(count);
+    if (index == DescriptorAllocator::InvalidIndex)
+    {
+      throw book_util::DX12Exception(
+        "DescriptorHeap exhausted. concurrent request=" + std::to_string(count));
+    }
+    m_sharedCache.reset();
+    m_concurrentPool.Reset(index, count);
+    m_sharedCache = std::make_unique<ThreadCache>(m_concurrentPool);
   }
 
-  void Free(const DescriptorHandle& handle)
+  // XbhƂ̃LbVg1mۂ. Xbh瓯ɌĂяo.
+  DescriptorHandle Alloc(ThreadCache& cache)
   {
-    m_freeList.push_back(handle);
+    auto index = cache.Allocate();
+    if (index == ConcurrentDescriptorPool::InvalidIndex)
+    {
+      throw book_util::DX12Exception(
+        "DescriptorHeap exhausted. concurrent capacity=" + std::to_string(m_concurrentPool.GetCount()));
+    }
+    return GetHandle(index);
   }
+  void Free(ThreadCache& cache, const DescriptorHandle& handle)
+  {
+    cache.Free(GetIndex(handle));
+  }
+  ConcurrentDescriptorPool& GetConcurrentPool() { return m_concurrentPool; }
 
+  // 擪 index Ԗڂ̃nh.
+  DescriptorHandle GetHandle(UINT index) const
+  {
+    return DescriptorHandle(
+      CD3DX12_CPU_DESCRIPTOR_HANDLE(m_handleCpu, index, m_incrementSize),
+      CD3DX12_GPU_DESCRIPTOR_HANDLE(m_handleGpu, index, m_incrementSize)
+    );
+  }
+  UINT GetIndex(const DescriptorHandle& handle) const
+  {
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu = handle;
+    return UINT((cpu.ptr - m_handleCpu.ptr) / m_incrementSize);
+  }
+  UINT GetIncrementSize() const { return m_incrementSize; }
+
+  DescriptorAllocator::Stats GetStats() const { return m_allocator.GetStats(); }
 
 private:
   ComPtr<ID3D12DescriptorHeap> m_heap;
   CD3DX12_CPU_DESCRIPTOR_HANDLE m_handleCpu;
   CD3DX12_GPU_DESCRIPTOR_HANDLE m_handleGpu;
-  UINT m_index;
   UINT m_incrementSize;
 
-  std::list<DescriptorHandle> m_freeList;
+  DescriptorAllocator m_allocator;
+
+  // m_sharedCache ͔jɃv[֖߂߁Av[ɐ錾.
+  ConcurrentDescriptorPool m_concurrentPool;
+  std::unique_ptr<ThreadCache> m_sharedCache;
+  std::mutex m_sharedCacheMutex;
 };
\ No newline at end of file
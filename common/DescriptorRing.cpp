@@ -0,0 +1,103 @@
+﻿#include "DescriptorRing.h"
+#include "D3D12BookUtil.h"
+
+#include <algorithm>
+#include <string>
+
+DescriptorRing::DescriptorRing()
+  : m_count(0), m_incrementSize(0), m_heapType(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV),
+  m_peakUsed(0), m_tablesThisFrame(0), m_copyCallsThisFrame(0)
+{
+}
+
+void DescriptorRing::Prepare(ComPtr<ID3D12Device> device, std::shared_ptr<DescriptorManager> heap, UINT count)
+{
+  m_device = device;
+  m_heap = heap;
+  m_count = count;
+  m_heapType = heap->GetHeap()->GetDesc().Type;
+  m_incrementSize = heap->GetIncrementSize();
+  m_base = heap->AllocRange(count);
+  m_allocator.Reset(count);
+  m_peakUsed = 0;
+  m_tablesThisFrame = 0;
+  m_copyCallsThisFrame = 0;
+}
+
+void DescriptorRing::Cleanup()
+{
+  if (m_heap)
+  {
+    m_heap->FreeRange(m_base, m_count);
+  }
+  m_heap.reset();
+  m_device.Reset();
+  m_dstStarts.clear();
+  m_dstSizes.clear();
+  m_srcHandles.clear();
+}
+
+void DescriptorRing::BeginFrame(UINT64 completedFenceValue)
+{
+  m_allocator.Retire(completedFenceValue);
+  m_tablesThisFrame = 0;
+  m_copyCallsThisFrame = 0;
+}
+
+DescriptorHandle DescriptorRing::Allocate(UINT count, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptors)
+{
+  auto offset = m_allocator.Allocate(count);
+  if (offset == RingAllocator::InvalidOffset)
+  {
+    throw book_util::DX12Exception(
+      "DescriptorRing exhausted. request=" + std::to_string(count) +
+      " used=" + std::to_string(m_allocator.GetUsed()) + "/" + std::to_string(m_count));
+  }
+  m_peakUsed = std::max(m_peakUsed, m_allocator.GetUsed());
+  ++m_tablesThisFrame;
+
+  D3D12_CPU_DESCRIPTOR_HANDLE base = m_base;
+  D3D12_GPU_DESCRIPTOR_HANDLE baseGpu = m_base;
+  auto handle = DescriptorHandle(
+    CD3DX12_CPU_DESCRIPTOR_HANDLE(base, offset, m_incrementSize),
+    CD3DX12_GPU_DESCRIPTOR_HANDLE(baseGpu, offset, m_incrementSize)
+  );
+  m_dstStarts.push_back(handle);
+  m_dstSizes.push_back(count);
+  m_srcHandles.insert(m_srcHandles.end(), srcDescriptors, srcDescriptors + count);
+  return handle;
+}
+
+void DescriptorRing::Flush()
+{
+  if (m_dstStarts.empty())
+  {
+    return;
+  }
+  // コピー元は1個ずつの範囲として渡す(サイズ配列の省略は全て 1 を意味する).
+  m_device->CopyDescriptors(
+    UINT(m_dstStarts.size()), m_dstStarts.data(), m_dstSizes.data(),
+    UINT(m_srcHandles.size()), m_srcHandles.data(), nullptr,
+    m_heapType);
+  ++m_copyCallsThisFrame;
+  m_dstStarts.clear();
+  m_dstSizes.clear();
+  m_srcHandles.clear();
+}
+
+void DescriptorRing::EndFrame(UINT64 fenceValue)
+{
+  m_allocator.EndFrame(fenceValue);
+}
+
+DescriptorRing::Stats DescriptorRing::GetStats() const
+{
+  Stats stats{};
+  stats.capacity = m_count;
+  stats.used = m_allocator.GetUsed();
+  stats.peakUsed = m_peakUsed;
+  stats.tablesThisFrame = m_tablesThisFrame;
+  stats.copyCallsThisFrame = m_copyCallsThisFrame;
+  stats.wrapCount = m_allocator.GetWrapCount();
+  return stats;
+}
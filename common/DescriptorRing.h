@@ -0,0 +1,66 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "DescriptorManager.h"
+#include "RingAllocator.h"
+
+// シェーダーから見えるヒープの一部を予約し、フレームごとのディスクリプタテーブルを切り出す.
+// ディスクリプタは CPU 専用ヒープで作っておき、テーブルへは CopyDescriptors でまとめて書き込む.
+// 永続的な確保を増やさずに、描画ごとに異なるテーブルを設定できる.
+class DescriptorRing
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  struct Stats
+  {
+    UINT capacity;
+    UINT used;
+    UINT peakUsed;
+    UINT tablesThisFrame;
+    UINT copyCallsThisFrame;
+    UINT64 wrapCount;
+  };
+
+  DescriptorRing();
+
+  void Prepare(ComPtr<ID3D12Device> device, std::shared_ptr<DescriptorManager> heap, UINT count);
+  void Cleanup();
+
+  // フレームの記録開始時に呼び、完了済みのフレームが使った領域を回収する.
+  void BeginFrame(UINT64 completedFenceValue);
+
+  // count 個の連続したテーブルを確保し、srcDescriptors からのコピーを予約する.
+  // srcDescriptors は CPU 専用ヒープのハンドルであること. 空きが無い場合は例外を投げる.
+  DescriptorHandle Allocate(UINT count, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptors);
+
+  // 予約したコピーを1回の CopyDescriptors で行う. コマンドリストの実行前に呼ぶこと.
+  void Flush();
+
+  // フレームの投入後、そのフレームの完了を示すフェンス値で区切る.
+  void EndFrame(UINT64 fenceValue);
+
+  Stats GetStats() const;
+private:
+  ComPtr<ID3D12Device> m_device;
+  std::shared_ptr<DescriptorManager> m_heap;
+  DescriptorHandle m_base;
+  UINT m_count;
+  UINT m_incrementSize;
+  D3D12_DESCRIPTOR_HEAP_TYPE m_heapType;
+  RingAllocator m_allocator;
+
+  // 次の Flush で行うコピー.
+  std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_dstStarts;
+  std::vector<UINT> m_dstSizes;
+  std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_srcHandles;
+
+  UINT m_peakUsed;
+  UINT m_tablesThisFrame;
+  UINT m_copyCallsThisFrame;
+};
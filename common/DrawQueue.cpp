@@ -0,0 +1,150 @@
+﻿#include "DrawQueue.h"
+#include "D3D12BookUtil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+void DrawQueue::Packet::AddRootArgument(RootArgumentType type, uint32_t index, uint64_t value)
+{
+  if (rootArgumentCount >= MaxRootArguments || index >= MaxRootParameters)
+  {
+    throw book_util::DX12Exception("DrawQueue::Packet too many root arguments.");
+  }
+  rootArguments[rootArgumentCount++] = RootArgument{ type, index, value };
+}
+
+DrawQueue::DrawQueue() : m_isSorted(true), m_sortMs(0.0)
+{
+}
+
+void DrawQueue::Reset()
+{
+  m_packets.clear();
+  m_items.clear();
+  m_isSorted = true;
+  m_pipelineIds.NextFrame();
+}
+
+uint32_t DrawQueue::GetPipelineId(ID3D12PipelineState* pipelineState)
+{
+  // ホットリロードで差し替わった古いパイプラインの番号は次の Reset で空き、新しいパイプラインに使われる.
+  // 番号が幅を超えて重なってもまとめ方が変わるだけで、記録ではパイプラインそのものを比べるため描画は正しい.
+  return m_pipelineIds.Get(pipelineState);
+}
+
+void DrawQueue::Add(uint64_t key, const Packet& packet)
+{
+  m_items.push_back(DrawSortItem{ key, uint32_t(m_packets.size()) });
+  m_packets.push_back(packet);
+  m_isSorted = false;
+}
+
+void DrawQueue::Sort()
+{
+  auto start = std::chrono::high_resolution_clock::now();
+  RadixSortDrawItems(m_items, m_scratch);
+  m_isSorted = true;
+  m_sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+DrawQueue::Stats DrawQueue::Submit(ID3D12GraphicsCommandList* commandList, uint32_t firstPass, uint32_t lastPass) const
+{
+  if (!m_isSorted)
+  {
+    throw book_util::DX12Exception("DrawQueue::Submit called before Sort.");
+  }
+  Stats stats{};
+  auto begin = std::lower_bound(m_items.begin(), m_items.end(), DrawKey::GetPassBegin(firstPass),
+    [](const DrawSortItem& item, uint64_t key) { return item.key < key; });
+  auto end = std::upper_bound(begin, m_items.end(), DrawKey::GetPassEnd(lastPass),
+    [](uint64_t key, const DrawSortItem& item) { return key < item.key; });
+
+  ID3D12RootSignature* rootSignature = nullptr;
+  ID3D12PipelineState* pipelineState = nullptr;
+  D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+  D3D12_VERTEX_BUFFER_VIEW vertexBuffer{};
+  D3D12_INDEX_BUFFER_VIEW indexBuffer{};
+  // ルートパラメータ毎に最後に設定した値. ルートシグネチャを切り替えると全て未設定に戻る.
+  RootArgument bound[MaxRootParameters];
+  bool isBound[MaxRootParameters] = {};
+
+  for (auto itr = begin; itr != end; ++itr)
+  {
+    const auto& packet = m_packets[itr->index];
+    ++stats.packetCount;
+    if (packet.rootSignature != rootSignature)
+    {
+      commandList->SetGraphicsRootSignature(packet.rootSignature);
+      rootSignature = packet.rootSignature;
+      std::fill(std::begin(isBound), std::end(isBound), false);
+      ++stats.rootSignatureChanges;
+    }
+    // キーで並べてあるため同じパイプラインは続いて現れる. 番号は重なり得るため、比べるのはパイプラインそのもの.
+    if (packet.pipelineState != pipelineState)
+    {
+      commandList->SetPipelineState(packet.pipelineState);
+      pipelineState = packet.pipelineState;
+      ++stats.pipelineChanges;
+    }
+
+    for (uint32_t i = 0; i < packet.rootArgumentCount; ++i)
+    {
+      const auto& argument = packet.rootArguments[i];
+      auto index = argument.parameterIndex;
+      if (isBound[index] && bound[index].type == argument.type && bound[index].value == argument.value)
+      {
+        continue;
+      }
+      switch (argument.type)
+      {
+      case ROOT_ARGUMENT_CBV:
+        commandList->SetGraphicsRootConstantBufferView(index, argument.value);
+        break;
+      case ROOT_ARGUMENT_SRV:
+        commandList->SetGraphicsRootShaderResourceView(index, argument.value);
+        break;
+      case ROOT_ARGUMENT_TABLE:
+        commandList->SetGraphicsRootDescriptorTable(index, D3D12_GPU_DESCRIPTOR_HANDLE{ argument.value });
+        break;
+      case ROOT_ARGUMENT_CONSTANT:
+        commandList->SetGraphicsRoot32BitConstant(index, UINT(argument.value), 0);
+        break;
+      }
+      bound[index] = argument;
+      isBound[index] = true;
+      ++stats.rootParameterChanges;
+    }
+
+    if (packet.topology != topology)
+    {
+      commandList->IASetPrimitiveTopology(packet.topology);
+      topology = packet.topology;
+      ++stats.bufferChanges;
+    }
+    if (memcmp(&packet.vertexBuffer, &vertexBuffer, sizeof(vertexBuffer)) != 0)
+    {
+      commandList->IASetVertexBuffers(0, 1, &packet.vertexBuffer);
+      vertexBuffer = packet.vertexBuffer;
+      ++stats.bufferChanges;
+    }
+    if (packet.indexBuffer.SizeInBytes > 0)
+    {
+      if (memcmp(&packet.indexBuffer, &indexBuffer, sizeof(indexBuffer)) != 0)
+      {
+        commandList->IASetIndexBuffer(&packet.indexBuffer);
+        indexBuffer = packet.indexBuffer;
+        ++stats.bufferChanges;
+      }
+      commandList->DrawIndexedInstanced(packet.vertexOrIndexCount, packet.instanceCount,
+        packet.startVertexOrIndex, packet.baseVertex, packet.startInstance);
+    }
+    else
+    {
+      commandList->DrawInstanced(packet.vertexOrIndexCount, packet.instanceCount,
+        packet.startVertexOrIndex, packet.startInstance);
+    }
+    ++stats.drawCount;
+  }
+  return stats;
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <cstdint>
+#include <vector>
+
+#include "DrawSortKey.h"
+
+// ソートキー (DrawKey) 付きの描画パケットを集め、キーの順に並べて記録するキュー.
+// フレーム毎に Reset, Add, Sort の順で呼び、その後 Submit でパス毎にコマンドリストへ記録する.
+// 記録では直前と異なる状態 (ルートシグネチャ, パイプライン, ルートパラメータ, 頂点とインデックスバッファ) のみ設定するため、
+// キーの上位 (パス, 順序, パイプライン, マテリアル) が同じパケットが続く間は描画コマンドだけになる.
+// Sort の後の Submit は読み取りのみのため、別々のパスを複数のスレッドから同時に記録してよい.
+// パケットはパイプラインなどを参照で持つ. 記録を終えたコマンドリストを GPU が使い終えるまで生かしておくこと.
+class DrawQueue
+{
+public:
+  enum
+  {
+    MaxRootArguments = 8,     // 1 パケットの持つルートパラメータの数.
+    MaxRootParameters = 16,   // ルートパラメータの番号の上限.
+  };
+  enum RootArgumentType : uint8_t
+  {
+    ROOT_ARGUMENT_CBV,
+    ROOT_ARGUMENT_SRV,
+    ROOT_ARGUMENT_TABLE,
+    ROOT_ARGUMENT_CONSTANT,   // 32 ビット定数 1 つ (オフセット 0).
+  };
+  struct RootArgument
+  {
+    RootArgumentType type;
+    uint32_t parameterIndex;
+    uint64_t value;           // GPU 仮想アドレス, ディスクリプタの GPU ハンドル, 定数のいずれか.
+  };
+  struct Packet
+  {
+    ID3D12RootSignature* rootSignature;
+    ID3D12PipelineState* pipelineState;
+    D3D_PRIMITIVE_TOPOLOGY topology;
+    D3D12_VERTEX_BUFFER_VIEW vertexBuffer;
+    D3D12_INDEX_BUFFER_VIEW indexBuffer;  // SizeInBytes が 0 ならインデックス無しで描く.
+    uint32_t rootArgumentCount;
+    RootArgument rootArguments[MaxRootArguments];
+    UINT vertexOrIndexCount;
+    UINT instanceCount;
+    UINT startVertexOrIndex;
+    INT baseVertex;
+    UINT startInstance;
+
+    void AddRootCBV(uint32_t index, D3D12_GPU_VIRTUAL_ADDRESS address) { AddRootArgument(ROOT_ARGUMENT_CBV, index, address); }
+    void AddRootSRV(uint32_t index, D3D12_GPU_VIRTUAL_ADDRESS address) { AddRootArgument(ROOT_ARGUMENT_SRV, index, address); }
+    void AddRootTable(uint32_t index, D3D12_GPU_DESCRIPTOR_HANDLE handle) { AddRootArgument(ROOT_ARGUMENT_TABLE, index, handle.ptr); }
+    void AddRootConstant(uint32_t index, UINT value) { AddRootArgument(ROOT_ARGUMENT_CONSTANT, index, value); }
+    void AddRootArgument(RootArgumentType type, uint32_t index, uint64_t value);
+  };
+  // Submit で記録したコマンドの数.
+  struct Stats
+  {
+    UINT packetCount;
+    UINT drawCount;
+    UINT pipelineChanges;
+    UINT rootSignatureChanges;
+    UINT rootParameterChanges;
+    UINT bufferChanges;       // 頂点バッファ, インデックスバッファ, トポロジの設定.
+  };
+
+  DrawQueue();
+
+  // 前のフレームのパケットを捨てる. パイプラインの番号は前のフレームで使ったものだけを残す.
+  void Reset();
+  // パイプラインにキー用の小さな番号を割り当てる. 毎フレーム使う間は同じ番号を返す.
+  uint32_t GetPipelineId(ID3D12PipelineState* pipelineState);
+  void Add(uint64_t key, const Packet& packet);
+  // キーの昇順に並べる. 同じキーのパケットは Add した順に描く.
+  void Sort();
+
+  // パス firstPass から lastPass までのパケットを記録する. Sort の後に呼ぶこと.
+  // 記録の前後でコマンドリストの状態は引き継がず、最初のパケットで全て設定する.
+  Stats Submit(ID3D12GraphicsCommandList* commandList, uint32_t firstPass, uint32_t lastPass) const;
+
+  UINT GetPacketCount() const { return UINT(m_packets.size()); }
+  // 直近の Sort にかかった時間.
+  double GetSortMs() const { return m_sortMs; }
+private:
+  std::vector<Packet> m_packets;
+  std::vector<DrawSortItem> m_items;
+  std::vector<DrawSortItem> m_scratch;
+  DrawIdTable<ID3D12PipelineState> m_pipelineIds;
+  bool m_isSorted;
+  double m_sortMs;
+};
@@ -0,0 +1,178 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// 描画のソートキー (64 ビット).
+// 上位から パス (4), 順序 (12), パイプライン (12), マテリアル (20), 深度のバケット (16) の順に並べ、
+// キーの昇順に描くとパス毎に、パイプライン、マテリアルの切り替えが少なくなる順で、同じ状態の中では手前から描く.
+// 描く順序が結果に影響する描画 (半透明の合成など) は「順序」に描きたい順の番号を入れ、状態より優先させる.
+// 順序を問わない描画は 0 にする.
+struct DrawKey
+{
+  enum : uint32_t
+  {
+    PassBits = 4,
+    OrderBits = 12,
+    PipelineBits = 12,
+    MaterialBits = 20,
+    DepthBits = 16,
+
+    DepthShift = 0,
+    MaterialShift = DepthShift + DepthBits,
+    PipelineShift = MaterialShift + MaterialBits,
+    OrderShift = PipelineShift + PipelineBits,
+    PassShift = OrderShift + OrderBits,
+  };
+  static_assert(PassShift + PassBits == 64, "DrawKey must use all 64 bits.");
+
+  // 各値は幅に収まらない部分を切り捨てる. パイプラインとマテリアルはまとめるための番号で、衝突しても描画は正しい.
+  static uint64_t Make(uint32_t pass, uint32_t order, uint32_t pipeline, uint32_t material, uint32_t depth)
+  {
+    return (Field(pass, PassBits) << PassShift) |
+      (Field(order, OrderBits) << OrderShift) |
+      (Field(pipeline, PipelineBits) << PipelineShift) |
+      (Field(material, MaterialBits) << MaterialShift) |
+      (Field(depth, DepthBits) << DepthShift);
+  }
+  static uint32_t GetPass(uint64_t key) { return uint32_t(key >> PassShift); }
+  // パス first から last までのキーの範囲 [begin, end].
+  static uint64_t GetPassBegin(uint32_t first) { return Field(first, PassBits) << PassShift; }
+  static uint64_t GetPassEnd(uint32_t last) { return GetPassBegin(last) | ((uint64_t(1) << PassShift) - 1); }
+
+  // カメラからの距離を深度のバケットにする. 手前ほど小さく、範囲外は端にまとめる.
+  static uint32_t MakeDepthBucket(float distance, float nearZ, float farZ)
+  {
+    const uint32_t maxBucket = (1u << DepthBits) - 1;
+    if (!(distance > nearZ) || !(farZ > nearZ))
+    {
+      return 0;
+    }
+    if (distance >= farZ)
+    {
+      return maxBucket;
+    }
+    return uint32_t((distance - nearZ) / (farZ - nearZ) * float(maxBucket));
+  }
+private:
+  static uint64_t Field(uint32_t value, uint32_t bits) { return uint64_t(value) & ((uint64_t(1) << bits) - 1); }
+};
+
+// ソートの対象. index は呼び出し側の配列 (描画パケットなど) の位置.
+struct DrawSortItem
+{
+  uint64_t key;
+  uint32_t index;
+};
+
+// items をキーの昇順に並べる. 同じキーのものは元の順序を保つ (LSD 基数ソート).
+// 1 バイトずつ 8 回分配するが、全ての要素で同じ値の桁は飛ばす. scratch は作業用で、中身は不定になる.
+inline void RadixSortDrawItems(std::vector<DrawSortItem>& items, std::vector<DrawSortItem>& scratch)
+{
+  enum { DigitBits = 8, DigitCount = 64 / DigitBits, BucketCount = 1 << DigitBits };
+  const size_t count = items.size();
+  if (count < 2)
+  {
+    return;
+  }
+  // 全ての桁の分布を1度の走査で数える.
+  std::vector<uint32_t> histograms(DigitCount * BucketCount, 0);
+  for (const auto& item : items)
+  {
+    auto key = item.key;
+    for (uint32_t digit = 0; digit < DigitCount; ++digit)
+    {
+      ++histograms[digit * BucketCount + ((key >> (digit * DigitBits)) & (BucketCount - 1))];
+    }
+  }
+  scratch.resize(count);
+  auto* source = &items;
+  auto* destination = &scratch;
+  for (uint32_t digit = 0; digit < DigitCount; ++digit)
+  {
+    auto* histogram = &histograms[digit * BucketCount];
+    auto firstKey = (*source)[0].key;
+    if (histogram[(firstKey >> (digit * DigitBits)) & (BucketCount - 1)] == count)
+    {
+      continue;
+    }
+    uint32_t offsets[BucketCount];
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < BucketCount; ++bucket)
+    {
+      offsets[bucket] = offset;
+      offset += histogram[bucket];
+    }
+    auto* out = destination->data();
+    for (const auto& item : *source)
+    {
+      out[offsets[(item.key >> (digit * DigitBits)) & (BucketCount - 1)]++] = item;
+    }
+    std::swap(source, destination);
+  }
+  if (source != &items)
+  {
+    items.swap(scratch);
+  }
+}
+
+// パイプラインなどのオブジェクトにキー用の小さな番号を割り当てる.
+// NextFrame の度に、直前のフレームで使われなかったもの (ホットリロードで差し替わったパイプラインなど) を外して番号を空けるため、
+// 表の大きさと番号は同時に使われるオブジェクトの数に収まる. 使い続けている間は同じ番号を返す.
+template<class T>
+class DrawIdTable
+{
+public:
+  DrawIdTable() : m_frame(0), m_nextId(0) { }
+
+  uint32_t Get(const T* object)
+  {
+    auto itr = m_entries.find(object);
+    if (itr != m_entries.end())
+    {
+      itr->second.lastFrame = m_frame;
+      return itr->second.id;
+    }
+    uint32_t id = m_nextId;
+    if (m_freeIds.empty())
+    {
+      ++m_nextId;
+    }
+    else
+    {
+      id = m_freeIds.back();
+      m_freeIds.pop_back();
+    }
+    m_entries.emplace(object, Entry{ id, m_frame });
+    return id;
+  }
+  void NextFrame()
+  {
+    for (auto itr = m_entries.begin(); itr != m_entries.end();)
+    {
+      if (itr->second.lastFrame != m_frame)
+      {
+        m_freeIds.push_back(itr->second.id);
+        itr = m_entries.erase(itr);
+      }
+      else
+      {
+        ++itr;
+      }
+    }
+    ++m_frame;
+  }
+  size_t GetSize() const { return m_entries.size(); }
+private:
+  struct Entry
+  {
+    uint32_t id;
+    uint64_t lastFrame;
+  };
+  std::unordered_map<const T*, Entry> m_entries;
+  std::vector<uint32_t> m_freeIds;
+  uint64_t m_frame;
+  uint32_t m_nextId;
+};
@@ -0,0 +1,116 @@
+﻿#include "DynamicBuffer.h"
+#include "D3D12AppBase.h"
+#include "D3D12BookUtil.h"
+
+#include <algorithm>
+
+DynamicBuffer::DynamicBuffer()
+  : m_usageState(D3D12_RESOURCE_STATE_COMMON), m_stagingIndex(0),
+  m_bufferSize(0), m_dirtyBegin(0), m_dirtyEnd(0), m_copiedBytes(0)
+{
+}
+
+DynamicBuffer::~DynamicBuffer()
+{
+  Cleanup();
+}
+
+void DynamicBuffer::Prepare(D3D12AppBase* app, UINT bufferSize, D3D12_RESOURCE_STATES usageState)
+{
+  m_bufferSize = bufferSize;
+  m_usageState = usageState;
+  m_stagingIndex = 0;
+  m_commandPool = app->GetCommandContextPool();
+  m_stateTable = app->GetResourceStateTable();
+
+  auto desc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+  m_buffer = app->CreateResource(
+    desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, D3D12_HEAP_TYPE_DEFAULT);
+  m_buffer->SetName(L"DynamicBuffer");
+
+  // ステージング用はフレーム毎に用意し、マップしたままにしておく.
+  m_stagingBuffers.resize(D3D12AppBase::FrameBufferCount);
+  m_mappedStaging.resize(D3D12AppBase::FrameBufferCount);
+  for (UINT i = 0; i < D3D12AppBase::FrameBufferCount; ++i)
+  {
+    m_stagingBuffers[i] = app->CreateResource(
+      desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
+
+    const CD3DX12_RANGE readRange(0, 0);
+    HRESULT hr = m_stagingBuffers[i]->Map(0, &readRange, &m_mappedStaging[i]);
+    ThrowIfFailed(hr, "Map Failed.");
+  }
+  m_dirtyBegin = m_bufferSize;
+  m_dirtyEnd = 0;
+  m_copiedBytes = 0;
+}
+
+void DynamicBuffer::Cleanup()
+{
+  for (auto& staging : m_stagingBuffers)
+  {
+    staging->Unmap(0, nullptr);
+  }
+  m_stagingBuffers.clear();
+  m_mappedStaging.clear();
+  // 同じアドレスに作られた別のリソースが古いステートを引き継がないよう、登録を外してから手放す.
+  if (m_buffer && m_stateTable)
+  {
+    m_stateTable->Unregister(m_buffer.Get());
+  }
+  m_buffer.Reset();
+  m_stateTable.reset();
+  m_commandPool.reset();
+}
+
+void DynamicBuffer::Write(UINT frameIndex, UINT offset, const void* data, UINT size)
+{
+  if (size == 0)
+  {
+    return;
+  }
+  if (offset + size > m_bufferSize)
+  {
+    throw std::out_of_range("DynamicBuffer::Write out of range.");
+  }
+  if (frameIndex != m_stagingIndex && m_dirtyBegin < m_dirtyEnd)
+  {
+    // 未転送の範囲が別フレームのステージングにあるため引き継いでおく.
+    auto src = static_cast<uint8_t*>(m_mappedStaging[m_stagingIndex]) + m_dirtyBegin;
+    auto dst = static_cast<uint8_t*>(m_mappedStaging[frameIndex]) + m_dirtyBegin;
+    memcpy(dst, src, m_dirtyEnd - m_dirtyBegin);
+  }
+  m_stagingIndex = frameIndex;
+
+  auto dst = static_cast<uint8_t*>(m_mappedStaging[frameIndex]) + offset;
+  memcpy(dst, data, size);
+
+  m_dirtyBegin = std::min(m_dirtyBegin, offset);
+  m_dirtyEnd = std::max(m_dirtyEnd, offset + size);
+}
+
+void DynamicBuffer::UploadDirtyRange(const ComPtr<ID3D12GraphicsCommandList>& commandList)
+{
+  m_copiedBytes = 0;
+  if (m_dirtyBegin >= m_dirtyEnd)
+  {
+    return;
+  }
+
+  // 初回は生成時の COPY_DEST のままなので、ステートテーブルから遷移が不要と分かる.
+  m_commandPool->Transition(commandList, m_buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+  m_commandPool->FlushBarriers(commandList);
+
+  const UINT size = m_dirtyEnd - m_dirtyBegin;
+  commandList->CopyBufferRegion(
+    m_buffer.Get(), m_dirtyBegin,
+    m_stagingBuffers[m_stagingIndex].Get(), m_dirtyBegin,
+    size);
+
+  m_commandPool->Transition(commandList, m_buffer.Get(), m_usageState);
+  m_commandPool->FlushBarriers(commandList);
+
+  m_copiedBytes = size;
+  m_dirtyBegin = m_bufferSize;
+  m_dirtyEnd = 0;
+}
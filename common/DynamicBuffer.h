@@ -0,0 +1,56 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+#include <vector>
+
+#include "d3dx12.h"
+
+class D3D12AppBase;
+class CommandContextPool;
+class ResourceStateTable;
+
+// CPU から毎フレーム書き換えるデータを DEFAULT ヒープに置くためのバッファ.
+// 書き込みは常時マップしたアップロード用バッファ(フレーム毎)に対して行い、
+// 変更のあった範囲だけを CopyBufferRegion で DEFAULT ヒープへ転送する.
+class DynamicBuffer
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  DynamicBuffer();
+  ~DynamicBuffer();
+
+  // usageState は転送後に遷移させる利用時のステート.
+  void Prepare(D3D12AppBase* app, UINT bufferSize, D3D12_RESOURCE_STATES usageState);
+  void Cleanup();
+
+  // ステージングバッファへ書き込み、転送範囲を広げる.
+  void Write(UINT frameIndex, UINT offset, const void* data, UINT size);
+
+  // 書き込まれた範囲を DEFAULT ヒープへ転送するコマンドを積む.
+  // バリアはプールのステート追跡を通してこの中で記録し、終了時には usageState に戻している.
+  // commandList は D3D12AppBase の CommandContextPool から取り出したものであること.
+  void UploadDirtyRange(const ComPtr<ID3D12GraphicsCommandList>& commandList);
+
+  D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress() const { return m_buffer->GetGPUVirtualAddress(); }
+  ComPtr<ID3D12Resource1> GetResource() const { return m_buffer; }
+  UINT GetSize() const { return m_bufferSize; }
+
+  // 直近の UploadDirtyRange で転送したバイト数.
+  UINT64 GetCopiedBytes() const { return m_copiedBytes; }
+private:
+  ComPtr<ID3D12Resource1> m_buffer;
+  std::vector<ComPtr<ID3D12Resource1>> m_stagingBuffers;
+  std::vector<void*> m_mappedStaging;
+  std::shared_ptr<CommandContextPool> m_commandPool;
+  std::shared_ptr<ResourceStateTable> m_stateTable;
+
+  D3D12_RESOURCE_STATES m_usageState;
+  UINT m_stagingIndex;
+  UINT m_bufferSize;
+  UINT m_dirtyBegin;
+  UINT m_dirtyEnd;
+  UINT64 m_copiedBytes;
+};
@@ -0,0 +1,61 @@
+﻿#pragma once
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+// GPU が使い終えるまで再利用できないオブジェクト(コマンドアロケータなど)のプール.
+// Release でチケット(フェンス値)と共に返し、そのチケットが完了したものだけを Acquire で取り出す.
+// 取り出す前に reset を呼ぶため、アロケータのリセットは GPU が使い終えた後にだけ行われる.
+// チケットは昇順に返すこと. D3D12 には依存しないため、フェンス値を直接与えて動作を確認できる.
+template<class T>
+class FencedPool
+{
+public:
+  using Ticket = uint64_t;
+
+  FencedPool() : m_createdCount(0) { }
+
+  // completed までに完了したものを reset して再利用する. 空きが無ければ create で作る.
+  template<class CreateFunc, class ResetFunc>
+  T Acquire(Ticket completed, CreateFunc create, ResetFunc reset)
+  {
+    // 返した順に完了するため、先頭から完了済みのものを回収する.
+    while (!m_pending.empty() && m_pending.front().first <= completed)
+    {
+      reset(m_pending.front().second);
+      m_free.push_back(std::move(m_pending.front().second));
+      m_pending.pop_front();
+    }
+    if (m_free.empty())
+    {
+      T object = create();
+      ++m_createdCount;
+      return object;
+    }
+    T object = std::move(m_free.back());
+    m_free.pop_back();
+    return object;
+  }
+
+  // ticket が完了するまで使用中として預かる.
+  void Release(T object, Ticket ticket)
+  {
+    m_pending.emplace_back(ticket, std::move(object));
+  }
+
+  // GPU の完了を待った後に呼ぶ.
+  void Clear()
+  {
+    m_pending.clear();
+    m_free.clear();
+  }
+
+  size_t GetCreatedCount() const { return m_createdCount; }
+  size_t GetFreeCount() const { return m_free.size(); }
+  size_t GetPendingCount() const { return m_pending.size(); }
+private:
+  std::deque<std::pair<Ticket, T>> m_pending;
+  std::vector<T> m_free;
+  size_t m_createdCount;
+};
@@ -0,0 +1,482 @@
+﻿#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+class FrameGraphContext;
+
+// パスが読み書きするテクスチャを宣言して組み立てるフレームグラフ.
+// Compile で次を求める.
+// - 出力に寄与しないパスの除去.
+// - パス毎にまとめたリソースバリア. 連続する読み取りは1つのステートにまとめ、不要な遷移は出さない.
+// - 一時テクスチャの共有ヒープ内の配置. 使用期間が重ならないものは同じ領域を使う.
+// D3D12 には依存しないため、GPU を使わずに動作を確認できる. 実行は FrameGraphExecutor が行う.
+//
+// 書き込みは以前の内容を残すものとして扱う(前の書き込みパスも除去しない).
+// 一時テクスチャは他のテクスチャと領域を共有するため、フレームを跨いで内容は残らない.
+// 最初に書き込むパスでクリアすること.
+class FrameGraph
+{
+public:
+  using ResourceId = uint32_t;
+  using PassId = uint32_t;
+  using ExecuteFunc = std::function<void(FrameGraphContext& context)>;
+  enum : uint32_t { InvalidId = 0xFFFFFFFFu };
+
+  // リソースの使われ方. 読み取りのうち MergeableUsages は組み合わせて1つのステートにできる.
+  enum Usage : uint32_t
+  {
+    USAGE_NONE = 0,
+    USAGE_RENDER_TARGET = 1u << 0,
+    USAGE_DEPTH_WRITE = 1u << 1,
+    USAGE_DEPTH_READ = 1u << 2,
+    USAGE_PIXEL_SHADER_RESOURCE = 1u << 3,
+    USAGE_NON_PIXEL_SHADER_RESOURCE = 1u << 4,
+    USAGE_COPY_SOURCE = 1u << 5,
+    USAGE_COPY_DEST = 1u << 6,
+    USAGE_UNORDERED_ACCESS = 1u << 7,
+    USAGE_RESOLVE_SOURCE = 1u << 8,
+    USAGE_RESOLVE_DEST = 1u << 9,
+    USAGE_PRESENT = 1u << 10,
+  };
+  enum : uint32_t
+  {
+    WriteUsages = USAGE_RENDER_TARGET | USAGE_DEPTH_WRITE | USAGE_COPY_DEST | USAGE_UNORDERED_ACCESS | USAGE_RESOLVE_DEST,
+    MergeableUsages = USAGE_DEPTH_READ | USAGE_PIXEL_SHADER_RESOURCE | USAGE_NON_PIXEL_SHADER_RESOURCE | USAGE_COPY_SOURCE | USAGE_RESOLVE_SOURCE,
+  };
+
+  struct TextureDesc
+  {
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;       // DXGI_FORMAT.
+    uint32_t sampleCount;
+    float clearValue[4];   // デプスの場合は [0] を使う.
+  };
+  // 一時テクスチャのメモリ要件. usage は全パスでの使われ方の和.
+  struct SizeInfo
+  {
+    uint64_t size;
+    uint64_t alignment;
+  };
+  using SizeFunc = std::function<SizeInfo(const TextureDesc& desc, uint32_t usage)>;
+
+  struct Barrier
+  {
+    enum Type { TYPE_TRANSITION, TYPE_ALIASING, TYPE_UAV };
+    Type type;
+    ResourceId resource;
+    ResourceId aliasBefore;  // TYPE_ALIASING で直前に同じ領域を使っていたもの. 不明なら InvalidId.
+    uint32_t before;
+    uint32_t after;
+  };
+  struct CompiledPass
+  {
+    PassId pass;
+    std::vector<Barrier> barriers;  // パスの前にまとめて発行する.
+  };
+  struct CompiledResource
+  {
+    bool isUsed;           // 残ったパスのいずれかが参照している.
+    uint32_t usage;        // 全パスでの使われ方の和.
+    uint32_t startUsage;   // フレーム開始時のステート. 一時テクスチャはフレーム終了時と同じ.
+    uint32_t firstPass;    // 使用期間 (CompileResult::passes 内の番号).
+    uint32_t lastPass;
+    uint64_t heapOffset;   // 一時テクスチャの共有ヒープ内の位置.
+    uint64_t size;
+  };
+  struct Stats
+  {
+    uint32_t declaredPassCount;
+    uint32_t culledPassCount;
+    uint32_t transitionCount;
+    uint32_t aliasingCount;
+    uint32_t uavCount;
+    uint32_t barrierBatchCount;  // ResourceBarrier の呼び出し回数.
+    uint32_t transientCount;
+    uint64_t transientBytes;     // 個別に確保した場合の合計.
+    uint64_t aliasedBytes;       // 共有ヒープのサイズ.
+  };
+  struct CompileResult
+  {
+    std::vector<CompiledPass> passes;
+    std::vector<Barrier> finalBarriers;  // 取り込んだリソースを最終ステートへ戻す.
+    std::vector<CompiledResource> resources;
+    uint64_t heapSize;
+    uint64_t heapAlignment;
+    Stats stats;
+  };
+
+  void Reset()
+  {
+    m_resources.clear();
+    m_passes.clear();
+    m_result = CompileResult{};
+  }
+
+  ResourceId CreateTexture(const std::string& name, const TextureDesc& desc)
+  {
+    Resource res{};
+    res.name = name;
+    res.desc = desc;
+    m_resources.push_back(res);
+    return ResourceId(m_resources.size() - 1);
+  }
+  // 外部で管理するテクスチャ. フレーム開始時は initialUsage で、終了時に finalUsage へ戻す.
+  ResourceId ImportTexture(const std::string& name, uint32_t initialUsage, uint32_t finalUsage)
+  {
+    Resource res{};
+    res.name = name;
+    res.isImported = true;
+    res.initialUsage = initialUsage;
+    res.finalUsage = finalUsage;
+    m_resources.push_back(res);
+    return ResourceId(m_resources.size() - 1);
+  }
+
+  // 解像度の変更などで作り直す場合に使う. 反映には Compile が必要.
+  void SetTextureDesc(ResourceId id, const TextureDesc& desc) { m_resources[id].desc = desc; }
+
+  // パスは追加した順に実行される.
+  PassId AddPass(const std::string& name, ExecuteFunc execute)
+  {
+    Pass pass{};
+    pass.name = name;
+    pass.execute = execute;
+    m_passes.push_back(pass);
+    return PassId(m_passes.size() - 1);
+  }
+  void Read(PassId pass, ResourceId resource, uint32_t usage)
+  {
+    m_passes[pass].accesses.push_back(Access{ resource, usage, false });
+  }
+  void Write(PassId pass, ResourceId resource, uint32_t usage)
+  {
+    m_passes[pass].accesses.push_back(Access{ resource, usage, true });
+  }
+  // 出力が無くても除去しない.
+  void SetSideEffect(PassId pass) { m_passes[pass].hasSideEffect = true; }
+
+  const CompileResult& Compile(const SizeFunc& getSizeInfo)
+  {
+    m_result = CompileResult{};
+    auto& result = m_result;
+    result.stats.declaredPassCount = uint32_t(m_passes.size());
+    result.resources.resize(m_resources.size());
+
+    // 後ろから辿り、必要とされるリソースを書き込むパスを残す.
+    std::vector<bool> isNeeded(m_resources.size(), false);
+    std::vector<bool> isAlive(m_passes.size(), false);
+    for (size_t i = m_passes.size(); i-- > 0;)
+    {
+      const auto& pass = m_passes[i];
+      bool alive = pass.hasSideEffect;
+      for (const auto& access : pass.accesses)
+      {
+        if (access.isWrite && (m_resources[access.resource].isImported || isNeeded[access.resource]))
+        {
+          alive = true;
+        }
+      }
+      if (!alive)
+      {
+        ++result.stats.culledPassCount;
+        continue;
+      }
+      isAlive[i] = true;
+      for (const auto& access : pass.accesses)
+      {
+        isNeeded[access.resource] = true;
+      }
+    }
+    for (PassId i = 0; i < PassId(m_passes.size()); ++i)
+    {
+      if (isAlive[i])
+      {
+        result.passes.push_back(CompiledPass{ i, {} });
+      }
+    }
+
+    // 使用期間と使われ方.
+    for (uint32_t p = 0; p < uint32_t(result.passes.size()); ++p)
+    {
+      for (const auto& access : m_passes[result.passes[p].pass].accesses)
+      {
+        auto& res = result.resources[access.resource];
+        if (!res.isUsed)
+        {
+          res.isUsed = true;
+          res.firstPass = p;
+        }
+        res.lastPass = p;
+        res.usage |= access.usage;
+      }
+    }
+
+    PlaceTransients(getSizeInfo);
+
+    // 1回目はフレーム終了時のステートを求めるため. 一時テクスチャはそのステートからフレームを始める.
+    std::vector<uint32_t> endUsages;
+    std::vector<CompiledPass> passes = result.passes;
+    std::vector<Barrier> finalBarriers;
+    BuildBarriers(passes, finalBarriers, endUsages);
+    for (ResourceId r = 0; r < ResourceId(m_resources.size()); ++r)
+    {
+      auto& res = result.resources[r];
+      res.startUsage = m_resources[r].isImported ? m_resources[r].initialUsage : endUsages[r];
+    }
+    BuildBarriers(result.passes, result.finalBarriers, endUsages);
+
+    auto countBarriers = [&result](const std::vector<Barrier>& barriers) {
+      for (const auto& barrier : barriers)
+      {
+        switch (barrier.type)
+        {
+        case Barrier::TYPE_TRANSITION: ++result.stats.transitionCount; break;
+        case Barrier::TYPE_ALIASING: ++result.stats.aliasingCount; break;
+        case Barrier::TYPE_UAV: ++result.stats.uavCount; break;
+        }
+      }
+      if (!barriers.empty())
+      {
+        ++result.stats.barrierBatchCount;
+      }
+    };
+    for (const auto& pass : result.passes)
+    {
+      countBarriers(pass.barriers);
+    }
+    countBarriers(result.finalBarriers);
+    return result;
+  }
+
+  const CompileResult& GetCompileResult() const { return m_result; }
+  uint32_t GetResourceCount() const { return uint32_t(m_resources.size()); }
+  const std::string& GetResourceName(ResourceId id) const { return m_resources[id].name; }
+  const TextureDesc& GetTextureDesc(ResourceId id) const { return m_resources[id].desc; }
+  bool IsImported(ResourceId id) const { return m_resources[id].isImported; }
+  uint32_t GetPassCount() const { return uint32_t(m_passes.size()); }
+  const std::string& GetPassName(PassId id) const { return m_passes[id].name; }
+  const ExecuteFunc& GetExecuteFunc(PassId id) const { return m_passes[id].execute; }
+
+private:
+  struct Resource
+  {
+    std::string name;
+    TextureDesc desc;
+    bool isImported;
+    uint32_t initialUsage;
+    uint32_t finalUsage;
+  };
+  struct Access
+  {
+    ResourceId resource;
+    uint32_t usage;
+    bool isWrite;
+  };
+  struct Pass
+  {
+    std::string name;
+    ExecuteFunc execute;
+    std::vector<Access> accesses;
+    bool hasSideEffect;
+  };
+
+  static bool IsMergeable(uint32_t usage)
+  {
+    return usage != USAGE_NONE && (usage & ~uint32_t(MergeableUsages)) == 0;
+  }
+
+  uint32_t GetPassUsage(PassId pass, ResourceId resource) const
+  {
+    uint32_t usage = USAGE_NONE;
+    for (const auto& access : m_passes[pass].accesses)
+    {
+      if (access.resource == resource)
+      {
+        usage |= access.usage;
+      }
+    }
+    return usage;
+  }
+
+  // 一時テクスチャを大きいものから順に、使用期間が重なるものと領域が重ならない最も低い位置へ置く.
+  void PlaceTransients(const SizeFunc& getSizeInfo)
+  {
+    auto& result = m_result;
+    result.heapAlignment = 1;
+    std::vector<ResourceId> transients;
+    std::vector<uint64_t> alignments(m_resources.size(), 1);
+    for (ResourceId r = 0; r < ResourceId(m_resources.size()); ++r)
+    {
+      auto& res = result.resources[r];
+      if (m_resources[r].isImported || !res.isUsed)
+      {
+        continue;
+      }
+      auto info = getSizeInfo(m_resources[r].desc, res.usage);
+      auto alignment = std::max<uint64_t>(info.alignment, 1);
+      res.size = (info.size + alignment - 1) / alignment * alignment;
+      alignments[r] = alignment;
+      result.heapAlignment = std::max(result.heapAlignment, alignment);
+      result.stats.transientBytes += res.size;
+      ++result.stats.transientCount;
+      transients.push_back(r);
+    }
+    std::stable_sort(transients.begin(), transients.end(), [&result](ResourceId a, ResourceId b) {
+      return result.resources[a].size > result.resources[b].size;
+    });
+
+    std::vector<ResourceId> placed;
+    for (auto r : transients)
+    {
+      auto& res = result.resources[r];
+      // 使用期間が重なるものが占める範囲を低い順に並べ、収まる隙間を探す.
+      std::vector<std::pair<uint64_t, uint64_t>> occupied;
+      for (auto other : placed)
+      {
+        const auto& o = result.resources[other];
+        if (o.firstPass <= res.lastPass && res.firstPass <= o.lastPass)
+        {
+          occupied.emplace_back(o.heapOffset, o.heapOffset + o.size);
+        }
+      }
+      std::sort(occupied.begin(), occupied.end());
+      uint64_t offset = 0;
+      for (const auto& range : occupied)
+      {
+        if (offset + res.size <= range.first)
+        {
+          break;
+        }
+        offset = std::max(offset, (range.second + alignments[r] - 1) / alignments[r] * alignments[r]);
+      }
+      res.heapOffset = offset;
+      result.heapSize = std::max(result.heapSize, offset + res.size);
+      placed.push_back(r);
+    }
+    result.stats.aliasedBytes = result.heapSize;
+  }
+
+  // 同じ領域を直前に使っていた一時テクスチャ. 領域を共有しない場合は false.
+  bool FindAliasBefore(ResourceId r, ResourceId& aliasBefore) const
+  {
+    const auto& result = m_result;
+    const auto& res = result.resources[r];
+    bool isShared = false;
+    aliasBefore = InvalidId;
+    uint32_t latestPass = 0;
+    for (ResourceId other = 0; other < ResourceId(m_resources.size()); ++other)
+    {
+      const auto& o = result.resources[other];
+      if (other == r || m_resources[other].isImported || !o.isUsed)
+      {
+        continue;
+      }
+      if (o.heapOffset >= res.heapOffset + res.size || res.heapOffset >= o.heapOffset + o.size)
+      {
+        continue;
+      }
+      isShared = true;
+      if (o.lastPass < res.firstPass && (aliasBefore == InvalidId || o.lastPass >= latestPass))
+      {
+        aliasBefore = other;
+        latestPass = o.lastPass;
+      }
+    }
+    return isShared;
+  }
+
+  void BuildBarriers(std::vector<CompiledPass>& passes, std::vector<Barrier>& finalBarriers, std::vector<uint32_t>& endUsages) const
+  {
+    const auto& result = m_result;
+    std::vector<uint32_t> current(m_resources.size());
+    for (ResourceId r = 0; r < ResourceId(m_resources.size()); ++r)
+    {
+      current[r] = result.resources[r].startUsage;
+    }
+
+    for (uint32_t p = 0; p < uint32_t(passes.size()); ++p)
+    {
+      auto& compiled = passes[p];
+      compiled.barriers.clear();
+      std::vector<ResourceId> visited;
+      for (const auto& access : m_passes[compiled.pass].accesses)
+      {
+        auto r = access.resource;
+        if (std::find(visited.begin(), visited.end(), r) != visited.end())
+        {
+          continue;
+        }
+        visited.push_back(r);
+        const auto& res = result.resources[r];
+
+        ResourceId aliasBefore;
+        if (!m_resources[r].isImported && res.firstPass == p && FindAliasBefore(r, aliasBefore))
+        {
+          compiled.barriers.push_back(Barrier{ Barrier::TYPE_ALIASING, r, aliasBefore, 0, 0 });
+        }
+
+        auto required = GetPassUsage(compiled.pass, r);
+        auto& state = current[r];
+        if (IsMergeable(required))
+        {
+          if (IsMergeable(state) && (state & required) == required)
+          {
+            continue;
+          }
+          // 後続の読み取りもまとめて1回の遷移で済ませる.
+          auto target = required;
+          for (uint32_t next = p + 1; next < uint32_t(passes.size()); ++next)
+          {
+            auto usage = GetPassUsage(passes[next].pass, r);
+            if (usage == USAGE_NONE)
+            {
+              continue;
+            }
+            if (!IsMergeable(usage))
+            {
+              break;
+            }
+            target |= usage;
+          }
+          if (state != target)
+          {
+            compiled.barriers.push_back(Barrier{ Barrier::TYPE_TRANSITION, r, InvalidId, state, target });
+            state = target;
+          }
+        }
+        else if (state == required)
+        {
+          // 一時テクスチャの最初の使用では前の内容を使わないため、UAV バリアも不要.
+          if ((required & USAGE_UNORDERED_ACCESS) && (m_resources[r].isImported || res.firstPass < p))
+          {
+            compiled.barriers.push_back(Barrier{ Barrier::TYPE_UAV, r, InvalidId, state, state });
+          }
+        }
+        else
+        {
+          compiled.barriers.push_back(Barrier{ Barrier::TYPE_TRANSITION, r, InvalidId, state, required });
+          state = required;
+        }
+      }
+    }
+
+    finalBarriers.clear();
+    for (ResourceId r = 0; r < ResourceId(m_resources.size()); ++r)
+    {
+      if (m_resources[r].isImported && current[r] != m_resources[r].finalUsage)
+      {
+        finalBarriers.push_back(Barrier{ Barrier::TYPE_TRANSITION, r, InvalidId, current[r], m_resources[r].finalUsage });
+        current[r] = m_resources[r].finalUsage;
+      }
+    }
+    endUsages = current;
+  }
+
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+  CompileResult m_result;
+};
@@ -0,0 +1,365 @@
+﻿#include "FrameGraphExecutor.h"
+#include "D3D12AppBase.h"
+#include "D3D12BookUtil.h"
+
+namespace
+{
+  struct DepthFormats
+  {
+    DXGI_FORMAT depth;
+    DXGI_FORMAT typeless;
+    DXGI_FORMAT shaderResource;
+  };
+  // シェーダーからも読むデプスは型なしで生成し、ビュー毎に型を指定する.
+  const DepthFormats DepthFormatTable[] = {
+    { DXGI_FORMAT_D32_FLOAT, DXGI_FORMAT_R32_TYPELESS, DXGI_FORMAT_R32_FLOAT },
+    { DXGI_FORMAT_D24_UNORM_S8_UINT, DXGI_FORMAT_R24G8_TYPELESS, DXGI_FORMAT_R24_UNORM_X8_TYPELESS },
+    { DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_TYPELESS, DXGI_FORMAT_R16_UNORM },
+    { DXGI_FORMAT_D32_FLOAT_S8X24_UINT, DXGI_FORMAT_R32G8X24_TYPELESS, DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS },
+  };
+  const DepthFormats* FindDepthFormats(DXGI_FORMAT format)
+  {
+    for (const auto& formats : DepthFormatTable)
+    {
+      if (formats.depth == format)
+      {
+        return &formats;
+      }
+    }
+    return nullptr;
+  }
+
+  const uint32_t DepthUsages = FrameGraph::USAGE_DEPTH_WRITE | FrameGraph::USAGE_DEPTH_READ;
+  const uint32_t ShaderResourceUsages = FrameGraph::USAGE_PIXEL_SHADER_RESOURCE | FrameGraph::USAGE_NON_PIXEL_SHADER_RESOURCE;
+}
+
+ID3D12Resource* FrameGraphContext::GetResource(ResourceId id) const
+{
+  return m_executor.m_textures[id].resource;
+}
+D3D12_CPU_DESCRIPTOR_HANDLE FrameGraphContext::GetRTV(ResourceId id) const
+{
+  return m_executor.m_textures[id].rtv;
+}
+D3D12_CPU_DESCRIPTOR_HANDLE FrameGraphContext::GetDSV(ResourceId id) const
+{
+  return m_executor.m_textures[id].dsv;
+}
+DescriptorHandle FrameGraphContext::GetSRV(ResourceId id) const
+{
+  return m_executor.m_textures[id].hSRV;
+}
+
+FrameGraphExecutor::FrameGraphExecutor()
+  : m_app(nullptr), m_graph(nullptr), m_result()
+{
+}
+
+FrameGraphExecutor::~FrameGraphExecutor()
+{
+}
+
+void FrameGraphExecutor::Prepare(
+  D3D12AppBase* app,
+  std::shared_ptr<DescriptorManager> rtvHeap,
+  std::shared_ptr<DescriptorManager> dsvHeap,
+  std::shared_ptr<DescriptorManager> srvHeap)
+{
+  m_app = app;
+  m_device = app->GetDevice();
+  m_rtvHeap = rtvHeap;
+  m_dsvHeap = dsvHeap;
+  m_srvHeap = srvHeap;
+  m_commandPool = app->GetCommandContextPool();
+}
+
+void FrameGraphExecutor::Cleanup()
+{
+  if (m_app)
+  {
+    ReleaseTransients();
+  }
+  m_graph = nullptr;
+  m_result = FrameGraph::CompileResult{};
+  m_rtvHeap.reset();
+  m_dsvHeap.reset();
+  m_srvHeap.reset();
+  m_commandPool.reset();
+  m_device.Reset();
+  m_app = nullptr;
+}
+
+void FrameGraphExecutor::Compile(FrameGraph& graph)
+{
+  m_result = graph.Compile(
+    [this](const FrameGraph::TextureDesc& desc, uint32_t usage) {
+      auto resDesc = GetResourceDesc(desc, usage);
+      auto info = m_device->GetResourceAllocationInfo(0, 1, &resDesc);
+      return FrameGraph::SizeInfo{ info.SizeInBytes, info.Alignment };
+    });
+  m_graph = &graph;
+
+  ReleaseTransients();
+  m_textures.assign(graph.GetResourceCount(), Texture{});
+
+  if (m_result.heapSize > 0)
+  {
+    D3D12_HEAP_DESC heapDesc{};
+    heapDesc.SizeInBytes = m_result.heapSize;
+    heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    heapDesc.Alignment = m_result.heapAlignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT ?
+      D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+    HRESULT hr = m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heap));
+    ThrowIfFailed(hr, "CreateHeap failed.(FrameGraph)");
+  }
+
+  for (ResourceId id = 0; id < graph.GetResourceCount(); ++id)
+  {
+    const auto& info = m_result.resources[id];
+    if (graph.IsImported(id) || !info.isUsed)
+    {
+      continue;
+    }
+    if ((info.usage & (FrameGraph::USAGE_RENDER_TARGET | DepthUsages)) == 0)
+    {
+      throw book_util::DX12Exception("FrameGraph transient must be a render target or depth: " + graph.GetResourceName(id));
+    }
+    const auto& desc = graph.GetTextureDesc(id);
+    auto resDesc = GetResourceDesc(desc, info.usage);
+
+    D3D12_CLEAR_VALUE clearValue{};
+    clearValue.Format = DXGI_FORMAT(desc.format);
+    if (info.usage & DepthUsages)
+    {
+      clearValue.DepthStencil.Depth = desc.clearValue[0];
+    }
+    else
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        clearValue.Color[i] = desc.clearValue[i];
+      }
+    }
+
+    auto& texture = m_textures[id];
+    HRESULT hr = m_device->CreatePlacedResource(
+      m_heap.Get(), info.heapOffset, &resDesc,
+      ToResourceStates(info.startUsage), &clearValue,
+      IID_PPV_ARGS(&texture.transient));
+    ThrowIfFailed(hr, "CreatePlacedResource failed.(FrameGraph)");
+    const auto& name = graph.GetResourceName(id);
+    texture.transient->SetName(std::wstring(name.begin(), name.end()).c_str());
+    texture.resource = texture.transient.Get();
+    // 解放は DeferRelease で行い、その時点で登録も外れる.
+    m_app->RegisterResourceState(texture.resource, ToResourceStates(info.startUsage));
+    CreateViews(texture, desc, info.usage);
+  }
+}
+
+void FrameGraphExecutor::SetImportedTexture(ResourceId id, ID3D12Resource* resource,
+  D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+  auto& texture = m_textures[id];
+  texture.resource = resource;
+  texture.rtv = rtv;
+  texture.dsv = dsv;
+}
+
+const std::string& FrameGraphExecutor::GetPassName(UINT index) const
+{
+  return m_graph->GetPassName(m_result.passes[index].pass);
+}
+
+void FrameGraphExecutor::RecordPass(UINT index, GraphicsCommandList& commandList) const
+{
+  const auto& pass = m_result.passes[index];
+  RecordBarriers(pass.barriers, commandList);
+  const auto& execute = m_graph->GetExecuteFunc(pass.pass);
+  if (execute)
+  {
+    FrameGraphContext context(*this, commandList);
+    execute(context);
+  }
+  if (index + 1 == m_result.passes.size())
+  {
+    RecordBarriers(m_result.finalBarriers, commandList);
+  }
+}
+
+void FrameGraphExecutor::Execute(GraphicsCommandList& commandList) const
+{
+  for (UINT i = 0; i < GetPassCount(); ++i)
+  {
+    RecordPass(i, commandList);
+  }
+}
+
+std::vector<CommandContextPool::RecordFunc> FrameGraphExecutor::GetRecordFuncs() const
+{
+  std::vector<CommandContextPool::RecordFunc> funcs;
+  for (UINT i = 0; i < GetPassCount(); ++i)
+  {
+    funcs.push_back([this, i](GraphicsCommandList& commandList) { RecordPass(i, commandList); });
+  }
+  return funcs;
+}
+
+D3D12_RESOURCE_STATES FrameGraphExecutor::ToResourceStates(uint32_t usage)
+{
+  struct UsageState
+  {
+    uint32_t usage;
+    D3D12_RESOURCE_STATES state;
+  };
+  static const UsageState table[] = {
+    { FrameGraph::USAGE_RENDER_TARGET, D3D12_RESOURCE_STATE_RENDER_TARGET },
+    { FrameGraph::USAGE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE },
+    { FrameGraph::USAGE_DEPTH_READ, D3D12_RESOURCE_STATE_DEPTH_READ },
+    { FrameGraph::USAGE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE },
+    { FrameGraph::USAGE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+    { FrameGraph::USAGE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE },
+    { FrameGraph::USAGE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST },
+    { FrameGraph::USAGE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS },
+    { FrameGraph::USAGE_RESOLVE_SOURCE, D3D12_RESOURCE_STATE_RESOLVE_SOURCE },
+    { FrameGraph::USAGE_RESOLVE_DEST, D3D12_RESOURCE_STATE_RESOLVE_DEST },
+    { FrameGraph::USAGE_PRESENT, D3D12_RESOURCE_STATE_PRESENT },
+  };
+  D3D12_RESOURCE_STATES states = D3D12_RESOURCE_STATE_COMMON;
+  for (const auto& entry : table)
+  {
+    if (usage & entry.usage)
+    {
+      states |= entry.state;
+    }
+  }
+  return states;
+}
+
+D3D12_RESOURCE_DESC FrameGraphExecutor::GetResourceDesc(const FrameGraph::TextureDesc& desc, uint32_t usage) const
+{
+  auto format = DXGI_FORMAT(desc.format);
+  D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+  if (usage & FrameGraph::USAGE_RENDER_TARGET)
+  {
+    flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+  }
+  if (usage & DepthUsages)
+  {
+    flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+    auto depthFormats = FindDepthFormats(format);
+    if (depthFormats && (usage & ShaderResourceUsages))
+    {
+      format = depthFormats->typeless;
+    }
+  }
+  if (usage & FrameGraph::USAGE_UNORDERED_ACCESS)
+  {
+    flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+  }
+  auto sampleCount = desc.sampleCount > 0 ? desc.sampleCount : 1;
+  return CD3DX12_RESOURCE_DESC::Tex2D(format, desc.width, desc.height, 1, 1, sampleCount, 0, flags);
+}
+
+void FrameGraphExecutor::CreateViews(Texture& texture, const FrameGraph::TextureDesc& desc, uint32_t usage)
+{
+  auto format = DXGI_FORMAT(desc.format);
+  bool isMultisample = desc.sampleCount > 1;
+  if (usage & FrameGraph::USAGE_RENDER_TARGET)
+  {
+    texture.hRTV = m_rtvHeap->Alloc();
+    texture.hasRTV = true;
+    D3D12_RENDER_TARGET_VIEW_DESC rtvDesc{};
+    rtvDesc.Format = format;
+    rtvDesc.ViewDimension = isMultisample ? D3D12_RTV_DIMENSION_TEXTURE2DMS : D3D12_RTV_DIMENSION_TEXTURE2D;
+    m_device->CreateRenderTargetView(texture.resource, &rtvDesc, texture.hRTV);
+    texture.rtv = texture.hRTV;
+  }
+  if (usage & DepthUsages)
+  {
+    texture.hDSV = m_dsvHeap->Alloc();
+    texture.hasDSV = true;
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
+    dsvDesc.Format = format;
+    dsvDesc.ViewDimension = isMultisample ? D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+    m_device->CreateDepthStencilView(texture.resource, &dsvDesc, texture.hDSV);
+    texture.dsv = texture.hDSV;
+
+    auto depthFormats = FindDepthFormats(format);
+    if (depthFormats)
+    {
+      format = depthFormats->shaderResource;
+    }
+  }
+  if (usage & ShaderResourceUsages)
+  {
+    texture.hSRV = m_srvHeap->Alloc();
+    texture.hasSRV = true;
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+    srvDesc.Format = format;
+    srvDesc.ViewDimension = isMultisample ? D3D12_SRV_DIMENSION_TEXTURE2DMS : D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    m_device->CreateShaderResourceView(texture.resource, &srvDesc, texture.hSRV);
+  }
+}
+
+void FrameGraphExecutor::ReleaseTransients()
+{
+  // 描画中のフレームが使い終えてから解放する.
+  for (auto& texture : m_textures)
+  {
+    if (texture.hasRTV)
+    {
+      m_app->DeferFree(m_rtvHeap, texture.hRTV);
+    }
+    if (texture.hasDSV)
+    {
+      m_app->DeferFree(m_dsvHeap, texture.hDSV);
+    }
+    if (texture.hasSRV)
+    {
+      m_app->DeferFree(m_srvHeap, texture.hSRV);
+    }
+    if (texture.transient)
+    {
+      m_app->DeferRelease(texture.transient);
+    }
+  }
+  m_textures.clear();
+  if (m_heap)
+  {
+    m_app->DeferRelease(m_heap);
+    m_heap.Reset();
+  }
+}
+
+void FrameGraphExecutor::RecordBarriers(const std::vector<FrameGraph::Barrier>& barriers, GraphicsCommandList& commandList) const
+{
+  if (barriers.empty())
+  {
+    return;
+  }
+  // 遷移前のステートはプールのステートテーブルが持つものを使い、グラフの外で変えられていても合わせる.
+  for (const auto& barrier : barriers)
+  {
+    auto resource = m_textures[barrier.resource].resource;
+    switch (barrier.type)
+    {
+    case FrameGraph::Barrier::TYPE_TRANSITION:
+      m_commandPool->Transition(commandList, resource, ToResourceStates(barrier.after));
+      break;
+    case FrameGraph::Barrier::TYPE_ALIASING:
+    {
+      // 直前の使用者が不明な場合は NULL とし、同じ領域を使う全てのリソースを対象にする.
+      auto before = barrier.aliasBefore != FrameGraph::InvalidId ? m_textures[barrier.aliasBefore].resource : nullptr;
+      m_commandPool->AliasingBarrier(commandList, before, resource);
+      break;
+    }
+    case FrameGraph::Barrier::TYPE_UAV:
+      m_commandPool->UAVBarrier(commandList, resource);
+      break;
+    }
+  }
+  m_commandPool->FlushBarriers(commandList);
+}
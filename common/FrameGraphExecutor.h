@@ -0,0 +1,107 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameGraph.h"
+#include "DescriptorManager.h"
+#include "CommandContextPool.h"
+
+class D3D12AppBase;
+class FrameGraphExecutor;
+
+// パスの実行時に渡される. 宣言したリソースとビューを ID で引く.
+class FrameGraphContext
+{
+public:
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+  using ResourceId = FrameGraph::ResourceId;
+
+  FrameGraphContext(const FrameGraphExecutor& executor, GraphicsCommandList& commandList)
+    : m_executor(executor), m_commandList(commandList) { }
+
+  GraphicsCommandList& GetCommandList() { return m_commandList; }
+  ID3D12Resource* GetResource(ResourceId id) const;
+  D3D12_CPU_DESCRIPTOR_HANDLE GetRTV(ResourceId id) const;
+  D3D12_CPU_DESCRIPTOR_HANDLE GetDSV(ResourceId id) const;
+  DescriptorHandle GetSRV(ResourceId id) const;
+private:
+  const FrameGraphExecutor& m_executor;
+  GraphicsCommandList& m_commandList;
+};
+
+// FrameGraph のコンパイル結果を D3D12 で実行する.
+// 一時テクスチャは1つのヒープ上に配置リソースとして生成し、使用期間の重ならないものは同じ領域を使う.
+// コンパイルで求めたバリアを各パスの先頭でまとめて発行してから、パスの処理を呼ぶ.
+// バリアは CommandContextPool のステート追跡を通すため、コマンドリストはプールの Begin か Record で用意すること.
+class FrameGraphExecutor
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+  using GraphicsCommandList = CommandContextPool::GraphicsCommandList;
+  using ResourceId = FrameGraph::ResourceId;
+
+  FrameGraphExecutor();
+  ~FrameGraphExecutor();
+
+  // srvHeap は一時テクスチャの SRV を置くヒープ.
+  void Prepare(
+    D3D12AppBase* app,
+    std::shared_ptr<DescriptorManager> rtvHeap,
+    std::shared_ptr<DescriptorManager> dsvHeap,
+    std::shared_ptr<DescriptorManager> srvHeap);
+  void Cleanup();
+
+  // グラフをコンパイルして一時テクスチャを生成する. 以前のものは GPU が使い終えてから解放する.
+  // graph は実行時にも参照するため、保持しておくこと.
+  void Compile(FrameGraph& graph);
+
+  // 取り込んだテクスチャの実体. バックバッファのように毎フレーム変わるものは記録前に設定する.
+  void SetImportedTexture(ResourceId id, ID3D12Resource* resource,
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv = D3D12_CPU_DESCRIPTOR_HANDLE());
+
+  // 除去されずに残ったパス.
+  UINT GetPassCount() const { return UINT(m_result.passes.size()); }
+  const std::string& GetPassName(UINT index) const;
+  // バリアとパスの処理を記録する. 最後のパスでは取り込んだテクスチャを最終ステートへ戻す.
+  void RecordPass(UINT index, GraphicsCommandList& commandList) const;
+  // 全パスを1つのコマンドリストへ記録する.
+  void Execute(GraphicsCommandList& commandList) const;
+  // パス毎に別のコマンドリストへ記録するための関数. CommandContextPool::Record へ渡す.
+  std::vector<CommandContextPool::RecordFunc> GetRecordFuncs() const;
+
+  // 一時テクスチャの SRV. 再コンパイルするまで有効.
+  DescriptorHandle GetSRV(ResourceId id) const { return m_textures[id].hSRV; }
+
+  const FrameGraph::Stats& GetStats() const { return m_result.stats; }
+  UINT64 GetHeapSize() const { return m_result.heapSize; }
+
+  static D3D12_RESOURCE_STATES ToResourceStates(uint32_t usage);
+private:
+  friend class FrameGraphContext;
+  struct Texture
+  {
+    ComPtr<ID3D12Resource1> transient;
+    ID3D12Resource* resource;
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv;
+    D3D12_CPU_DESCRIPTOR_HANDLE dsv;
+    DescriptorHandle hRTV, hDSV, hSRV;
+    bool hasRTV, hasDSV, hasSRV;
+  };
+  D3D12_RESOURCE_DESC GetResourceDesc(const FrameGraph::TextureDesc& desc, uint32_t usage) const;
+  void CreateViews(Texture& texture, const FrameGraph::TextureDesc& desc, uint32_t usage);
+  void ReleaseTransients();
+  void RecordBarriers(const std::vector<FrameGraph::Barrier>& barriers, GraphicsCommandList& commandList) const;
+
+  D3D12AppBase* m_app;
+  ComPtr<ID3D12Device> m_device;
+  std::shared_ptr<DescriptorManager> m_rtvHeap, m_dsvHeap, m_srvHeap;
+  std::shared_ptr<CommandContextPool> m_commandPool;
+  const FrameGraph* m_graph;
+  FrameGraph::CompileResult m_result;
+  ComPtr<ID3D12Heap> m_heap;
+  std::vector<Texture> m_textures;
+};
@@ -0,0 +1,181 @@
+﻿#include "GeometryPool.h"
+#include "D3D12AppBase.h"
+#include "D3D12BookUtil.h"
+
+#include <algorithm>
+
+GeometryPool::GeometryPool()
+  : m_vertexStride(0), m_uploadTicket(0)
+{
+}
+
+void GeometryPool::Prepare(D3D12AppBase* app, UINT vertexStride, UINT maxVertexCount, UINT maxIndexCount)
+{
+  m_vertexStride = vertexStride;
+  m_vertexAllocator.Reset(maxVertexCount);
+  m_indexAllocator.Reset(maxIndexCount);
+  m_vertexBuffer = CreateArena(app, vertexStride * maxVertexCount);
+  m_indexBuffer = CreateArena(app, UINT(sizeof(UINT)) * maxIndexCount);
+  m_vertexBuffer->SetName(L"GeometryPool(VB)");
+  m_indexBuffer->SetName(L"GeometryPool(IB)");
+  m_uploadTicket = 0;
+}
+
+void GeometryPool::Cleanup(D3D12AppBase* app)
+{
+  app->DeferRelease(m_vertexBuffer);
+  app->DeferRelease(m_indexBuffer);
+  m_vertexBuffer.Reset();
+  m_indexBuffer.Reset();
+  m_meshes.clear();
+  m_isMeshAlive.clear();
+  m_freeHandles.clear();
+}
+
+GeometryPool::MeshHandle GeometryPool::AddMesh(D3D12AppBase* app,
+  const void* vertices, UINT vertexCount,
+  const UINT* indices, UINT indexCount)
+{
+  UINT baseVertex = m_vertexAllocator.Allocate(vertexCount);
+  if (baseVertex == RangeAllocator::InvalidOffset)
+  {
+    return InvalidHandle;
+  }
+  UINT firstIndex = m_indexAllocator.Allocate(indexCount);
+  if (firstIndex == RangeAllocator::InvalidOffset)
+  {
+    m_vertexAllocator.Free(baseVertex, vertexCount);
+    return InvalidHandle;
+  }
+
+  // コピーキューのバッチへ積む. 複数のメッシュの転送は次の Flush でまとめて投入される.
+  // バッファは同時アクセスが可能なため、描画中の他のメッシュの領域と重ならなければ書き込める.
+  auto uploader = app->GetUploadManager();
+  uploader->UploadBuffer(m_vertexBuffer.Get(), UINT64(baseVertex) * m_vertexStride,
+    vertices, UINT64(vertexCount) * m_vertexStride);
+  m_uploadTicket = uploader->UploadBuffer(m_indexBuffer.Get(), UINT64(firstIndex) * sizeof(UINT),
+    indices, UINT64(indexCount) * sizeof(UINT));
+
+  MeshInfo info{ baseVertex, vertexCount, firstIndex, indexCount };
+  MeshHandle handle;
+  if (!m_freeHandles.empty())
+  {
+    handle = m_freeHandles.back();
+    m_freeHandles.pop_back();
+    m_meshes[handle] = info;
+    m_isMeshAlive[handle] = true;
+  }
+  else
+  {
+    handle = MeshHandle(m_meshes.size());
+    m_meshes.push_back(info);
+    m_isMeshAlive.push_back(true);
+  }
+  return handle;
+}
+
+void GeometryPool::RemoveMesh(MeshHandle handle)
+{
+  if (handle >= m_meshes.size() || !m_isMeshAlive[handle])
+  {
+    return;
+  }
+  const auto& info = m_meshes[handle];
+  m_vertexAllocator.Free(info.baseVertex, info.vertexCount);
+  m_indexAllocator.Free(info.firstIndex, info.indexCount);
+  m_isMeshAlive[handle] = false;
+  m_freeHandles.push_back(handle);
+}
+
+void GeometryPool::Compact(D3D12AppBase* app)
+{
+  auto newVB = CreateArena(app, m_vertexStride * m_vertexAllocator.GetTotalSize());
+  auto newIB = CreateArena(app, UINT(sizeof(UINT)) * m_indexAllocator.GetTotalSize());
+  newVB->SetName(L"GeometryPool(VB)");
+  newIB->SetName(L"GeometryPool(IB)");
+
+  // 旧バッファへの転送が残っていれば、コピーの前に描画キューで待つ.
+  app->QueueWaitForUpload(m_uploadTicket);
+
+  // 遷移はステートテーブルを通し、投入時の実際のステートから張る.
+  auto pool = app->GetCommandContextPool();
+  auto command = app->CreateCommandList();
+  pool->Transition(command, m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+  pool->Transition(command, m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+  pool->Transition(command, newVB.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+  pool->Transition(command, newIB.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+  pool->FlushBarriers(command);
+
+  // 生きているメッシュを先頭から順に詰める. ハンドルはそのまま使える.
+  UINT vertexCursor = 0, indexCursor = 0;
+  for (MeshHandle i = 0; i < MeshHandle(m_meshes.size()); ++i)
+  {
+    if (!m_isMeshAlive[i])
+      continue;
+    auto& info = m_meshes[i];
+    command->CopyBufferRegion(
+      newVB.Get(), UINT64(vertexCursor) * m_vertexStride,
+      m_vertexBuffer.Get(), UINT64(info.baseVertex) * m_vertexStride,
+      UINT64(info.vertexCount) * m_vertexStride);
+    command->CopyBufferRegion(
+      newIB.Get(), UINT64(indexCursor) * sizeof(UINT),
+      m_indexBuffer.Get(), UINT64(info.firstIndex) * sizeof(UINT),
+      UINT64(info.indexCount) * sizeof(UINT));
+    info.baseVertex = vertexCursor;
+    info.firstIndex = indexCursor;
+    vertexCursor += info.vertexCount;
+    indexCursor += info.indexCount;
+  }
+
+  // 以降の転送はコピーキューで行うため COMMON へ戻しておく. 描画では暗黙の昇格で使う.
+  pool->Transition(command, newVB.Get(), D3D12_RESOURCE_STATE_COMMON);
+  pool->Transition(command, newIB.Get(), D3D12_RESOURCE_STATE_COMMON);
+  app->FinishCommandList(command);
+
+  app->DeferRelease(m_vertexBuffer);
+  app->DeferRelease(m_indexBuffer);
+  m_vertexBuffer = newVB;
+  m_indexBuffer = newIB;
+
+  // 詰めた後は空き領域が末尾の1つだけになる.
+  auto rebuild = [](RangeAllocator& allocator, UINT used) {
+    allocator.Reset(allocator.GetTotalSize());
+    allocator.Allocate(used);
+  };
+  rebuild(m_vertexAllocator, vertexCursor);
+  rebuild(m_indexAllocator, indexCursor);
+}
+
+D3D12_VERTEX_BUFFER_VIEW GeometryPool::GetVertexBufferView() const
+{
+  D3D12_VERTEX_BUFFER_VIEW vbView{};
+  vbView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+  vbView.StrideInBytes = m_vertexStride;
+  vbView.SizeInBytes = m_vertexStride * m_vertexAllocator.GetTotalSize();
+  return vbView;
+}
+
+D3D12_INDEX_BUFFER_VIEW GeometryPool::GetIndexBufferView() const
+{
+  D3D12_INDEX_BUFFER_VIEW ibView{};
+  ibView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+  ibView.Format = DXGI_FORMAT_R32_UINT;
+  ibView.SizeInBytes = UINT(sizeof(UINT)) * m_indexAllocator.GetTotalSize();
+  return ibView;
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const
+{
+  Stats stats{};
+  stats.vertex = m_vertexAllocator.GetStats();
+  stats.index = m_indexAllocator.GetStats();
+  stats.meshCount = UINT(std::count(m_isMeshAlive.begin(), m_isMeshAlive.end(), true));
+  return stats;
+}
+
+GeometryPool::ComPtr<ID3D12Resource1> GeometryPool::CreateArena(D3D12AppBase* app, UINT size)
+{
+  return app->CreateResource(
+    CD3DX12_RESOURCE_DESC::Buffer(size),
+    D3D12_RESOURCE_STATE_COMMON, nullptr, D3D12_HEAP_TYPE_DEFAULT);
+}
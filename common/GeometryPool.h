@@ -0,0 +1,79 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <vector>
+
+#include "d3dx12.h"
+#include "UploadManager.h"
+#include "RangeAllocator.h"
+
+class D3D12AppBase;
+
+// 複数のメッシュの頂点とインデックスを、1つの DEFAULT ヒープ上のバッファへまとめて配置する.
+// メッシュは BaseVertexLocation / StartIndexLocation で参照するため、
+// 同じプールのメッシュは頂点バッファ・インデックスバッファの設定を共有できる.
+// バッファは COMMON のまま置き、転送はコピーキュー、描画では暗黙の昇格で使う.
+class GeometryPool
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  using MeshHandle = UINT;
+  enum { InvalidHandle = 0xFFFFFFFFu };
+
+  struct MeshInfo
+  {
+    UINT baseVertex;
+    UINT vertexCount;
+    UINT firstIndex;
+    UINT indexCount;
+  };
+  struct Stats
+  {
+    RangeAllocator::Stats vertex;
+    RangeAllocator::Stats index;
+    UINT meshCount;
+  };
+
+  GeometryPool();
+
+  // インデックスは 32bit 固定.
+  void Prepare(D3D12AppBase* app, UINT vertexStride, UINT maxVertexCount, UINT maxIndexCount);
+  void Cleanup(D3D12AppBase* app);
+
+  // 頂点とインデックスを転送して登録する. インデックスはメッシュ先頭からの相対値のままでよい.
+  // 転送は UploadManager へ積むだけで待機しない. 空きが無い場合は InvalidHandle を返す.
+  // 描画の前に GetUploadTicket を QueueWaitForUpload へ渡すこと. 未投入の転送はそこで投入される.
+  MeshHandle AddMesh(D3D12AppBase* app,
+    const void* vertices, UINT vertexCount,
+    const UINT* indices, UINT indexCount);
+  void RemoveMesh(MeshHandle handle);
+
+  // 使用中の領域を先頭から詰め直す. 新しいバッファへ GPU 上でコピーし、完了まで待機する.
+  // 旧バッファは使用中のコマンドの完了後に解放する.
+  // オフセットが変わるため記録済みのバンドルは作り直すこと.
+  void Compact(D3D12AppBase* app);
+
+  // 直近の AddMesh の転送を示すチケット. これより前の転送も含む.
+  UploadManager::Ticket GetUploadTicket() const { return m_uploadTicket; }
+
+  const MeshInfo& GetMesh(MeshHandle handle) const { return m_meshes[handle]; }
+  D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView() const;
+  D3D12_INDEX_BUFFER_VIEW GetIndexBufferView() const;
+
+  Stats GetStats() const;
+private:
+  ComPtr<ID3D12Resource1> CreateArena(D3D12AppBase* app, UINT size);
+
+  ComPtr<ID3D12Resource1> m_vertexBuffer;
+  ComPtr<ID3D12Resource1> m_indexBuffer;
+  RangeAllocator m_vertexAllocator;
+  RangeAllocator m_indexAllocator;
+  UINT m_vertexStride;
+  UploadManager::Ticket m_uploadTicket;
+
+  std::vector<MeshInfo> m_meshes;
+  std::vector<bool> m_isMeshAlive;
+  std::vector<MeshHandle> m_freeHandles;
+};
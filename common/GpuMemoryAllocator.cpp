@@ -0,0 +1,296 @@
+﻿#include "GpuMemoryAllocator.h"
+#include "D3D12BookUtil.h"
+
+#include <atomic>
+#include <string>
+
+namespace
+{
+  // 配置リソースに関連付ける追跡オブジェクトの識別子.
+  // {6A3B1C52-8E0F-4D57-9B7A-2F41C6D8E903}
+  const GUID PlacedAllocationTrackerGuid =
+  { 0x6a3b1c52, 0x8e0f, 0x4d57, { 0x9b, 0x7a, 0x2f, 0x41, 0xc6, 0xd8, 0xe9, 0x3 } };
+
+  const D3D12_HEAP_TYPE HeapTypes[GpuMemoryAllocator::HeapTypeCount] = {
+    D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_TYPE_READBACK,
+  };
+  const D3D12_HEAP_FLAGS HeapFlags[GpuMemoryAllocator::HEAP_CATEGORY_COUNT] = {
+    D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+    D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+    D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+  };
+}
+
+// リソースのプライベートデータとして保持させ、リソースの破棄時に領域を返却する.
+// アロケータが先に破棄された場合は何もしない(ヒープはリソース側が参照している).
+class GpuMemoryAllocator::PlacedAllocationTracker : public IUnknown
+{
+public:
+  PlacedAllocationTracker(std::weak_ptr<GpuMemoryAllocator> owner, int typeIndex, HeapCategory category, const HeapBlockPool::Allocation& allocation)
+    : m_refCount(1), m_owner(owner), m_typeIndex(typeIndex), m_category(category), m_allocation(allocation)
+  {
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (ppvObject == nullptr)
+    {
+      return E_POINTER;
+    }
+    if (riid == __uuidof(IUnknown))
+    {
+      *ppvObject = static_cast<IUnknown*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override
+  {
+    return ++m_refCount;
+  }
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    auto count = --m_refCount;
+    if (count == 0)
+    {
+      if (auto owner = m_owner.lock())
+      {
+        owner->FreePlaced(m_typeIndex, m_category, m_allocation);
+      }
+      delete this;
+    }
+    return count;
+  }
+private:
+  std::atomic<ULONG> m_refCount;
+  std::weak_ptr<GpuMemoryAllocator> m_owner;
+  int m_typeIndex;
+  HeapCategory m_category;
+  HeapBlockPool::Allocation m_allocation;
+};
+
+GpuMemoryAllocator::GpuMemoryAllocator()
+  : m_placedCount(0), m_committedCount(0)
+{
+}
+
+GpuMemoryAllocator::~GpuMemoryAllocator()
+{
+}
+
+void GpuMemoryAllocator::Prepare(ComPtr<ID3D12Device> device, UINT64 blockSize)
+{
+  m_device = device;
+  for (int t = 0; t < HeapTypeCount; ++t)
+  {
+    for (int c = 0; c < HEAP_CATEGORY_COUNT; ++c)
+    {
+      auto category = HeapCategory(c);
+      m_pools[t][c].Reset(
+        blockSize,
+        [this, t, category](uint32_t blockIndex, uint64_t size) { return CreateHeapBlock(t, category, blockIndex, size); },
+        [this, t, c](uint32_t blockIndex) { m_heaps[t][c][blockIndex].Reset(); }
+      );
+    }
+  }
+  m_smallBufferPool.Reset(
+    SmallBufferPageSize,
+    [this](uint32_t pageIndex, uint64_t) { return CreatePage(pageIndex); },
+    [this](uint32_t pageIndex) { m_pages[pageIndex] = Page{}; }
+  );
+}
+
+GpuMemoryAllocator::ComPtr<ID3D12Resource1> GpuMemoryAllocator::CreateResource(
+  const D3D12_RESOURCE_DESC& desc,
+  D3D12_RESOURCE_STATES resourceStates,
+  const D3D12_CLEAR_VALUE* clearValue,
+  D3D12_HEAP_TYPE heapType)
+{
+  HRESULT hr;
+  ComPtr<ID3D12Resource1> ret;
+  auto typeIndex = GetHeapTypeIndex(heapType);
+  auto category = GetHeapCategory(desc);
+  // UPLOAD/READBACK ヒープに置けるのはバッファのみ.
+  bool isPlaceable = typeIndex >= 0 && (heapType == D3D12_HEAP_TYPE_DEFAULT || category == HEAP_CATEGORY_BUFFER);
+
+  if (isPlaceable)
+  {
+    auto info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    HeapBlockPool::Allocation allocation;
+    if (m_pools[typeIndex][category].Allocate(info.SizeInBytes, info.Alignment, allocation))
+    {
+      auto heap = m_heaps[typeIndex][category][allocation.blockIndex];
+      hr = m_device->CreatePlacedResource(
+        heap.Get(),
+        allocation.offset,
+        &desc,
+        resourceStates,
+        clearValue,
+        IID_PPV_ARGS(&ret)
+      );
+      if (FAILED(hr))
+      {
+        m_pools[typeIndex][category].Free(allocation);
+        ThrowIfFailed(hr, "CreatePlacedResource Failed.");
+      }
+      // 追跡オブジェクトの参照はリソースへ移す.
+      auto tracker = new PlacedAllocationTracker(shared_from_this(), typeIndex, category, allocation);
+      ret->SetPrivateDataInterface(PlacedAllocationTrackerGuid, tracker);
+      tracker->Release();
+      ++m_placedCount;
+      return ret;
+    }
+  }
+
+  const auto heapProps = CD3DX12_HEAP_PROPERTIES(heapType);
+  hr = m_device->CreateCommittedResource(
+    &heapProps,
+    D3D12_HEAP_FLAG_NONE,
+    &desc,
+    resourceStates,
+    clearValue,
+    IID_PPV_ARGS(&ret)
+  );
+  ThrowIfFailed(hr, "CreateCommittedResource Failed.");
+  ++m_committedCount;
+  return ret;
+}
+
+GpuMemoryAllocator::SmallBuffer GpuMemoryAllocator::AllocateSmallBuffer(UINT64 size)
+{
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  SmallBuffer ret{};
+  if (size == 0 || size > SmallBufferPageSize ||
+    !m_smallBufferPool.Allocate(size, SmallBufferAlignment, ret.allocation))
+  {
+    throw book_util::DX12Exception("AllocateSmallBuffer Failed. size=" + std::to_string(size));
+  }
+  const auto& page = m_pages[ret.allocation.blockIndex];
+  ret.resource = page.resource;
+  ret.offset = ret.allocation.offset;
+  ret.size = size;
+  ret.address = page.resource->GetGPUVirtualAddress() + ret.offset;
+  ret.mapped = static_cast<char*>(page.mapped) + ret.offset;
+  return ret;
+}
+
+void GpuMemoryAllocator::FreeSmallBuffer(const SmallBuffer& buffer)
+{
+  if (!buffer.resource)
+  {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  m_smallBufferPool.Free(buffer.allocation);
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats()
+{
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  Stats stats{};
+  UINT64 freeTotal = 0;
+  for (int t = 0; t < HeapTypeCount; ++t)
+  {
+    for (int c = 0; c < HEAP_CATEGORY_COUNT; ++c)
+    {
+      const auto s = m_pools[t][c].GetStats();
+      stats.pools[t][c] = s;
+      stats.total.blockCount += s.blockCount;
+      stats.total.allocationCount += s.allocationCount;
+      stats.total.reserved += s.reserved;
+      stats.total.used += s.used;
+      stats.total.freeBlockCount += s.freeBlockCount;
+      stats.total.largestFreeBlock = std::max(stats.total.largestFreeBlock, s.largestFreeBlock);
+      freeTotal += s.reserved - s.used;
+    }
+  }
+  if (freeTotal > 0)
+  {
+    stats.total.fragmentation = 1.0f - float(double(stats.total.largestFreeBlock) / double(freeTotal));
+  }
+  stats.smallBuffers = m_smallBufferPool.GetStats();
+  stats.placedCount = m_placedCount;
+  stats.committedCount = m_committedCount;
+  return stats;
+}
+
+int GpuMemoryAllocator::GetHeapTypeIndex(D3D12_HEAP_TYPE heapType)
+{
+  for (int i = 0; i < HeapTypeCount; ++i)
+  {
+    if (HeapTypes[i] == heapType)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+GpuMemoryAllocator::HeapCategory GpuMemoryAllocator::GetHeapCategory(const D3D12_RESOURCE_DESC& desc)
+{
+  if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+  {
+    return HEAP_CATEGORY_BUFFER;
+  }
+  const auto rtds = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+  return (desc.Flags & rtds) ? HEAP_CATEGORY_RT_DS_TEXTURE : HEAP_CATEGORY_TEXTURE;
+}
+
+bool GpuMemoryAllocator::CreateHeapBlock(int typeIndex, HeapCategory category, uint32_t blockIndex, UINT64 size)
+{
+  // RT/DS は MSAA のリソースも置けるよう 4MB 境界のヒープにする.
+  UINT64 alignment = category == HEAP_CATEGORY_RT_DS_TEXTURE ?
+    D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+  D3D12_HEAP_DESC heapDesc{};
+  heapDesc.SizeInBytes = (size + alignment - 1) & ~(alignment - 1);
+  heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(HeapTypes[typeIndex]);
+  heapDesc.Alignment = alignment;
+  heapDesc.Flags = HeapFlags[category];
+
+  ComPtr<ID3D12Heap> heap;
+  HRESULT hr = m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap));
+  if (FAILED(hr))
+  {
+    return false;
+  }
+  auto& heaps = m_heaps[typeIndex][category];
+  if (blockIndex >= heaps.size())
+  {
+    heaps.resize(blockIndex + 1);
+  }
+  heaps[blockIndex] = heap;
+  return true;
+}
+
+bool GpuMemoryAllocator::CreatePage(uint32_t pageIndex)
+{
+  Page page;
+  page.resource = CreateResource(
+    CD3DX12_RESOURCE_DESC::Buffer(SmallBufferPageSize),
+    D3D12_RESOURCE_STATE_GENERIC_READ,
+    nullptr,
+    D3D12_HEAP_TYPE_UPLOAD
+  );
+  // UPLOAD ヒープはマップしたままにしておける.
+  CD3DX12_RANGE readRange(0, 0);
+  HRESULT hr = page.resource->Map(0, &readRange, &page.mapped);
+  if (FAILED(hr))
+  {
+    return false;
+  }
+  if (pageIndex >= m_pages.size())
+  {
+    m_pages.resize(pageIndex + 1);
+  }
+  m_pages[pageIndex] = page;
+  return true;
+}
+
+void GpuMemoryAllocator::FreePlaced(int typeIndex, HeapCategory category, const HeapBlockPool::Allocation& allocation)
+{
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  m_pools[typeIndex][category].Free(allocation);
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TlsfAllocator.h"
+
+// リソースを大きな ID3D12Heap から切り出して CreatePlacedResource で生成するアロケータ.
+// ヒープはヒープ種別とリソースの分類(バッファ/テクスチャ/RT・DS)ごとにブロック単位で確保する.
+// 生成したリソースが破棄されると、そのリソースの領域は自動的にヒープへ返却される.
+// 小さな定数バッファ向けに、共有バッファ内の一部を切り出す SmallBuffer も提供する.
+// リソースの破棄に合わせて参照されるため、std::make_shared で生成すること.
+class GpuMemoryAllocator : public std::enable_shared_from_this<GpuMemoryAllocator>
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  enum : UINT64 {
+    DefaultBlockSize = 32 * 1024 * 1024,
+    SmallBufferPageSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+    SmallBufferAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT,
+  };
+  enum HeapCategory {
+    HEAP_CATEGORY_BUFFER,
+    HEAP_CATEGORY_TEXTURE,
+    HEAP_CATEGORY_RT_DS_TEXTURE,
+    HEAP_CATEGORY_COUNT,
+  };
+  enum { HeapTypeCount = 3 }; // DEFAULT, UPLOAD, READBACK
+
+  // 共有バッファ内の一部. UPLOAD ヒープ上にあり、常にマップされている.
+  struct SmallBuffer
+  {
+    ComPtr<ID3D12Resource1> resource;
+    UINT64 offset;
+    UINT64 size;
+    D3D12_GPU_VIRTUAL_ADDRESS address;
+    void* mapped;
+    HeapBlockPool::Allocation allocation;
+  };
+
+  struct Stats
+  {
+    HeapBlockPool::Stats pools[HeapTypeCount][HEAP_CATEGORY_COUNT];
+    HeapBlockPool::Stats smallBuffers;
+    HeapBlockPool::Stats total;
+    UINT64 placedCount;     // 生成した配置リソースの累計.
+    UINT64 committedCount;  // ヒープから切り出せずコミットリソースにした累計.
+  };
+
+  GpuMemoryAllocator();
+  ~GpuMemoryAllocator();
+  GpuMemoryAllocator(const GpuMemoryAllocator&) = delete;
+  GpuMemoryAllocator& operator=(const GpuMemoryAllocator&) = delete;
+
+  void Prepare(ComPtr<ID3D12Device> device, UINT64 blockSize = DefaultBlockSize);
+
+  ComPtr<ID3D12Resource1> CreateResource(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES resourceStates,
+    const D3D12_CLEAR_VALUE* clearValue,
+    D3D12_HEAP_TYPE heapType
+  );
+
+  // SmallBufferPageSize 以下のバッファを共有バッファから切り出す.
+  // GPU が使用中の可能性がある間は FreeSmallBuffer を呼ばないこと.
+  SmallBuffer AllocateSmallBuffer(UINT64 size);
+  void FreeSmallBuffer(const SmallBuffer& buffer);
+
+  Stats GetStats();
+private:
+  class PlacedAllocationTracker;
+  struct Page
+  {
+    ComPtr<ID3D12Resource1> resource;
+    void* mapped;
+  };
+
+  static int GetHeapTypeIndex(D3D12_HEAP_TYPE heapType);
+  static HeapCategory GetHeapCategory(const D3D12_RESOURCE_DESC& desc);
+  bool CreateHeapBlock(int typeIndex, HeapCategory category, uint32_t blockIndex, UINT64 size);
+  bool CreatePage(uint32_t pageIndex);
+  void FreePlaced(int typeIndex, HeapCategory category, const HeapBlockPool::Allocation& allocation);
+
+  ComPtr<ID3D12Device> m_device;
+  std::recursive_mutex m_mutex;  // 領域の返却はリソースの破棄に伴って入れ子で起こりうる.
+  HeapBlockPool m_pools[HeapTypeCount][HEAP_CATEGORY_COUNT];
+  std::vector<ComPtr<ID3D12Heap>> m_heaps[HeapTypeCount][HEAP_CATEGORY_COUNT];
+  HeapBlockPool m_smallBufferPool;
+  std::vector<Page> m_pages;
+  UINT64 m_placedCount;
+  UINT64 m_committedCount;
+};
@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// [0, count) を最大 threadCount 本のスレッドで分担して func(i) を呼ぶ. 呼び出したスレッドも処理に加わる.
+// 各スレッドは次の番号を順に取りに行くため、処理時間にばらつきがあっても偏りにくい.
+// threadCount が 0 なら論理コア数を使う.
+// func が投げた例外は全ての処理が終わってから、番号の最も小さいものを投げ直す.
+template<class Func>
+void ParallelFor(size_t count, unsigned threadCount, Func func)
+{
+  if (threadCount == 0)
+  {
+    threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+  }
+  threadCount = unsigned((std::min)(size_t(threadCount), count));
+
+  std::vector<std::exception_ptr> errors(count);
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++)
+    {
+      try
+      {
+        func(i);
+      }
+      catch (...)
+      {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < threadCount; ++i)
+  {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  for (auto& error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+}
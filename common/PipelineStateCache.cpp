@@ -0,0 +1,303 @@
+﻿#include "PipelineStateCache.h"
+#include "D3D12BookUtil.h"
+
+#include <dxgi1_6.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+  using clock = std::chrono::high_resolution_clock;
+  double ElapsedMs(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+}
+
+PipelineStateCache::PipelineStateCache()
+  : m_adapter(), m_isDirty(false), m_stats()
+{
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+  Cleanup();
+}
+
+void PipelineStateCache::Prepare(ComPtr<ID3D12Device> device, const std::wstring& fileName)
+{
+  m_device = device;
+  m_fileName = fileName;
+  m_isDirty = false;
+  m_stats = Stats();
+  OpenLibrary();
+}
+
+void PipelineStateCache::Cleanup()
+{
+  if (!m_device)
+  {
+    return;
+  }
+  Save();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_pipelines.clear();
+  m_libraryPipelines.clear();
+  m_rootSignatures.clear();
+  m_rootSignatureHashes.clear();
+  m_library.Reset();
+  m_libraryData.clear();
+  m_loadedKeys.clear();
+  m_device.Reset();
+}
+
+HRESULT PipelineStateCache::CreateRootSignature(UINT nodeMask, const void* blob, SIZE_T blobLength, REFIID riid, void** ppRootSignature)
+{
+  auto hash = PipelineStateKey::Hash(blob, blobLength);
+  auto bytes = static_cast<const uint8_t*>(blob);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto range = m_rootSignatures.equal_range(hash);
+  for (auto itr = range.first; itr != range.second; ++itr)
+  {
+    const auto& entry = itr->second;
+    if (entry.nodeMask == nodeMask && entry.blob.size() == blobLength &&
+      std::equal(entry.blob.begin(), entry.blob.end(), bytes))
+    {
+      ++m_stats.rootSignatureHitCount;
+      return entry.rootSignature.CopyTo(riid, ppRootSignature);
+    }
+  }
+
+  RootSignatureEntry entry;
+  HRESULT hr = m_device->CreateRootSignature(nodeMask, blob, blobLength, IID_PPV_ARGS(&entry.rootSignature));
+  if (FAILED(hr))
+  {
+    return hr;
+  }
+  entry.blob.assign(bytes, bytes + blobLength);
+  entry.nodeMask = nodeMask;
+  m_rootSignatureHashes[entry.rootSignature.Get()] = PipelineStateKey::Hash(&nodeMask, sizeof(nodeMask), hash);
+  ++m_stats.rootSignatureCount;
+  auto rootSignature = entry.rootSignature;
+  m_rootSignatures.emplace(hash, std::move(entry));
+  return rootSignature.CopyTo(riid, ppRootSignature);
+}
+
+HRESULT PipelineStateCache::CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc, REFIID riid, void** ppPipelineState)
+{
+  auto start = clock::now();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  ++m_stats.requestCount;
+
+  // キャッシュを通さずに作ったルートシグネチャは内容が分からないため、メモリ上でのみ共有する.
+  uint64_t rootSignatureHash = uint64_t(uintptr_t(desc->pRootSignature));
+  bool isPersistent = false;
+  auto found = m_rootSignatureHashes.find(desc->pRootSignature);
+  if (found != m_rootSignatureHashes.end())
+  {
+    rootSignatureHash = found->second;
+    isPersistent = true;
+  }
+  auto key = PipelineStateKey::FromGraphicsDesc(*desc, rootSignatureHash);
+
+  ComPtr<ID3D12PipelineState> pso;
+  auto itr = m_pipelines.find(key);
+  if (itr != m_pipelines.end())
+  {
+    ++m_stats.memoryHitCount;
+    pso = itr->second;
+  }
+  else
+  {
+    auto name = key.GetName();
+    isPersistent = isPersistent && m_library;
+    if (isPersistent && SUCCEEDED(m_library->LoadGraphicsPipeline(name.c_str(), desc, IID_PPV_ARGS(&pso))))
+    {
+      ++m_stats.libraryHitCount;
+    }
+    else
+    {
+      // コンパイルには時間がかかるため、他のスレッドの要求を止めないようロックを外す.
+      lock.unlock();
+      HRESULT hr = m_device->CreateGraphicsPipelineState(desc, IID_PPV_ARGS(&pso));
+      lock.lock();
+      if (FAILED(hr))
+      {
+        m_stats.pipelineMs += ElapsedMs(start);
+        return hr;
+      }
+      ++m_stats.compiledCount;
+      auto raced = m_pipelines.find(key);
+      if (raced != m_pipelines.end())
+      {
+        pso = raced->second;
+      }
+      else if (isPersistent && SUCCEEDED(m_library->StorePipeline(name.c_str(), pso.Get())))
+      {
+        m_isDirty = true;
+      }
+    }
+    if (isPersistent)
+    {
+      m_libraryPipelines.emplace(key.GetHash(), pso);
+    }
+    m_pipelines.emplace(std::move(key), pso);
+  }
+  m_stats.pipelineMs += ElapsedMs(start);
+  return pso.CopyTo(riid, ppPipelineState);
+}
+
+void PipelineStateCache::Save()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_library || !m_isDirty || m_fileName.empty())
+  {
+    return;
+  }
+
+  // シェーダーの変更などで使われなくなったものが残っていれば、今回使ったものだけで作り直す.
+  bool hasStale = false;
+  for (auto key : m_loadedKeys)
+  {
+    hasStale = hasStale || m_libraryPipelines.find(key) == m_libraryPipelines.end();
+  }
+  auto library = m_library;
+  std::vector<uint64_t> keys;
+  if (hasStale)
+  {
+    ComPtr<ID3D12PipelineLibrary> rebuilt;
+    if (SUCCEEDED(CreateLibrary(nullptr, 0, rebuilt)))
+    {
+      for (const auto& item : m_libraryPipelines)
+      {
+        rebuilt->StorePipeline(PipelineStateKey::MakeName(item.first).c_str(), item.second.Get());
+      }
+      library = rebuilt;
+    }
+    else
+    {
+      keys = m_loadedKeys;
+    }
+  }
+  else
+  {
+    keys = m_loadedKeys;
+  }
+  for (const auto& item : m_libraryPipelines)
+  {
+    if (std::find(keys.begin(), keys.end(), item.first) == keys.end())
+    {
+      keys.push_back(item.first);
+    }
+  }
+
+  std::vector<uint8_t> serialized(library->GetSerializedSize());
+  HRESULT hr = library->Serialize(serialized.data(), serialized.size());
+  if (FAILED(hr))
+  {
+    OutputDebugStringA("PipelineStateCache: Serialize failed.\n");
+    return;
+  }
+  auto data = PipelineCacheFile::Write(m_adapter, keys, serialized.data(), serialized.size());
+  std::ofstream outfile(m_fileName, std::ios::binary | std::ios::trunc);
+  if (!outfile.write(reinterpret_cast<const char*>(data.data()), data.size()))
+  {
+    OutputDebugStringA("PipelineStateCache: failed to write the cache file.\n");
+    return;
+  }
+  m_loadedKeys = keys;
+  m_isDirty = false;
+}
+
+PipelineStateCache::Stats PipelineStateCache::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void PipelineStateCache::OpenLibrary()
+{
+  auto start = clock::now();
+  if (m_fileName.empty() || !GetAdapterInfo(m_adapter))
+  {
+    m_stats.invalidReason = "disabled";
+    return;
+  }
+
+  std::vector<uint8_t> data;
+  std::ifstream infile(m_fileName, std::ios::binary);
+  if (infile)
+  {
+    data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+  }
+  PipelineCacheFile file;
+  m_stats.invalidReason = PipelineCacheFile::Read(data, m_adapter, file);
+  if (m_stats.invalidReason == nullptr)
+  {
+    m_libraryData.swap(file.library);
+    HRESULT hr = CreateLibrary(m_libraryData.data(), m_libraryData.size(), m_library);
+    if (SUCCEEDED(hr))
+    {
+      m_loadedKeys = file.keys;
+      m_stats.isWarm = true;
+    }
+    else
+    {
+      // ヘッダが一致してもドライバ側で使えないと判断される場合がある. 空のライブラリから作り直す.
+      m_stats.invalidReason =
+        hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH ? "driver mismatch" :
+        hr == D3D12_ERROR_ADAPTER_NOT_FOUND ? "adapter not found" : "corrupted";
+      m_libraryData.clear();
+    }
+  }
+  if (!m_library && FAILED(CreateLibrary(nullptr, 0, m_library)))
+  {
+    // ID3D12PipelineLibrary に対応していない環境では、メモリ上での重複の除去のみ行う.
+    m_library.Reset();
+    m_stats.invalidReason = "library unsupported";
+  }
+  m_stats.loadMs = ElapsedMs(start);
+}
+
+bool PipelineStateCache::GetAdapterInfo(PipelineCacheFile::AdapterInfo& info) const
+{
+  ComPtr<IDXGIFactory4> factory;
+  if (FAILED(CreateDXGIFactory2(0, IID_PPV_ARGS(&factory))))
+  {
+    return false;
+  }
+  ComPtr<IDXGIAdapter1> adapter;
+  if (FAILED(factory->EnumAdapterByLuid(m_device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+  {
+    return false;
+  }
+  DXGI_ADAPTER_DESC1 desc{};
+  adapter->GetDesc1(&desc);
+  // ユーザーモードドライバのバージョン.
+  LARGE_INTEGER driverVersion{};
+  adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+
+  info.vendorId = desc.VendorId;
+  info.deviceId = desc.DeviceId;
+  info.subSysId = desc.SubSysId;
+  info.revision = desc.Revision;
+  info.driverVersion = uint64_t(driverVersion.QuadPart);
+  return true;
+}
+
+HRESULT PipelineStateCache::CreateLibrary(const void* data, SIZE_T size, ComPtr<ID3D12PipelineLibrary>& library)
+{
+  ComPtr<ID3D12Device1> device1;
+  HRESULT hr = m_device.As(&device1);
+  if (FAILED(hr))
+  {
+    return hr;
+  }
+  library.Reset();
+  return device1->CreatePipelineLibrary(data, size, IID_PPV_ARGS(&library));
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PipelineStateKey.h"
+
+// パイプラインステートとルートシグネチャのキャッシュ.
+// 同じ記述の生成要求には生成済みのものを返し、ドライバでのコンパイルはアプリの実行中に1度だけ行う.
+// コンパイルしたパイプラインは ID3D12PipelineLibrary に格納してファイルへ保存し、次回の起動時はそこから読み込む.
+// アダプタやドライバが変わったファイルは破棄する. シェーダーを変えた場合はキーが変わるため、新しく作り直される.
+// 生成関数は ID3D12Device と同じ形にしてあり、呼び出し側は device を置き換えるだけでよい.
+class PipelineStateCache
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  struct Stats
+  {
+    UINT requestCount;          // パイプラインの生成要求の数.
+    UINT memoryHitCount;        // 生成済みのものを返した数.
+    UINT libraryHitCount;       // ライブラリから読み込んだ数.
+    UINT compiledCount;         // ドライバでコンパイルした数.
+    UINT rootSignatureCount;    // 生成したルートシグネチャの数.
+    UINT rootSignatureHitCount; // 生成済みのルートシグネチャを返した数.
+    double pipelineMs;          // パイプラインの生成要求にかかった時間の累計.
+    double loadMs;              // ファイルの読み込みとライブラリの生成にかかった時間.
+    bool isWarm;                // 保存済みのライブラリを使えた.
+    const char* invalidReason;  // ファイルを使わなかった理由. 使えた場合は nullptr.
+  };
+
+  PipelineStateCache();
+  ~PipelineStateCache();
+
+  // fileName が空ならファイルへは保存せず、メモリ上での重複の除去のみ行う.
+  void Prepare(ComPtr<ID3D12Device> device, const std::wstring& fileName);
+  // 保存してから全てを解放する.
+  void Cleanup();
+
+  HRESULT CreateRootSignature(UINT nodeMask, const void* blob, SIZE_T blobLength, REFIID riid, void** ppRootSignature);
+  HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc, REFIID riid, void** ppPipelineState);
+
+  // 新しく格納したパイプラインがあればファイルへ書き出す. その際、今回使わなかったものは取り除く.
+  void Save();
+
+  Stats GetStats() const;
+private:
+  struct RootSignatureEntry
+  {
+    std::vector<uint8_t> blob;
+    UINT nodeMask;
+    ComPtr<ID3D12RootSignature> rootSignature;
+  };
+  void OpenLibrary();
+  bool GetAdapterInfo(PipelineCacheFile::AdapterInfo& info) const;
+  HRESULT CreateLibrary(const void* data, SIZE_T size, ComPtr<ID3D12PipelineLibrary>& library);
+
+  ComPtr<ID3D12Device> m_device;
+  std::wstring m_fileName;
+  PipelineCacheFile::AdapterInfo m_adapter;
+
+  mutable std::mutex m_mutex;
+  std::unordered_multimap<uint64_t, RootSignatureEntry> m_rootSignatures;
+  // ルートシグネチャからシリアライズ済みの内容のハッシュを引く.
+  std::unordered_map<ID3D12RootSignature*, uint64_t> m_rootSignatureHashes;
+  std::unordered_map<PipelineStateKey, ComPtr<ID3D12PipelineState>, PipelineStateKey::Hasher> m_pipelines;
+  // 今回ライブラリから読み込んだ、または格納したパイプライン. 名前はキーのハッシュから作る.
+  std::unordered_map<uint64_t, ComPtr<ID3D12PipelineState>> m_libraryPipelines;
+
+  // ID3D12PipelineLibrary は生成時のデータを参照し続けるため、ライブラリより長く保持する.
+  std::vector<uint8_t> m_libraryData;
+  ComPtr<ID3D12PipelineLibrary> m_library;
+  std::vector<uint64_t> m_loadedKeys;
+  bool m_isDirty;
+  Stats m_stats;
+};
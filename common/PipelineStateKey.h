@@ -0,0 +1,319 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// グラフィックスパイプラインの記述を、ポインタを含まない正規化したバイト列へ変換したもの.
+// シェーダーとルートシグネチャは内容のハッシュで表すため、別々に生成したバイトコードでも中身が同じなら同じキーになる.
+// 結果に影響しない値 (無効なブレンドの係数、無効なデプス/ステンシルの設定、使わないターゲットのフォーマットなど) は 0 にそろえる.
+// D3D12 の構造体のみを参照し API は呼ばないため、GPU を使わずに動作を確認できる.
+class PipelineStateKey
+{
+public:
+  enum : uint64_t
+  {
+    FnvOffsetBasis = 0xcbf29ce484222325ull,
+    FnvPrime = 0x100000001b3ull,
+  };
+
+  PipelineStateKey() : m_hash(0) { }
+
+  // FNV-1a (64bit).
+  static uint64_t Hash(const void* data, size_t size, uint64_t seed = FnvOffsetBasis)
+  {
+    auto p = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= p[i];
+      hash *= FnvPrime;
+    }
+    return hash;
+  }
+  // 空のシェーダーは 0.
+  static uint64_t HashShader(const D3D12_SHADER_BYTECODE& shader)
+  {
+    if (shader.pShaderBytecode == nullptr || shader.BytecodeLength == 0)
+    {
+      return 0;
+    }
+    return Hash(shader.pShaderBytecode, shader.BytecodeLength);
+  }
+
+  // rootSignatureHash はシリアライズ済みルートシグネチャのハッシュ. CachedPSO は含めない.
+  static PipelineStateKey FromGraphicsDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+  {
+    PipelineStateKey key;
+    key.Write(uint32_t(TypeGraphics));
+    key.Write(rootSignatureHash);
+    for (const auto* shader : { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS })
+    {
+      key.Write(HashShader(*shader));
+    }
+
+    const auto& so = desc.StreamOutput;
+    key.Write(so.NumEntries);
+    for (UINT i = 0; so.pSODeclaration && i < so.NumEntries; ++i)
+    {
+      const auto& entry = so.pSODeclaration[i];
+      key.Write(entry.Stream);
+      key.WriteSemantic(entry.SemanticName);
+      key.Write(entry.SemanticIndex);
+      key.Write(entry.StartComponent);
+      key.Write(entry.ComponentCount);
+      key.Write(entry.OutputSlot);
+    }
+    key.Write(so.NumStrides);
+    for (UINT i = 0; so.pBufferStrides && i < so.NumStrides; ++i)
+    {
+      key.Write(so.pBufferStrides[i]);
+    }
+    key.Write(so.NumEntries > 0 ? so.RasterizedStream : 0u);
+
+    // IndependentBlendEnable でなければ RenderTarget[0] の設定が全ターゲットに使われる.
+    const auto& blend = desc.BlendState;
+    key.Write(blend.AlphaToCoverageEnable);
+    key.Write(blend.IndependentBlendEnable);
+    UINT blendCount = blend.IndependentBlendEnable ? desc.NumRenderTargets : 1;
+    for (UINT i = 0; i < blendCount && i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+    {
+      auto rt = blend.RenderTarget[i];
+      if (!rt.BlendEnable)
+      {
+        rt.SrcBlend = rt.DestBlend = rt.SrcBlendAlpha = rt.DestBlendAlpha = D3D12_BLEND(0);
+        rt.BlendOp = rt.BlendOpAlpha = D3D12_BLEND_OP(0);
+      }
+      if (!rt.LogicOpEnable)
+      {
+        rt.LogicOp = D3D12_LOGIC_OP(0);
+      }
+      key.Write(rt.BlendEnable);
+      key.Write(rt.LogicOpEnable);
+      key.Write(rt.SrcBlend);
+      key.Write(rt.DestBlend);
+      key.Write(rt.BlendOp);
+      key.Write(rt.SrcBlendAlpha);
+      key.Write(rt.DestBlendAlpha);
+      key.Write(rt.BlendOpAlpha);
+      key.Write(rt.LogicOp);
+      key.Write(rt.RenderTargetWriteMask);
+    }
+    key.Write(desc.SampleMask);
+
+    const auto& rs = desc.RasterizerState;
+    key.Write(rs.FillMode);
+    key.Write(rs.CullMode);
+    key.Write(rs.FrontCounterClockwise);
+    key.Write(rs.DepthBias);
+    key.Write(rs.DepthBiasClamp);
+    key.Write(rs.SlopeScaledDepthBias);
+    key.Write(rs.DepthClipEnable);
+    key.Write(rs.MultisampleEnable);
+    key.Write(rs.AntialiasedLineEnable);
+    key.Write(rs.ForcedSampleCount);
+    key.Write(rs.ConservativeRaster);
+
+    auto ds = desc.DepthStencilState;
+    if (!ds.DepthEnable)
+    {
+      ds.DepthWriteMask = D3D12_DEPTH_WRITE_MASK(0);
+      ds.DepthFunc = D3D12_COMPARISON_FUNC(0);
+    }
+    if (!ds.StencilEnable)
+    {
+      ds.StencilReadMask = ds.StencilWriteMask = 0;
+      ds.FrontFace = ds.BackFace = D3D12_DEPTH_STENCILOP_DESC{};
+    }
+    key.Write(ds.DepthEnable);
+    key.Write(ds.DepthWriteMask);
+    key.Write(ds.DepthFunc);
+    key.Write(ds.StencilEnable);
+    key.Write(ds.StencilReadMask);
+    key.Write(ds.StencilWriteMask);
+    for (const auto* face : { &ds.FrontFace, &ds.BackFace })
+    {
+      key.Write(face->StencilFailOp);
+      key.Write(face->StencilDepthFailOp);
+      key.Write(face->StencilPassOp);
+      key.Write(face->StencilFunc);
+    }
+
+    const auto& layout = desc.InputLayout;
+    key.Write(layout.NumElements);
+    for (UINT i = 0; layout.pInputElementDescs && i < layout.NumElements; ++i)
+    {
+      const auto& element = layout.pInputElementDescs[i];
+      key.WriteSemantic(element.SemanticName);
+      key.Write(element.SemanticIndex);
+      key.Write(element.Format);
+      key.Write(element.InputSlot);
+      key.Write(element.AlignedByteOffset);
+      key.Write(element.InputSlotClass);
+      key.Write(element.InputSlotClass == D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA ? element.InstanceDataStepRate : 0u);
+    }
+
+    key.Write(desc.IBStripCutValue);
+    key.Write(desc.PrimitiveTopologyType);
+    key.Write(desc.NumRenderTargets);
+    for (UINT i = 0; i < desc.NumRenderTargets && i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+    {
+      key.Write(desc.RTVFormats[i]);
+    }
+    key.Write(desc.DSVFormat);
+    key.Write(desc.SampleDesc.Count);
+    key.Write(desc.SampleDesc.Quality);
+    key.Write(desc.NodeMask);
+    key.Write(desc.Flags);
+
+    key.m_hash = Hash(key.m_bytes.data(), key.m_bytes.size());
+    return key;
+  }
+
+  uint64_t GetHash() const { return m_hash; }
+  const std::vector<uint8_t>& GetBytes() const { return m_bytes; }
+  // ID3D12PipelineLibrary へ格納する際の名前.
+  std::wstring GetName() const { return MakeName(m_hash); }
+  static std::wstring MakeName(uint64_t hash)
+  {
+    const wchar_t digits[] = L"0123456789abcdef";
+    std::wstring name = L"PSO_";
+    for (int shift = 60; shift >= 0; shift -= 4)
+    {
+      name += digits[(hash >> shift) & 0xF];
+    }
+    return name;
+  }
+
+  bool operator==(const PipelineStateKey& other) const
+  {
+    return m_hash == other.m_hash && m_bytes == other.m_bytes;
+  }
+  bool operator!=(const PipelineStateKey& other) const { return !(*this == other); }
+
+  struct Hasher
+  {
+    size_t operator()(const PipelineStateKey& key) const { return size_t(key.m_hash); }
+  };
+private:
+  enum { TypeGraphics = 1 };
+
+  template<class T>
+  void Write(const T& value)
+  {
+    auto p = reinterpret_cast<const uint8_t*>(&value);
+    m_bytes.insert(m_bytes.end(), p, p + sizeof(T));
+  }
+  // セマンティクス名は大文字小文字を区別しない.
+  void WriteSemantic(const char* name)
+  {
+    uint32_t length = name ? uint32_t(strlen(name)) : 0;
+    Write(length);
+    for (uint32_t i = 0; i < length; ++i)
+    {
+      char c = name[i];
+      Write(char(c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c));
+    }
+  }
+
+  std::vector<uint8_t> m_bytes;
+  uint64_t m_hash;
+};
+
+// PipelineStateCache が保存するファイルの形式.
+// ヘッダ、格納したパイプラインのハッシュの一覧、ID3D12PipelineLibrary::Serialize の結果の順に並ぶ.
+// アダプタやドライバが変わった場合、形式の版が変わった場合は読み込まずに破棄する.
+struct PipelineCacheFile
+{
+  enum : uint32_t
+  {
+    Magic = 0x43505350,   // "PSPC"
+    Version = 1,          // キーの正規化を変えた場合も上げること.
+  };
+  struct AdapterInfo
+  {
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint32_t subSysId;
+    uint32_t revision;
+    uint64_t driverVersion;
+  };
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    AdapterInfo adapter;
+    uint32_t keyCount;
+    uint32_t reserved;
+    uint64_t librarySize;
+  };
+
+  std::vector<uint64_t> keys;
+  std::vector<uint8_t> library;
+
+  static std::vector<uint8_t> Write(const AdapterInfo& adapter, const std::vector<uint64_t>& keys, const void* library, size_t librarySize)
+  {
+    Header header{};
+    header.magic = Magic;
+    header.version = Version;
+    header.adapter = adapter;
+    header.keyCount = uint32_t(keys.size());
+    header.librarySize = librarySize;
+
+    std::vector<uint8_t> data(sizeof(Header) + keys.size() * sizeof(uint64_t) + librarySize);
+    memcpy(data.data(), &header, sizeof(Header));
+    if (!keys.empty())
+    {
+      memcpy(data.data() + sizeof(Header), keys.data(), keys.size() * sizeof(uint64_t));
+    }
+    if (librarySize > 0)
+    {
+      memcpy(data.data() + sizeof(Header) + keys.size() * sizeof(uint64_t), library, librarySize);
+    }
+    return data;
+  }
+
+  // 使えない場合は理由を返す. 使える場合は nullptr.
+  static const char* Read(const std::vector<uint8_t>& data, const AdapterInfo& adapter, PipelineCacheFile& out)
+  {
+    out.keys.clear();
+    out.library.clear();
+    if (data.empty())
+    {
+      return "no file";
+    }
+    Header header;
+    if (data.size() < sizeof(Header))
+    {
+      return "truncated";
+    }
+    memcpy(&header, data.data(), sizeof(Header));
+    if (header.magic != Magic || header.version != Version)
+    {
+      return "format changed";
+    }
+    if (header.adapter.vendorId != adapter.vendorId || header.adapter.deviceId != adapter.deviceId ||
+      header.adapter.subSysId != adapter.subSysId || header.adapter.revision != adapter.revision)
+    {
+      return "adapter changed";
+    }
+    if (header.adapter.driverVersion != adapter.driverVersion)
+    {
+      return "driver changed";
+    }
+    const uint64_t keyBytes = uint64_t(header.keyCount) * sizeof(uint64_t);
+    if (data.size() != sizeof(Header) + keyBytes + header.librarySize)
+    {
+      return "truncated";
+    }
+    out.keys.resize(header.keyCount);
+    if (header.keyCount > 0)
+    {
+      memcpy(out.keys.data(), data.data() + sizeof(Header), size_t(keyBytes));
+    }
+    out.library.assign(data.begin() + size_t(sizeof(Header) + keyBytes), data.end());
+    return nullptr;
+  }
+};
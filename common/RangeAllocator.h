@@ -0,0 +1,127 @@
+﻿#pragma once
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <cstdint>
+
+// 要素単位で範囲を切り出すアロケータ.
+// 空き領域をオフセット順に保持し、解放時に前後の空き領域と結合する.
+// D3D12 には依存しないため、GPU リソースを作らずに動作を確認できる.
+class RangeAllocator
+{
+public:
+  enum : uint32_t { InvalidOffset = 0xFFFFFFFFu };
+
+  struct Stats
+  {
+    uint32_t totalSize;
+    uint32_t usedSize;
+    uint32_t freeBlockCount;
+    uint32_t largestFreeBlock;
+    // 空き領域のうち、最大の空きブロックに含まれない割合 (0 で断片化なし).
+    float fragmentation;
+  };
+
+  RangeAllocator() : m_totalSize(0), m_usedSize(0) { }
+  explicit RangeAllocator(uint32_t totalSize) { Reset(totalSize); }
+
+  // [0, totalSize) を1つの空き領域として初期化する.
+  void Reset(uint32_t totalSize)
+  {
+    m_totalSize = totalSize;
+    m_usedSize = 0;
+    m_freeBlocks.clear();
+    if (totalSize > 0)
+    {
+      m_freeBlocks[0] = totalSize;
+    }
+  }
+
+  // 最も小さく収まる空き領域から確保する. 確保できない場合は InvalidOffset.
+  uint32_t Allocate(uint32_t size)
+  {
+    if (size == 0)
+    {
+      return InvalidOffset;
+    }
+    auto best = m_freeBlocks.end();
+    for (auto itr = m_freeBlocks.begin(); itr != m_freeBlocks.end(); ++itr)
+    {
+      if (itr->second < size)
+        continue;
+      if (best == m_freeBlocks.end() || itr->second < best->second)
+      {
+        best = itr;
+        if (best->second == size)
+          break;
+      }
+    }
+    if (best == m_freeBlocks.end())
+    {
+      return InvalidOffset;
+    }
+
+    uint32_t offset = best->first;
+    uint32_t remain = best->second - size;
+    m_freeBlocks.erase(best);
+    if (remain > 0)
+    {
+      m_freeBlocks[offset + size] = remain;
+    }
+    m_usedSize += size;
+    return offset;
+  }
+
+  void Free(uint32_t offset, uint32_t size)
+  {
+    if (size == 0)
+    {
+      return;
+    }
+    m_usedSize -= size;
+
+    auto next = m_freeBlocks.lower_bound(offset);
+    // 後ろの空き領域と結合.
+    if (next != m_freeBlocks.end() && offset + size == next->first)
+    {
+      size += next->second;
+      next = m_freeBlocks.erase(next);
+    }
+    // 前の空き領域と結合.
+    if (next != m_freeBlocks.begin())
+    {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset)
+      {
+        prev->second += size;
+        return;
+      }
+    }
+    m_freeBlocks[offset] = size;
+  }
+
+  Stats GetStats() const
+  {
+    Stats stats{};
+    stats.totalSize = m_totalSize;
+    stats.usedSize = m_usedSize;
+    stats.freeBlockCount = uint32_t(m_freeBlocks.size());
+    for (const auto& block : m_freeBlocks)
+    {
+      stats.largestFreeBlock = std::max(stats.largestFreeBlock, block.second);
+    }
+    uint32_t freeSize = m_totalSize - m_usedSize;
+    if (freeSize > 0)
+    {
+      stats.fragmentation = 1.0f - float(stats.largestFreeBlock) / float(freeSize);
+    }
+    return stats;
+  }
+
+  uint32_t GetTotalSize() const { return m_totalSize; }
+  uint32_t GetUsedSize() const { return m_usedSize; }
+private:
+  std::map<uint32_t, uint32_t> m_freeBlocks;  // オフセット => サイズ.
+  uint32_t m_totalSize;
+  uint32_t m_usedSize;
+};
@@ -0,0 +1,329 @@
+﻿#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// キューへ投入済みのコマンドを基準にした、リソース(サブリソース)毎の現在のステート.
+// 全てのコマンドリストで共有し、投入時に ResourceStateTracker::Resolve で更新する.
+// ステートの値は D3D12_RESOURCE_STATES と同じ. キーはリソースのアドレス.
+// 同じアドレスに別のリソースが生成された場合に備え、生成時に Register で上書きすること.
+class ResourceStateTable
+{
+public:
+  using ResourceKey = const void*;
+
+  void Register(ResourceKey resource, uint32_t subresourceCount, uint32_t initialState)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[resource].assign(subresourceCount > 0 ? subresourceCount : 1, initialState);
+  }
+  void Unregister(ResourceKey resource)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states.erase(resource);
+  }
+  bool IsRegistered(ResourceKey resource) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_states.find(resource) != m_states.end();
+  }
+  // 登録されていないリソースは 1 を返す.
+  uint32_t GetSubresourceCount(ResourceKey resource) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itr = m_states.find(resource);
+    return itr != m_states.end() ? uint32_t(itr->second.size()) : 1;
+  }
+  uint32_t GetState(ResourceKey resource, uint32_t subresource) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itr = m_states.find(resource);
+    assert(itr != m_states.end() && subresource < itr->second.size());
+    return itr->second[subresource];
+  }
+  size_t GetResourceCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_states.size();
+  }
+
+private:
+  friend class ResourceStateTracker;
+  mutable std::mutex m_mutex;
+  std::unordered_map<ResourceKey, std::vector<uint32_t>> m_states;
+};
+
+// コマンドリスト1つ分のリソースステートの追跡.
+// Transition は直ちにバリアを出さずに積んでおき、描画やコピーの直前の Flush でまとめて1回の ResourceBarrier にする.
+// - 既にそのステートにある、または読み取りステートに含まれる遷移は出さない.
+// - 積んだまま Flush されていない遷移が続く場合は1つにまとめ、元のステートへ戻るものは取り除く.
+// - このリストで初めて使うリソースは前のステートが分からないため、バリアを出さずに必要なステートを覚えておく.
+//   投入時の Resolve で共有テーブルのステートと比べ、必要なバリアをこのリストの前に置く.
+// D3D12 には依存しないため、GPU を使わずに動作を確認できる.
+class ResourceStateTracker
+{
+public:
+  using ResourceKey = ResourceStateTable::ResourceKey;
+  enum : uint32_t
+  {
+    AllSubresources = 0xFFFFFFFFu,  // D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES と同じ値.
+    UnknownState = 0xFFFFFFFFu,
+  };
+  // 組み合わせて同時に持てる読み取りステート.
+  // VERTEX_AND_CONSTANT_BUFFER, INDEX_BUFFER, DEPTH_READ, NON_PIXEL_SHADER_RESOURCE,
+  // PIXEL_SHADER_RESOURCE, INDIRECT_ARGUMENT, COPY_SOURCE, RESOLVE_SOURCE.
+  enum : uint32_t { ReadOnlyStates = 0x1 | 0x2 | 0x20 | 0x40 | 0x80 | 0x200 | 0x800 | 0x2000 };
+
+  struct Barrier
+  {
+    enum Type { TYPE_TRANSITION, TYPE_ALIASING, TYPE_UAV };
+    Type type;
+    ResourceKey resource;
+    uint32_t subresource;
+    uint32_t before;
+    uint32_t after;
+    ResourceKey resourceBefore;   // TYPE_ALIASING で直前に同じ領域を使っていたもの. 不明なら nullptr.
+  };
+  struct Stats
+  {
+    uint64_t requestCount;      // Transition の呼び出し回数.
+    uint64_t skippedCount;      // 既にそのステートだったため出さなかった遷移.
+    uint64_t elidedCount;       // 積んだ遷移同士をまとめて減った数.
+    uint64_t barrierCount;      // 実際に出したバリア (Resolve 分を含む).
+    uint64_t flushCount;        // ResourceBarrier の呼び出し回数.
+    uint64_t resolvedCount;     // 投入時に前へ置いたバリア.
+  };
+
+  explicit ResourceStateTracker(const ResourceStateTable* table = nullptr)
+    : m_table(table), m_stats()
+  {
+  }
+
+  // 記録を始める前に呼ぶ.
+  void Reset(const ResourceStateTable* table)
+  {
+    m_table = table;
+    m_resources.clear();
+    m_pending.clear();
+  }
+
+  void Transition(ResourceKey resource, uint32_t state, uint32_t subresource = AllSubresources)
+  {
+    ++m_stats.requestCount;
+    auto& entry = GetEntry(resource);
+    const auto count = uint32_t(entry.current.size());
+    if (subresource != AllSubresources)
+    {
+      assert(subresource < count);
+      TransitionSubresource(resource, entry, subresource, state);
+      return;
+    }
+    // 全サブリソースが同じ既知のステートなら1つのバリアで済ませる.
+    bool isUniform = true;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+      isUniform = isUniform && entry.current[i] == entry.current[0];
+    }
+    if (count > 1 && isUniform && entry.current[0] != UnknownState)
+    {
+      if (IsCovered(entry.current[0], state))
+      {
+        ++m_stats.skippedCount;
+        return;
+      }
+      AddPending(Barrier{ Barrier::TYPE_TRANSITION, resource, AllSubresources, entry.current[0], state, nullptr });
+      entry.current.assign(count, state);
+      entry.hasBarrier.assign(count, true);
+      return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      TransitionSubresource(resource, entry, i, state);
+    }
+  }
+
+  // 同じ UAV への書き込みの間に置く.
+  void UAVBarrier(ResourceKey resource)
+  {
+    m_pending.push_back(Barrier{ Barrier::TYPE_UAV, resource, AllSubresources, 0, 0, nullptr });
+  }
+
+  // 同じメモリを使う配置リソースの切り替え. resourceBefore が不明なら nullptr.
+  // 後に続く resource の遷移とは順序を保ち、まとめない.
+  void AliasingBarrier(ResourceKey resourceBefore, ResourceKey resource)
+  {
+    m_pending.push_back(Barrier{ Barrier::TYPE_ALIASING, resource, AllSubresources, 0, 0, resourceBefore });
+  }
+
+  bool HasPendingBarriers() const { return !m_pending.empty(); }
+  // 積んでいるバリアを out へ移す. 空でなければ1回の ResourceBarrier として記録すること.
+  void Flush(std::vector<Barrier>& out)
+  {
+    out.clear();
+    if (m_pending.empty())
+    {
+      return;
+    }
+    out.swap(m_pending);
+    m_stats.barrierCount += out.size();
+    ++m_stats.flushCount;
+  }
+
+  // 投入時に呼ぶ. このリストの前に必要なバリアを out へ返し、リスト終了時のステートを table へ反映する.
+  // 投入する順に呼ぶこと.
+  void Resolve(ResourceStateTable& table, std::vector<Barrier>& out)
+  {
+    out.clear();
+    std::lock_guard<std::mutex> lock(table.m_mutex);
+    for (auto& item : m_resources)
+    {
+      auto itr = table.m_states.find(item.first);
+      if (itr == table.m_states.end())
+      {
+        itr = table.m_states.emplace(item.first, std::vector<uint32_t>(item.second.first.size(), UnknownState)).first;
+      }
+      auto& global = itr->second;
+      const auto& entry = item.second;
+      const auto count = uint32_t(std::min(global.size(), entry.first.size()));
+      size_t begin = out.size();
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        // 管理外のリソースは最初に必要としたステートにあったものとして扱う.
+        if (entry.first[i] == UnknownState || global[i] == UnknownState)
+        {
+          continue;
+        }
+        // リスト内のバリアは最初に必要としたステートを遷移前としているため、その場合はちょうどそのステートへ移す.
+        // リスト内で遷移していなければ、読み取りステートに含まれていればよい.
+        if (entry.hasBarrier[i] ? global[i] != entry.first[i] : !IsCovered(global[i], entry.first[i]))
+        {
+          out.push_back(Barrier{ Barrier::TYPE_TRANSITION, item.first, i, global[i], entry.first[i], nullptr });
+        }
+      }
+      // 全サブリソースが同じ遷移なら1つにまとめる.
+      if (out.size() - begin == count && count > 1)
+      {
+        bool isSame = true;
+        for (size_t i = begin + 1; i < out.size(); ++i)
+        {
+          isSame = isSame && out[i].before == out[begin].before && out[i].after == out[begin].after;
+        }
+        if (isSame)
+        {
+          out.resize(begin + 1);
+          out[begin].subresource = AllSubresources;
+        }
+      }
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        // 遷移を置かずに済ませた場合は、元のステートのままになっている.
+        const bool isKept = !entry.hasBarrier[i] && global[i] != UnknownState && IsCovered(global[i], entry.first[i]);
+        if (entry.current[i] != UnknownState && !isKept)
+        {
+          global[i] = entry.current[i];
+        }
+      }
+    }
+    m_stats.resolvedCount += out.size();
+    m_stats.barrierCount += out.size();
+    m_resources.clear();
+    m_pending.clear();
+  }
+
+  // 現在のステート. このリストでまだ使っていなければ UnknownState.
+  uint32_t GetState(ResourceKey resource, uint32_t subresource = 0) const
+  {
+    auto itr = m_resources.find(resource);
+    return itr != m_resources.end() ? itr->second.current[subresource] : uint32_t(UnknownState);
+  }
+  const Stats& GetStats() const { return m_stats; }
+
+  // current が target を満たしているか. 読み取り同士は含まれていればよい.
+  static bool IsCovered(uint32_t current, uint32_t target)
+  {
+    if (current == target)
+    {
+      return true;
+    }
+    bool isRead = target != 0 && (target & ~uint32_t(ReadOnlyStates)) == 0;
+    bool isCurrentRead = current != 0 && (current & ~uint32_t(ReadOnlyStates)) == 0;
+    return isRead && isCurrentRead && (current & target) == target;
+  }
+
+private:
+  struct Entry
+  {
+    std::vector<uint32_t> first;    // このリストで最初に必要としたステート.
+    std::vector<uint32_t> current;
+    std::vector<bool> hasBarrier;   // このリスト内で遷移のバリアを積んだか.
+  };
+
+  Entry& GetEntry(ResourceKey resource)
+  {
+    auto itr = m_resources.find(resource);
+    if (itr == m_resources.end())
+    {
+      uint32_t count = m_table ? m_table->GetSubresourceCount(resource) : 1;
+      Entry entry;
+      entry.first.assign(count, UnknownState);
+      entry.current.assign(count, UnknownState);
+      entry.hasBarrier.assign(count, false);
+      itr = m_resources.emplace(resource, std::move(entry)).first;
+    }
+    return itr->second;
+  }
+
+  void TransitionSubresource(ResourceKey resource, Entry& entry, uint32_t subresource, uint32_t state)
+  {
+    auto& current = entry.current[subresource];
+    if (current == UnknownState)
+    {
+      entry.first[subresource] = state;
+      current = state;
+      return;
+    }
+    if (IsCovered(current, state))
+    {
+      ++m_stats.skippedCount;
+      return;
+    }
+    AddPending(Barrier{ Barrier::TYPE_TRANSITION, resource, subresource, current, state, nullptr });
+    current = state;
+    entry.hasBarrier[subresource] = true;
+  }
+
+  void AddPending(const Barrier& barrier)
+  {
+    // まだ出していない同じ対象への遷移があれば、その遷移先を書き換える.
+    // 間に UAV バリアがある場合は順序を保つためにまとめない.
+    for (size_t i = m_pending.size(); i-- > 0;)
+    {
+      auto& pending = m_pending[i];
+      if (pending.resource != barrier.resource)
+      {
+        continue;
+      }
+      if (pending.type != Barrier::TYPE_TRANSITION || pending.subresource != barrier.subresource)
+      {
+        break;
+      }
+      ++m_stats.elidedCount;
+      pending.after = barrier.after;
+      if (pending.before == pending.after)
+      {
+        m_pending.erase(m_pending.begin() + i);
+        ++m_stats.elidedCount;
+      }
+      return;
+    }
+    m_pending.push_back(barrier);
+  }
+
+  const ResourceStateTable* m_table;
+  std::unordered_map<ResourceKey, Entry> m_resources;
+  std::vector<Barrier> m_pending;
+  Stats m_stats;
+};
@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <deque>
+#include <cstdint>
+
+// フレーム単位で使い捨てる領域をリング状に切り出すアロケータ.
+// 確保した領域は EndFrame で渡したフェンス値に紐づけ、
+// その値が完了したことを Retire で通知されるまで再利用しない.
+// D3D12 には依存しないため、GPU を使わずに動作を確認できる.
+class RingAllocator
+{
+public:
+  enum : uint32_t { InvalidOffset = 0xFFFFFFFFu };
+
+  RingAllocator() : m_capacity(0), m_head(0), m_allocatedTotal(0), m_retiredTotal(0), m_wrapCount(0) { }
+  explicit RingAllocator(uint32_t capacity) { Reset(capacity); }
+
+  void Reset(uint32_t capacity)
+  {
+    m_capacity = capacity;
+    m_head = 0;
+    m_allocatedTotal = 0;
+    m_retiredTotal = 0;
+    m_wrapCount = 0;
+    m_frames.clear();
+  }
+
+  // 連続した count 個を確保する. 末尾に収まらない場合は残りを捨てて先頭から確保する.
+  // 空きが足りない場合は InvalidOffset.
+  uint32_t Allocate(uint32_t count)
+  {
+    if (count == 0 || count > m_capacity)
+    {
+      return InvalidOffset;
+    }
+    uint32_t waste = 0;
+    if (m_head + count > m_capacity)
+    {
+      waste = m_capacity - m_head;
+    }
+    if (GetUsed() + waste + count > m_capacity)
+    {
+      return InvalidOffset;
+    }
+    if (waste > 0)
+    {
+      m_head = 0;
+      ++m_wrapCount;
+    }
+    auto offset = m_head;
+    m_head = (m_head + count) % m_capacity;
+    m_allocatedTotal += waste + count;
+    return offset;
+  }
+
+  // ここまでに確保した領域を fenceValue のフレームに属するものとして区切る.
+  void EndFrame(uint64_t fenceValue)
+  {
+    m_frames.push_back(FrameMarker{ fenceValue, m_allocatedTotal });
+  }
+
+  // completedFenceValue までに完了したフレームの領域を回収する.
+  void Retire(uint64_t completedFenceValue)
+  {
+    while (!m_frames.empty() && m_frames.front().fenceValue <= completedFenceValue)
+    {
+      m_retiredTotal = m_frames.front().allocatedTotal;
+      m_frames.pop_front();
+    }
+  }
+
+  uint32_t GetCapacity() const { return m_capacity; }
+  uint32_t GetUsed() const { return uint32_t(m_allocatedTotal - m_retiredTotal); }
+  uint32_t GetPendingFrameCount() const { return uint32_t(m_frames.size()); }
+  uint64_t GetWrapCount() const { return m_wrapCount; }
+
+private:
+  struct FrameMarker
+  {
+    uint64_t fenceValue;
+    uint64_t allocatedTotal;  // このフレーム終了時点での累計確保数.
+  };
+
+  uint32_t m_capacity;
+  uint32_t m_head;
+  uint64_t m_allocatedTotal;  // 末尾で捨てた分も含む累計.
+  uint64_t m_retiredTotal;
+  uint64_t m_wrapCount;
+  std::deque<FrameMarker> m_frames;
+};
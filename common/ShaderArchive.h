@@ -0,0 +1,272 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ShaderCacheKey.h"
+
+// 事前にコンパイルしたシェーダー (DXIL とリフレクション) を1つにまとめたアーカイブ.
+// 実行時はソースを読まずに引けるよう、要求 (ファイル名, エントリポイント, プロファイル, 引数, マクロ定義) から求めた
+// ハッシュで並べた索引を持ち、二分探索で引く. 中身はファイルをメモリへマップしたまま参照し、コピーしない.
+//
+// 形式: Header, 索引 (Entry を requestHash の昇順), 名前と各データ (16 バイト境界).
+class ShaderArchive
+{
+public:
+  enum : uint32_t
+  {
+    FileMagic = 0x52414853,   // "SHAR"
+    FileVersion = 1,
+    DataAlignment = 16,
+  };
+
+  // Build に渡す1件分.
+  struct Source
+  {
+    ShaderCacheKey::Request request;
+    uint64_t sourceHash;              // ShaderCacheKey で求めたキー. 作成時のソースとの対応を確認するのに使う.
+    std::vector<uint8_t> dxil;
+    std::vector<uint8_t> reflection;  // 無ければ空.
+  };
+  // Find の結果. アーカイブのメモリを指す.
+  struct View
+  {
+    const uint8_t* dxil;
+    size_t dxilSize;
+    const uint8_t* reflection;
+    size_t reflectionSize;
+    uint64_t sourceHash;
+  };
+  // CheckSource の結果.
+  enum SourceState
+  {
+    SOURCE_MISSING,   // ソースが無い (.hlsl を置かずに配布した場合). アーカイブの結果をそのまま使う.
+    SOURCE_MATCHED,   // 作成時と同じソースとインクルード.
+    SOURCE_CHANGED,   // 作成後に編集された. アーカイブの結果は使えない.
+  };
+
+  ShaderArchive() : m_data(nullptr), m_size(0), m_entries(nullptr), m_entryCount(0) { }
+
+  // 要求を一意に表す文字列. 同じハッシュの別の要求と取り違えないよう、索引からはこれも比べる.
+  static std::wstring MakeRequestName(const ShaderCacheKey::Request& request)
+  {
+    std::wstring name = request.fileName + L"|" + request.entryPoint + L"|" + request.profile;
+    for (const auto& argument : request.arguments)
+    {
+      name += L"|" + argument;
+    }
+    for (const auto& define : request.defines)
+    {
+      name += L"|" + define.first + L"=" + define.second;
+    }
+    return name;
+  }
+  static uint64_t MakeRequestHash(const std::wstring& requestName)
+  {
+    return ShaderCacheKey::Hash(requestName.data(), requestName.size() * sizeof(wchar_t));
+  }
+  // fileName の機能キーの宣言 ("// @feature NAME" の行) を入れておく要求. dxil の代わりに宣言の行を持つ.
+  static ShaderCacheKey::Request MakeFeatureRequest(const std::wstring& fileName)
+  {
+    return ShaderCacheKey::Request{ fileName, L"", L"@feature", {}, {} };
+  }
+
+  // sources をアーカイブの内容にする. 同じ要求が複数あれば後のものを使う.
+  static std::vector<uint8_t> Build(const std::vector<Source>& sources)
+  {
+    struct Item
+    {
+      uint64_t requestHash;
+      std::wstring name;
+      const Source* source;
+    };
+    std::vector<Item> items;
+    for (const auto& source : sources)
+    {
+      auto name = MakeRequestName(source.request);
+      auto hash = MakeRequestHash(name);
+      auto itr = std::find_if(items.begin(), items.end(), [&](const Item& item) { return item.name == name; });
+      if (itr != items.end())
+      {
+        itr->source = &source;
+        continue;
+      }
+      items.push_back(Item{ hash, name, &source });
+    }
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+      return a.requestHash != b.requestHash ? a.requestHash < b.requestHash : a.name < b.name;
+    });
+
+    Header header{};
+    header.magic = FileMagic;
+    header.version = FileVersion;
+    header.entryCount = uint32_t(items.size());
+    std::vector<uint8_t> data(sizeof(Header) + sizeof(Entry) * items.size());
+    std::vector<Entry> entries(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+      const auto& item = items[i];
+      auto& entry = entries[i];
+      entry.requestHash = item.requestHash;
+      entry.sourceHash = item.source->sourceHash;
+      entry.nameOffset = Append(data, item.name.data(), item.name.size() * sizeof(wchar_t));
+      entry.nameSize = uint32_t(item.name.size());
+      entry.dxilOffset = Append(data, item.source->dxil.data(), item.source->dxil.size());
+      entry.dxilSize = item.source->dxil.size();
+      entry.reflectionOffset = Append(data, item.source->reflection.data(), item.source->reflection.size());
+      entry.reflectionSize = item.source->reflection.size();
+      entry.checksum = ChecksumOf(data.data(), entry);
+    }
+    if (!entries.empty())
+    {
+      memcpy(data.data() + sizeof(Header), entries.data(), sizeof(Entry) * entries.size());
+    }
+    header.fileSize = data.size();
+    header.indexChecksum = ShaderCacheKey::Hash(data.data() + sizeof(Header), sizeof(Entry) * entries.size());
+    memcpy(data.data(), &header, sizeof(Header));
+    return data;
+  }
+
+  // data は Close するか破棄するまで有効であること. 形式が正しくなければ false.
+  bool Open(const void* data, size_t size)
+  {
+    Close();
+    Header header;
+    if (data == nullptr || size < sizeof(Header))
+    {
+      return false;
+    }
+    memcpy(&header, data, sizeof(Header));
+    auto bytes = static_cast<const uint8_t*>(data);
+    if (header.magic != FileMagic || header.version != FileVersion || header.fileSize != size ||
+      header.entryCount > (size - sizeof(Header)) / sizeof(Entry))
+    {
+      return false;
+    }
+    auto entries = reinterpret_cast<const Entry*>(bytes + sizeof(Header));
+    if (ShaderCacheKey::Hash(entries, sizeof(Entry) * header.entryCount) != header.indexChecksum)
+    {
+      return false;
+    }
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+      const auto& entry = entries[i];
+      if (!IsInside(entry.nameOffset, uint64_t(entry.nameSize) * sizeof(wchar_t), size) ||
+        !IsInside(entry.dxilOffset, entry.dxilSize, size) ||
+        !IsInside(entry.reflectionOffset, entry.reflectionSize, size))
+      {
+        return false;
+      }
+    }
+    m_data = bytes;
+    m_size = size;
+    m_entries = entries;
+    m_entryCount = header.entryCount;
+    return true;
+  }
+  void Close()
+  {
+    m_data = nullptr;
+    m_size = 0;
+    m_entries = nullptr;
+    m_entryCount = 0;
+  }
+  bool IsOpen() const { return m_data != nullptr; }
+  uint32_t GetEntryCount() const { return m_entryCount; }
+  size_t GetSize() const { return m_size; }
+
+  // 要求に一致するものを探す. 見つかったものは中身のチェックサムを確かめてから返す.
+  bool Find(const ShaderCacheKey::Request& request, View& view) const
+  {
+    if (!IsOpen())
+    {
+      return false;
+    }
+    auto name = MakeRequestName(request);
+    auto hash = MakeRequestHash(name);
+    auto end = m_entries + m_entryCount;
+    auto itr = std::lower_bound(m_entries, end, hash, [](const Entry& entry, uint64_t value) { return entry.requestHash < value; });
+    for (; itr != end && itr->requestHash == hash; ++itr)
+    {
+      if (itr->nameSize != name.size() ||
+        memcmp(m_data + itr->nameOffset, name.data(), name.size() * sizeof(wchar_t)) != 0)
+      {
+        continue;
+      }
+      if (ChecksumOf(m_data, *itr) != itr->checksum)
+      {
+        return false;
+      }
+      view.dxil = m_data + itr->dxilOffset;
+      view.dxilSize = size_t(itr->dxilSize);
+      view.reflection = itr->reflectionSize > 0 ? m_data + itr->reflectionOffset : nullptr;
+      view.reflectionSize = size_t(itr->reflectionSize);
+      view.sourceHash = itr->sourceHash;
+      return true;
+    }
+    return false;
+  }
+
+  // view を作成した時のキーと、今のソースとインクルードから求めたキーを比べる.
+  // key には求めたキーとファイルを返す. ソースが無ければ key.files は空.
+  static SourceState CheckSource(const View& view, const ShaderCacheKey::Request& request,
+    const std::string& compilerVersion, const ShaderCacheKey::ReadFileFunc& readFile, ShaderCacheKey::Result& key)
+  {
+    if (!ShaderCacheKey::Compute(request, compilerVersion, readFile, key))
+    {
+      return SOURCE_MISSING;
+    }
+    return key.hash == view.sourceHash ? SOURCE_MATCHED : SOURCE_CHANGED;
+  }
+private:
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+    uint64_t indexChecksum;
+  };
+  struct Entry
+  {
+    uint64_t requestHash;
+    uint64_t sourceHash;
+    uint64_t nameOffset;
+    uint64_t dxilOffset;
+    uint64_t dxilSize;
+    uint64_t reflectionOffset;
+    uint64_t reflectionSize;
+    uint64_t checksum;      // DXIL とリフレクション.
+    uint32_t nameSize;      // 文字数.
+    uint32_t reserved;
+  };
+
+  static uint64_t Append(std::vector<uint8_t>& data, const void* bytes, size_t size)
+  {
+    data.resize((data.size() + DataAlignment - 1) / DataAlignment * DataAlignment);
+    auto offset = uint64_t(data.size());
+    if (size > 0)
+    {
+      auto p = static_cast<const uint8_t*>(bytes);
+      data.insert(data.end(), p, p + size);
+    }
+    return offset;
+  }
+  static uint64_t ChecksumOf(const uint8_t* data, const Entry& entry)
+  {
+    auto hash = ShaderCacheKey::Hash(data + entry.dxilOffset, size_t(entry.dxilSize));
+    return ShaderCacheKey::Hash(data + entry.reflectionOffset, size_t(entry.reflectionSize), hash);
+  }
+  static bool IsInside(uint64_t offset, uint64_t size, size_t fileSize)
+  {
+    return offset <= fileSize && size <= fileSize - offset;
+  }
+
+  const uint8_t* m_data;
+  size_t m_size;
+  const Entry* m_entries;
+  uint32_t m_entryCount;
+};
@@ -0,0 +1,500 @@
+﻿#include "ShaderCache.h"
+#include "D3D12BookUtil.h"
+#include "ParallelFor.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#if _MSC_VER > 1922 && !defined(_SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING)
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#endif
+#include <experimental/filesystem>
+
+#include <d3d12shader.h>
+#include <dxcapi.h>
+#include <wrl/implements.h>
+
+using namespace Microsoft::WRL;
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+  using clock = std::chrono::high_resolution_clock;
+  double ElapsedMs(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+
+  struct DxcContext
+  {
+    ComPtr<IDxcLibrary> library;
+    ComPtr<IDxcCompiler> compiler;
+    ComPtr<IDxcIncludeHandler> includeHandler;
+  };
+  // DXC のインスタンスは複数のスレッドから同時に使えないため、スレッド毎に1つ持つ.
+  DxcContext& GetThreadContext()
+  {
+    thread_local DxcContext context;
+    if (!context.compiler)
+    {
+      HRESULT hr = DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&context.library));
+      ThrowIfFailed(hr, "DxcCreateInstance(DxcLibrary) failed.");
+      hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&context.compiler));
+      ThrowIfFailed(hr, "DxcCreateInstance(DxcCompiler) failed.");
+      hr = context.library->CreateIncludeHandler(&context.includeHandler);
+      ThrowIfFailed(hr, "CreateIncludeHandler failed.");
+    }
+    return context;
+  }
+
+  // DXIL コンテナのパートの種類.
+  const UINT32 ReflectionPartKind = UINT32('S') | (UINT32('T') << 8) | (UINT32('A') << 16) | (UINT32('T') << 24);
+  const UINT32 DxilPartKind = UINT32('D') | (UINT32('X') << 8) | (UINT32('I') << 16) | (UINT32('L') << 24);
+
+  bool ReadBinaryFile(const fs::path& path, std::vector<char>& data)
+  {
+    std::ifstream infile(path, std::ifstream::binary);
+    if (!infile)
+    {
+      return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  // アーカイブ内の DXIL をコピーせずに指す ID3DBlob. マップしたアーカイブへの参照を持つ.
+  class ArchiveBlob : public RuntimeClass<RuntimeClassFlags<ClassicCom>, ID3DBlob>
+  {
+  public:
+    ArchiveBlob(std::shared_ptr<const void> archive, const void* data, size_t size)
+      : m_archive(archive), m_data(data), m_size(size)
+    {
+    }
+    LPVOID STDMETHODCALLTYPE GetBufferPointer() override { return const_cast<void*>(m_data); }
+    SIZE_T STDMETHODCALLTYPE GetBufferSize() override { return m_size; }
+  private:
+    std::shared_ptr<const void> m_archive;
+    const void* m_data;
+    size_t m_size;
+  };
+}
+
+ShaderCache::ShaderCache()
+  : m_stats()
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+  m_archive.Close();
+  m_archiveView.reset();
+}
+
+void ShaderCache::SetDirectory(const std::wstring& directory)
+{
+  m_directory = directory;
+}
+
+bool ShaderCache::OpenArchive(const std::wstring& path)
+{
+  m_archive.Close();
+  m_archiveView.reset();
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size{};
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+  {
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  CloseHandle(file);
+  if (mapping == nullptr)
+  {
+    return false;
+  }
+  // ビューはマッピングのハンドルを閉じても残る.
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr)
+  {
+    return false;
+  }
+  m_archiveView = std::shared_ptr<const void>(view, [](const void* p) { UnmapViewOfFile(p); });
+  if (!m_archive.Open(view, size_t(size.QuadPart)))
+  {
+    m_archiveView.reset();
+    return false;
+  }
+  return true;
+}
+
+bool ShaderCache::FindFeatureDeclarations(const std::wstring& fileName, std::string& declarations) const
+{
+  ShaderArchive::View view;
+  if (!m_archive.Find(ShaderArchive::MakeFeatureRequest(fs::path(fileName).wstring()), view))
+  {
+    return false;
+  }
+  declarations.assign(reinterpret_cast<const char*>(view.dxil), view.dxilSize);
+  return true;
+}
+
+ShaderCacheKey::Request ShaderCache::MakeRequest(
+  const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines)
+{
+  LPCWSTR compilerFlags[] = {
+#if _DEBUG
+    L"/Zi", L"/O0",
+#else
+    L"/O2" // リリースビルドでは最適化
+#endif
+  };
+  return ShaderCacheKey::Request{
+    fs::path(fileName).wstring(), L"main", profile,
+    std::vector<std::wstring>(std::begin(compilerFlags), std::end(compilerFlags)),
+    defines
+  };
+}
+
+HRESULT ShaderCache::Compile(
+  const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines,
+  ComPtr<ID3DBlob>& shaderBlob, ComPtr<ID3DBlob>& errorBlob, std::vector<std::wstring>* files, uint64_t* keyHash)
+{
+  auto start = clock::now();
+  auto request = MakeRequest(fileName, profile, defines);
+
+  // キーを求める際に読んだソースをそのままコンパイルに使い、途中でファイルが変わってもキーと内容がずれないようにする.
+  std::string source;
+  bool isSource = true;
+  auto readFile = [&](const std::wstring& path, std::string& data)
+  {
+    std::vector<char> bytes;
+    if (!ReadBinaryFile(path, bytes))
+    {
+      return false;
+    }
+    data.assign(bytes.begin(), bytes.end());
+    if (isSource)
+    {
+      source = data;
+      isSource = false;
+    }
+    return true;
+  };
+  ShaderCacheKey::Result key;
+  auto sourceState = ShaderArchive::SOURCE_MISSING;
+
+  // アーカイブにあり、作成時からソースとインクルードが変わっていなければコンパイルせずに返す.
+  // ソースがあればファイルも返し、アーカイブから読んだものもホットリロードの対象にする.
+  ShaderArchive::View view;
+  if (m_archive.Find(request, view))
+  {
+    sourceState = ShaderArchive::CheckSource(view, request, GetCompilerVersion(), readFile, key);
+    if (sourceState != ShaderArchive::SOURCE_CHANGED)
+    {
+      shaderBlob = Make<ArchiveBlob>(m_archiveView, view.dxil, view.dxilSize);
+      if (files)
+      {
+        *files = key.files;
+      }
+      if (keyHash)
+      {
+        *keyHash = view.sourceHash;
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_stats.requestCount;
+      ++m_stats.archiveHitCount;
+      m_variants[std::make_pair(request.fileName, profile)].keys.insert(view.sourceHash);
+      m_stats.loadMs += ElapsedMs(start);
+      return S_OK;
+    }
+  }
+  else if (ShaderCacheKey::Compute(request, GetCompilerVersion(), readFile, key))
+  {
+    sourceState = ShaderArchive::SOURCE_MATCHED;
+  }
+  if (sourceState == ShaderArchive::SOURCE_MISSING)
+  {
+    throw std::runtime_error("shader not found");
+  }
+  if (files)
+  {
+    *files = key.files;
+  }
+  if (keyHash)
+  {
+    *keyHash = key.hash;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.requestCount;
+    if (sourceState == ShaderArchive::SOURCE_CHANGED)
+    {
+      ++m_stats.archiveStaleCount;
+    }
+    m_variants[std::make_pair(request.fileName, profile)].keys.insert(key.hash);
+    auto itr = m_blobs.find(key.hash);
+    if (itr != m_blobs.end())
+    {
+      shaderBlob = itr->second;
+      ++m_stats.memoryHitCount;
+      m_stats.loadMs += ElapsedMs(start);
+      return S_OK;
+    }
+  }
+
+  auto& context = GetThreadContext();
+  std::vector<uint8_t> dxil;
+  if (LoadFromDisk(key.hash, dxil))
+  {
+    ComPtr<IDxcBlobEncoding> blob;
+    HRESULT hr = context.library->CreateBlobWithEncodingOnHeapCopy(dxil.data(), UINT32(dxil.size()), CP_ACP, &blob);
+    if (SUCCEEDED(hr))
+    {
+      shaderBlob.Attach(reinterpret_cast<ID3DBlob*>(blob.Detach()));
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_blobs.emplace(key.hash, shaderBlob);
+      ++m_stats.diskHitCount;
+      m_stats.loadMs += ElapsedMs(start);
+      return S_OK;
+    }
+  }
+  double keyMs = ElapsedMs(start);
+
+  // DXC によるコンパイル処理
+  auto compileStart = clock::now();
+  ComPtr<IDxcBlobEncoding> sourceBlob;
+  ComPtr<IDxcOperationResult> dxcResult;
+  context.library->CreateBlobWithEncodingFromPinned(source.data(), UINT32(source.size()), CP_ACP, &sourceBlob);
+
+  std::vector<DxcDefine> dxcDefines;
+  for (const auto& define : defines)
+  {
+    dxcDefines.push_back(DxcDefine{ define.first.c_str(), define.second.empty() ? nullptr : define.second.c_str() });
+  }
+  std::vector<LPCWSTR> arguments;
+  for (const auto& argument : request.arguments)
+  {
+    arguments.push_back(argument.c_str());
+  }
+  HRESULT hr = context.compiler->Compile(sourceBlob.Get(), request.fileName.c_str(),
+    request.entryPoint.c_str(), profile.c_str(),
+    arguments.data(), UINT32(arguments.size()),
+    dxcDefines.data(), UINT32(dxcDefines.size()),
+    context.includeHandler.Get(),
+    &dxcResult);
+  if (SUCCEEDED(hr))
+  {
+    dxcResult->GetStatus(&hr);
+  }
+  if (SUCCEEDED(hr))
+  {
+    dxcResult->GetResult(
+      reinterpret_cast<IDxcBlob**>(shaderBlob.GetAddressOf())
+    );
+    StoreToDisk(key.hash, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+  }
+  else if (dxcResult)
+  {
+    dxcResult->GetErrorBuffer(
+      reinterpret_cast<IDxcBlobEncoding**>(errorBlob.GetAddressOf())
+    );
+  }
+
+  double compileMs = ElapsedMs(compileStart);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (SUCCEEDED(hr))
+  {
+    m_blobs.emplace(key.hash, shaderBlob);
+    ++m_stats.compiledCount;
+  }
+  else
+  {
+    ++m_stats.failedCount;
+  }
+  auto& variant = m_variants[std::make_pair(request.fileName, profile)];
+  ++variant.compiledCount;
+  variant.compileMs += compileMs;
+  m_stats.loadMs += keyMs;
+  m_stats.compileMs += compileMs;
+  return hr;
+}
+
+HRESULT ShaderCache::CompileBatch(std::vector<ShaderCompileJob>& jobs, UINT threadCount)
+{
+  // DXC のインスタンスは各ワーカースレッドで GetThreadContext により生成される.
+  auto start = clock::now();
+  ParallelFor(jobs.size(), threadCount, [&](size_t i) {
+    auto& job = jobs[i];
+    job.hr = Compile(job.fileName, job.profile, job.defines, job.shaderBlob, job.errorBlob, &job.files, &job.keyHash);
+  });
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.batchMs += ElapsedMs(start);
+  }
+  for (const auto& job : jobs)
+  {
+    if (FAILED(job.hr))
+    {
+      return job.hr;
+    }
+  }
+  return S_OK;
+}
+
+bool ShaderCache::ReflectConstantBuffers(ID3DBlob* shader, ConstantBufferLayouts& layouts)
+{
+  layouts.clear();
+  if (shader == nullptr)
+  {
+    return false;
+  }
+  auto& context = GetThreadContext();
+  ComPtr<IDxcBlobEncoding> container;
+  ComPtr<IDxcContainerReflection> containerReflection;
+  ComPtr<ID3D12ShaderReflection> reflection;
+  UINT32 index = 0;
+  if (FAILED(context.library->CreateBlobWithEncodingFromPinned(
+      shader->GetBufferPointer(), UINT32(shader->GetBufferSize()), 0, &container)) ||
+    FAILED(DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&containerReflection))) ||
+    FAILED(containerReflection->Load(container.Get())))
+  {
+    return false;
+  }
+  // リフレクションは STAT パートにあり、古いコンパイラでは DXIL パートに含まれる.
+  if (FAILED(containerReflection->FindFirstPartKind(ReflectionPartKind, &index)) &&
+    FAILED(containerReflection->FindFirstPartKind(DxilPartKind, &index)))
+  {
+    return false;
+  }
+  if (FAILED(containerReflection->GetPartReflection(index, IID_PPV_ARGS(&reflection))))
+  {
+    return false;
+  }
+
+  D3D12_SHADER_DESC shaderDesc{};
+  if (FAILED(reflection->GetDesc(&shaderDesc)))
+  {
+    return false;
+  }
+  // 束縛されるもの (参照のある cbuffer) だけを集める.
+  for (UINT i = 0; i < shaderDesc.BoundResources; ++i)
+  {
+    D3D12_SHADER_INPUT_BIND_DESC bindDesc{};
+    if (FAILED(reflection->GetResourceBindingDesc(i, &bindDesc)) || bindDesc.Type != D3D_SIT_CBUFFER)
+    {
+      continue;
+    }
+    auto constantBuffer = reflection->GetConstantBufferByName(bindDesc.Name);
+    D3D12_SHADER_BUFFER_DESC bufferDesc{};
+    if (FAILED(constantBuffer->GetDesc(&bufferDesc)))
+    {
+      return false;
+    }
+    ConstantBufferLayout layout{ bufferDesc.Name, bindDesc.BindPoint, bindDesc.Space, bufferDesc.Size, {} };
+    for (UINT v = 0; v < bufferDesc.Variables; ++v)
+    {
+      D3D12_SHADER_VARIABLE_DESC variableDesc{};
+      if (FAILED(constantBuffer->GetVariableByIndex(v)->GetDesc(&variableDesc)))
+      {
+        return false;
+      }
+      layout.variables.push_back(ConstantBufferVariable{
+        variableDesc.Name, variableDesc.StartOffset, variableDesc.Size, (variableDesc.uFlags & D3D_SVF_USED) != 0 });
+    }
+    layouts.push_back(std::move(layout));
+  }
+  return true;
+}
+
+ShaderCache::Stats ShaderCache::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+std::vector<ShaderCache::VariantReport> ShaderCache::GetVariantReport() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<VariantReport> report;
+  for (const auto& item : m_variants)
+  {
+    const auto& entry = item.second;
+    report.push_back(VariantReport{
+      item.first.first, item.first.second, UINT(entry.keys.size()), entry.compiledCount, entry.compileMs
+    });
+  }
+  return report;
+}
+
+const std::string& ShaderCache::GetCompilerVersion()
+{
+  // DXC のバージョンと dxcompiler.dll の更新日時とサイズ. DLL を差し替えた場合も別のキーになる.
+  std::call_once(m_versionFlag, [this]()
+  {
+    std::string version = "dxc";
+    ComPtr<IDxcVersionInfo> info;
+    if (SUCCEEDED(GetThreadContext().compiler.As(&info)))
+    {
+      UINT32 major = 0, minor = 0, flags = 0;
+      info->GetVersion(&major, &minor);
+      info->GetFlags(&flags);
+      version += " " + std::to_string(major) + "." + std::to_string(minor) + " flags " + std::to_string(flags);
+    }
+    wchar_t modulePath[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    HMODULE module = GetModuleHandleW(L"dxcompiler.dll");
+    if (module && GetModuleFileNameW(module, modulePath, MAX_PATH) > 0 &&
+      GetFileAttributesExW(modulePath, GetFileExInfoStandard, &attributes))
+    {
+      uint64_t writeTime = (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+      version += " " + std::to_string(writeTime) + " " + std::to_string(attributes.nFileSizeLow);
+    }
+    m_compilerVersion = version;
+  });
+  return m_compilerVersion;
+}
+
+bool ShaderCache::LoadFromDisk(uint64_t hash, std::vector<uint8_t>& dxil) const
+{
+  if (m_directory.empty())
+  {
+    return false;
+  }
+  std::vector<char> bytes;
+  if (!ReadBinaryFile(fs::path(m_directory) / ShaderCacheKey::MakeFileName(hash), bytes))
+  {
+    return false;
+  }
+  return ShaderCacheKey::DecodeFile(std::vector<uint8_t>(bytes.begin(), bytes.end()), hash, dxil);
+}
+
+void ShaderCache::StoreToDisk(uint64_t hash, const void* dxil, size_t size) const
+{
+  if (m_directory.empty())
+  {
+    return;
+  }
+  // 他のスレッドやプロセスが途中まで書いたファイルを読まないよう、一時ファイルに書いてから置き換える.
+  std::error_code ec;
+  fs::create_directories(m_directory, ec);
+  auto path = fs::path(m_directory) / ShaderCacheKey::MakeFileName(hash);
+  auto tempPath = path.wstring() + L"." + std::to_wstring(GetCurrentThreadId()) + L".tmp";
+  auto data = ShaderCacheKey::EncodeFile(hash, dxil, size);
+  {
+    std::ofstream outfile(tempPath, std::ofstream::binary | std::ofstream::trunc);
+    if (!outfile.write(reinterpret_cast<const char*>(data.data()), data.size()))
+    {
+      return;
+    }
+  }
+  if (!MoveFileExW(tempPath.c_str(), path.wstring().c_str(), MOVEFILE_REPLACE_EXISTING))
+  {
+    DeleteFileW(tempPath.c_str());
+  }
+}
@@ -0,0 +1,124 @@
+﻿#pragma once
+#include <d3dcommon.h>
+#include <wrl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ConstantBufferLayout.h"
+#include "ShaderArchive.h"
+#include "ShaderCacheKey.h"
+
+// まとめてコンパイルする際の1件分. 結果は shaderBlob, errorBlob, hr に入る.
+struct ShaderCompileJob
+{
+  ShaderCompileJob(const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines = ShaderDefines())
+    : fileName(fileName), profile(profile), defines(defines), hr(E_PENDING), keyHash(0)
+  {
+  }
+  std::wstring fileName;
+  std::wstring profile;
+  ShaderDefines defines;
+  Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+  Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+  HRESULT hr;
+  std::vector<std::wstring> files;  // ソースと、そこから辿ったインクルード. ソースが無くアーカイブから読んだ場合は空.
+  uint64_t keyHash;                  // ソースとインクルードの内容から求めたキー.
+};
+
+// DXC でのコンパイル結果 (DXIL) のキャッシュ.
+// ShaderCacheKey で求めたキーをファイル名にしてディレクトリへ保存し、次回以降はコンパイルせずに読み込む.
+// 同じプロセス内で同じキーを要求された場合はメモリ上の結果を返す.
+// DXC のコンパイラはスレッド毎に1つ生成して使い回す.
+// アーカイブ (ShaderArchiver で作成) を開いている場合はそこから引き、作成時とソースが同じか、ソースが無ければコンパイルしない.
+// ソースやインクルードが作成後に編集されていれば、アーカイブの結果は使わずにコンパイルする.
+class ShaderCache
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  struct Stats
+  {
+    UINT requestCount;
+    UINT memoryHitCount;  // このプロセスで既に求めた結果を返した数.
+    UINT diskHitCount;    // ファイルから読み込んだ数.
+    UINT archiveHitCount; // アーカイブから読み込んだ数.
+    UINT archiveStaleCount; // アーカイブにあったが、ソースが変わっていたため使わなかった数.
+    UINT compiledCount;   // DXC でコンパイルした数.
+    UINT failedCount;     // コンパイルエラーの数.
+    double compileMs;     // コンパイルにかかった時間の累計.
+    double loadMs;        // キーの計算とファイルからの読み込みにかかった時間の累計.
+    double batchMs;       // CompileBatch の経過時間の累計. compileMs と比べると並列化の効果が分かる.
+  };
+
+  // ファイルとプロファイル毎の変種の数とコンパイルのコスト.
+  struct VariantReport
+  {
+    std::wstring fileName;
+    std::wstring profile;
+    UINT variantCount;    // 要求された異なるキー (マクロ定義の組み合わせ) の数.
+    UINT compiledCount;   // そのうち DXC でコンパイルした数.
+    double compileMs;
+  };
+
+  ShaderCache();
+  ~ShaderCache();
+
+  // 保存先. 空ならファイルには保存しない.
+  void SetDirectory(const std::wstring& directory);
+
+  // アーカイブをメモリへマップして開く. 無いか形式が正しくなければ false. コンパイルを始める前に呼ぶこと.
+  // ソースがあれば、アーカイブから返したシェーダーもホットリロードの対象になる.
+  bool OpenArchive(const std::wstring& path);
+  bool IsArchiveOpen() const { return m_archive.IsOpen(); }
+  size_t GetArchiveSize() const { return m_archive.GetSize(); }
+  // アーカイブに fileName の機能キーの宣言があれば返す. ソースが無くても変種を選べるようにする.
+  bool FindFeatureDeclarations(const std::wstring& fileName, std::string& declarations) const;
+
+  // Compile がキーの計算とアーカイブの索引に使う要求. エントリポイントは main, 引数はビルド構成の最適化フラグ.
+  static ShaderCacheKey::Request MakeRequest(
+    const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines);
+
+  // files を渡すと、キーに含めたファイル (ソースとインクルード) を返す. keyHash を渡すとキーを返す.
+  HRESULT Compile(
+    const std::wstring& fileName, const std::wstring& profile, const ShaderDefines& defines,
+    ComPtr<ID3DBlob>& shaderBlob, ComPtr<ID3DBlob>& errorBlob,
+    std::vector<std::wstring>* files = nullptr, uint64_t* keyHash = nullptr);
+  // jobs を並列にコンパイルする. threadCount が 0 なら論理コア数のスレッドを使う.
+  // 戻り値は最初に失敗したものの HRESULT. 全て成功すれば S_OK.
+  HRESULT CompileBatch(std::vector<ShaderCompileJob>& jobs, UINT threadCount = 0);
+
+  // コンパイル結果 (DXIL コンテナ) のリフレクションから定数バッファのレイアウトと変数の参照の有無を読む.
+  // リフレクションが取り除かれているなどで読めなければ false.
+  static bool ReflectConstantBuffers(ID3DBlob* shader, ConstantBufferLayouts& layouts);
+
+  Stats GetStats() const;
+  std::vector<VariantReport> GetVariantReport() const;
+private:
+  struct VariantEntry
+  {
+    std::unordered_set<uint64_t> keys;
+    UINT compiledCount = 0;
+    double compileMs = 0.0;
+  };
+  const std::string& GetCompilerVersion();
+  bool LoadFromDisk(uint64_t hash, std::vector<uint8_t>& dxil) const;
+  void StoreToDisk(uint64_t hash, const void* dxil, size_t size) const;
+
+  std::wstring m_directory;
+  // マップしたアーカイブ. 返したシェーダーも参照するため、閉じた後も参照が無くなるまで残る.
+  std::shared_ptr<const void> m_archiveView;
+  ShaderArchive m_archive;
+  std::string m_compilerVersion;
+  std::once_flag m_versionFlag;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<uint64_t, ComPtr<ID3DBlob>> m_blobs;
+  std::map<std::pair<std::wstring, std::wstring>, VariantEntry> m_variants;
+  Stats m_stats;
+};
@@ -0,0 +1,278 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using ShaderDefines = std::vector<std::pair<std::wstring, std::wstring>>;
+
+// シェーダーのコンパイル結果を引くためのキー.
+// ソースと、そこから辿れる #include の全ファイルの内容、エントリポイント、プロファイル、引数、マクロ定義、コンパイラのバージョンから求める.
+// #if の中のインクルードも辿るため、実際には使わないファイルを含むことがあるが、結果が変わる変更を見落とすことはない.
+// ファイルの読み込みは呼び出し側が渡すため、DXC やファイルシステムを使わずに動作を確認できる.
+class ShaderCacheKey
+{
+public:
+  // path のファイルを data へ読む. 無ければ false.
+  using ReadFileFunc = std::function<bool(const std::wstring& path, std::string& data)>;
+
+  struct Request
+  {
+    std::wstring fileName;
+    std::wstring entryPoint;
+    std::wstring profile;
+    std::vector<std::wstring> arguments;
+    ShaderDefines defines;
+  };
+  struct Result
+  {
+    uint64_t hash;
+    std::vector<std::wstring> files;  // キーに含めたファイル. 先頭がソース.
+  };
+
+  // FNV-1a (64bit).
+  static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+  {
+    auto p = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= p[i];
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  // ソースが読めなければ false.
+  static bool Compute(const Request& request, const std::string& compilerVersion, const ReadFileFunc& readFile, Result& out)
+  {
+    out.hash = 0;
+    out.files.clear();
+    std::string source;
+    if (!readFile(request.fileName, source))
+    {
+      return false;
+    }
+
+    // 文字列は長さを前に置き、区切りが曖昧にならないようにする.
+    std::vector<uint8_t> bytes;
+    WriteString(bytes, compilerVersion);
+    WriteString(bytes, request.entryPoint);
+    WriteString(bytes, request.profile);
+    WriteValue(bytes, uint32_t(request.arguments.size()));
+    for (const auto& argument : request.arguments)
+    {
+      WriteString(bytes, argument);
+    }
+    WriteValue(bytes, uint32_t(request.defines.size()));
+    for (const auto& define : request.defines)
+    {
+      WriteString(bytes, define.first);
+      WriteString(bytes, define.second);
+    }
+
+    std::unordered_set<std::wstring> visited;
+    std::vector<std::pair<std::wstring, std::string>> pending;
+    pending.emplace_back(request.fileName, std::move(source));
+    visited.insert(request.fileName);
+    while (!pending.empty())
+    {
+      auto file = std::move(pending.back());
+      pending.pop_back();
+      out.files.push_back(file.first);
+      WriteString(bytes, file.first);
+      WriteValue(bytes, Hash(file.second.data(), file.second.size()));
+
+      for (const auto& name : FindIncludes(file.second))
+      {
+        // インクルードしたファイルのディレクトリから探し、無ければ作業ディレクトリから探す.
+        std::wstring candidates[] = { ResolveInclude(file.first, name), Widen(name) };
+        bool isFound = false;
+        for (const auto& path : candidates)
+        {
+          if (visited.count(path))
+          {
+            isFound = true;
+            break;
+          }
+          std::string data;
+          if (readFile(path, data))
+          {
+            visited.insert(path);
+            pending.emplace_back(path, std::move(data));
+            isFound = true;
+            break;
+          }
+        }
+        if (!isFound)
+        {
+          // 見つからないインクルードはコンパイルエラーになるが、名前だけは含めておく.
+          WriteString(bytes, Widen(name));
+        }
+      }
+    }
+    out.hash = Hash(bytes.data(), bytes.size());
+    return true;
+  }
+
+  // #include "name" と #include <name> の name を返す. コメントの中は無視する.
+  static std::vector<std::string> FindIncludes(const std::string& source)
+  {
+    std::vector<std::string> names;
+    size_t i = 0;
+    const size_t length = source.size();
+    bool isLineStart = true;
+    while (i < length)
+    {
+      char c = source[i];
+      if (c == '/' && i + 1 < length && source[i + 1] == '/')
+      {
+        while (i < length && source[i] != '\n')
+        {
+          ++i;
+        }
+        continue;
+      }
+      if (c == '/' && i + 1 < length && source[i + 1] == '*')
+      {
+        auto end = source.find("*/", i + 2);
+        i = end == std::string::npos ? length : end + 2;
+        continue;
+      }
+      if (c == '\n')
+      {
+        isLineStart = true;
+        ++i;
+        continue;
+      }
+      if (c == ' ' || c == '\t' || c == '\r')
+      {
+        ++i;
+        continue;
+      }
+      if (c == '#' && isLineStart)
+      {
+        size_t p = i + 1;
+        while (p < length && (source[p] == ' ' || source[p] == '\t'))
+        {
+          ++p;
+        }
+        if (source.compare(p, 7, "include") == 0)
+        {
+          p += 7;
+          while (p < length && (source[p] == ' ' || source[p] == '\t'))
+          {
+            ++p;
+          }
+          if (p < length && (source[p] == '"' || source[p] == '<'))
+          {
+            char close = source[p] == '"' ? '"' : '>';
+            auto end = source.find_first_of(std::string(1, close) + "\n", p + 1);
+            if (end != std::string::npos && source[end] == close)
+            {
+              names.push_back(source.substr(p + 1, end - p - 1));
+            }
+          }
+        }
+      }
+      isLineStart = false;
+      ++i;
+    }
+    return names;
+  }
+
+  // includer と同じディレクトリにある name のパス.
+  static std::wstring ResolveInclude(const std::wstring& includer, const std::string& name)
+  {
+    auto separator = includer.find_last_of(L"/\\");
+    auto directory = separator == std::wstring::npos ? std::wstring() : includer.substr(0, separator + 1);
+    return directory + Widen(name);
+  }
+
+  static std::wstring MakeFileName(uint64_t hash)
+  {
+    const wchar_t digits[] = L"0123456789abcdef";
+    std::wstring name;
+    for (int shift = 60; shift >= 0; shift -= 4)
+    {
+      name += digits[(hash >> shift) & 0xF];
+    }
+    return name + L".dxil";
+  }
+
+  // キャッシュファイルの形式. 書き込み途中で止まったものや別のキーのものは読み込まない.
+  enum : uint32_t
+  {
+    FileMagic = 0x43485344,   // "DSHC"
+    FileVersion = 1,
+  };
+  static std::vector<uint8_t> EncodeFile(uint64_t hash, const void* dxil, size_t size)
+  {
+    FileHeader header{ FileMagic, FileVersion, hash, uint64_t(size), Hash(dxil, size) };
+    std::vector<uint8_t> data(sizeof(FileHeader) + size);
+    memcpy(data.data(), &header, sizeof(FileHeader));
+    if (size > 0)
+    {
+      memcpy(data.data() + sizeof(FileHeader), dxil, size);
+    }
+    return data;
+  }
+  static bool DecodeFile(const std::vector<uint8_t>& data, uint64_t hash, std::vector<uint8_t>& dxil)
+  {
+    dxil.clear();
+    FileHeader header;
+    if (data.size() < sizeof(FileHeader))
+    {
+      return false;
+    }
+    memcpy(&header, data.data(), sizeof(FileHeader));
+    if (header.magic != FileMagic || header.version != FileVersion || header.hash != hash ||
+      header.size != data.size() - sizeof(FileHeader))
+    {
+      return false;
+    }
+    if (Hash(data.data() + sizeof(FileHeader), size_t(header.size)) != header.checksum)
+    {
+      return false;
+    }
+    dxil.assign(data.begin() + sizeof(FileHeader), data.end());
+    return true;
+  }
+private:
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t size;
+    uint64_t checksum;
+  };
+
+  template<class T>
+  static void WriteValue(std::vector<uint8_t>& bytes, const T& value)
+  {
+    auto p = reinterpret_cast<const uint8_t*>(&value);
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+  }
+  static void WriteString(std::vector<uint8_t>& bytes, const std::string& text)
+  {
+    WriteValue(bytes, uint32_t(text.size()));
+    bytes.insert(bytes.end(), text.begin(), text.end());
+  }
+  static void WriteString(std::vector<uint8_t>& bytes, const std::wstring& text)
+  {
+    WriteValue(bytes, uint32_t(text.size()));
+    for (auto c : text)
+    {
+      WriteValue(bytes, uint16_t(c));
+    }
+  }
+  // インクルード名は ASCII のみを想定する.
+  static std::wstring Widen(const std::string& text)
+  {
+    return std::wstring(text.begin(), text.end());
+  }
+};
@@ -0,0 +1,170 @@
+﻿#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// シェーダーのソースとインクルードの更新の監視.
+// id 毎に依存するファイルを登録しておき、更新されたファイルに依存する id を返す.
+// 更新の判定はファイル毎のスタンプ (更新時刻など) の比較で行い、取得方法は呼び出し側が渡す.
+// 保存の途中を拾わないよう、スタンプが変わってから次の確認でも同じ値であった時点で更新とみなす.
+class ShaderFileWatcher
+{
+public:
+  // path のスタンプを返す. ファイルが無ければ false.
+  using StampFunc = std::function<bool(const std::wstring& path, uint64_t& stamp)>;
+  using ChangedFunc = std::function<void(const std::vector<uint32_t>& ids)>;
+
+  explicit ShaderFileWatcher(StampFunc getStamp)
+    : m_getStamp(getStamp), m_isRunning(false)
+  {
+  }
+  ~ShaderFileWatcher()
+  {
+    Stop();
+  }
+  ShaderFileWatcher(const ShaderFileWatcher&) = delete;
+  ShaderFileWatcher& operator=(const ShaderFileWatcher&) = delete;
+
+  // id が依存するファイルを files に置き換える. 現在のスタンプを基準にする.
+  void Track(uint32_t id, const std::vector<std::wstring>& files)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RemoveLocked(id);
+    auto& dependencies = m_dependencies[id];
+    for (const auto& path : files)
+    {
+      auto itr = m_files.find(path);
+      if (itr == m_files.end())
+      {
+        FileEntry entry{};
+        entry.exists = m_getStamp(path, entry.stamp);
+        entry.pendingStamp = entry.stamp;
+        itr = m_files.emplace(path, entry).first;
+      }
+      if (itr->second.ids.insert(id).second)
+      {
+        dependencies.push_back(path);
+      }
+    }
+  }
+  void Untrack(uint32_t id)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RemoveLocked(id);
+  }
+
+  // 前回から更新されたファイルに依存する id を昇順で返す.
+  // 削除されたファイルは、再び作られるまで更新とみなさない.
+  std::vector<uint32_t> Poll()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::set<uint32_t> changed;
+    for (auto& item : m_files)
+    {
+      auto& entry = item.second;
+      uint64_t stamp = 0;
+      if (!m_getStamp(item.first, stamp))
+      {
+        entry.exists = false;
+        continue;
+      }
+      if (entry.exists && stamp == entry.stamp)
+      {
+        entry.pendingStamp = stamp;
+        continue;
+      }
+      if (stamp != entry.pendingStamp)
+      {
+        // 変化を見つけた. 次の確認でも同じなら書き込みが終わったとみなす.
+        entry.pendingStamp = stamp;
+        continue;
+      }
+      entry.stamp = stamp;
+      entry.exists = true;
+      changed.insert(entry.ids.begin(), entry.ids.end());
+    }
+    return std::vector<uint32_t>(changed.begin(), changed.end());
+  }
+
+  // intervalMs 毎に Poll し、更新があれば onChanged をこのクラスのスレッドで呼ぶ.
+  // onChanged の中から Track を呼んでもよい.
+  void Start(uint32_t intervalMs, ChangedFunc onChanged)
+  {
+    Stop();
+    m_isRunning = true;
+    m_thread = std::thread([this, intervalMs, onChanged]() {
+      std::unique_lock<std::mutex> lock(m_threadMutex);
+      while (!m_wakeup.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return !m_isRunning; }))
+      {
+        lock.unlock();
+        auto ids = Poll();
+        if (!ids.empty())
+        {
+          onChanged(ids);
+        }
+        lock.lock();
+      }
+    });
+  }
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_threadMutex);
+      m_isRunning = false;
+    }
+    m_wakeup.notify_all();
+    if (m_thread.joinable())
+    {
+      m_thread.join();
+    }
+  }
+
+  size_t GetFileCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_files.size();
+  }
+private:
+  struct FileEntry
+  {
+    uint64_t stamp;
+    uint64_t pendingStamp;
+    bool exists;
+    std::set<uint32_t> ids;
+  };
+  void RemoveLocked(uint32_t id)
+  {
+    auto itr = m_dependencies.find(id);
+    if (itr == m_dependencies.end())
+    {
+      return;
+    }
+    for (const auto& path : itr->second)
+    {
+      auto file = m_files.find(path);
+      file->second.ids.erase(id);
+      if (file->second.ids.empty())
+      {
+        m_files.erase(file);
+      }
+    }
+    m_dependencies.erase(itr);
+  }
+
+  StampFunc m_getStamp;
+  mutable std::mutex m_mutex;
+  std::map<std::wstring, FileEntry> m_files;
+  std::map<uint32_t, std::vector<std::wstring>> m_dependencies;
+
+  std::mutex m_threadMutex;
+  std::condition_variable m_wakeup;
+  bool m_isRunning;
+  std::thread m_thread;
+};
@@ -0,0 +1,302 @@
+﻿#include "ShaderHotReload.h"
+#include "PipelineStateCache.h"
+
+#include <chrono>
+#include <exception>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+  using clock = std::chrono::high_resolution_clock;
+  double ElapsedMs(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+
+  // 最終更新時刻とサイズから作るスタンプ.
+  bool GetFileStamp(const std::wstring& path, uint64_t& stamp)
+  {
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+    {
+      return false;
+    }
+    uint64_t values[] = {
+      (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime,
+      (uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow,
+    };
+    stamp = ShaderCacheKey::Hash(values, sizeof(values));
+    return true;
+  }
+
+  // 作り直すパイプラインの記述. 記述内のポインタが指す先を一緒に持つ.
+  struct PendingPipeline
+  {
+    uint32_t id;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+    std::vector<std::string> semanticNames;
+    ComPtr<ID3D12RootSignature> rootSignature;
+    ComPtr<ID3DBlob> vs, ps;
+  };
+}
+
+ShaderHotReload::ShaderHotReload()
+  : m_shaderCache(nullptr), m_stats()
+{
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+  Cleanup();
+}
+
+void ShaderHotReload::Prepare(ShaderCache* shaderCache, std::shared_ptr<PipelineStateCache> pipelineCache, ReleaseFunc release, UINT pollIntervalMs)
+{
+  m_shaderCache = shaderCache;
+  m_pipelineCache = pipelineCache;
+  m_release = release;
+  m_stats = Stats();
+  m_watcher.reset(new ShaderFileWatcher(GetFileStamp));
+  m_watcher->Start(pollIntervalMs, [this](const std::vector<uint32_t>& ids) { Rebuild(ids); });
+}
+
+void ShaderHotReload::Cleanup()
+{
+  // 監視スレッドを止めてから破棄する.
+  m_watcher.reset();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shaders.clear();
+  m_pipelines.clear();
+  m_ready.clear();
+  m_events.clear();
+  m_pipelineCache.reset();
+}
+
+void ShaderHotReload::Register(const void* owner, ComPtr<ID3D12PipelineState>* target, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+  const ShaderCompileJob& vs, const ShaderCompileJob& ps, SwapFunc onSwap)
+{
+  if (!m_watcher)
+  {
+    return;
+  }
+  Pipeline pipeline;
+  pipeline.owner = owner;
+  pipeline.target = target;
+  pipeline.desc = desc;
+  pipeline.desc.CachedPSO = D3D12_CACHED_PIPELINE_STATE{};
+  pipeline.desc.DS = pipeline.desc.HS = pipeline.desc.GS = D3D12_SHADER_BYTECODE{};
+  pipeline.desc.StreamOutput = D3D12_STREAM_OUTPUT_DESC{};
+  pipeline.inputElements.assign(desc.InputLayout.pInputElementDescs, desc.InputLayout.pInputElementDescs + desc.InputLayout.NumElements);
+  for (auto& element : pipeline.inputElements)
+  {
+    pipeline.semanticNames.push_back(element.SemanticName);
+  }
+  pipeline.rootSignature = desc.pRootSignature;
+  pipeline.onSwap = onSwap;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  pipeline.vs = AddShader(vs);
+  pipeline.ps = AddShader(ps);
+  m_pipelines.push_back(std::move(pipeline));
+}
+
+void ShaderHotReload::Unregister(const void* owner)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& pipeline : m_pipelines)
+  {
+    if (pipeline.owner != owner || !pipeline.target)
+    {
+      continue;
+    }
+    pipeline.target = nullptr;
+    pipeline.onSwap = nullptr;
+    for (auto id : { pipeline.vs, pipeline.ps })
+    {
+      if (--m_shaders[id].pipelineCount == 0 && m_watcher)
+      {
+        m_watcher->Untrack(id);
+      }
+    }
+  }
+}
+
+void ShaderHotReload::SetEventCallback(EventFunc callback)
+{
+  m_eventCallback = callback;
+}
+
+UINT ShaderHotReload::Update()
+{
+  std::vector<SwapFunc> swapped;
+  std::vector<Event> events;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& ready : m_ready)
+    {
+      auto& pipeline = m_pipelines[ready.pipeline];
+      if (!pipeline.target)
+      {
+        continue;
+      }
+      if (*pipeline.target && m_release)
+      {
+        m_release(*pipeline.target);
+      }
+      *pipeline.target = ready.pipelineState;
+      ++m_stats.swappedCount;
+      if (pipeline.onSwap)
+      {
+        swapped.push_back(pipeline.onSwap);
+      }
+    }
+    m_ready.clear();
+    events.swap(m_events);
+  }
+  for (auto& onSwap : swapped)
+  {
+    onSwap();
+  }
+  if (m_eventCallback)
+  {
+    for (const auto& event : events)
+    {
+      m_eventCallback(event);
+    }
+  }
+  return UINT(swapped.size());
+}
+
+ShaderHotReload::Stats ShaderHotReload::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+uint32_t ShaderHotReload::AddShader(const ShaderCompileJob& job)
+{
+  for (uint32_t id = 0; id < uint32_t(m_shaders.size()); ++id)
+  {
+    auto& shader = m_shaders[id];
+    if (shader.job.fileName == job.fileName && shader.job.profile == job.profile && shader.job.defines == job.defines)
+    {
+      if (shader.pipelineCount++ == 0)
+      {
+        m_watcher->Track(id, shader.job.files);
+      }
+      return id;
+    }
+  }
+  auto id = uint32_t(m_shaders.size());
+  m_shaders.push_back(Shader{ job, 1 });
+  m_watcher->Track(id, job.files);
+  return id;
+}
+
+void ShaderHotReload::Rebuild(const std::vector<uint32_t>& shaderIds)
+{
+  // 監視スレッドで呼ばれる. コンパイルとパイプラインの生成の間はロックを外す.
+  for (auto shaderId : shaderIds)
+  {
+    auto start = clock::now();
+    ShaderCompileJob job(L"", L"");
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto& shader = m_shaders[shaderId];
+      job = ShaderCompileJob(shader.job.fileName, shader.job.profile, shader.job.defines);
+    }
+    Event event{ job.fileName, false, 0, 0.0, std::string() };
+    try
+    {
+      job.hr = m_shaderCache->Compile(job.fileName, job.profile, job.defines, job.shaderBlob, job.errorBlob, &job.files);
+    }
+    catch (std::exception& e)
+    {
+      job.hr = E_FAIL;
+      event.message = e.what();
+    }
+    if (FAILED(job.hr))
+    {
+      if (job.errorBlob)
+      {
+        event.message.assign(static_cast<const char*>(job.errorBlob->GetBufferPointer()), job.errorBlob->GetBufferSize());
+      }
+      event.rebuildMs = ElapsedMs(start);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_stats.failedCount;
+      m_stats.lastRebuildMs = event.rebuildMs;
+      m_events.push_back(event);
+      continue;
+    }
+
+    // 新しいシェーダーを反映し、それを使うパイプラインの記述を集める.
+    std::vector<PendingPipeline> pending;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto& shader = m_shaders[shaderId];
+      shader.job.shaderBlob = job.shaderBlob;
+      shader.job.files = job.files;
+      if (shader.pipelineCount > 0)
+      {
+        m_watcher->Track(shaderId, job.files);
+      }
+      for (uint32_t id = 0; id < uint32_t(m_pipelines.size()); ++id)
+      {
+        const auto& pipeline = m_pipelines[id];
+        if (!pipeline.target || (pipeline.vs != shaderId && pipeline.ps != shaderId))
+        {
+          continue;
+        }
+        PendingPipeline item;
+        item.id = id;
+        item.desc = pipeline.desc;
+        item.inputElements = pipeline.inputElements;
+        item.semanticNames = pipeline.semanticNames;
+        item.rootSignature = pipeline.rootSignature;
+        item.vs = m_shaders[pipeline.vs].job.shaderBlob;
+        item.ps = m_shaders[pipeline.ps].job.shaderBlob;
+        pending.push_back(std::move(item));
+      }
+    }
+
+    std::vector<Ready> ready;
+    for (auto& item : pending)
+    {
+      for (size_t i = 0; i < item.inputElements.size(); ++i)
+      {
+        item.inputElements[i].SemanticName = item.semanticNames[i].c_str();
+      }
+      item.desc.InputLayout = { item.inputElements.data(), UINT(item.inputElements.size()) };
+      item.desc.pRootSignature = item.rootSignature.Get();
+      item.desc.VS = { item.vs->GetBufferPointer(), item.vs->GetBufferSize() };
+      item.desc.PS = { item.ps->GetBufferPointer(), item.ps->GetBufferSize() };
+      ComPtr<ID3D12PipelineState> pipelineState;
+      HRESULT hr = m_pipelineCache->CreateGraphicsPipelineState(&item.desc, IID_PPV_ARGS(&pipelineState));
+      if (FAILED(hr))
+      {
+        event.message = "CreateGraphicsPipelineState failed.";
+        ready.clear();
+        break;
+      }
+      ready.push_back(Ready{ item.id, pipelineState });
+    }
+
+    event.isSucceeded = event.message.empty();
+    event.pipelineCount = UINT(ready.size());
+    event.rebuildMs = ElapsedMs(start);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (event.isSucceeded)
+    {
+      ++m_stats.reloadCount;
+      m_ready.insert(m_ready.end(), ready.begin(), ready.end());
+    }
+    else
+    {
+      ++m_stats.failedCount;
+    }
+    m_stats.lastRebuildMs = event.rebuildMs;
+    m_events.push_back(event);
+  }
+}
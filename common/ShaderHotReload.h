@@ -0,0 +1,105 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+#include "ShaderFileWatcher.h"
+
+class PipelineStateCache;
+
+// シェーダーのホットリロード.
+// パイプラインを作った記述とシェーダー (VS, PS) を登録しておくと、ソースやインクルードの更新時に
+// 影響するシェーダーだけを監視スレッドで再コンパイルし、パイプラインを作り直す.
+// 差し替えは Update を呼んだ時点 (フレームの境界) でまとめて行い、失敗した場合は元のパイプラインを使い続ける.
+class ShaderHotReload
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  struct Event
+  {
+    std::wstring fileName;  // 再コンパイルしたシェーダー.
+    bool isSucceeded;
+    UINT pipelineCount;     // 作り直したパイプラインの数.
+    double rebuildMs;       // シェーダーのコンパイルとパイプラインの生成にかかった時間.
+    std::string message;    // 失敗した場合のエラー.
+  };
+  struct Stats
+  {
+    UINT reloadCount;       // 成功した再コンパイルの数.
+    UINT failedCount;
+    UINT swappedCount;      // 差し替えたパイプラインの数.
+    double lastRebuildMs;
+  };
+  using EventFunc = std::function<void(const Event&)>;
+  // 差し替えた古いパイプラインを渡す. GPU が使い終えてから解放すること.
+  using ReleaseFunc = std::function<void(ComPtr<IUnknown>)>;
+  using SwapFunc = std::function<void()>;
+
+  ShaderHotReload();
+  ~ShaderHotReload();
+
+  void Prepare(ShaderCache* shaderCache, std::shared_ptr<PipelineStateCache> pipelineCache, ReleaseFunc release, UINT pollIntervalMs);
+  // 監視を止めて登録を全て破棄する.
+  void Cleanup();
+
+  // desc と vs, ps から作った target を登録する. vs, ps は CompileShadersFromFile の結果 (files を含む) を渡す.
+  // desc の VS, PS 以外のシェーダーとストリーム出力は扱わない.
+  // onSwap は target を差し替えた後に Update の中で呼ばれる. バンドルの記録し直しなどに使う.
+  void Register(const void* owner, ComPtr<ID3D12PipelineState>* target, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+    const ShaderCompileJob& vs, const ShaderCompileJob& ps, SwapFunc onSwap = nullptr);
+  // owner で登録したものを全て外す. owner の破棄前に呼ぶこと.
+  void Unregister(const void* owner);
+
+  // 再コンパイルの結果を受け取る. Update の中で呼ばれる.
+  void SetEventCallback(EventFunc callback);
+
+  // フレームの境界で呼ぶ. 作り直しの終わったパイプラインを差し替え、その数を返す.
+  UINT Update();
+
+  Stats GetStats() const;
+private:
+  struct Shader
+  {
+    ShaderCompileJob job;
+    UINT pipelineCount;
+  };
+  struct Pipeline
+  {
+    const void* owner;
+    ComPtr<ID3D12PipelineState>* target;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+    std::vector<std::string> semanticNames;
+    ComPtr<ID3D12RootSignature> rootSignature;
+    uint32_t vs, ps;
+    SwapFunc onSwap;
+  };
+  struct Ready
+  {
+    uint32_t pipeline;
+    ComPtr<ID3D12PipelineState> pipelineState;
+  };
+  uint32_t AddShader(const ShaderCompileJob& job);
+  void Rebuild(const std::vector<uint32_t>& shaderIds);
+
+  ShaderCache* m_shaderCache;
+  std::shared_ptr<PipelineStateCache> m_pipelineCache;
+  ReleaseFunc m_release;
+  EventFunc m_eventCallback;
+  std::unique_ptr<ShaderFileWatcher> m_watcher;
+
+  mutable std::mutex m_mutex;
+  // 番号は監視の id を兼ねる. 登録を外したパイプラインは target を nullptr にして残す.
+  std::vector<Shader> m_shaders;
+  std::vector<Pipeline> m_pipelines;
+  std::vector<Ready> m_ready;
+  std::vector<Event> m_events;
+  Stats m_stats;
+};
@@ -0,0 +1,125 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ShaderCacheKey.h"
+
+using ShaderFeatureMask = uint32_t;
+
+// シェーダーの変種 (パーミュテーション).
+// シェーダーは "// @feature NAME" の行で機能キーを宣言し、処理を #if NAME で切り替える.
+// 宣言した順に mask のビット 0, 1, ... が対応し、mask から全てのキーを 0/1 で定義したマクロを作る.
+// 実行時の分岐をコンパイル時に確定させ、描画時は mask でパイプラインを選ぶ.
+class ShaderPermutation
+{
+public:
+  enum { MaxFeatureCount = 32 };
+
+  ShaderPermutation() { }
+  explicit ShaderPermutation(const std::string& source)
+    : m_features(ParseFeatures(source))
+  {
+  }
+
+  // fileName のソースから機能キーを読む. 読めなければ例外.
+  static ShaderPermutation FromFile(const std::wstring& fileName, const ShaderCacheKey::ReadFileFunc& readFile)
+  {
+    std::string source;
+    if (!readFile(fileName, source))
+    {
+      throw std::runtime_error("shader not found");
+    }
+    return ShaderPermutation(source);
+  }
+
+  const std::vector<std::string>& GetFeatures() const { return m_features; }
+
+  // 宣言されていないキーは誤りとして例外にする.
+  ShaderFeatureMask GetMask(const std::string& feature) const
+  {
+    for (size_t i = 0; i < m_features.size(); ++i)
+    {
+      if (m_features[i] == feature)
+      {
+        return ShaderFeatureMask(1) << i;
+      }
+    }
+    throw std::runtime_error("unknown shader feature: " + feature);
+  }
+  ShaderFeatureMask GetAllMask() const
+  {
+    return m_features.size() >= MaxFeatureCount ? ~ShaderFeatureMask(0) : (ShaderFeatureMask(1) << m_features.size()) - 1;
+  }
+
+  // mask の変種をコンパイルするためのマクロ定義. 宣言した全てのキーを 0 か 1 で定義する.
+  ShaderDefines MakeDefines(ShaderFeatureMask mask) const
+  {
+    if (mask & ~GetAllMask())
+    {
+      throw std::runtime_error("shader feature mask has undeclared bits");
+    }
+    ShaderDefines defines;
+    for (size_t i = 0; i < m_features.size(); ++i)
+    {
+      auto& name = m_features[i];
+      defines.emplace_back(std::wstring(name.begin(), name.end()), (mask >> i) & 1 ? L"1" : L"0");
+    }
+    return defines;
+  }
+
+  // 行頭 (空白は除く) の "// @feature NAME" を宣言順に返す. 同じ名前は1度だけ数える.
+  static std::vector<std::string> ParseFeatures(const std::string& source)
+  {
+    static const std::string Marker = "@feature";
+    std::vector<std::string> features;
+    size_t lineStart = 0;
+    while (lineStart < source.size())
+    {
+      auto lineEnd = source.find('\n', lineStart);
+      if (lineEnd == std::string::npos)
+      {
+        lineEnd = source.size();
+      }
+      auto p = source.find_first_not_of(" \t", lineStart);
+      if (p != std::string::npos && p < lineEnd && source.compare(p, 2, "//") == 0)
+      {
+        p = source.find_first_not_of(" \t", p + 2);
+        if (p != std::string::npos && p < lineEnd && source.compare(p, Marker.size(), Marker) == 0)
+        {
+          p += Marker.size();
+          auto nameStart = source.find_first_not_of(" \t", p);
+          if (nameStart != std::string::npos && nameStart > p && nameStart < lineEnd)
+          {
+            auto nameEnd = nameStart;
+            while (nameEnd < lineEnd && IsIdentifier(source[nameEnd]))
+            {
+              ++nameEnd;
+            }
+            auto name = source.substr(nameStart, nameEnd - nameStart);
+            if (!name.empty() && !IsDigit(name[0]) && std::find(features.begin(), features.end(), name) == features.end())
+            {
+              features.push_back(name);
+            }
+          }
+        }
+      }
+      lineStart = lineEnd + 1;
+    }
+    if (features.size() > MaxFeatureCount)
+    {
+      throw std::runtime_error("too many shader features");
+    }
+    return features;
+  }
+private:
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+  static bool IsIdentifier(char c)
+  {
+    return IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+
+  std::vector<std::string> m_features;
+};
@@ -3,7 +3,8 @@
 Swapchain::Swapchain(
   ComPtr<IDXGISwapChain1> swapchain,
   std::shared_ptr<DescriptorManager>& heapRTV,
-  bool useHDR)
+  std::shared_ptr<TimelineFence> queueFence,
+  bool useHDR) : m_queueFence(queueFence)
 {
   swapchain.As(&m_swapchain); // IDXGISwapChain4 擾
   m_swapchain->GetDesc1(&m_desc);
@@ -13,18 +14,11 @@ Swapchain::Swapchain(
 
   m_images.resize(m_desc.BufferCount);
   m_imageRTV.resize(m_desc.BufferCount);
-  m_fences.resize(m_desc.BufferCount);
-  m_fenceValues.resize(m_desc.BufferCount);
-  m_waitEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+  m_frameTickets.resize(m_desc.BufferCount);
 
   HRESULT hr;
   for (UINT i = 0; i < m_desc.BufferCount; ++i)
   {
-    hr = device->CreateFence(
-      0, D3D12_FENCE_FLAG_NONE,
-      IID_PPV_ARGS(&m_fences[i]));
-    ThrowIfFailed(hr, "CreateFence s");
-
     m_imageRTV[i] = heapRTV->Alloc();
 
     // Swapchain C[W RTV .
@@ -62,7 +56,6 @@ Swapchain::~Swapchain() {
   {
     m_swapchain->SetFullscreenState(FALSE, nullptr);
   }
-  CloseHandle(m_waitEvent);
 }
 
 DescriptorHandle Swapchain::GetCurrentRTV() const
@@ -78,22 +71,12 @@ HRESULT Swapchain::Present(UINT SyncInterval, UINT Flags)
 
 void Swapchain::WaitPreviousFrame(ComPtr<ID3D12CommandQueue> commandQueue, int frameIndex, DWORD timeout)
 {
-  auto fence = m_fences[frameIndex];
-  // ݂̃tFX GPU Bݒ肳lZbg.
-  auto value = ++m_fenceValues[frameIndex];
-  commandQueue->Signal(fence.Get(), value);
+  // ̃t[̃R}h̊`PbgL^.
+  m_frameTickets[frameIndex] = m_queueFence->Signal();
 
   // t[ŏR}h̎sҋ@.
   auto nextIndex = GetCurrentBackBufferIndex();
-  auto finishValue = m_fenceValues[nextIndex];
-  fence = m_fences[nextIndex];
-  value = fence->GetCompletedValue();
-  if (value < finishValue)
-  {
-    // ̂߃Cxgőҋ@.
-    fence->SetEventOnCompletion(finishValue, m_waitEvent);
-    WaitForSingleObject(m_waitEvent, timeout);
-  }
+  m_queueFence->WaitFor(m_frameTickets[nextIndex], timeout);
 }
 
 void Swapchain::ResizeBuffers(UINT width, UINT height)
@@ -120,21 +103,6 @@ void Swapchain::ResizeBuffers(UINT width, UINT height)
   }
 }
 
-CD3DX12_RESOURCE_BARRIER Swapchain::GetBarrierToRenderTarget()
-{
-  return CD3DX12_RESOURCE_BARRIER::Transition(
-    m_images[GetCurrentBackBufferIndex()].Get(),
-    D3D12_RESOURCE_STATE_PRESENT,
-    D3D12_RESOURCE_STATE_RENDER_TARGET);
-}
-CD3DX12_RESOURCE_BARRIER Swapchain::GetBarrierToPresent()
-{
-  return CD3DX12_RESOURCE_BARRIER::Transition(
-    m_images[GetCurrentBackBufferIndex()].Get(),
-    D3D12_RESOURCE_STATE_RENDER_TARGET,
-    D3D12_RESOURCE_STATE_PRESENT);
-}
-
 
 void Swapchain::SetMetadata()
 {
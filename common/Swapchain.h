@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "DescriptorManager.h"
+#include "TimelineFence.h"
 #include "D3D12BookUtil.h"
 
 class Swapchain
@@ -18,6 +19,7 @@ public:
   Swapchain(
     ComPtr<IDXGISwapChain1> swapchain,
     std::shared_ptr<DescriptorManager>& heapRTV,
+    std::shared_ptr<TimelineFence> queueFence,
     bool useHDR = false);
 
   ~Swapchain();
@@ -26,22 +28,20 @@ public:
     return m_swapchain->GetCurrentBackBufferIndex();
   }
   DescriptorHandle GetCurrentRTV() const;
+  // C[W̃Xe[g̓AṽXe[ge[uŒǐՂ.
+  // `̑ȎJڂ CommandContextPool::Transition ōs.
   ComPtr<ID3D12Resource1> GetImage(UINT index) { return m_images[index]; }
 
   HRESULT Present(UINT SyncInterval, UINT Flags);
 
   // ̃R}hς߂悤ɂȂ܂őҋ@.
+  // tFX͐ɓn`L[̂̂g. commandQueue ͂̃L[ł邱.
   void WaitPreviousFrame(
     ComPtr<ID3D12CommandQueue> commandQueue, 
     int frameIndex, DWORD timeout);
 
   void ResizeBuffers(UINT width, UINT height);
 
-  // ݂̃C[Wɑ΂ĕ`\oAݒ̎擾.
-  CD3DX12_RESOURCE_BARRIER GetBarrierToRenderTarget();
-  // ݂̃C[Wɑ΂ĕ\\oAݒ̎擾.
-  CD3DX12_RESOURCE_BARRIER GetBarrierToPresent();
-
   DXGI_FORMAT GetFormat() const { return m_desc.Format; }
 
   bool IsFullScreen() const;
@@ -56,10 +56,9 @@ private:
   std::vector<ComPtr<ID3D12Resource1>> m_images;
   std::vector<DescriptorHandle> m_imageRTV;
 
-  std::vector<UINT64> m_fenceValues;
-  std::vector<ComPtr<ID3D12Fence1>> m_fences;
+  // C[WɁAŌɕ`悵R}h̊`Pbg.
+  std::vector<TimelineFence::Ticket> m_frameTickets;
+  std::shared_ptr<TimelineFence> m_queueFence;
 
   DXGI_SWAP_CHAIN_DESC1 m_desc;
-
-  HANDLE m_waitEvent;
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+﻿#pragma once
+#include <cstdint>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+// キュー毎に1つ持つ、単調増加するフェンス.
+// Signal が返すチケットはキューのその位置までの完了を表し、CPU での待機やキュー間の待機に使う.
+// 実際のフェンス操作は Backend が行う. D3D12 には依存しないため、GPU を使わずに動作を確認できる.
+// 完了の問い合わせと待機はどのスレッドからでも呼べる. Signal も値の単調増加は保つが、
+// チケットが示すのは Signal を呼んだ時点のキューの位置のため、ExecuteCommandLists と Signal の組は
+// 呼び出し側で直列化すること (別スレッドの投入が間に入ると、チケットがその投入の完了も含んでしまう).
+class TimelineFence
+{
+public:
+  using Ticket = uint64_t;
+  enum : uint32_t { InfiniteTimeout = 0xFFFFFFFFu };  // INFINITE と同じ値.
+
+  class Backend
+  {
+  public:
+    virtual ~Backend() { }
+    // キューの現在位置に value を書き込むコマンドを積む.
+    virtual void Signal(uint64_t value) = 0;
+    virtual uint64_t GetCompletedValue() const = 0;
+    // value に到達するまで CPU を止める. タイムアウトした場合は false.
+    virtual bool Wait(uint64_t value, uint32_t timeoutMs) = 0;
+    // このキューの以降のコマンドを、other が value に到達するまで待たせる.
+    virtual void QueueWait(Backend& other, uint64_t value) = 0;
+  };
+
+  struct Stats
+  {
+    uint64_t signalCount;
+    uint64_t blockingWaitCount;  // 実際に CPU が止まった回数.
+    uint64_t timeoutCount;
+    uint64_t queueWaitCount;     // 他のキューを待つコマンドを積んだ回数.
+    double blockedMs;            // GPU を待って CPU が止まっていた時間.
+  };
+
+  explicit TimelineFence(std::unique_ptr<Backend> backend)
+    : m_backend(std::move(backend)), m_lastSignaled(0), m_lastCompleted(0), m_stats()
+  {
+  }
+
+  Ticket Signal()
+  {
+    // 値の採番とキューへの Signal の順が入れ替わらないよう、まとめてロックする.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto ticket = m_lastSignaled.load(std::memory_order_relaxed) + 1;
+    m_backend->Signal(ticket);
+    m_lastSignaled.store(ticket, std::memory_order_release);
+    ++m_stats.signalCount;
+    return ticket;
+  }
+  Ticket GetLastSignaled() const { return m_lastSignaled.load(std::memory_order_acquire); }
+
+  uint64_t GetCompletedValue() const
+  {
+    return UpdateCompleted(m_backend->GetCompletedValue());
+  }
+  bool IsComplete(Ticket ticket) const
+  {
+    return ticket <= m_lastCompleted.load(std::memory_order_acquire) || ticket <= GetCompletedValue();
+  }
+
+  // ticket の完了を待つ. まだ Signal していないチケットを待ってはいけない.
+  bool WaitFor(Ticket ticket, uint32_t timeoutMs = InfiniteTimeout)
+  {
+    assert(ticket <= GetLastSignaled());
+    if (IsComplete(ticket))
+    {
+      return true;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    bool isCompleted = m_backend->Wait(ticket, timeoutMs);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (isCompleted)
+    {
+      UpdateCompleted(ticket);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.blockedMs += std::chrono::duration<double, std::milli>(end - start).count();
+    ++m_stats.blockingWaitCount;
+    if (!isCompleted)
+    {
+      ++m_stats.timeoutCount;
+    }
+    return isCompleted;
+  }
+  // ここまでに積んだ全てのコマンドの完了を待つ.
+  bool WaitIdle(uint32_t timeoutMs = InfiniteTimeout)
+  {
+    return WaitFor(Signal(), timeoutMs);
+  }
+
+  // このキューが other の ticket の完了を GPU 上で待つようにする. 完了済みなら何もしない.
+  void QueueWait(TimelineFence& other, Ticket ticket)
+  {
+    assert(ticket <= other.GetLastSignaled());
+    if (other.IsComplete(ticket))
+    {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_backend->QueueWait(*other.m_backend, ticket);
+    ++m_stats.queueWaitCount;
+  }
+
+  Stats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+  Backend* GetBackend() const { return m_backend.get(); }
+private:
+  // 完了値のキャッシュを value まで進める. 他のスレッドがより大きな値を書いていれば、そちらを返す.
+  uint64_t UpdateCompleted(uint64_t value) const
+  {
+    auto current = m_lastCompleted.load(std::memory_order_acquire);
+    while (current < value && !m_lastCompleted.compare_exchange_weak(current, value, std::memory_order_acq_rel))
+    {
+    }
+    return std::max(current, value);
+  }
+
+  std::unique_ptr<Backend> m_backend;
+  std::atomic<Ticket> m_lastSignaled;
+  mutable std::atomic<uint64_t> m_lastCompleted;  // 問い合わせ結果のキャッシュ.
+  mutable std::mutex m_mutex;                     // Signal とキューへのコマンド, 統計を守る.
+  Stats m_stats;
+};
@@ -0,0 +1,569 @@
+﻿#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+// 一定サイズの領域からオフセットを切り出す TLSF (Two-Level Segregated Fit) アロケータ.
+// 空き領域をサイズの 2 のべき(第1レベル)とその中の 16 分割(第2レベル)で分類し、
+// ビットマップから条件を満たす空きを定数時間で見つける. 解放時は隣接する空きと結合する.
+// D3D12 には依存しないため、ヒープを作らずに動作を確認できる.
+class TlsfAllocator
+{
+public:
+  enum : uint64_t { InvalidOffset = ~0ull };
+
+  struct Stats
+  {
+    uint64_t size;
+    uint64_t used;
+    uint64_t largestFreeBlock;
+    uint32_t freeBlockCount;
+    uint32_t allocationCount;
+  };
+
+  TlsfAllocator() { Reset(0); }
+  explicit TlsfAllocator(uint64_t size) { Reset(size); }
+
+  // [0, size) を1つの空き領域として初期化する.
+  void Reset(uint64_t size)
+  {
+    m_size = size;
+    m_used = 0;
+    m_flBitmap = 0;
+    m_freeBlockCount = 0;
+    std::fill(std::begin(m_slBitmap), std::end(m_slBitmap), 0u);
+    for (auto& heads : m_freeHeads)
+    {
+      std::fill(std::begin(heads), std::end(heads), InvalidNode);
+    }
+    m_nodes.clear();
+    m_unusedNodes.clear();
+    m_allocated.clear();
+    if (size > 0)
+    {
+      auto node = NewNode(0, size);
+      InsertFree(node);
+    }
+  }
+
+  // alignment は 2 のべきであること. 空きが無い場合は InvalidOffset.
+  uint64_t Allocate(uint64_t size, uint64_t alignment = 1)
+  {
+    if (size == 0 || size > m_size)
+    {
+      return InvalidOffset;
+    }
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    // まずはサイズのみで探し、アライメントの分が収まらない場合は余裕を持たせて探し直す.
+    auto node = FindFree(size);
+    if (node != InvalidNode && !IsFit(node, size, alignment))
+    {
+      node = FindFree(size + alignment - 1);
+    }
+    // 切り上げたクラスに無くても、size を含むクラスに収まる空きが残っている場合がある
+    // (領域全体やブロックと同じサイズの要求など). そのリストを辿って探す.
+    if (node == InvalidNode)
+    {
+      node = FindFreeInClass(size, alignment);
+    }
+    if (node == InvalidNode)
+    {
+      return InvalidOffset;
+    }
+    RemoveFree(node);
+
+    // 先頭の余りは空き領域として残す(直前の物理ブロックは使用中なので結合は不要).
+    auto alignedOffset = AlignUp(m_nodes[node].offset, alignment);
+    auto padding = alignedOffset - m_nodes[node].offset;
+    if (padding > 0)
+    {
+      auto front = SplitFront(node, padding);
+      InsertFree(front);
+    }
+    // 末尾の余りも空き領域へ戻す.
+    if (m_nodes[node].size > size)
+    {
+      auto back = SplitBack(node, size);
+      InsertFree(back);
+    }
+    m_nodes[node].isFree = false;
+    m_used += m_nodes[node].size;
+    m_allocated[m_nodes[node].offset] = node;
+    return m_nodes[node].offset;
+  }
+
+  // Allocate が返したオフセットを解放する. 該当するものが無い場合は false.
+  bool Free(uint64_t offset)
+  {
+    auto itr = m_allocated.find(offset);
+    if (itr == m_allocated.end())
+    {
+      return false;
+    }
+    auto node = itr->second;
+    m_allocated.erase(itr);
+    m_used -= m_nodes[node].size;
+    m_nodes[node].isFree = true;
+
+    // 前後の物理ブロックが空きであれば結合する.
+    auto prev = m_nodes[node].prevPhys;
+    if (prev != InvalidNode && m_nodes[prev].isFree)
+    {
+      RemoveFree(prev);
+      node = Merge(prev, node);
+    }
+    auto next = m_nodes[node].nextPhys;
+    if (next != InvalidNode && m_nodes[next].isFree)
+    {
+      RemoveFree(next);
+      node = Merge(node, next);
+    }
+    InsertFree(node);
+    return true;
+  }
+
+  uint64_t GetSize() const { return m_size; }
+  uint64_t GetUsed() const { return m_used; }
+  bool IsEmpty() const { return m_allocated.empty(); }
+
+  // 確保済みのサイズ. 該当するものが無い場合は 0.
+  uint64_t GetAllocationSize(uint64_t offset) const
+  {
+    auto itr = m_allocated.find(offset);
+    return itr != m_allocated.end() ? m_nodes[itr->second].size : 0;
+  }
+
+  Stats GetStats() const
+  {
+    Stats stats{};
+    stats.size = m_size;
+    stats.used = m_used;
+    stats.freeBlockCount = m_freeBlockCount;
+    stats.allocationCount = uint32_t(m_allocated.size());
+    // 最大の空きは最上位の空でないクラスにあるため、そのリストのみ調べる.
+    if (m_flBitmap != 0)
+    {
+      auto fl = 63 - CountLeadingZeros(m_flBitmap);
+      auto sl = 63 - CountLeadingZeros(m_slBitmap[fl]);
+      for (auto node = m_freeHeads[fl][sl]; node != InvalidNode; node = m_nodes[node].nextFree)
+      {
+        stats.largestFreeBlock = std::max(stats.largestFreeBlock, m_nodes[node].size);
+      }
+    }
+    return stats;
+  }
+
+private:
+  enum : uint32_t {
+    SLBits = 4,
+    SLCount = 1 << SLBits,
+    FLCount = 64 - SLBits + 1,
+    InvalidNode = 0xFFFFFFFFu,
+  };
+
+  struct Node
+  {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t prevPhys, nextPhys;  // アドレス順で隣接するブロック.
+    uint32_t prevFree, nextFree;  // 同じクラスの空きリスト.
+    bool isFree;
+  };
+
+  static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+  {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+  static uint32_t CountLeadingZeros(uint64_t v)
+  {
+    uint32_t n = 0;
+    for (uint64_t bit = 1ull << 63; bit != 0 && (v & bit) == 0; bit >>= 1)
+    {
+      ++n;
+    }
+    return n;
+  }
+  static uint32_t CountTrailingZeros(uint64_t v)
+  {
+    uint32_t n = 0;
+    for (; n < 64 && (v & (1ull << n)) == 0; ++n) { }
+    return n;
+  }
+
+  // サイズからクラス(第1レベル, 第2レベル)を求める.
+  static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+  {
+    if (size < SLCount)
+    {
+      fl = 0;
+      sl = uint32_t(size);
+      return;
+    }
+    auto msb = 63 - CountLeadingZeros(size);
+    fl = msb - SLBits + 1;
+    sl = uint32_t(size >> (msb - SLBits)) ^ SLCount;
+  }
+
+  // size 以上であることが保証されたクラスから空きを探す.
+  uint32_t FindFree(uint64_t size) const
+  {
+    if (size >= SLCount)
+    {
+      // 次のクラスの境界へ切り上げ、そのクラスのどの空きでも足りるようにする.
+      auto msb = 63 - CountLeadingZeros(size);
+      size += (1ull << (msb - SLBits)) - 1;
+    }
+    uint32_t fl, sl;
+    Mapping(size, fl, sl);
+    if (fl >= FLCount)
+    {
+      return InvalidNode;
+    }
+    auto slMap = m_slBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+      auto flMap = fl + 1 < 64 ? (m_flBitmap & (~0ull << (fl + 1))) : 0;
+      if (flMap == 0)
+      {
+        return InvalidNode;
+      }
+      fl = CountTrailingZeros(flMap);
+      slMap = m_slBitmap[fl];
+    }
+    sl = CountTrailingZeros(slMap);
+    return m_freeHeads[fl][sl];
+  }
+
+  // size を含むクラスの空きリストから、アライメントを含めて収まるものを探す.
+  uint32_t FindFreeInClass(uint64_t size, uint64_t alignment) const
+  {
+    uint32_t fl, sl;
+    Mapping(size, fl, sl);
+    if (fl >= FLCount)
+    {
+      return InvalidNode;
+    }
+    for (auto node = m_freeHeads[fl][sl]; node != InvalidNode; node = m_nodes[node].nextFree)
+    {
+      if (IsFit(node, size, alignment))
+      {
+        return node;
+      }
+    }
+    return InvalidNode;
+  }
+
+  bool IsFit(uint32_t node, uint64_t size, uint64_t alignment) const
+  {
+    const auto& n = m_nodes[node];
+    auto padding = AlignUp(n.offset, alignment) - n.offset;
+    return padding <= n.size && size <= n.size - padding;
+  }
+
+  void InsertFree(uint32_t node)
+  {
+    uint32_t fl, sl;
+    Mapping(m_nodes[node].size, fl, sl);
+    auto& n = m_nodes[node];
+    n.isFree = true;
+    n.prevFree = InvalidNode;
+    n.nextFree = m_freeHeads[fl][sl];
+    if (n.nextFree != InvalidNode)
+    {
+      m_nodes[n.nextFree].prevFree = node;
+    }
+    m_freeHeads[fl][sl] = node;
+    m_flBitmap |= 1ull << fl;
+    m_slBitmap[fl] |= 1u << sl;
+    ++m_freeBlockCount;
+  }
+
+  void RemoveFree(uint32_t node)
+  {
+    uint32_t fl, sl;
+    Mapping(m_nodes[node].size, fl, sl);
+    auto& n = m_nodes[node];
+    if (n.prevFree != InvalidNode)
+    {
+      m_nodes[n.prevFree].nextFree = n.nextFree;
+    }
+    else
+    {
+      m_freeHeads[fl][sl] = n.nextFree;
+    }
+    if (n.nextFree != InvalidNode)
+    {
+      m_nodes[n.nextFree].prevFree = n.prevFree;
+    }
+    if (m_freeHeads[fl][sl] == InvalidNode)
+    {
+      m_slBitmap[fl] &= ~(1u << sl);
+      if (m_slBitmap[fl] == 0)
+      {
+        m_flBitmap &= ~(1ull << fl);
+      }
+    }
+    n.prevFree = n.nextFree = InvalidNode;
+    --m_freeBlockCount;
+  }
+
+  uint32_t NewNode(uint64_t offset, uint64_t size)
+  {
+    uint32_t index;
+    if (m_unusedNodes.empty())
+    {
+      index = uint32_t(m_nodes.size());
+      m_nodes.emplace_back();
+    }
+    else
+    {
+      index = m_unusedNodes.back();
+      m_unusedNodes.pop_back();
+    }
+    m_nodes[index] = Node{ offset, size, InvalidNode, InvalidNode, InvalidNode, InvalidNode, false };
+    return index;
+  }
+
+  // node の先頭 size を切り離して新しいブロックとして返す.
+  uint32_t SplitFront(uint32_t node, uint64_t size)
+  {
+    auto front = NewNode(m_nodes[node].offset, size);
+    m_nodes[front].prevPhys = m_nodes[node].prevPhys;
+    m_nodes[front].nextPhys = node;
+    if (m_nodes[front].prevPhys != InvalidNode)
+    {
+      m_nodes[m_nodes[front].prevPhys].nextPhys = front;
+    }
+    m_nodes[node].prevPhys = front;
+    m_nodes[node].offset += size;
+    m_nodes[node].size -= size;
+    return front;
+  }
+
+  // node を size に縮め、残りを新しいブロックとして返す.
+  uint32_t SplitBack(uint32_t node, uint64_t size)
+  {
+    auto back = NewNode(m_nodes[node].offset + size, m_nodes[node].size - size);
+    m_nodes[back].prevPhys = node;
+    m_nodes[back].nextPhys = m_nodes[node].nextPhys;
+    if (m_nodes[back].nextPhys != InvalidNode)
+    {
+      m_nodes[m_nodes[back].nextPhys].prevPhys = back;
+    }
+    m_nodes[node].nextPhys = back;
+    m_nodes[node].size = size;
+    return back;
+  }
+
+  // 隣接する2つを first へまとめる.
+  uint32_t Merge(uint32_t first, uint32_t second)
+  {
+    m_nodes[first].size += m_nodes[second].size;
+    m_nodes[first].nextPhys = m_nodes[second].nextPhys;
+    if (m_nodes[first].nextPhys != InvalidNode)
+    {
+      m_nodes[m_nodes[first].nextPhys].prevPhys = first;
+    }
+    m_unusedNodes.push_back(second);
+    return first;
+  }
+
+  uint64_t m_size;
+  uint64_t m_used;
+  uint64_t m_flBitmap;
+  uint32_t m_slBitmap[FLCount];
+  uint32_t m_freeHeads[FLCount][SLCount];
+  uint32_t m_freeBlockCount;
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_unusedNodes;
+  std::unordered_map<uint64_t, uint32_t> m_allocated;  // オフセットから使用中ブロックを引く.
+};
+
+// 同じ種類のメモリを blockSize ごとのブロックとして確保し、TLSF で切り出すプール.
+// ブロックの実体(ID3D12Heap など)は呼び出し側のコールバックで生成・破棄する.
+// blockSize を超える要求には専用のブロックを割り当てる.
+class HeapBlockPool
+{
+public:
+  using CreateBlockFunc = std::function<bool(uint32_t blockIndex, uint64_t size)>;
+  using DestroyBlockFunc = std::function<void(uint32_t blockIndex)>;
+
+  struct Allocation
+  {
+    uint32_t blockIndex;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Stats
+  {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    uint64_t reserved;          // 確保済みブロックの合計.
+    uint64_t used;
+    uint64_t largestFreeBlock;
+    uint32_t freeBlockCount;
+    // 空き容量のうち、最大の空きブロックに含まれない割合(0 で断片化なし).
+    float fragmentation;
+  };
+
+  HeapBlockPool() : m_blockSize(0) { }
+  HeapBlockPool(const HeapBlockPool&) = delete;
+  HeapBlockPool& operator=(const HeapBlockPool&) = delete;
+
+  void Reset(uint64_t blockSize, CreateBlockFunc createBlock, DestroyBlockFunc destroyBlock)
+  {
+    Clear();
+    m_blockSize = blockSize;
+    m_createBlock = createBlock;
+    m_destroyBlock = destroyBlock;
+  }
+
+  // 全てのブロックを破棄する.
+  void Clear()
+  {
+    for (uint32_t i = 0; i < uint32_t(m_blocks.size()); ++i)
+    {
+      if (m_blocks[i] && m_destroyBlock)
+      {
+        m_destroyBlock(i);
+      }
+    }
+    m_blocks.clear();
+  }
+
+  // 空きのあるブロックから切り出す. 足りなければブロックを追加する.
+  bool Allocate(uint64_t size, uint64_t alignment, Allocation& out)
+  {
+    if (size <= m_blockSize)
+    {
+      for (uint32_t i = 0; i < uint32_t(m_blocks.size()); ++i)
+      {
+        if (m_blocks[i] && !m_blocks[i]->isDedicated && TryAllocate(i, size, alignment, out))
+        {
+          return true;
+        }
+      }
+    }
+    auto isDedicated = size > m_blockSize;
+    auto blockSize = isDedicated ? ((size + alignment - 1) & ~(alignment - 1)) : m_blockSize;
+    auto index = AddBlock(blockSize, isDedicated);
+    if (index == InvalidBlock)
+    {
+      return false;
+    }
+    if (!TryAllocate(index, size, alignment, out))
+    {
+      // 追加したばかりのブロックに収まらない場合は、空のまま残さず破棄する.
+      if (m_destroyBlock)
+      {
+        m_destroyBlock(index);
+      }
+      m_blocks[index].reset();
+      return false;
+    }
+    return true;
+  }
+
+  void Free(const Allocation& allocation)
+  {
+    if (allocation.blockIndex >= m_blocks.size() || !m_blocks[allocation.blockIndex])
+    {
+      return;
+    }
+    auto& block = m_blocks[allocation.blockIndex];
+    block->allocator.Free(allocation.offset);
+    // 空になったブロックは、通常のブロックを1つだけ残して破棄する.
+    if (block->allocator.IsEmpty() && (block->isDedicated || CountSharedBlocks() > 1))
+    {
+      if (m_destroyBlock)
+      {
+        m_destroyBlock(allocation.blockIndex);
+      }
+      block.reset();
+    }
+  }
+
+  uint64_t GetBlockSize() const { return m_blockSize; }
+
+  Stats GetStats() const
+  {
+    Stats stats{};
+    uint64_t freeTotal = 0;
+    for (const auto& block : m_blocks)
+    {
+      if (!block)
+      {
+        continue;
+      }
+      auto s = block->allocator.GetStats();
+      ++stats.blockCount;
+      stats.allocationCount += s.allocationCount;
+      stats.reserved += s.size;
+      stats.used += s.used;
+      stats.freeBlockCount += s.freeBlockCount;
+      stats.largestFreeBlock = std::max(stats.largestFreeBlock, s.largestFreeBlock);
+      freeTotal += s.size - s.used;
+    }
+    if (freeTotal > 0)
+    {
+      stats.fragmentation = 1.0f - float(double(stats.largestFreeBlock) / double(freeTotal));
+    }
+    return stats;
+  }
+
+private:
+  enum : uint32_t { InvalidBlock = 0xFFFFFFFFu };
+
+  struct Block
+  {
+    TlsfAllocator allocator;
+    bool isDedicated;
+  };
+
+  bool TryAllocate(uint32_t index, uint64_t size, uint64_t alignment, Allocation& out)
+  {
+    auto offset = m_blocks[index]->allocator.Allocate(size, alignment);
+    if (offset == TlsfAllocator::InvalidOffset)
+    {
+      return false;
+    }
+    out = Allocation{ index, offset, size };
+    return true;
+  }
+
+  uint32_t AddBlock(uint64_t size, bool isDedicated)
+  {
+    // 破棄済みの枠があれば再利用する.
+    uint32_t index = 0;
+    while (index < m_blocks.size() && m_blocks[index])
+    {
+      ++index;
+    }
+    if (!m_createBlock || !m_createBlock(index, size))
+    {
+      return InvalidBlock;
+    }
+    if (index == m_blocks.size())
+    {
+      m_blocks.emplace_back();
+    }
+    m_blocks[index].reset(new Block{ TlsfAllocator(size), isDedicated });
+    return index;
+  }
+
+  uint32_t CountSharedBlocks() const
+  {
+    return uint32_t(std::count_if(m_blocks.begin(), m_blocks.end(),
+      [](const std::unique_ptr<Block>& b) { return b && !b->isDedicated; }));
+  }
+
+  uint64_t m_blockSize;
+  CreateBlockFunc m_createBlock;
+  DestroyBlockFunc m_destroyBlock;
+  std::vector<std::unique_ptr<Block>> m_blocks;
+};
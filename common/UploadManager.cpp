@@ -0,0 +1,274 @@
+﻿#include "UploadManager.h"
+#include "D3D12AppBase.h"
+#include "D3D12BookUtil.h"
+#include "CommandQueueFence.h"
+
+#include <algorithm>
+
+UploadManager::UploadManager()
+  : m_app(nullptr), m_isRecording(false),
+  m_mappedStaging(nullptr), m_stats()
+{
+}
+
+UploadManager::~UploadManager()
+{
+  Cleanup();
+}
+
+void UploadManager::Prepare(D3D12AppBase* app, UINT64 stagingSize)
+{
+  HRESULT hr;
+  m_app = app;
+  m_device = app->GetDevice();
+
+  D3D12_COMMAND_QUEUE_DESC queueDesc{
+    D3D12_COMMAND_LIST_TYPE_COPY,
+    0,
+    D3D12_COMMAND_QUEUE_FLAG_NONE,
+    0
+  };
+  hr = m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue));
+  ThrowIfFailed(hr, "CreateCommandQueue(Copy) 失敗");
+  m_queue->SetName(L"UploadQueue");
+
+  m_queueFence = CommandQueueFence::CreateTimeline(m_device, m_queue);
+
+  auto units = (stagingSize + StagingAlignment - 1) / StagingAlignment;
+  m_staging = app->CreateResource(
+    CD3DX12_RESOURCE_DESC::Buffer(units * StagingAlignment),
+    D3D12_RESOURCE_STATE_GENERIC_READ,
+    nullptr,
+    D3D12_HEAP_TYPE_UPLOAD
+  );
+  m_staging->SetName(L"UploadStaging");
+  CD3DX12_RANGE readRange(0, 0);
+  hr = m_staging->Map(0, &readRange, &m_mappedStaging);
+  ThrowIfFailed(hr, "Map 失敗");
+  m_stagingRing.Reset(uint32_t(units));
+
+  m_stats = Stats{};
+  m_stats.stagingCapacity = units * StagingAlignment;
+}
+
+void UploadManager::Cleanup()
+{
+  if (m_queue)
+  {
+    Wait(Flush());
+  }
+  m_oversizeStaging.clear();
+  m_pendingAllocators.clear();
+  m_freeAllocators.clear();
+  m_commandList.Reset();
+  m_staging.Reset();
+  m_mappedStaging = nullptr;
+  m_queueFence.reset();
+  m_queue.Reset();
+  m_device.Reset();
+}
+
+UploadManager::Ticket UploadManager::UploadBuffer(ID3D12Resource* dst, UINT64 dstOffset, const void* data, UINT64 size)
+{
+  auto staging = AllocateStaging(size);
+  memcpy(staging.cpuAddress, data, size_t(size));
+
+  GetCommandList()->CopyBufferRegion(dst, dstOffset, staging.resource, staging.offset, size);
+  ++m_stats.uploadCount;
+  m_stats.uploadedBytes += size;
+  return GetRecordingTicket();
+}
+
+UploadManager::Ticket UploadManager::UploadTexture(ID3D12Resource* dst, UINT firstSubresource, const D3D12_SUBRESOURCE_DATA* subresources, UINT count)
+{
+  auto desc = dst->GetDesc();
+  std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(count);
+  std::vector<UINT> numRows(count);
+  std::vector<UINT64> rowSizes(count);
+  UINT64 totalBytes = 0;
+  m_device->GetCopyableFootprints(&desc, firstSubresource, count, 0,
+    layouts.data(), numRows.data(), rowSizes.data(), &totalBytes);
+
+  auto staging = AllocateStaging(totalBytes);
+  auto commandList = GetCommandList();
+  for (UINT i = 0; i < count; ++i)
+  {
+    // フットプリントはステージング先頭からの位置に読み替える.
+    D3D12_MEMCPY_DEST dest{
+      static_cast<BYTE*>(staging.cpuAddress) + layouts[i].Offset,
+      layouts[i].Footprint.RowPitch,
+      SIZE_T(layouts[i].Footprint.RowPitch) * numRows[i]
+    };
+    MemcpySubresource(&dest, &subresources[i], SIZE_T(rowSizes[i]), numRows[i], layouts[i].Footprint.Depth);
+
+    layouts[i].Offset += staging.offset;
+    CD3DX12_TEXTURE_COPY_LOCATION dstLocation(dst, firstSubresource + i);
+    CD3DX12_TEXTURE_COPY_LOCATION srcLocation(staging.resource, layouts[i]);
+    commandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
+  }
+  ++m_stats.uploadCount;
+  m_stats.uploadedBytes += totalBytes;
+  return GetRecordingTicket();
+}
+
+UploadManager::Ticket UploadManager::Flush()
+{
+  if (!m_isRecording)
+  {
+    return m_queueFence->GetLastSignaled();
+  }
+  m_commandList->Close();
+  ID3D12CommandList* lists[] = { m_commandList.Get() };
+  m_queue->ExecuteCommandLists(1, lists);
+
+  auto ticket = m_queueFence->Signal();
+  m_stagingRing.EndFrame(ticket);
+  m_isRecording = false;
+  ++m_stats.batchCount;
+  return ticket;
+}
+
+bool UploadManager::IsComplete(Ticket ticket) const
+{
+  return m_queueFence->IsComplete(ticket);
+}
+
+void UploadManager::Wait(Ticket ticket)
+{
+  if (ticket > m_queueFence->GetLastSignaled())
+  {
+    ticket = Flush();
+  }
+  m_queueFence->WaitFor(ticket);
+  Retire();
+}
+
+void UploadManager::QueueWait(TimelineFence& queueFence, Ticket ticket)
+{
+  if (ticket > m_queueFence->GetLastSignaled())
+  {
+    ticket = Flush();
+  }
+  queueFence.QueueWait(*m_queueFence, ticket);
+}
+
+UploadManager::Stats UploadManager::GetStats() const
+{
+  auto stats = m_stats;
+  if (m_queueFence)
+  {
+    stats.cpuWaitMs = m_queueFence->GetStats().blockedMs;
+  }
+  return stats;
+}
+
+UploadManager::Ticket UploadManager::GetRecordingTicket() const
+{
+  return m_queueFence->GetLastSignaled() + 1;
+}
+
+UploadManager::StagingBlock UploadManager::AllocateStaging(UINT64 size)
+{
+  Retire();
+  auto units = uint32_t((size + StagingAlignment - 1) / StagingAlignment);
+  if (units <= m_stagingRing.GetCapacity())
+  {
+    auto offset = m_stagingRing.Allocate(units);
+    while (offset == RingAllocator::InvalidOffset)
+    {
+      // 記録中のものを投入し、古いバッチから順に完了を待って領域を空ける.
+      Flush();
+      if (m_stagingRing.GetPendingFrameCount() > 0)
+      {
+        Wait(m_queueFence->GetCompletedValue() + 1);
+      }
+      if (m_stagingRing.GetUsed() == 0)
+      {
+        // 空でも末尾の位置によっては連続領域が取れないため先頭へ戻す.
+        m_stagingRing.Reset(m_stagingRing.GetCapacity());
+      }
+      offset = m_stagingRing.Allocate(units);
+    }
+    m_stats.stagingPeak = std::max(m_stats.stagingPeak, UINT64(m_stagingRing.GetUsed()) * StagingAlignment);
+    StagingBlock block;
+    block.offset = UINT64(offset) * StagingAlignment;
+    block.cpuAddress = static_cast<BYTE*>(m_mappedStaging) + block.offset;
+    block.resource = m_staging.Get();
+    return block;
+  }
+
+  // リング全体より大きい場合は、このバッチ専用のバッファを用意する.
+  auto buffer = m_app->CreateResource(
+    CD3DX12_RESOURCE_DESC::Buffer(size),
+    D3D12_RESOURCE_STATE_GENERIC_READ,
+    nullptr,
+    D3D12_HEAP_TYPE_UPLOAD
+  );
+  StagingBlock block;
+  CD3DX12_RANGE readRange(0, 0);
+  HRESULT hr = buffer->Map(0, &readRange, &block.cpuAddress);
+  ThrowIfFailed(hr, "Map 失敗");
+  block.resource = buffer.Get();
+  block.offset = 0;
+  m_oversizeStaging.emplace_back(GetRecordingTicket(), buffer);
+  ++m_stats.oversizeCount;
+  return block;
+}
+
+ID3D12GraphicsCommandList* UploadManager::GetCommandList()
+{
+  if (m_isRecording)
+  {
+    return m_commandList.Get();
+  }
+  HRESULT hr;
+  ComPtr<ID3D12CommandAllocator> allocator;
+  if (m_freeAllocators.empty())
+  {
+    hr = m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator));
+    ThrowIfFailed(hr, "CreateCommandAllocator(Copy) 失敗");
+  }
+  else
+  {
+    allocator = m_freeAllocators.back();
+    m_freeAllocators.pop_back();
+  }
+  if (m_commandList)
+  {
+    m_commandList->Reset(allocator.Get(), nullptr);
+  }
+  else
+  {
+    hr = m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList));
+    ThrowIfFailed(hr, "CreateCommandList(Copy) 失敗");
+    m_commandList->SetName(L"UploadCommand");
+  }
+  m_pendingAllocators.emplace_back(GetRecordingTicket(), allocator);
+  m_isRecording = true;
+  return m_commandList.Get();
+}
+
+void UploadManager::Retire()
+{
+  auto completed = m_queueFence->GetCompletedValue();
+  m_stagingRing.Retire(completed);
+
+  auto isDone = [completed](const std::pair<Ticket, ComPtr<ID3D12CommandAllocator>>& entry) {
+    return entry.first <= completed;
+  };
+  for (auto& entry : m_pendingAllocators)
+  {
+    if (isDone(entry))
+    {
+      entry.second->Reset();
+      m_freeAllocators.push_back(entry.second);
+    }
+  }
+  m_pendingAllocators.erase(
+    std::remove_if(m_pendingAllocators.begin(), m_pendingAllocators.end(), isDone),
+    m_pendingAllocators.end());
+  m_oversizeStaging.erase(
+    std::remove_if(m_oversizeStaging.begin(), m_oversizeStaging.end(),
+      [completed](const std::pair<Ticket, ComPtr<ID3D12Resource1>>& entry) { return entry.first <= completed; }),
+    m_oversizeStaging.end());
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <vector>
+#include <utility>
+#include <memory>
+
+#include "RingAllocator.h"
+#include "TimelineFence.h"
+
+class D3D12AppBase;
+
+// コピーキューを使って、バッファやテクスチャへの転送をまとめて実行する.
+// 転送データはステージング用のリングへ書き込み、コピーコマンドは1つのコマンドリストへ積む.
+// Flush で1回の ExecuteCommandLists として投入し、完了を示すチケット(フェンス値)を返す.
+// 転送先は利用するキューで QueueWait してから使うこと(GPU 側で待つため CPU は止まらない).
+// コピーキューで扱ったリソースは完了時に COMMON へ戻り、描画時の暗黙の昇格で使用できる.
+class UploadManager
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+  using Ticket = TimelineFence::Ticket;
+
+  enum : UINT64 { StagingAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT };
+
+  struct Stats
+  {
+    UINT64 batchCount;       // 投入回数.
+    UINT64 uploadCount;      // 転送要求の数.
+    UINT64 uploadedBytes;
+    UINT64 stagingCapacity;
+    UINT64 stagingPeak;
+    UINT64 oversizeCount;    // リングに収まらず一時バッファを使った数.
+    double cpuWaitMs;        // 完了待ちやリングの空き待ちで CPU が止まった時間(コピーキューのフェンスの集計).
+  };
+
+  UploadManager();
+  ~UploadManager();
+
+  void Prepare(D3D12AppBase* app, UINT64 stagingSize);
+  // 投入済みの転送の完了を待ってから破棄する.
+  void Cleanup();
+
+  // dst は COPY_DEST か COMMON であること. 返すチケットは次の Flush で投入されるバッチを示す.
+  Ticket UploadBuffer(ID3D12Resource* dst, UINT64 dstOffset, const void* data, UINT64 size);
+  Ticket UploadTexture(ID3D12Resource* dst, UINT firstSubresource, const D3D12_SUBRESOURCE_DATA* subresources, UINT count);
+
+  // 積まれた転送を投入する. 何も無ければ直前に投入したバッチのチケットを返す.
+  Ticket Flush();
+
+  bool IsComplete(Ticket ticket) const;
+  // CPU で完了を待つ. 未投入のバッチであれば先に投入する.
+  void Wait(Ticket ticket);
+  // queueFence のキューがチケットの完了を GPU 上で待つようにする.
+  void QueueWait(TimelineFence& queueFence, Ticket ticket);
+
+  std::shared_ptr<TimelineFence> GetQueueFence() { return m_queueFence; }
+  Stats GetStats() const;
+private:
+  struct StagingBlock
+  {
+    void* cpuAddress;
+    ID3D12Resource* resource;
+    UINT64 offset;
+  };
+  // ステージング領域を確保する. リングが一杯の場合は古いバッチの完了を待つ.
+  StagingBlock AllocateStaging(UINT64 size);
+  ID3D12GraphicsCommandList* GetCommandList();
+  // 記録中のバッチが投入時に受け取るチケット.
+  Ticket GetRecordingTicket() const;
+  void Retire();
+
+  D3D12AppBase* m_app;
+  ComPtr<ID3D12Device> m_device;
+  ComPtr<ID3D12CommandQueue> m_queue;
+  std::shared_ptr<TimelineFence> m_queueFence;
+
+  ComPtr<ID3D12GraphicsCommandList> m_commandList;
+  bool m_isRecording;
+  // 投入したバッチのアロケータ. 完了後に再利用する.
+  std::vector<std::pair<Ticket, ComPtr<ID3D12CommandAllocator>>> m_pendingAllocators;
+  std::vector<ComPtr<ID3D12CommandAllocator>> m_freeAllocators;
+
+  ComPtr<ID3D12Resource1> m_staging;
+  void* m_mappedStaging;
+  RingAllocator m_stagingRing;  // StagingAlignment 単位で管理する.
+  std::vector<std::pair<Ticket, ComPtr<ID3D12Resource1>>> m_oversizeStaging;
+
+  Stats m_stats;
+};
@@ -0,0 +1,114 @@
+﻿#include "UploadRing.h"
+#include "D3D12AppBase.h"
+#include "D3D12BookUtil.h"
+
+#include <algorithm>
+#include <string>
+
+UploadRing::UploadRing()
+  : m_mapped(nullptr), m_baseAddress(0), m_peakUsed(0), m_bytesThisFrame(0), m_skippedBytesThisFrame(0), m_allocationsThisFrame(0)
+{
+}
+
+UploadRing::~UploadRing()
+{
+  Cleanup();
+}
+
+void UploadRing::Prepare(D3D12AppBase* app, UINT64 size)
+{
+  auto units = (size + Alignment - 1) / Alignment;
+  m_buffer = app->CreateResource(
+    CD3DX12_RESOURCE_DESC::Buffer(units * Alignment),
+    D3D12_RESOURCE_STATE_GENERIC_READ,
+    nullptr,
+    D3D12_HEAP_TYPE_UPLOAD
+  );
+  // CPU から読み戻すことはないため、読み取り範囲は空にしておく.
+  CD3DX12_RANGE readRange(0, 0);
+  HRESULT hr = m_buffer->Map(0, &readRange, &m_mapped);
+  ThrowIfFailed(hr, "UploadRing Map failed.");
+  m_baseAddress = m_buffer->GetGPUVirtualAddress();
+  m_allocator.Reset(uint32_t(units));
+  m_peakUsed = 0;
+  m_bytesThisFrame = 0;
+  m_skippedBytesThisFrame = 0;
+  m_allocationsThisFrame = 0;
+}
+
+void UploadRing::Cleanup()
+{
+  if (m_buffer && m_mapped)
+  {
+    m_buffer->Unmap(0, nullptr);
+  }
+  m_mapped = nullptr;
+  m_buffer.Reset();
+}
+
+void UploadRing::BeginFrame(UINT64 completedFenceValue)
+{
+  m_allocator.Retire(completedFenceValue);
+  m_bytesThisFrame = 0;
+  m_skippedBytesThisFrame = 0;
+  m_allocationsThisFrame = 0;
+}
+
+UploadRing::Allocation UploadRing::Allocate(UINT64 size)
+{
+  auto units = uint32_t((size + Alignment - 1) / Alignment);
+  auto offset = m_allocator.Allocate(units);
+  if (offset == RingAllocator::InvalidOffset)
+  {
+    throw book_util::DX12Exception(
+      "UploadRing exhausted. request=" + std::to_string(size) +
+      " used=" + std::to_string(UINT64(m_allocator.GetUsed()) * Alignment) +
+      "/" + std::to_string(UINT64(m_allocator.GetCapacity()) * Alignment));
+  }
+  m_peakUsed = std::max(m_peakUsed, UINT64(m_allocator.GetUsed()) * Alignment);
+  m_bytesThisFrame += UINT64(units) * Alignment;
+  ++m_allocationsThisFrame;
+
+  Allocation ret;
+  ret.offset = UINT64(offset) * Alignment;
+  ret.size = size;
+  ret.cpuAddress = static_cast<char*>(m_mapped) + ret.offset;
+  ret.gpuAddress = m_baseAddress + ret.offset;
+  return ret;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadRing::Push(const void* data, UINT64 size)
+{
+  auto allocation = Allocate(size);
+  memcpy(allocation.cpuAddress, data, size_t(size));
+  return allocation.gpuAddress;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadRing::Push(const void* data, UINT64 size, const ConstantBufferRange& range)
+{
+  auto end = std::min<UINT64>(range.end, size);
+  auto begin = std::min<UINT64>(range.begin, end);
+  // 何も読まない場合もアドレスは要るため、最小の単位を確保する.
+  auto allocation = Allocate(std::max<UINT64>(end, 1));
+  memcpy(static_cast<char*>(allocation.cpuAddress) + begin, static_cast<const char*>(data) + begin, size_t(end - begin));
+  m_skippedBytesThisFrame += size - (end - begin);
+  return allocation.gpuAddress;
+}
+
+void UploadRing::EndFrame(UINT64 fenceValue)
+{
+  m_allocator.EndFrame(fenceValue);
+}
+
+UploadRing::Stats UploadRing::GetStats() const
+{
+  Stats stats{};
+  stats.capacity = UINT64(m_allocator.GetCapacity()) * Alignment;
+  stats.used = UINT64(m_allocator.GetUsed()) * Alignment;
+  stats.peakUsed = m_peakUsed;
+  stats.bytesThisFrame = m_bytesThisFrame;
+  stats.skippedBytesThisFrame = m_skippedBytesThisFrame;
+  stats.allocationsThisFrame = m_allocationsThisFrame;
+  stats.wrapCount = m_allocator.GetWrapCount();
+  return stats;
+}
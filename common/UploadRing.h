@@ -0,0 +1,78 @@
+﻿#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "ConstantBufferLayout.h"
+#include "RingAllocator.h"
+
+class D3D12AppBase;
+
+// 毎フレーム書き換える定数バッファなどを切り出すためのアップロード用リング.
+// バッファは常時マップしておき、256 バイト境界の前詰めで確保する.
+// 確保した領域は EndFrame で渡したフェンス値が完了するまで再利用しない.
+// 返す GPU 仮想アドレスはルート CBV にそのまま設定できる.
+class UploadRing
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  enum : UINT64 { Alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT };
+
+  struct Allocation
+  {
+    void* cpuAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    UINT64 offset;
+    UINT64 size;
+  };
+
+  struct Stats
+  {
+    UINT64 capacity;
+    UINT64 used;
+    UINT64 peakUsed;
+    UINT64 bytesThisFrame;
+    UINT64 skippedBytesThisFrame; // 範囲付きの Push で書き込みを省いたバイト数.
+    UINT allocationsThisFrame;
+    UINT64 wrapCount;
+  };
+
+  UploadRing();
+  ~UploadRing();
+
+  void Prepare(D3D12AppBase* app, UINT64 size);
+  void Cleanup();
+
+  // フレームの記録開始時に呼び、完了済みのフレームが使った領域を回収する.
+  void BeginFrame(UINT64 completedFenceValue);
+
+  // size バイトを確保する. 空きが無い場合は例外を投げる.
+  Allocation Allocate(UINT64 size);
+
+  // data を書き込み、その GPU 仮想アドレスを返す.
+  D3D12_GPU_VIRTUAL_ADDRESS Push(const void* data, UINT64 size);
+  template<class T>
+  D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data) { return Push(&data, sizeof(T)); }
+  // data のうちシェーダーが読む範囲 (ConstantBufferBinding::GetUsedRange) だけを同じオフセットへ書き込む.
+  // 先頭は CBV の境界のため詰めず、確保は範囲の末尾までにする.
+  D3D12_GPU_VIRTUAL_ADDRESS Push(const void* data, UINT64 size, const ConstantBufferRange& range);
+  template<class T>
+  D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data, const ConstantBufferRange& range) { return Push(&data, sizeof(T), range); }
+
+  // フレームの投入後、そのフレームの完了を示すフェンス値で区切る.
+  void EndFrame(UINT64 fenceValue);
+
+  ComPtr<ID3D12Resource1> GetResource() const { return m_buffer; }
+  Stats GetStats() const;
+private:
+  ComPtr<ID3D12Resource1> m_buffer;
+  void* m_mapped;
+  D3D12_GPU_VIRTUAL_ADDRESS m_baseAddress;
+  RingAllocator m_allocator;  // Alignment 単位で管理する.
+
+  UINT64 m_peakUsed;
+  UINT64 m_bytesThisFrame;
+  UINT64 m_skippedBytesThisFrame;
+  UINT m_allocationsThisFrame;
+};
@@ -0,0 +1,148 @@
+﻿#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 常駐するワーカースレッドで [0, count) を分担して func(i) を呼ぶ. 呼び出したスレッドも処理に加わる.
+// ParallelFor と同じ分担の仕方だが、スレッドを生成時に1度だけ作るため、フレーム毎の呼び出しでも生成と破棄の負荷がかからない.
+// Run は全ての番号の処理が終わるまで戻らない. 同時に Run できるのは1つのスレッドからのみ.
+// func が投げた例外は全ての処理が終わってから、番号の最も小さいものを投げ直す.
+class WorkerThreadPool
+{
+public:
+  // workerCount は呼び出したスレッドを除く本数. 0 なら論理コア数 - 1 を使う.
+  explicit WorkerThreadPool(unsigned workerCount = 0)
+    : m_func(nullptr), m_count(0), m_next(0), m_activeWorkers(0), m_generation(0), m_isExiting(false)
+  {
+    if (workerCount == 0)
+    {
+      workerCount = (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    for (unsigned i = 0; i < workerCount; ++i)
+    {
+      m_threads.emplace_back([this]() { WorkerMain(); });
+    }
+  }
+  WorkerThreadPool(const WorkerThreadPool&) = delete;
+  WorkerThreadPool& operator=(const WorkerThreadPool&) = delete;
+
+  ~WorkerThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_isExiting = true;
+    }
+    m_wakeUp.notify_all();
+    for (auto& t : m_threads)
+    {
+      t.join();
+    }
+  }
+
+  unsigned GetWorkerCount() const { return unsigned(m_threads.size()); }
+
+  void Run(size_t count, const std::function<void(size_t)>& func)
+  {
+    if (count == 0)
+    {
+      return;
+    }
+    m_errors.assign(count, nullptr);
+    // 1つだけなら呼び出したスレッドで済ませ、ワーカーは起こさない.
+    const bool isWakeUp = count > 1 && !m_threads.empty();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_func = &func;
+      m_count = count;
+      m_next = 0;
+      if (isWakeUp)
+      {
+        m_activeWorkers = unsigned(m_threads.size());
+        ++m_generation;
+      }
+    }
+    if (isWakeUp)
+    {
+      m_wakeUp.notify_all();
+    }
+    Work();
+    {
+      // ワーカーが func を参照し終えるまで待つ.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+      m_func = nullptr;
+    }
+    for (auto& error : m_errors)
+    {
+      if (error)
+      {
+        std::rethrow_exception(error);
+      }
+    }
+  }
+
+private:
+  // 次の番号を取りに行きながら、残りが無くなるまで処理する.
+  void Work()
+  {
+    for (;;)
+    {
+      size_t i;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next >= m_count)
+        {
+          return;
+        }
+        i = m_next++;
+      }
+      try
+      {
+        (*m_func)(i);
+      }
+      catch (...)
+      {
+        m_errors[i] = std::current_exception();
+      }
+    }
+  }
+
+  void WorkerMain()
+  {
+    unsigned long long generation = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wakeUp.wait(lock, [&]() { return m_isExiting || m_generation != generation; });
+        if (m_isExiting)
+        {
+          return;
+        }
+        generation = m_generation;
+      }
+      Work();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_activeWorkers;
+      }
+      m_done.notify_one();
+    }
+  }
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+  std::condition_variable m_done;
+  const std::function<void(size_t)>* m_func;
+  size_t m_count;
+  size_t m_next;
+  unsigned m_activeWorkers;          // Run の呼び出しに加わり、まだ戻っていないワーカーの数.
+  unsigned long long m_generation;   // Run でワーカーを起こした回数.
+  bool m_isExiting;
+  std::vector<std::exception_ptr> m_errors;
+};